@@ -0,0 +1,65 @@
+// Channel throughput for 1:1, N:1 and N:M producer/consumer setups, on a
+// bounded and an unbounded channel. Each producer sends `messages / N`
+// numbers and the consumers drain the channel until it is closed.
+//
+// Usage: channel_bench [messages] [threads]
+#include "lib/runtime/channel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace Quastra;
+
+// Returns messages per second.
+static double run(size_t capacity, int producers, int consumers, long messages) {
+    Channel<long> channel(capacity);
+    long per_producer = messages / producers;
+    std::atomic<long> received{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i) {
+        threads.emplace_back([&] {
+            long count = 0;
+            for (long value : channel) {
+                (void)value;
+                count++;
+            }
+            received += count;
+        });
+    }
+    std::vector<std::thread> senders;
+    for (int i = 0; i < producers; ++i) {
+        senders.emplace_back([&] {
+            for (long n = 0; n < per_producer; ++n) channel.send(n);
+        });
+    }
+    for (auto& sender : senders) sender.join();
+    channel.close();
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (received.load() != per_producer * producers) {
+        std::fprintf(stderr, "lost messages: %ld of %ld\n", received.load(), per_producer * producers);
+        std::exit(1);
+    }
+    return received.load() / seconds;
+}
+
+int main(int argc, char** argv) {
+    long messages = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    struct Setup {
+        const char* name;
+        int producers;
+        int consumers;
+    };
+    const Setup setups[] = {{"1:1", 1, 1}, {"N:1", threads, 1}, {"N:M", threads, threads}};
+    std::printf("%-8s%18s%18s\n", "setup", "bounded(1024)", "unbounded");
+    for (const Setup& setup : setups) {
+        double bounded = run(1024, setup.producers, setup.consumers, messages);
+        double unbounded = run(0, setup.producers, setup.consumers, messages);
+        std::printf("%-8s%14.2f M/s%14.2f M/s\n", setup.name, bounded / 1e6, unbounded / 1e6);
+    }
+    return 0;
+}
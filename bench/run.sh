@@ -0,0 +1,47 @@
+#!/bin/sh
+# Runs every example and benchmark program on each execution engine (and
+# the tree engine with the baseline JIT or the native tier) and prints the
+# wall-clock time of each run. The outputs of the engines must match; a
+# mismatch is reported and makes the script fail.
+#
+# Usage: bench/run.sh [path/to/quastra] [extra compiler flags...]
+
+QUASTRA=${1:-build/bin/quastra}
+[ $# -gt 0 ] && shift
+ENGINES="tree closure vm jit tiered"
+status=0
+
+seconds() {
+    date +%s.%N
+}
+
+flags() {
+    case $1 in
+        jit) echo "--engine=tree --jit" ;;
+        tiered) echo "--engine=tree --tiered" ;;
+        *) echo "--engine=$1" ;;
+    esac
+}
+
+printf "%-36s" "program"
+for engine in $ENGINES; do printf "%12s" "$engine"; done
+printf "\n"
+
+for program in examples/*.qstra bench/*.qstra; do
+    printf "%-36s" "$program"
+    reference=""
+    for engine in $ENGINES; do
+        start=$(seconds)
+        output=$("$QUASTRA" --run $(flags "$engine") "$@" "$program" 2>&1; echo "exit $?")
+        end=$(seconds)
+        awk -v s="$start" -v e="$end" 'BEGIN { printf "%11.3fs", e - s }'
+        if [ -z "$reference" ]; then
+            reference=$output
+        elif [ "$output" != "$reference" ]; then
+            printf "  (output differs)"
+            status=1
+        fi
+    done
+    printf "\n"
+done
+exit $status
@@ -2,21 +2,349 @@
 
 namespace Quastra {
 
+namespace {
+
+// Whether `stmt` contains `return f(...)` where f is the enclosing function.
+// Nested functions are not searched; their returns belong to them.
+bool has_self_tail_call(const AST::Stmt& stmt) {
+    if (auto ret = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        auto call = dynamic_cast<const AST::Call*>(ret->value.get());
+        return call && call->is_self_call;
+    }
+    if (auto block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s && has_self_tail_call(*s)) return true;
+        }
+        return false;
+    }
+    if (auto if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return (if_stmt->then_branch && has_self_tail_call(*if_stmt->then_branch)) ||
+               (if_stmt->else_branch && has_self_tail_call(*if_stmt->else_branch));
+    }
+    if (auto while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return while_stmt->body && has_self_tail_call(*while_stmt->body);
+    }
+    return false;
+}
+
+// Async functions are C++20 coroutines. One starts when it is called, as
+// in the Interpreter, and runs until it awaits a future that is still
+// pending; quastra_loop resumes it once the future completes, and fires the
+// timers sleep() sets. Coroutines still waiting when main returns run
+// before the program exits. The prelude goes after io_prelude, whose
+// output buffer has to outlive them.
+const char* const async_prelude = R"(struct QuastraLoop {
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        unsigned long long sequence;
+        std::function<void()> fire;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    std::deque<std::coroutine_handle<>> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    unsigned long long timer_sequence = 0;
+
+    void add_timer(double milliseconds, std::function<void()> fire) {
+        auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(milliseconds > 0 ? milliseconds : 0));
+        timers.push({std::chrono::steady_clock::now() + delay, timer_sequence++, std::move(fire)});
+    }
+
+    // Fires the timers that are due, sleeping until the first one if no
+    // coroutine is ready, then resumes the next ready one. Returns false
+    // if there was nothing to do.
+    bool step() {
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && (ready.empty() || timers.top().deadline <= now)) {
+            if (timers.top().deadline > now) {
+                std::this_thread::sleep_until(timers.top().deadline);
+                now = std::chrono::steady_clock::now();
+            }
+            std::function<void()> fire = timers.top().fire;
+            timers.pop();
+            fire();
+        }
+        if (ready.empty()) return false;
+        std::coroutine_handle<> next = ready.front();
+        ready.pop_front();
+        next.resume();
+        return true;
+    }
+
+    ~QuastraLoop() {
+        while (step()) {}
+    }
+};
+
+QuastraLoop quastra_loop;
+
+template <typename T> struct QuastraFuture {
+    using Value = std::conditional_t<std::is_void_v<T>, bool, T>;
+
+    struct State {
+        bool done = false;
+        Value value{};
+        std::vector<std::coroutine_handle<>> waiters;
+
+        void complete() {
+            done = true;
+            for (auto waiter : waiters) quastra_loop.ready.push_back(waiter);
+            waiters.clear();
+        }
+    };
+
+    struct PromiseBase {
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        QuastraFuture get_return_object() { return {state}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void unhandled_exception() { throw; }
+    };
+    struct ValuePromise : PromiseBase {
+        void return_value(Value value) {
+            this->state->value = std::move(value);
+            this->state->complete();
+        }
+    };
+    struct VoidPromise : PromiseBase {
+        void return_void() { this->state->complete(); }
+    };
+    using promise_type = std::conditional_t<std::is_void_v<T>, VoidPromise, ValuePromise>;
+
+    std::shared_ptr<State> state;
+
+    bool await_ready() const { return state->done; }
+    void await_suspend(std::coroutine_handle<> waiter) const { state->waiters.push_back(waiter); }
+    T await_resume() const {
+        if constexpr (!std::is_void_v<T>) return state->value;
+    }
+};
+
+// What awaiting the future gives. Each async body is also generated as a
+// plain lambda that awaits with this, only for decltype to find the type
+// of its result; it is never called.
+template <typename T> T quastra_result_of(const QuastraFuture<T>& future);
+
+// The exit status of an async main, once it is done: its number, or 0.
+template <typename T> int quastra_exit_status(const QuastraFuture<T>& future) {
+    while (!future.state->done) {
+        if (!quastra_loop.step()) {
+            std::cerr << "Runtime Error: Awaited a future that can never complete." << std::endl;
+            return 70;
+        }
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+        return static_cast<int>(future.state->value);
+    } else {
+        return 0;
+    }
+}
+
+)";
+
+// sleep(ms) for generated programs: a future that quastra_loop completes
+// after `ms` milliseconds, running other coroutines meanwhile.
+const char* const sleep_prelude = R"(QuastraFuture<bool> quastra_sleep(double milliseconds) {
+    QuastraFuture<bool> future{std::make_shared<QuastraFuture<bool>::State>()};
+    quastra_loop.add_timer(milliseconds, [state = future.state] { state->complete(); });
+    return future;
+}
+
+)";
+
+} // namespace
+
+const char* const CodeGen::io_prelude = R"(// Output is held in a buffer and written when it is full, on flush(),
+// before reading stdin and at exit.
+struct QuastraOutput {
+    char buffer[1 << 16];
+    size_t size = 0;
+
+    void put(const char* text, size_t length) {
+        if (size + length > sizeof(buffer)) drain();
+        if (length > sizeof(buffer)) {
+            std::fwrite(text, 1, length, stdout);
+            return;
+        }
+        std::memcpy(buffer + size, text, length);
+        size += length;
+    }
+
+    void drain() {
+        std::fwrite(buffer, 1, size, stdout);
+        std::fflush(stdout);
+        size = 0;
+    }
+
+    ~QuastraOutput() { drain(); }
+};
+
+QuastraOutput quastra_output;
+
+template <typename T> void quastra_put(const T& value) {
+    if constexpr (std::is_same_v<T, bool>) {
+        quastra_output.put(value ? "true" : "false", value ? 4 : 5);
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%g", static_cast<double>(value));
+        quastra_output.put(text, length);
+    } else {
+        std::string text(value);
+        quastra_output.put(text.data(), text.size());
+    }
+}
+
+template <typename T> bool quastra_print(const T& value) {
+    quastra_put(value);
+    return false;
+}
+
+template <typename T> bool quastra_println(const T& value) {
+    quastra_put(value);
+    quastra_output.put("\n", 1);
+    return false;
+}
+
+double quastra_write(const std::string& text) {
+    quastra_output.put(text.data(), text.size());
+    return text.size();
+}
+
+bool quastra_flush() {
+    quastra_output.drain();
+    return false;
+}
+
+// Gives "" rather than false at the end of the input.
+std::string quastra_read_line() {
+    quastra_output.drain();
+    std::string line;
+    std::getline(std::cin, line);
+    return line;
+}
+
+)";
+
+bool CodeGen::is_io_native(const std::string& name) {
+    return name == "print" || name == "println" || name == "write" || name == "flush" || name == "read_line";
+}
+
+namespace {
+
+bool declares_async(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& stmt : statements) {
+        auto function = dynamic_cast<const AST::FunctionStmt*>(stmt.get());
+        if (function && (function->is_async || declares_async(function->body))) return true;
+    }
+    return false;
+}
+
+} // namespace
+
 std::string CodeGen::generate(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
-    // Add standard C++ includes.
-    output << "#include <iostream>\n";
-    output << "#include <vector>\n\n";
+    for (const auto& stmt : statements) {
+        if (auto function = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            user_globals.insert(function->name.lexeme);
+        } else if (auto var = dynamic_cast<const AST::VarDecl*>(stmt.get())) {
+            user_globals.insert(var->name.lexeme);
+        }
+    }
 
     // Generate code for each top-level statement (now including functions).
+    // The includes and preludes depend on what it uses, so they go in front
+    // afterwards.
     for (const auto& stmt : statements) {
         if (stmt) {
             generate_code(*stmt);
         }
     }
+    std::string body = output.str();
+    output.str("");
+
+    bool is_async = declares_async(statements) || uses_sleep;
+    if (is_async) output << "#include <chrono>\n#include <coroutine>\n";
+    if (uses_io) output << "#include <cstdio>\n#include <cstring>\n";
+    if (is_async) output << "#include <deque>\n#include <functional>\n";
+    output << "#include <iostream>\n";
+    if (is_async) output << "#include <memory>\n#include <queue>\n";
+    if (uses_io) output << "#include <string>\n";
+    if (is_async) output << "#include <thread>\n";
+    if (is_async || uses_io) output << "#include <type_traits>\n";
+    output << "#include <vector>\n\n";
+    if (uses_io) output << io_prelude;
+    if (is_async) output << async_prelude;
+    if (uses_sleep) output << sleep_prelude;
+    output << body;
+    return output.str();
+}
+
+std::string CodeGen::generate_native(const std::vector<const AST::FunctionStmt*>& functions) {
+    native = true;
+    output << "// Generated by the Quastra native tier.\n";
+    output << "namespace {\n\n";
+    output << "struct QuastraBailout {};\n";
+    output << "int quastra_depth = 0;\n";
+    output << "const int quastra_max_depth = 20000;\n\n";
+    output << "double quastra_bail() { throw QuastraBailout(); }\n\n";
+    output << "double quastra_divide(double a, double b) { return b == 0 ? quastra_bail() : a / b; }\n\n";
+    output << "struct QuastraFrame {\n";
+    output << "    QuastraFrame() {\n";
+    output << "        if (++quastra_depth > quastra_max_depth) {\n";
+    output << "            --quastra_depth;\n";
+    output << "            throw QuastraBailout();\n";
+    output << "        }\n";
+    output << "    }\n";
+    output << "    ~QuastraFrame() { --quastra_depth; }\n";
+    output << "};\n\n";
+
+    // Declare everything first; the functions may call each other.
+    for (const auto* function : functions) {
+        output << "double " << function->name.lexeme << "(";
+        for (size_t i = 0; i < function->params.size(); ++i) {
+            output << (i ? ", " : "") << "double " << function->params[i].lexeme;
+        }
+        output << ");\n";
+    }
+    output << "\n";
+    for (const auto* function : functions) {
+        generate_code(*function);
+    }
+    output << "} // namespace\n\n";
 
+    for (const auto* function : functions) {
+        output << "extern \"C\" int quastra_native_" << function->name.lexeme
+               << "(const double* arguments, double* result) {\n";
+        output << "    (void)arguments;\n";
+        output << "    quastra_depth = 0;\n";
+        output << "    try {\n";
+        output << "        *result = " << function->name.lexeme << "(";
+        for (size_t i = 0; i < function->params.size(); ++i) {
+            output << (i ? ", " : "") << "arguments[" << i << "]";
+        }
+        output << ");\n";
+        output << "        return 1;\n";
+        output << "    } catch (const QuastraBailout&) {\n";
+        output << "        return 0;\n";
+        output << "    }\n";
+        output << "}\n\n";
+    }
+    native = false;
     return output.str();
 }
 
+bool CodeGen::calls_native(const std::string& name) const {
+    if ((!is_io_native(name) && name != "sleep") || user_globals.count(name)) return false;
+    for (const auto& scope : local_scopes) {
+        if (scope.count(name)) return false;
+    }
+    return true;
+}
+
 // --- Visitor Implementations ---
 
 void CodeGen::indent() {
@@ -33,24 +361,28 @@ void CodeGen::visit(const AST::ExprStmt& stmt) {
 
 void CodeGen::visit(const AST::VarDecl& stmt) {
     indent();
-    output << "auto " << stmt.name.lexeme << " = ";
+    const char* type = native ? "double " : "auto ";
+    output << (stmt.is_const ? "const " : "") << type << stmt.name.lexeme << " = ";
     if (stmt.initializer) {
         generate_code(*stmt.initializer);
     } else {
         output << "0"; // Default initialize
     }
     output << ";\n";
+    if (!local_scopes.empty()) local_scopes.back().insert(stmt.name.lexeme);
 }
 
 void CodeGen::visit(const AST::Block& stmt) {
     output << "{\n";
     indent_level++;
+    local_scopes.emplace_back();
     for (const auto& statement : stmt.statements) {
         // CORRECTED: Add safety check for null statements from parser recovery.
         if (statement) {
             generate_code(*statement);
         }
     }
+    local_scopes.pop_back();
     indent_level--;
     indent();
     output << "}\n";
@@ -87,33 +419,123 @@ void CodeGen::visit(const AST::WhileStmt& stmt) {
 }
 
 void CodeGen::visit(const AST::FunctionStmt& stmt) {
-    if (stmt.name.lexeme == "main") {
+    if (!local_scopes.empty()) local_scopes.back().insert(stmt.name.lexeme);
+    const char* type = native ? "double " : "auto ";
+    // An async main is emitted as quastra_main, and the C++ main waits for
+    // its future.
+    bool async_main = stmt.name.lexeme == "main" && stmt.is_async && !native && local_scopes.empty();
+    if (async_main) {
+        output << "auto quastra_main(";
+    } else if (stmt.name.lexeme == "main" && !native) {
         output << "int " << stmt.name.lexeme << "(";
     } else {
-        output << "auto " << stmt.name.lexeme << "(";
+        output << type << stmt.name.lexeme << "(";
     }
 
     for (size_t i = 0; i < stmt.params.size(); ++i) {
-        output << "auto " << stmt.params[i].lexeme;
+        output << type << stmt.params[i].lexeme;
         if (i < stmt.params.size() - 1) output << ", ";
     }
     output << ") ";
 
     output << "{\n";
+    AsyncBody enclosing = async_body;
+    if (!stmt.is_async) {
+        async_body = AsyncBody::None;
+        generate_body(stmt);
+    } else {
+        // The body is generated twice: as a plain lambda, whose return
+        // type is the coroutine's result, then as the coroutine. That takes
+        // the parameters as its own, since its frame outlives the call.
+        indent_level++;
+        indent();
+        output << "auto quastra_body = [=]() mutable {\n";
+        async_body = AsyncBody::Typing;
+        generate_body(stmt);
+        indent();
+        output << "};\n";
+        indent();
+        output << "return [](";
+        for (size_t i = 0; i < stmt.params.size(); ++i) {
+            output << (i ? ", " : "") << type << stmt.params[i].lexeme;
+        }
+        output << ") -> QuastraFuture<decltype(quastra_body())> {\n";
+        async_body = AsyncBody::Coroutine;
+        generate_body(stmt);
+        indent();
+        output << "}(";
+        for (size_t i = 0; i < stmt.params.size(); ++i) {
+            output << (i ? ", " : "") << stmt.params[i].lexeme;
+        }
+        output << ");\n";
+        indent_level--;
+    }
+    async_body = enclosing;
+    indent();
+    output << "}\n\n";
+    if (async_main) output << "int main() {\n    return quastra_exit_status(quastra_main());\n}\n\n";
+}
+
+void CodeGen::generate_body(const AST::FunctionStmt& stmt) {
+    const AST::FunctionStmt* enclosing = tail_function;
+    tail_function = nullptr;
+    // An async function's self call gives a future, so it is a call.
+    for (const auto& statement : stmt.body) {
+        if (!stmt.is_async && statement && has_self_tail_call(*statement)) tail_function = &stmt;
+    }
+    if (tail_function) output << "tail_call:\n";
     indent_level++;
+    local_scopes.emplace_back();
+    for (const auto& param : stmt.params) {
+        local_scopes.back().insert(param.lexeme);
+    }
+    if (native) {
+        indent();
+        output << "QuastraFrame quastra_frame;\n";
+    }
     for (const auto& statement : stmt.body) {
         if (statement) {
             generate_code(*statement);
         }
     }
+    if (native) {
+        indent();
+        output << "return quastra_bail();\n";
+    }
+    local_scopes.pop_back();
     indent_level--;
-    indent();
-    output << "}\n\n";
+    tail_function = enclosing;
 }
 
 void CodeGen::visit(const AST::ReturnStmt& stmt) {
+    auto call = dynamic_cast<const AST::Call*>(stmt.value.get());
+    if (tail_function && call && call->is_self_call) {
+        // Evaluate every argument before updating any parameter, since the
+        // arguments may read the parameters.
+        const auto& params = tail_function->params;
+        indent();
+        output << "{\n";
+        indent_level++;
+        for (size_t i = 0; i < params.size(); ++i) {
+            indent();
+            output << "auto __tail_" << params[i].lexeme << " = ";
+            generate_code(*call->arguments[i]);
+            output << ";\n";
+        }
+        for (const auto& param : params) {
+            indent();
+            output << param.lexeme << " = __tail_" << param.lexeme << ";\n";
+        }
+        indent();
+        output << "goto tail_call;\n";
+        indent_level--;
+        indent();
+        output << "}\n";
+        return;
+    }
+
     indent();
-    output << "return ";
+    output << (async_body == AsyncBody::Coroutine ? "co_return " : "return ");
     if (stmt.value) {
         generate_code(*stmt.value);
     }
@@ -121,7 +543,14 @@ void CodeGen::visit(const AST::ReturnStmt& stmt) {
 }
 
 void CodeGen::visit(const AST::Literal& expr) {
+    if (expr.value.type == TokenType::StringLiteral) {
+        // Quastra's escapes are C++'s; std::string makes `+` concatenate.
+        output << "std::string(" << expr.value.lexeme << ")";
+        return;
+    }
     output << expr.value.lexeme;
+    // Keep `1 / 2` a floating-point division.
+    if (native && expr.value.type == TokenType::IntLiteral) output << ".0";
 }
 
 void CodeGen::visit(const AST::Variable& expr) {
@@ -135,12 +564,26 @@ void CodeGen::visit(const AST::Assign& expr) {
 }
 
 void CodeGen::visit(const AST::Unary& expr) {
+    if (expr.op.type == TokenType::Await) {
+        output << (async_body == AsyncBody::Typing ? "quastra_result_of(" : "(co_await ");
+        generate_code(*expr.right);
+        output << ")";
+        return;
+    }
     output << "(" << expr.op.lexeme;
     generate_code(*expr.right);
     output << ")";
 }
 
 void CodeGen::visit(const AST::Binary& expr) {
+    if (native && expr.op.type == TokenType::Slash) {
+        output << "quastra_divide(";
+        generate_code(*expr.left);
+        output << ", ";
+        generate_code(*expr.right);
+        output << ")";
+        return;
+    }
     output << "(";
     generate_code(*expr.left);
     output << " " << expr.op.lexeme << " ";
@@ -149,7 +592,13 @@ void CodeGen::visit(const AST::Binary& expr) {
 }
 
 void CodeGen::visit(const AST::Call& expr) {
-    generate_code(*expr.callee);
+    auto callee = dynamic_cast<const AST::Variable*>(expr.callee.get());
+    if (!native && callee && calls_native(callee->name.lexeme)) {
+        (callee->name.lexeme == "sleep" ? uses_sleep : uses_io) = true;
+        output << "quastra_" << callee->name.lexeme;
+    } else {
+        generate_code(*expr.callee);
+    }
     output << "(";
     for (size_t i = 0; i < expr.arguments.size(); ++i) {
         generate_code(*expr.arguments[i]);
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "../frontend/ast.hpp"
+#include "../ir/ir.hpp"
 #include <string>
 #include <vector>
 #include <memory>
+#include <set>
 #include <sstream>
 
 namespace Quastra {
@@ -14,6 +16,20 @@ public:
     // The main entry point. Takes an AST and returns a string of C++ code.
     std::string generate(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
 
+    // Generates C++ from the SSA IR instead of the AST. Each block becomes a
+    // label and phis become copies on the incoming edges. Implemented in
+    // codegen_ir.cpp.
+    std::string generate(const IR::Module& module);
+
+    // Generates a shared-object translation unit for numeric functions (see
+    // is_numeric_function), with every value a double. Each function is
+    // exported with the native tier's ABI,
+    //     extern "C" int quastra_native_<name>(const double* arguments, double* result);
+    // which returns 0 instead of a result when the call has to be left to
+    // the interpreter: a division by zero, falling off the end of a
+    // function, or recursion deeper than the native stack allows.
+    std::string generate_native(const std::vector<const AST::FunctionStmt*>& functions);
+
 private:
     // Statement visitors
     void visit(const AST::ExprStmt& stmt) override;
@@ -32,14 +48,48 @@ private:
     void visit(const AST::Assign& expr) override;
     void visit(const AST::Call& expr) override;
 
+    // The statements of a function, with its parameters in scope.
+    void generate_body(const AST::FunctionStmt& stmt);
+
     // Helper to generate code for a single node.
     void generate_code(const AST::Stmt& stmt);
     void generate_code(const AST::Expr& expr);
 
     std::stringstream output;
     int indent_level = 0;
+    // The function being generated, when it makes self tail calls. Those are
+    // emitted as parameter updates and a jump back to its `tail_call:` label.
+    const AST::FunctionStmt* tail_function = nullptr;
+    // Which form of an async function's body is being generated: the
+    // coroutine, or the plain lambda that only gives its result type.
+    enum class AsyncBody { None, Typing, Coroutine };
+    AsyncBody async_body = AsyncBody::None;
+    // Generating for generate_native: doubles instead of `auto`.
+    bool native = false;
+    // Calls to the io natives have been generated, so the program needs
+    // io_prelude.
+    bool uses_io = false;
+    // Calls to sleep have been generated, which needs sleep_prelude.
+    bool uses_sleep = false;
+    // Names declared at top level, which take the place of natives.
+    std::set<std::string> user_globals;
+    // Names declared by the enclosing functions and blocks, which shadow
+    // natives too. Calls are mapped by name, since the optimizer's clones
+    // need not carry the Resolver's annotations.
+    std::vector<std::set<std::string>> local_scopes;
+    bool calls_native(const std::string& name) const;
+
+    // core.io for generated programs: the print, println, write, flush and
+    // read_line natives as quastra_<name>, with the runtime's buffering.
+    static const char* const io_prelude;
+    static bool is_io_native(const std::string& name);
 
     void indent();
+
+    // IR code generation helpers.
+    void generate_function(const IR::Function& function, bool has_init);
+    void generate_instruction(const IR::Function& function, int block, const IR::Instruction& inst);
+    void generate_edge(const IR::Function& function, int from, int to, const char* pad);
 };
 
 } // namespace Quastra
@@ -0,0 +1,193 @@
+#include "codegen.hpp"
+
+namespace Quastra {
+
+// C++ spelling of an IR type.
+static const char* cpp_type(Type type) {
+    switch (type) {
+        case Type::Bool: return "bool";
+        case Type::Void: return "void";
+        default: return "int64_t";
+    }
+}
+
+// C++ spelling of a function name. main keeps its name; the init function
+// gets a name that cannot clash with user code.
+static std::string cpp_function_name(const std::string& name) {
+    if (name == IR::InitFunction) return "quastra_init";
+    return name;
+}
+
+static std::string reg(int r) {
+    return "r" + std::to_string(r);
+}
+
+std::string CodeGen::generate(const IR::Module& module) {
+    bool has_init = false;
+    bool has_main = false;
+    for (const auto& function : module.functions) {
+        has_init = has_init || function.name == IR::InitFunction;
+        has_main = has_main || function.name == "main";
+        user_globals.insert(function.name);
+    }
+    // Calls to names the module does not define go to natives.
+    for (const auto& function : module.functions) {
+        for (const auto& block : function.blocks) {
+            for (const auto& inst : block.instructions) {
+                if (inst.op == IR::Opcode::Call && is_io_native(inst.name) && !user_globals.count(inst.name)) {
+                    uses_io = true;
+                }
+            }
+        }
+    }
+
+    output << "#include <cstdint>\n";
+    if (uses_io) output << "#include <cstdio>\n#include <cstring>\n";
+    output << "#include <iostream>\n";
+    if (uses_io) output << "#include <string>\n#include <type_traits>\n";
+    output << "\n";
+    if (uses_io) output << io_prelude;
+
+    for (const auto& global : module.globals) {
+        output << "static " << cpp_type(global.type) << " g_" << global.name << ";\n";
+    }
+    if (!module.globals.empty()) output << "\n";
+
+    // Prototypes first, so functions can be defined in any order.
+    bool any_prototype = false;
+    for (const auto& function : module.functions) {
+        if (function.name == "main") continue;
+        output << (function.name == IR::InitFunction ? "static " : "") << cpp_type(function.return_type) << " "
+               << cpp_function_name(function.name) << "(";
+        for (size_t i = 0; i < function.params.size(); ++i) {
+            output << (i ? ", " : "") << cpp_type(function.register_types[function.params[i]]);
+        }
+        output << ");\n";
+        any_prototype = true;
+    }
+    if (any_prototype) output << "\n";
+
+    for (const auto& function : module.functions) {
+        generate_function(function, has_init);
+    }
+
+    // A script without a main function still runs its top-level code.
+    if (has_init && !has_main) {
+        output << "int main() {\n    quastra_init();\n    return 0;\n}\n\n";
+    }
+    return output.str();
+}
+
+void CodeGen::generate_function(const IR::Function& function, bool has_init) {
+    bool is_main = function.name == "main";
+    output << (function.name == IR::InitFunction ? "static " : "")
+           << (is_main ? "int" : cpp_type(function.return_type)) << " " << cpp_function_name(function.name) << "(";
+    for (size_t i = 0; i < function.params.size(); ++i) {
+        int param = function.params[i];
+        output << (i ? ", " : "") << cpp_type(function.register_types[param]) << " " << reg(param);
+    }
+    output << ") {\n";
+
+    // Declare every register up front: jumping over an initialization is
+    // not allowed in C++. Phis also get an "_in" copy written on each edge.
+    for (const auto& block : function.blocks) {
+        for (const auto& inst : block.instructions) {
+            if (inst.result == IR::NoRegister || inst.op == IR::Opcode::Param) continue;
+            output << "    " << cpp_type(inst.type) << " " << reg(inst.result);
+            if (inst.op == IR::Opcode::Phi) output << ", " << reg(inst.result) << "_in";
+            output << ";\n";
+        }
+    }
+    if (is_main && has_init) output << "    quastra_init();\n";
+
+    for (const auto& block : function.blocks) {
+        if (!block.predecessors.empty()) output << "bb" << block.id << ":\n";
+        for (const auto& inst : block.instructions) {
+            generate_instruction(function, block.id, inst);
+        }
+    }
+    output << "}\n\n";
+}
+
+void CodeGen::generate_instruction(const IR::Function& function, int block, const IR::Instruction& inst) {
+    auto binary = [&](const char* op) {
+        output << "    " << reg(inst.result) << " = (" << reg(inst.operands[0]) << " " << op << " "
+               << reg(inst.operands[1]) << ");\n";
+    };
+
+    switch (inst.op) {
+        case IR::Opcode::Const:
+            output << "    " << reg(inst.result) << " = ";
+            if (inst.type == Type::Bool) output << (inst.immediate ? "true" : "false");
+            else output << inst.immediate;
+            output << ";\n";
+            break;
+        case IR::Opcode::Param:
+            break; // Parameters are the function's arguments.
+        case IR::Opcode::Neg:
+            output << "    " << reg(inst.result) << " = -" << reg(inst.operands[0]) << ";\n";
+            break;
+        case IR::Opcode::Not:
+            output << "    " << reg(inst.result) << " = !" << reg(inst.operands[0]) << ";\n";
+            break;
+        case IR::Opcode::Add: binary("+"); break;
+        case IR::Opcode::Sub: binary("-"); break;
+        case IR::Opcode::Mul: binary("*"); break;
+        case IR::Opcode::Div: binary("/"); break;
+        case IR::Opcode::Eq: binary("=="); break;
+        case IR::Opcode::Ne: binary("!="); break;
+        case IR::Opcode::Lt: binary("<"); break;
+        case IR::Opcode::Le: binary("<="); break;
+        case IR::Opcode::Gt: binary(">"); break;
+        case IR::Opcode::Ge: binary(">="); break;
+        case IR::Opcode::Call: {
+            bool io = is_io_native(inst.name) && !user_globals.count(inst.name);
+            output << "    " << reg(inst.result) << " = " << (io ? "quastra_" + inst.name : cpp_function_name(inst.name))
+                   << "(";
+            for (size_t i = 0; i < inst.operands.size(); ++i) {
+                output << (i ? ", " : "") << reg(inst.operands[i]);
+            }
+            output << ");\n";
+            break;
+        }
+        case IR::Opcode::LoadGlobal:
+            output << "    " << reg(inst.result) << " = g_" << inst.name << ";\n";
+            break;
+        case IR::Opcode::StoreGlobal:
+            output << "    g_" << inst.name << " = " << reg(inst.operands[0]) << ";\n";
+            break;
+        case IR::Opcode::Phi:
+            output << "    " << reg(inst.result) << " = " << reg(inst.result) << "_in;\n";
+            break;
+        case IR::Opcode::Jump:
+            generate_edge(function, block, inst.blocks[0], "    ");
+            break;
+        case IR::Opcode::Branch:
+            output << "    if (" << reg(inst.operands[0]) << ") {\n";
+            generate_edge(function, block, inst.blocks[0], "        ");
+            output << "    } else {\n";
+            generate_edge(function, block, inst.blocks[1], "        ");
+            output << "    }\n";
+            break;
+        case IR::Opcode::Return:
+            output << "    return";
+            if (!inst.operands.empty()) output << " " << reg(inst.operands[0]);
+            output << ";\n";
+            break;
+    }
+}
+
+// Writes the phi inputs of 'to' that flow in from 'from', then jumps.
+void CodeGen::generate_edge(const IR::Function& function, int from, int to, const char* pad) {
+    for (const auto& inst : function.blocks[to].instructions) {
+        if (inst.op != IR::Opcode::Phi) break;
+        for (size_t i = 0; i < inst.blocks.size(); ++i) {
+            if (inst.blocks[i] == from) {
+                output << pad << reg(inst.result) << "_in = " << reg(inst.operands[i]) << ";\n";
+            }
+        }
+    }
+    output << pad << "goto bb" << to << ";\n";
+}
+
+} // namespace Quastra
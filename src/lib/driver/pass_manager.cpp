@@ -0,0 +1,171 @@
+#include "pass_manager.hpp"
+#include "../optimizer/ast_utils.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+namespace {
+
+// Per thread, and only while a PassManager measures on that thread, so
+// allocations elsewhere cost a thread-local test and nothing more.
+thread_local bool counting = false;
+thread_local size_t allocations = 0;
+thread_local size_t bytes_allocated = 0;
+
+void count(std::size_t size) {
+    if (!counting) return;
+    ++allocations;
+    bytes_allocated += size;
+}
+
+} // namespace
+
+// Counting replacements for the global allocation functions. The array and
+// nothrow forms forward to these by default.
+void* operator new(std::size_t size) {
+    count(size);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    count(size);
+    auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment.
+    std::size_t rounded = (size + align - 1) / align * align;
+    if (void* memory = std::aligned_alloc(align, rounded ? rounded : align)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+
+namespace Quastra {
+
+size_t allocation_count() {
+    return allocations;
+}
+
+size_t allocated_bytes() {
+    return bytes_allocated;
+}
+
+namespace {
+
+// Measures `body`, filling in the time and allocation fields of `stats`.
+template <typename Body>
+void measure_into(PassStats& stats, Body&& body) {
+    bool was_counting = counting;
+    counting = true;
+    size_t allocations_before = allocation_count();
+    size_t bytes_before = allocated_bytes();
+    auto start = std::chrono::steady_clock::now();
+    try {
+        body();
+    } catch (...) {
+        counting = was_counting;
+        throw;
+    }
+    auto end = std::chrono::steady_clock::now();
+    stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    stats.allocations = allocation_count() - allocations_before;
+    stats.bytes = allocated_bytes() - bytes_before;
+    counting = was_counting;
+}
+
+} // namespace
+
+void PassManager::add_analysis(const std::string& name, std::function<bool(const Program&)> analysis) {
+    add({name, true, [analysis](Program& program, int&) { return analysis(program); }});
+}
+
+void PassManager::add_transform(const std::string& name, std::function<int(Program&)> transform) {
+    add({name, false, [transform](Program& program, int& changes) {
+        changes = transform(program);
+        return true;
+    }});
+}
+
+bool PassManager::run(Program& program) {
+    for (auto& pass : passes) {
+        PassStats pass_stats;
+        pass_stats.name = pass.name;
+        pass_stats.is_analysis = pass.is_analysis;
+        bool ok = true;
+        if (measuring) {
+            pass_stats.has_nodes = true;
+            pass_stats.nodes_before = count_nodes(program);
+            measure_into(pass_stats, [&] { ok = pass.run(program, pass_stats.changes); });
+            pass_stats.nodes_after = count_nodes(program);
+        } else {
+            ok = pass.run(program, pass_stats.changes);
+        }
+        stats.push_back(pass_stats);
+        if (!ok) return false;
+    }
+    return true;
+}
+
+void PassManager::measure(const std::string& name, const std::function<void()>& stage) {
+    PassStats stage_stats;
+    stage_stats.name = name;
+    if (measuring) {
+        measure_into(stage_stats, stage);
+    } else {
+        stage();
+    }
+    stats.push_back(stage_stats);
+}
+
+std::vector<std::string> PassManager::pass_names() const {
+    std::vector<std::string> names;
+    for (const auto& pass : passes) {
+        names.push_back(pass.name);
+    }
+    return names;
+}
+
+std::string PassManager::report() const {
+    std::ostringstream out;
+    out << "===-- Pass execution report --===\n";
+    out << std::setw(10) << "Time (ms)" << std::setw(10) << "Allocs" << std::setw(12) << "Bytes"
+        << std::setw(16) << "Nodes" << std::setw(9) << "Changes" << "  Pass\n";
+
+    PassStats total;
+    for (const auto& pass : stats) {
+        std::string nodes = "-";
+        std::string changes = "-";
+        if (pass.has_nodes) {
+            nodes = std::to_string(pass.nodes_before) + " -> " + std::to_string(pass.nodes_after);
+            if (!pass.is_analysis) changes = std::to_string(pass.changes);
+        }
+        out << std::fixed << std::setprecision(3) << std::setw(10) << pass.milliseconds
+            << std::setw(10) << pass.allocations << std::setw(12) << pass.bytes
+            << std::setw(16) << nodes << std::setw(9) << changes << "  " << pass.name
+            << (pass.is_analysis ? " (analysis)" : "") << "\n";
+        total.milliseconds += pass.milliseconds;
+        total.allocations += pass.allocations;
+        total.bytes += pass.bytes;
+    }
+    out << std::fixed << std::setprecision(3) << std::setw(10) << total.milliseconds
+        << std::setw(10) << total.allocations << std::setw(12) << total.bytes
+        << std::setw(16) << "" << std::setw(9) << "" << "  Total\n";
+    return out.str();
+}
+
+} // namespace Quastra
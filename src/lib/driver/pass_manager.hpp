@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+using Program = std::vector<std::unique_ptr<AST::Stmt>>;
+
+// What one pass cost and what it did, for --time-passes.
+struct PassStats {
+    std::string name;
+    bool is_analysis = false;
+    bool has_nodes = false;   // Front-end and back-end stages have no AST to count.
+    double milliseconds = 0;
+    size_t allocations = 0;   // Calls to operator new while the pass ran.
+    size_t bytes = 0;         // Bytes those calls asked for.
+    size_t nodes_before = 0;
+    size_t nodes_after = 0;
+    int changes = 0;          // Rewrites the pass reported making.
+};
+
+// A step of the pipeline. An analysis only reads the program; a transform
+// may rewrite it. Returning false rejects the program and stops the
+// pipeline; the pass prints its own diagnostics.
+struct Pass {
+    std::string name;
+    bool is_analysis = false;
+    std::function<bool(Program& program, int& changes)> run;
+};
+
+// Runs a sequence of passes over the AST, measuring each one if asked to.
+// Stages that do not work on the AST (lexing, parsing, the backends) can be
+// measured with `measure` so that they show up in the same report.
+class PassManager {
+public:
+    // Without `measuring`, passes only record their names and changes:
+    // no clocks are read, allocations are not counted and the AST is not
+    // walked to count its nodes.
+    explicit PassManager(bool measuring = false) : measuring(measuring) {}
+
+    void add(Pass pass) { passes.push_back(std::move(pass)); }
+    void add_analysis(const std::string& name, std::function<bool(const Program&)> analysis);
+    void add_transform(const std::string& name, std::function<int(Program&)> transform);
+
+    // Runs the passes in order. Returns false if one of them failed.
+    bool run(Program& program);
+
+    // Runs and measures a stage outside the pass list.
+    void measure(const std::string& name, const std::function<void()>& stage);
+
+    std::vector<std::string> pass_names() const;
+    const std::vector<PassStats>& get_stats() const { return stats; }
+
+    // A table of the recorded stats, one line per pass plus a total.
+    std::string report() const;
+
+private:
+    std::vector<Pass> passes;
+    std::vector<PassStats> stats;
+    bool measuring;
+};
+
+// Counters kept by the replacement global operator new, for the calling
+// thread and only while a measuring PassManager runs a pass or stage on it.
+size_t allocation_count();
+size_t allocated_bytes();
+
+} // namespace Quastra
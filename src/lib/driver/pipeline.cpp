@@ -0,0 +1,118 @@
+#include "pipeline.hpp"
+#include "../frontend/lexer.hpp"
+#include "../frontend/parser.hpp"
+#include "../semantic/resolver.hpp"
+#include "../semantic/type_checker.hpp"
+#include "../optimizer/const_evaluator.hpp"
+#include "../optimizer/constant_folder.hpp"
+#include "../optimizer/cse.hpp"
+#include "../optimizer/dead_code.hpp"
+#include "../optimizer/loop_optimizer.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace Quastra {
+
+const std::vector<std::string>& known_passes() {
+    static const std::vector<std::string> names = {
+        "resolve", "type-check", "const-eval", "inline", "fold", "cse", "loop-opt", "dce",
+    };
+    return names;
+}
+
+namespace {
+
+void add_pass(PassManager& manager, const std::string& name, const PipelineOptions& options) {
+    if (name == "resolve") {
+        // Checks scopes and marks tail calls for the interpreter and CodeGen.
+        manager.add_analysis(name, [globals = options.globals](const Program& program) {
+            Resolver resolver(globals);
+            if (resolver.resolve(program)) return true;
+            std::cerr << "Error: Semantic analysis failed." << std::endl;
+            return false;
+        });
+    } else if (name == "type-check") {
+        manager.add_analysis(name, [](const Program& program) {
+            TypeChecker checker;
+            if (checker.check(program)) return true;
+            std::cerr << "Error: Type checking failed." << std::endl;
+            return false;
+        });
+    } else if (name == "const-eval") {
+        // Folds constants and pure calls so they cost nothing at runtime.
+        manager.add({name, false, [](Program& program, int& changes) {
+            ConstEvaluator evaluator;
+            bool ok = evaluator.run(program);
+            changes = evaluator.replacements();
+            if (!ok) std::cerr << "Error: Compile-time evaluation failed." << std::endl;
+            return ok;
+        }});
+    } else if (name == "inline") {
+        manager.add_transform(name, [options](Program& program) {
+            Inliner inliner(options.inline_options);
+            int inlined = inliner.run(program);
+            if (options.inline_report) std::cerr << inliner.report();
+            return inlined;
+        });
+    } else if (name == "fold") {
+        manager.add_transform(name, [](Program& program) { return ConstantFolder().run(program); });
+    } else if (name == "cse") {
+        manager.add_transform(name, [](Program& program) { return CommonSubexpressionEliminator().run(program); });
+    } else if (name == "loop-opt") {
+        manager.add_transform(name, [](Program& program) { return LoopOptimizer().run(program); });
+    } else if (name == "dce") {
+        manager.add_transform(name, [](Program& program) { return DeadCodeEliminator().run(program); });
+    }
+}
+
+} // namespace
+
+bool build_pipeline(PassManager& manager, const PipelineOptions& options) {
+    std::vector<std::string> names = options.passes;
+    if (names.empty()) {
+        names.push_back("resolve");
+        if (options.type_check) names.push_back("type-check");
+        if (options.opt_level >= 1) names.push_back("const-eval");
+        if (options.opt_level >= 2) names.push_back("inline");
+        if (options.opt_level >= 1) {
+            names.push_back("fold");
+            names.push_back("cse");
+        }
+        if (options.opt_level >= 2) names.push_back("loop-opt");
+        if (options.opt_level >= 1) names.push_back("dce");
+    }
+
+    const auto& known = known_passes();
+    for (const auto& name : names) {
+        if (std::find(known.begin(), known.end(), name) == known.end()) {
+            std::cerr << "Error: Unknown pass '" << name << "'." << std::endl;
+            return false;
+        }
+    }
+    for (const auto& name : names) {
+        add_pass(manager, name, options);
+    }
+    return true;
+}
+
+std::shared_ptr<const CompiledProgram> compile_program(const std::string& source, const PipelineOptions& options) {
+    PassManager passes;
+    if (!build_pipeline(passes, options)) return nullptr;
+    std::vector<Token> tokens = Lexer(source).scan_tokens();
+    Parser parser(tokens);
+    Program statements = parser.parse();
+    if (parser.failed()) {
+        std::cerr << "Error: Parsing failed." << std::endl;
+        return nullptr;
+    }
+    if (!passes.run(statements)) return nullptr;
+    try {
+        return std::make_shared<const CompiledProgram>(statements);
+    } catch (const std::runtime_error& failure) {
+        std::cerr << "Error: " << failure.what() << std::endl;
+        return nullptr;
+    }
+}
+
+} // namespace Quastra
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "pass_manager.hpp"
+#include "../optimizer/inliner.hpp"
+#include "../vm/compiled_program.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// How the driver wants the AST pipeline set up.
+struct PipelineOptions {
+    int opt_level = 0;            // -O0, -O1 or -O2.
+    bool type_check = false;      // Run the TypeChecker and reject ill-typed programs.
+    bool inline_report = false;   // Print the inliner's decisions to stderr.
+    InlineOptions inline_options;
+    std::vector<std::string> passes; // If not empty, run exactly these passes in this order.
+    std::vector<std::string> globals; // Defined before the program runs, e.g. by a restored snapshot.
+};
+
+// The names build_pipeline understands, in their default order:
+// resolve, type-check, const-eval, inline, fold, cse, loop-opt, dce.
+const std::vector<std::string>& known_passes();
+
+// Adds the passes selected by `options` to `manager`. Without an explicit
+// list, -O0 only resolves, -O1 adds compile-time evaluation, folding, CSE
+// and dead code elimination, and -O2 adds inlining and loop optimisation. Returns false
+// if the explicit list names an unknown pass.
+bool build_pipeline(PassManager& manager, const PipelineOptions& options);
+
+// The embedding entry point: lexes and parses `source`, runs the passes
+// `options` select and compiles the result for VirtualMachines to share.
+// Errors are reported on stderr, and give nullptr.
+std::shared_ptr<const CompiledProgram> compile_program(const std::string& source, const PipelineOptions& options = {});
+
+} // namespace Quastra
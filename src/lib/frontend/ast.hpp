@@ -1,9 +1,15 @@
 #pragma once
 
 #include "token.hpp"
+#include <cstdint>
 #include <memory>
 #include <vector>
 
+namespace Quastra {
+class QuastraCallable;
+class QuastraString;
+}
+
 namespace Quastra::AST {
 
 // Forward declare all node types
@@ -58,14 +64,15 @@ struct Expr {
 
 // --- Statement Nodes ---
 
-// Represents a variable declaration: `let mut x = 5;`
+// Represents a variable declaration: `let mut x = 5;` or `const x = 5;`
 struct VarDecl : Stmt {
     Token name;
     std::unique_ptr<Expr> initializer;
     bool is_mutable; // Flag to track mutability
+    bool is_const;   // `const` declarations must be evaluable at compile time
 
-    VarDecl(Token name, std::unique_ptr<Expr> initializer, bool is_mutable)
-        : name(std::move(name)), initializer(std::move(initializer)), is_mutable(is_mutable) {}
+    VarDecl(Token name, std::unique_ptr<Expr> initializer, bool is_mutable, bool is_const = false)
+        : name(std::move(name)), initializer(std::move(initializer)), is_mutable(is_mutable), is_const(is_const) {}
 
     void accept(StmtVisitor& visitor) const override {
         visitor.visit(*this);
@@ -79,10 +86,18 @@ struct ExprStmt : Stmt {
     void accept(StmtVisitor& visitor) const override { visitor.visit(*this); }
 };
 
+// What a block does besides scoping its statements. A `spawn` block runs as
+// a task, concurrently with the code after it; a `scope` block waits for
+// the tasks spawned while it runs. Passes treat both as plain blocks, and
+// engines without tasks run a spawn's statements in place: one valid
+// schedule for tasks that do not wait on other code.
+enum class BlockKind : unsigned char { Plain, Spawn, Scope };
+
 struct Block : Stmt {
     std::vector<std::unique_ptr<Stmt>> statements;
-    Block(std::vector<std::unique_ptr<Stmt>> statements)
-        : statements(std::move(statements)) {}
+    BlockKind kind;
+    Block(std::vector<std::unique_ptr<Stmt>> statements, BlockKind kind = BlockKind::Plain)
+        : statements(std::move(statements)), kind(kind) {}
     void accept(StmtVisitor& visitor) const override { visitor.visit(*this); }
 };
 
@@ -107,8 +122,12 @@ struct FunctionStmt : Stmt {
     Token name;
     std::vector<Token> params;
     std::vector<std::unique_ptr<Stmt>> body;
-    FunctionStmt(Token name, std::vector<Token> params, std::vector<std::unique_ptr<Stmt>> body)
-        : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
+    // An `async fn`: a call returns a future of the body's result, and the
+    // body may `await` other futures.
+    bool is_async;
+    FunctionStmt(Token name, std::vector<Token> params, std::vector<std::unique_ptr<Stmt>> body,
+                 bool is_async = false)
+        : name(std::move(name)), params(std::move(params)), body(std::move(body)), is_async(is_async) {}
     void accept(StmtVisitor& visitor) const override { visitor.visit(*this); }
 };
 
@@ -125,6 +144,9 @@ struct ReturnStmt : Stmt {
 
 struct Literal : Expr {
     Token value;
+    // For a StringLiteral, the interned string the Interpreter evaluates it
+    // to, once it has run the node; see QuastraString::intern.
+    mutable const QuastraString* interned = nullptr;
     Literal(Token val) : value(std::move(val)) {}
     void accept(ExprVisitor& visitor) const override { visitor.visit(*this); }
 };
@@ -136,10 +158,31 @@ struct Unary : Expr {
     void accept(ExprVisitor& visitor) const override { visitor.visit(*this); }
 };
 
+// What the Interpreter has specialised a binary expression into, from the
+// operand types it has seen. `Generic` is for nodes that have seen anything
+// else and stay on the fully checked path.
+enum class BinarySpecialization : unsigned char {
+    Uninitialized,
+    AddNumbers,
+    SubtractNumbers,
+    MultiplyNumbers,
+    DivideNumbers,
+    LessNumbers,
+    LessEqualNumbers,
+    GreaterNumbers,
+    GreaterEqualNumbers,
+    EqualNumbers,
+    NotEqualNumbers,
+    Generic,
+};
+
 struct Binary : Expr {
     std::unique_ptr<Expr> left;
     Token op;
     std::unique_ptr<Expr> right;
+    // Rewritten by the Interpreter as it runs the node; see
+    // Interpreter::visit(const AST::Binary&).
+    mutable BinarySpecialization specialization = BinarySpecialization::Uninitialized;
     Binary(std::unique_ptr<Expr> l, Token o, std::unique_ptr<Expr> r)
         : left(std::move(l)), op(std::move(o)), right(std::move(r)) {}
     void accept(ExprVisitor& visitor) const override { visitor.visit(*this); }
@@ -162,6 +205,20 @@ struct Call : Expr {
     std::unique_ptr<Expr> callee;
     Token paren; // The closing ')' for error reporting.
     std::vector<std::unique_ptr<Expr>> arguments;
+    // Set by the Resolver when the call is the value of a return statement in
+    // a function, so the caller's frame can be released before the call is
+    // made. `is_self_call` additionally means the callee is the enclosing
+    // function itself.
+    mutable bool is_tail_call = false;
+    mutable bool is_self_call = false;
+    // Set by the Resolver when the callee is a name only ever declared at
+    // top level, so no local can shadow it. The Interpreter then caches the
+    // function the name was bound to, valid while the global environment's
+    // version is still `cached_version`; see Interpreter::prepare_call. The
+    // environment keeps the function alive meanwhile, so the cache does not.
+    mutable bool is_global_call = false;
+    mutable QuastraCallable* cached_callee = nullptr;
+    mutable uint64_t cached_version = 0;
     Call(std::unique_ptr<Expr> callee, Token paren, std::vector<std::unique_ptr<Expr>> arguments)
         : callee(std::move(callee)), paren(std::move(paren)), arguments(std::move(arguments)) {}
     void accept(ExprVisitor& visitor) const override { visitor.visit(*this); }
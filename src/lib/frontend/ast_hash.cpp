@@ -0,0 +1,106 @@
+#include "ast_hash.hpp"
+#include <functional>
+#include <string>
+
+namespace Quastra {
+
+namespace {
+
+// Tags that keep, say, `-x` and a variable named `-x` from colliding.
+enum class Kind : size_t { Literal = 1, Unary, Binary, Variable, Assign, Call };
+
+void combine(size_t& seed, size_t value) {
+    seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+size_t hash_token(const Token& token) {
+    size_t seed = static_cast<size_t>(token.type);
+    combine(seed, std::hash<std::string>{}(token.lexeme));
+    return seed;
+}
+
+bool same_token(const Token& a, const Token& b) {
+    return a.type == b.type && a.lexeme == b.lexeme;
+}
+
+} // namespace
+
+size_t structural_hash(const AST::Expr& expr) {
+    size_t seed = 0;
+    if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Literal));
+        combine(seed, hash_token(literal->value));
+    } else if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Unary));
+        combine(seed, hash_token(unary->op));
+        combine(seed, structural_hash(*unary->right));
+    } else if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Binary));
+        combine(seed, hash_token(binary->op));
+        combine(seed, structural_hash(*binary->left));
+        combine(seed, structural_hash(*binary->right));
+    } else if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Variable));
+        combine(seed, std::hash<std::string>{}(variable->name.lexeme));
+    } else if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Assign));
+        combine(seed, std::hash<std::string>{}(assign->name.lexeme));
+        combine(seed, structural_hash(*assign->value));
+    } else if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        combine(seed, static_cast<size_t>(Kind::Call));
+        combine(seed, structural_hash(*call->callee));
+        for (const auto& argument : call->arguments) {
+            combine(seed, structural_hash(*argument));
+        }
+    }
+    return seed;
+}
+
+bool structurally_equal(const AST::Expr& a, const AST::Expr& b) {
+    if (&a == &b) return true;
+    if (auto* x = dynamic_cast<const AST::Literal*>(&a)) {
+        auto* y = dynamic_cast<const AST::Literal*>(&b);
+        return y && same_token(x->value, y->value);
+    }
+    if (auto* x = dynamic_cast<const AST::Unary*>(&a)) {
+        auto* y = dynamic_cast<const AST::Unary*>(&b);
+        return y && same_token(x->op, y->op) && structurally_equal(*x->right, *y->right);
+    }
+    if (auto* x = dynamic_cast<const AST::Binary*>(&a)) {
+        auto* y = dynamic_cast<const AST::Binary*>(&b);
+        return y && same_token(x->op, y->op) && structurally_equal(*x->left, *y->left) &&
+               structurally_equal(*x->right, *y->right);
+    }
+    if (auto* x = dynamic_cast<const AST::Variable*>(&a)) {
+        auto* y = dynamic_cast<const AST::Variable*>(&b);
+        return y && x->name.lexeme == y->name.lexeme;
+    }
+    if (auto* x = dynamic_cast<const AST::Assign*>(&a)) {
+        auto* y = dynamic_cast<const AST::Assign*>(&b);
+        return y && x->name.lexeme == y->name.lexeme && structurally_equal(*x->value, *y->value);
+    }
+    if (auto* x = dynamic_cast<const AST::Call*>(&a)) {
+        auto* y = dynamic_cast<const AST::Call*>(&b);
+        if (!y || x->arguments.size() != y->arguments.size() || !structurally_equal(*x->callee, *y->callee)) {
+            return false;
+        }
+        for (size_t i = 0; i < x->arguments.size(); ++i) {
+            if (!structurally_equal(*x->arguments[i], *y->arguments[i])) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+int ExprTable::intern(const AST::Expr& expr) {
+    auto [it, inserted] = ids.emplace(&expr, static_cast<int>(ids.size()));
+    (void)inserted;
+    return it->second;
+}
+
+int ExprTable::find(const AST::Expr& expr) const {
+    auto it = ids.find(&expr);
+    return it == ids.end() ? -1 : it->second;
+}
+
+} // namespace Quastra
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ast.hpp"
+#include <cstddef>
+#include <unordered_map>
+
+namespace Quastra {
+
+// Structural hashing of expressions. Two expressions are structurally equal
+// when they have the same shape, operators, literal lexemes and variable
+// names. Names are compared as written, so a caller must know that they
+// refer to the same bindings (for example, by invalidating on assignment).
+size_t structural_hash(const AST::Expr& expr);
+bool structurally_equal(const AST::Expr& a, const AST::Expr& b);
+
+// Functors for keying unordered containers by expression structure.
+struct StructuralHash {
+    size_t operator()(const AST::Expr* expr) const { return structural_hash(*expr); }
+};
+struct StructuralEqual {
+    bool operator()(const AST::Expr* a, const AST::Expr* b) const { return structurally_equal(*a, *b); }
+};
+
+// A hash-consing table: structurally equal expressions get the same id, in
+// the order they were first seen. The table keeps pointers to the first
+// expression of each class, which must outlive it.
+class ExprTable {
+public:
+    int intern(const AST::Expr& expr);
+    // The id of an expression already interned, or -1.
+    int find(const AST::Expr& expr) const;
+    size_t size() const { return ids.size(); }
+    void clear() { ids.clear(); }
+
+private:
+    std::unordered_map<const AST::Expr*, int, StructuralHash, StructuralEqual> ids;
+};
+
+} // namespace Quastra
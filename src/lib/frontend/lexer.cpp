@@ -76,6 +76,7 @@ void Lexer::scan_token() {
         case '\n':
             line++;
             break;
+        case '"': string(); break;
         default:
             if (std::isdigit(c)) {
                 number();
@@ -93,15 +94,35 @@ void Lexer::number() {
     add_token(TokenType::IntLiteral);
 }
 
+// The lexeme keeps the quotes and escapes; string_value() decodes it. An
+// unterminated string becomes an Unknown token.
+void Lexer::string() {
+    int start_line = line;
+    while (peek() != '"' && !is_at_end()) {
+        if (peek() == '\n') line++;
+        if (peek() == '\\') advance();
+        if (!is_at_end()) advance();
+    }
+    if (is_at_end()) {
+        tokens.push_back({TokenType::Unknown, source.substr(start, current - start), start_line});
+        return;
+    }
+    advance(); // The closing quote.
+    tokens.push_back({TokenType::StringLiteral, source.substr(start, current - start), start_line});
+}
+
 void Lexer::identifier() {
     while (std::isalnum(peek()) || peek() == '_') advance();
     std::string text = source.substr(start, current - start);
     static const std::map<std::string, TokenType> keywords = {
         {"fn", TokenType::Fn}, {"return", TokenType::Return},
         {"let", TokenType::Let}, {"mut", TokenType::Mut},
+        {"const", TokenType::Const},
         {"if", TokenType::If}, {"else", TokenType::Else},
         {"while", TokenType::While}, {"true", TokenType::True},
-        {"false", TokenType::False}, {"int", TokenType::TypeIdentifier},
+        {"false", TokenType::False}, {"spawn", TokenType::Spawn},
+        {"scope", TokenType::Scope}, {"async", TokenType::Async},
+        {"await", TokenType::Await}, {"int", TokenType::TypeIdentifier},
         {"string", TokenType::TypeIdentifier}, {"bool", TokenType::TypeIdentifier},
         {"float", TokenType::TypeIdentifier},
     };
@@ -24,6 +24,7 @@ private:
     // Correct return types to void to match implementation
     void identifier();
     void number();
+    void string();
 
     const std::string source;
     std::vector<Token> tokens;
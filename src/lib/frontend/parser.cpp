@@ -22,7 +22,12 @@ std::vector<std::unique_ptr<AST::Stmt>> Parser::parse() {
 std::unique_ptr<AST::Stmt> Parser::declaration() {
     try {
         if (match({TokenType::Fn})) return function_declaration();
+        if (match({TokenType::Async})) {
+            consume(TokenType::Fn, "Expect 'fn' after 'async'.");
+            return function_declaration(true);
+        }
         if (match({TokenType::Let})) return var_declaration();
+        if (match({TokenType::Const})) return const_declaration();
         return statement();
     } catch (const std::runtime_error& e) {
         // When an error is caught, synchronize and report it.
@@ -42,7 +47,9 @@ void Parser::synchronize() {
 
         switch (peek().type) {
             case TokenType::Fn:
+            case TokenType::Async:
             case TokenType::Let:
+            case TokenType::Const:
             case TokenType::If:
             case TokenType::While:
             case TokenType::Return:
@@ -55,7 +62,7 @@ void Parser::synchronize() {
 }
 
 
-std::unique_ptr<AST::Stmt> Parser::function_declaration() {
+std::unique_ptr<AST::Stmt> Parser::function_declaration(bool is_async) {
     Token name = consume(TokenType::Identifier, "Expect function name.");
     consume(TokenType::LeftParen, "Expect '(' after function name.");
     std::vector<Token> parameters;
@@ -67,7 +74,7 @@ std::unique_ptr<AST::Stmt> Parser::function_declaration() {
     consume(TokenType::RightParen, "Expect ')' after parameters.");
     consume(TokenType::LeftBrace, "Expect '{' before function body.");
     std::vector<std::unique_ptr<AST::Stmt>> body = block();
-    return std::make_unique<AST::FunctionStmt>(name, std::move(parameters), std::move(body));
+    return std::make_unique<AST::FunctionStmt>(name, std::move(parameters), std::move(body), is_async);
 }
 
 std::unique_ptr<AST::Stmt> Parser::var_declaration() {
@@ -81,14 +88,32 @@ std::unique_ptr<AST::Stmt> Parser::var_declaration() {
     return std::make_unique<AST::VarDecl>(name, std::move(initializer), is_mutable);
 }
 
+// A constant always has an initializer; its value is computed by the ConstEvaluator.
+std::unique_ptr<AST::Stmt> Parser::const_declaration() {
+    Token name = consume(TokenType::Identifier, "Expect constant name.");
+    consume(TokenType::Equal, "Expect '=' after constant name.");
+    std::unique_ptr<AST::Expr> initializer = expression();
+    consume(TokenType::Semicolon, "Expect ';' after constant declaration.");
+    return std::make_unique<AST::VarDecl>(name, std::move(initializer), false, true);
+}
+
 std::unique_ptr<AST::Stmt> Parser::statement() {
     if (match({TokenType::If})) return if_statement();
     if (match({TokenType::While})) return while_statement();
     if (match({TokenType::Return})) return return_statement();
     if (match({TokenType::LeftBrace})) return std::make_unique<AST::Block>(block());
+    if (match({TokenType::Spawn})) return task_block(AST::BlockKind::Spawn);
+    if (match({TokenType::Scope})) return task_block(AST::BlockKind::Scope);
     return expression_statement();
 }
 
+// `spawn { ... }` or `scope { ... }`, after the keyword.
+std::unique_ptr<AST::Stmt> Parser::task_block(AST::BlockKind kind) {
+    Token keyword = previous();
+    consume(TokenType::LeftBrace, "Expect '{' after '" + keyword.lexeme + "'.");
+    return std::make_unique<AST::Block>(block(), kind);
+}
+
 std::unique_ptr<AST::Stmt> Parser::if_statement() {
     consume(TokenType::LeftParen, "Expect '(' after 'if'.");
     std::unique_ptr<AST::Expr> condition = expression();
@@ -192,7 +217,8 @@ std::unique_ptr<AST::Expr> Parser::factor() {
 }
 
 std::unique_ptr<AST::Expr> Parser::unary() {
-    if (match({TokenType::Bang, TokenType::Minus})) {
+    // `await` is a prefix operator, like `!` and `-`.
+    if (match({TokenType::Bang, TokenType::Minus, TokenType::Await})) {
         Token op = previous();
         return std::make_unique<AST::Unary>(op, unary());
     }
@@ -221,7 +247,7 @@ std::unique_ptr<AST::Expr> Parser::call() {
 std::unique_ptr<AST::Expr> Parser::primary() {
     if (match({TokenType::False})) return std::make_unique<AST::Literal>(Token{TokenType::False, "false", previous().line});
     if (match({TokenType::True})) return std::make_unique<AST::Literal>(Token{TokenType::True, "true", previous().line});
-    if (match({TokenType::IntLiteral})) return std::make_unique<AST::Literal>(previous());
+    if (match({TokenType::IntLiteral, TokenType::StringLiteral})) return std::make_unique<AST::Literal>(previous());
     if (match({TokenType::Identifier})) return std::make_unique<AST::Variable>(previous());
     if (match({TokenType::LeftParen})) {
         std::unique_ptr<AST::Expr> expr = expression();
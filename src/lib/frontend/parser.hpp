@@ -13,15 +13,20 @@ public:
 
     std::vector<std::unique_ptr<AST::Stmt>> parse();
 
+    // True if parse() reported an error and dropped the statement it was in.
+    bool failed() const { return had_error; }
+
 private:
     // Statement parsing
     std::unique_ptr<AST::Stmt> declaration();
-    std::unique_ptr<AST::Stmt> function_declaration();
+    std::unique_ptr<AST::Stmt> function_declaration(bool is_async = false);
     std::unique_ptr<AST::Stmt> return_statement();
     std::unique_ptr<AST::Stmt> var_declaration();
+    std::unique_ptr<AST::Stmt> const_declaration();
     std::unique_ptr<AST::Stmt> statement();
     std::unique_ptr<AST::Stmt> if_statement();
     std::unique_ptr<AST::Stmt> while_statement();
+    std::unique_ptr<AST::Stmt> task_block(AST::BlockKind kind);
     std::vector<std::unique_ptr<AST::Stmt>> block();
     std::unique_ptr<AST::Stmt> expression_statement();
 
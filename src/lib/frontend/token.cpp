@@ -8,14 +8,20 @@ const char* to_string(TokenType type) {
         case TokenType::Fn: return "Fn";
         case TokenType::Return: return "Return";
         case TokenType::Let: return "Let";
+        case TokenType::Const: return "Const";
         case TokenType::If: return "If";
         case TokenType::Else: return "Else";
         case TokenType::While: return "While";
         case TokenType::True: return "True";
         case TokenType::False: return "False";
+        case TokenType::Spawn: return "Spawn";
+        case TokenType::Scope: return "Scope";
+        case TokenType::Async: return "Async";
+        case TokenType::Await: return "Await";
         case TokenType::Identifier: return "Identifier";
         case TokenType::TypeIdentifier: return "TypeIdentifier";
         case TokenType::IntLiteral: return "IntLiteral";
+        case TokenType::StringLiteral: return "StringLiteral";
         case TokenType::Plus: return "Plus";
         case TokenType::Minus: return "Minus";
         case TokenType::Star: return "Star";
@@ -40,4 +46,19 @@ const char* to_string(TokenType type) {
     }
 }
 
+std::string string_value(const Token& token) {
+    const std::string& lexeme = token.lexeme;
+    std::string value;
+    for (size_t i = 1; i + 1 < lexeme.size(); ++i) {
+        char c = lexeme[i];
+        if (c == '\\' && i + 2 < lexeme.size()) {
+            c = lexeme[++i];
+            if (c == 'n') c = '\n';
+            else if (c == 't') c = '\t';
+        }
+        value += c;
+    }
+    return value;
+}
+
 } // namespace Quastra
@@ -9,7 +9,7 @@ namespace Quastra {
 // Enum for all possible token types in the Quastra language.
 enum class TokenType {
     // Keywords
-    Fn, Return, Let, Mut, If, Else, While, For, In, True, False,
+    Fn, Return, Let, Mut, Const, If, Else, While, For, In, True, False, Spawn, Scope, Async, Await,
     // Identifiers
     Identifier, TypeIdentifier,
     // Literals
@@ -31,6 +31,12 @@ enum class TokenType {
 // Converts a TokenType to its string representation for debugging.
 const char* to_string(TokenType type);
 
+struct Token;
+
+// The characters a StringLiteral token stands for: its lexeme without the
+// quotes, with the escapes \n, \t, \" and \\ resolved.
+std::string string_value(const Token& token);
+
 // Represents a single token scanned from the source code.
 struct Token {
     TokenType type;
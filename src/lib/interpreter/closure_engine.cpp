@@ -0,0 +1,616 @@
+#include "closure_engine.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include "../runtime/core_io.hpp"
+#include "../runtime/event_loop.hpp"
+#include "../runtime/native_registry.hpp"
+#include <stdexcept>
+
+namespace Quastra {
+
+namespace {
+
+using ExprCode = ClosureEngine::ExprCode;
+using StmtCode = ClosureEngine::StmtCode;
+using Signal = ClosureEngine::Signal;
+
+// Puts a counter back as it was when it goes away. Calls on other fibers
+// change the call depth while an async call or an await switches to them.
+struct Restore {
+    size_t& counter;
+    size_t value;
+    explicit Restore(size_t& counter) : counter(counter), value(counter) {}
+    ~Restore() { counter = value; }
+};
+
+// Slots hold this until their variable is declared.
+QuastraValue undefined() { return std::shared_ptr<QuastraCallable>(); }
+
+bool is_undefined(const QuastraValue& value) {
+    auto* function = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+    return function && !*function;
+}
+
+bool truthy(const QuastraValue& value) {
+    auto* flag = std::get_if<bool>(&value);
+    return !flag || *flag;
+}
+
+Signal run(const std::vector<StmtCode>& statements, Frame& frame) {
+    for (const auto& statement : statements) {
+        Signal signal = statement(frame);
+        if (signal != Signal::Next) return signal;
+    }
+    return Signal::Next;
+}
+
+Frame& frame_at(Frame& frame, size_t hops) {
+    Frame* current = &frame;
+    for (size_t i = 0; i < hops; ++i) current = current->parent.get();
+    return *current;
+}
+
+std::runtime_error undefined_variable(const std::string& name) {
+    return std::runtime_error("Undefined variable '" + name + "'.");
+}
+
+// True if the statement declares a function outside any nested function
+// body. Such blocks need a frame of their own for the function to capture.
+bool declares_function(const AST::Stmt& stmt) {
+    if (dynamic_cast<const AST::FunctionStmt*>(&stmt)) return true;
+    if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& inner : block->statements) {
+            if (declares_function(*inner)) return true;
+        }
+    } else if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return declares_function(*if_stmt->then_branch) ||
+               (if_stmt->else_branch && declares_function(*if_stmt->else_branch));
+    } else if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return declares_function(*while_stmt->body);
+    }
+    return false;
+}
+
+// An arithmetic or comparison operator on two numbers. `op` also decides
+// the result type.
+template <typename Op>
+ExprCode numeric(ExprCode left, ExprCode right, const char* message, Op op) {
+    return [left = std::move(left), right = std::move(right), message, op](Frame& frame) -> QuastraValue {
+        QuastraValue a = left(frame);
+        QuastraValue b = right(frame);
+        const double* x = std::get_if<double>(&a);
+        const double* y = std::get_if<double>(&b);
+        if (!x || !y) throw std::runtime_error(message);
+        return op(*x, *y);
+    };
+}
+
+// The same with a number literal on the right, as in `i + 1` or `n < 2`.
+template <typename Op>
+ExprCode numeric(ExprCode left, double constant, const char* message, Op op) {
+    return [left = std::move(left), constant, message, op](Frame& frame) -> QuastraValue {
+        QuastraValue a = left(frame);
+        const double* x = std::get_if<double>(&a);
+        if (!x) throw std::runtime_error(message);
+        return op(*x, constant);
+    };
+}
+
+// A Quastra function compiled by the engine, with the frame it was declared in.
+class CompiledFunction : public QuastraCallable {
+public:
+    CompiledFunction(std::shared_ptr<const ClosureEngine::FunctionCode> code, std::shared_ptr<Frame> closure,
+                     ClosureEngine& engine)
+        : code(std::move(code)), closure(std::move(closure)), engine(engine) {}
+
+    int arity() const override { return static_cast<int>(code->parameters.size()); }
+
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override {
+        (void)interpreter; // The body runs on the engine that compiled it.
+        return engine.call(shared_from_this(), std::vector<QuastraValue>(std::make_move_iterator(arguments.begin()),
+                                                                         std::make_move_iterator(arguments.end())));
+    }
+
+    std::shared_ptr<const ClosureEngine::FunctionCode> code;
+    std::shared_ptr<Frame> closure;
+
+private:
+    ClosureEngine& engine;
+};
+
+} // namespace
+
+Frame::Frame(size_t size, std::shared_ptr<Frame> parent) : slots(size, undefined()), parent(std::move(parent)) {}
+
+ClosureEngine::ClosureEngine(size_t max_call_depth) : max_call_depth(max_call_depth) {
+    scopes.emplace_back();
+    scopes.back().owns_frame = true;
+    const auto& natives = native_registry().all();
+    for (const auto& native : natives) {
+        scopes.back().declared[native.name] = declare_slot(scopes.back(), native.name);
+    }
+    globals = std::make_shared<Frame>(scopes.back().frame_size, nullptr);
+    for (const auto& native : natives) {
+        globals->slots[scopes.back().declared[native.name]] = native.function;
+    }
+}
+
+void ClosureEngine::interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    try {
+        predeclare(statements);
+        std::vector<StmtCode> code;
+        for (const auto& statement : statements) {
+            if (statement) code.push_back(compile(*statement));
+        }
+        globals->slots.resize(scopes.front().frame_size, undefined());
+        drive([&] { run(code, *globals); });
+    } catch (const std::runtime_error& error) {
+        standard_output().flush();
+        std::cerr << "Runtime Error: " << error.what() << std::endl;
+    }
+    standard_output().flush();
+}
+
+QuastraValue ClosureEngine::call(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments) {
+    if (driving) return invoke(std::move(function), std::move(arguments));
+    QuastraValue result;
+    drive([&] { result = invoke(std::move(function), std::move(arguments)); });
+    return result;
+}
+
+void ClosureEngine::drive(const std::function<void()>& body) {
+    Restore depth(call_depth); // Fibers the loop unwinds leave it behind.
+    EventLoop loop;
+    EventLoop::Installed installed(loop);
+    driving = true;
+    try {
+        body();
+        loop.run();
+    } catch (...) {
+        driving = false;
+        throw;
+    }
+    driving = false;
+}
+
+// Runs a call and any tail calls its body hands back in place of returning;
+// like the Interpreter, a chain of tail calls counts as one level.
+QuastraValue ClosureEngine::invoke(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments) {
+    if (max_call_depth != 0 && call_depth >= max_call_depth) {
+        throw std::runtime_error("Call depth limit exceeded.");
+    }
+    struct Level {
+        size_t& depth;
+        explicit Level(size_t& depth) : depth(depth) { depth++; }
+        ~Level() { depth--; }
+    } level(call_depth);
+    while (true) {
+        auto* compiled = dynamic_cast<CompiledFunction*>(function.get());
+        if (!compiled) return function->call(host, arguments);
+
+        const FunctionCode& code = *compiled->code;
+        auto frame = std::make_shared<Frame>(code.frame_size, compiled->closure);
+        for (size_t i = 0; i < code.parameters.size(); ++i) {
+            frame->slots[code.parameters[i]] = std::move(arguments[i]);
+        }
+        if (code.is_async) return start_async(compiled->code, std::move(frame));
+        Signal signal = run(code.body, *frame);
+        if (signal == Signal::TailCall) {
+            function = std::move(tail_function);
+            arguments = std::move(tail_arguments);
+            continue;
+        }
+        // Falling off the end returns false.
+        return signal == Signal::Return ? std::move(return_value) : QuastraValue(false);
+    }
+}
+
+std::shared_ptr<QuastraFuture> ClosureEngine::start_async(std::shared_ptr<const FunctionCode> code,
+                                                          std::shared_ptr<Frame> frame) {
+    auto future = std::make_shared<QuastraFuture>();
+    Restore depth(call_depth);
+    EventLoop::current().start([this, code = std::move(code), frame = std::move(frame), future] {
+        // The resolver marks no tail calls in async bodies.
+        Signal signal = run(code->body, *frame);
+        future->complete(signal == Signal::Return ? std::move(return_value) : QuastraValue(false));
+    });
+    return future;
+}
+
+const QuastraValue* ClosureEngine::get_global(const std::string& name) const {
+    const Scope& scope = scopes.front();
+    auto it = scope.all.find(name);
+    if (it == scope.all.end() || it->second >= globals->slots.size()) return nullptr;
+    const QuastraValue& value = globals->slots[it->second];
+    return is_undefined(value) ? nullptr : &value;
+}
+
+// --- Scopes ---
+
+void ClosureEngine::push_scope(bool owns_frame) {
+    Scope scope;
+    scope.owns_frame = owns_frame;
+    scope.frame_owner = owns_frame ? scopes.size() : scopes.back().frame_owner;
+    scope.function_depth = function_depth;
+    scopes.push_back(std::move(scope));
+}
+
+// Gives every name the statements declare a slot in the innermost scope.
+void ClosureEngine::predeclare(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& statement : statements) {
+        if (auto* decl = dynamic_cast<const AST::VarDecl*>(statement.get())) {
+            declare_slot(scopes.back(), decl->name.lexeme);
+        } else if (auto* function = dynamic_cast<const AST::FunctionStmt*>(statement.get())) {
+            declare_slot(scopes.back(), function->name.lexeme);
+        }
+    }
+}
+
+// Redeclaring a name in the same scope reuses its slot.
+size_t ClosureEngine::declare_slot(Scope& scope, const std::string& name) {
+    auto it = scope.all.find(name);
+    if (it != scope.all.end()) return it->second;
+    size_t slot = scopes[scope.frame_owner].frame_size++;
+    scope.all[name] = slot;
+    return slot;
+}
+
+// Marks a name as declared from here on and returns its slot.
+size_t ClosureEngine::declare(const std::string& name) {
+    Scope& scope = scopes.back();
+    size_t slot = declare_slot(scope, name);
+    scope.declared[name] = slot;
+    return slot;
+}
+
+bool ClosureEngine::resolve(const std::string& name, Binding& binding) const {
+    size_t hops = 0;
+    for (size_t i = scopes.size(); i-- > 0;) {
+        const Scope& scope = scopes[i];
+        bool same_function = scope.function_depth == function_depth;
+        const auto& names = same_function ? scope.declared : scope.all;
+        auto it = names.find(name);
+        if (it != names.end()) {
+            binding = {hops, it->second, !same_function};
+            return true;
+        }
+        if (scope.owns_frame) hops++;
+    }
+    return false;
+}
+
+// --- Statements ---
+
+std::vector<StmtCode> ClosureEngine::compile_block(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::vector<StmtCode> code;
+    for (const auto& statement : statements) {
+        code.push_back(compile(*statement));
+    }
+    return code;
+}
+
+StmtCode ClosureEngine::compile(const AST::Stmt& stmt) {
+    if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        return [expr = compile(*expr_stmt->expression)](Frame& frame) {
+            expr(frame);
+            return Signal::Next;
+        };
+    }
+
+    if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        // The initializer still sees any outer binding of the name.
+        ExprCode initializer = decl->initializer ? compile(*decl->initializer) : nullptr;
+        size_t slot = declare(decl->name.lexeme);
+        if (!initializer) {
+            return [slot](Frame& frame) {
+                frame.slots[slot] = false;
+                return Signal::Next;
+            };
+        }
+        return [slot, initializer = std::move(initializer)](Frame& frame) {
+            frame.slots[slot] = initializer(frame);
+            return Signal::Next;
+        };
+    }
+
+    if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        bool owns_frame = declares_function(stmt);
+        push_scope(owns_frame);
+        predeclare(block->statements);
+        std::vector<StmtCode> body = compile_block(block->statements);
+        size_t frame_size = scopes.back().frame_size;
+        scopes.pop_back();
+        if (!owns_frame) {
+            return [body = std::move(body)](Frame& frame) { return run(body, frame); };
+        }
+        return [body = std::move(body), frame_size](Frame& frame) {
+            auto block_frame = std::make_shared<Frame>(frame_size, frame.shared_from_this());
+            return run(body, *block_frame);
+        };
+    }
+
+    if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        ExprCode condition = compile(*if_stmt->condition);
+        StmtCode then_branch = compile(*if_stmt->then_branch);
+        if (!if_stmt->else_branch) {
+            return [condition = std::move(condition), then_branch = std::move(then_branch)](Frame& frame) {
+                return truthy(condition(frame)) ? then_branch(frame) : Signal::Next;
+            };
+        }
+        StmtCode else_branch = compile(*if_stmt->else_branch);
+        return [condition = std::move(condition), then_branch = std::move(then_branch),
+                else_branch = std::move(else_branch)](Frame& frame) {
+            return truthy(condition(frame)) ? then_branch(frame) : else_branch(frame);
+        };
+    }
+
+    if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return [condition = compile(*while_stmt->condition), body = compile(*while_stmt->body)](Frame& frame) {
+            while (truthy(condition(frame))) {
+                Signal signal = body(frame);
+                if (signal != Signal::Next) return signal;
+            }
+            return Signal::Next;
+        };
+    }
+
+    if (auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        size_t slot = declare(function->name.lexeme);
+        auto code = std::make_shared<FunctionCode>();
+        code->name = function->name.lexeme;
+        code->is_async = function->is_async;
+
+        // Parameters and the body share a scope, as in the Interpreter.
+        function_depth++;
+        push_scope(true);
+        for (const auto& param : function->params) {
+            code->parameters.push_back(declare(param.lexeme));
+        }
+        predeclare(function->body);
+        code->body = compile_block(function->body);
+        code->frame_size = scopes.back().frame_size;
+        scopes.pop_back();
+        function_depth--;
+
+        return [this, slot, code = std::shared_ptr<const FunctionCode>(std::move(code))](Frame& frame) {
+            frame.slots[slot] = std::make_shared<CompiledFunction>(code, frame.shared_from_this(), *this);
+            return Signal::Next;
+        };
+    }
+
+    if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        auto* call = dynamic_cast<const AST::Call*>(return_stmt->value.get());
+        if (call && call->is_tail_call && function_depth > 0) return compile_tail_call(*call);
+        if (!return_stmt->value) {
+            return [this](Frame&) {
+                return_value = false;
+                return Signal::Return;
+            };
+        }
+        return [this, value = compile(*return_stmt->value)](Frame& frame) {
+            return_value = value(frame);
+            return Signal::Return;
+        };
+    }
+
+    throw std::runtime_error("Unsupported statement.");
+}
+
+// --- Expressions ---
+
+ExprCode ClosureEngine::compile(const AST::Expr& expr) {
+    if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        QuastraValue value = false;
+        if (literal->value.type == TokenType::IntLiteral) value = std::stod(literal->value.lexeme);
+        else if (literal->value.type == TokenType::True) value = true;
+        else if (literal->value.type == TokenType::StringLiteral) value = QuastraString::intern(string_value(literal->value));
+        return [value](Frame&) { return value; };
+    }
+
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        std::string name = variable->name.lexeme;
+        Binding binding;
+        if (!resolve(name, binding)) {
+            return [name](Frame&) -> QuastraValue { throw undefined_variable(name); };
+        }
+        if (binding.checked) {
+            return [name, binding](Frame& frame) {
+                const QuastraValue& value = frame_at(frame, binding.hops).slots[binding.slot];
+                if (is_undefined(value)) throw undefined_variable(name);
+                return value;
+            };
+        }
+        if (binding.hops == 0) {
+            return [slot = binding.slot](Frame& frame) { return frame.slots[slot]; };
+        }
+        return [binding](Frame& frame) { return frame_at(frame, binding.hops).slots[binding.slot]; };
+    }
+
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        std::string name = assign->name.lexeme;
+        ExprCode value = compile(*assign->value);
+        Binding binding;
+        if (!resolve(name, binding)) {
+            return [name, value = std::move(value)](Frame& frame) -> QuastraValue {
+                value(frame);
+                throw undefined_variable(name);
+            };
+        }
+        return [name, binding, value = std::move(value)](Frame& frame) {
+            QuastraValue result = value(frame);
+            QuastraValue& slot = frame_at(frame, binding.hops).slots[binding.slot];
+            if (binding.checked && is_undefined(slot)) throw undefined_variable(name);
+            slot = result;
+            return result;
+        };
+    }
+
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        ExprCode right = compile(*unary->right);
+        if (unary->op.type == TokenType::Minus) {
+            return [right = std::move(right)](Frame& frame) -> QuastraValue {
+                QuastraValue value = right(frame);
+                const double* number = std::get_if<double>(&value);
+                if (!number) throw std::runtime_error("Operand must be a number for unary minus.");
+                return -*number;
+            };
+        }
+        if (unary->op.type == TokenType::Await) {
+            return [this, right = std::move(right)](Frame& frame) -> QuastraValue {
+                QuastraValue value = right(frame);
+                auto* future = std::get_if<std::shared_ptr<QuastraFuture>>(&value);
+                if (!future) throw std::runtime_error("Can only await futures.");
+                Restore depth(call_depth);
+                return EventLoop::current().await(**future);
+            };
+        }
+        return [right = std::move(right)](Frame& frame) -> QuastraValue { return !truthy(right(frame)); };
+    }
+
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) return compile_binary(*binary);
+    if (auto* call = dynamic_cast<const AST::Call*>(&expr)) return compile_call(*call);
+
+    throw std::runtime_error("Unsupported expression.");
+}
+
+ExprCode ClosureEngine::compile_binary(const AST::Binary& expr) {
+    ExprCode left = compile(*expr.left);
+
+    // Arithmetic and comparisons against a number literal only check the left operand.
+    auto* literal = dynamic_cast<const AST::Literal*>(expr.right.get());
+    if (literal && literal->value.type == TokenType::IntLiteral) {
+        double constant = std::stod(literal->value.lexeme);
+        switch (expr.op.type) {
+            case TokenType::Greater:
+                return numeric(std::move(left), constant, "Operands must be numbers for comparison.",
+                               [](double a, double b) { return a > b; });
+            case TokenType::GreaterEqual:
+                return numeric(std::move(left), constant, "Operands must be numbers for comparison.",
+                               [](double a, double b) { return a >= b; });
+            case TokenType::Less:
+                return numeric(std::move(left), constant, "Operands must be numbers for comparison.",
+                               [](double a, double b) { return a < b; });
+            case TokenType::LessEqual:
+                return numeric(std::move(left), constant, "Operands must be numbers for comparison.",
+                               [](double a, double b) { return a <= b; });
+            case TokenType::Plus:
+                return numeric(std::move(left), constant, "Operands must be two numbers or two strings for addition.",
+                               [](double a, double b) { return a + b; });
+            case TokenType::Minus:
+                return numeric(std::move(left), constant, "Operands must be numbers for subtraction.",
+                               [](double a, double b) { return a - b; });
+            case TokenType::Star:
+                return numeric(std::move(left), constant, "Operands must be numbers for multiplication.",
+                               [](double a, double b) { return a * b; });
+            default: break;
+        }
+    }
+
+    ExprCode right = compile(*expr.right);
+    switch (expr.op.type) {
+        case TokenType::EqualEqual:
+            return [left = std::move(left), right = std::move(right)](Frame& frame) -> QuastraValue {
+                QuastraValue a = left(frame);
+                return a == right(frame);
+            };
+        case TokenType::BangEqual:
+            return [left = std::move(left), right = std::move(right)](Frame& frame) -> QuastraValue {
+                QuastraValue a = left(frame);
+                return a != right(frame);
+            };
+        case TokenType::Greater:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for comparison.",
+                           [](double a, double b) { return a > b; });
+        case TokenType::GreaterEqual:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for comparison.",
+                           [](double a, double b) { return a >= b; });
+        case TokenType::Less:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for comparison.",
+                           [](double a, double b) { return a < b; });
+        case TokenType::LessEqual:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for comparison.",
+                           [](double a, double b) { return a <= b; });
+        case TokenType::Plus:
+            return [left = std::move(left), right = std::move(right)](Frame& frame) -> QuastraValue {
+                QuastraValue a = left(frame);
+                QuastraValue b = right(frame);
+                const double* x = std::get_if<double>(&a);
+                const double* y = std::get_if<double>(&b);
+                if (x && y) return *x + *y;
+                const QuastraString* s = std::get_if<QuastraString>(&a);
+                const QuastraString* t = std::get_if<QuastraString>(&b);
+                if (s && t) return QuastraString::concat(*s, *t);
+                throw std::runtime_error("Operands must be two numbers or two strings for addition.");
+            };
+        case TokenType::Minus:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for subtraction.",
+                           [](double a, double b) { return a - b; });
+        case TokenType::Star:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for multiplication.",
+                           [](double a, double b) { return a * b; });
+        case TokenType::Slash:
+            return numeric(std::move(left), std::move(right), "Operands must be numbers for division.",
+                           [](double a, double b) {
+                               if (b == 0) throw std::runtime_error("Division by zero.");
+                               return a / b;
+                           });
+        default: break;
+    }
+    return [left = std::move(left), right = std::move(right)](Frame& frame) -> QuastraValue {
+        left(frame);
+        right(frame);
+        throw std::runtime_error("Invalid binary operation.");
+    };
+}
+
+namespace {
+
+// Evaluates the callee and arguments of a call and checks the arity, in the
+// Interpreter's order.
+std::shared_ptr<QuastraCallable> prepare_call(const ExprCode& callee, const std::vector<ExprCode>& arguments,
+                                              Frame& frame, std::vector<QuastraValue>& values) {
+    QuastraValue value = callee(frame);
+    auto* function = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+    if (!function || !*function) throw std::runtime_error("Can only call functions and classes.");
+    if (arguments.size() != static_cast<size_t>((*function)->arity())) {
+        throw std::runtime_error("Expected " + std::to_string((*function)->arity()) + " arguments but got " +
+                                 std::to_string(arguments.size()) + ".");
+    }
+    values.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        values.push_back(argument(frame));
+    }
+    return std::move(*function);
+}
+
+} // namespace
+
+ExprCode ClosureEngine::compile_call(const AST::Call& expr) {
+    ExprCode callee = compile(*expr.callee);
+    std::vector<ExprCode> arguments;
+    for (const auto& argument : expr.arguments) {
+        arguments.push_back(compile(*argument));
+    }
+    return [this, callee = std::move(callee), arguments = std::move(arguments)](Frame& frame) {
+        std::vector<QuastraValue> values;
+        auto function = prepare_call(callee, arguments, frame, values);
+        return invoke(std::move(function), std::move(values));
+    };
+}
+
+// `return f(...)` in a function: hands the call to the caller's loop in
+// ClosureEngine::invoke instead of making it here.
+StmtCode ClosureEngine::compile_tail_call(const AST::Call& expr) {
+    ExprCode callee = compile(*expr.callee);
+    std::vector<ExprCode> arguments;
+    for (const auto& argument : expr.arguments) {
+        arguments.push_back(compile(*argument));
+    }
+    return [this, callee = std::move(callee), arguments = std::move(arguments)](Frame& frame) {
+        std::vector<QuastraValue> values;
+        tail_function = prepare_call(callee, arguments, frame, values);
+        tail_arguments = std::move(values);
+        return Signal::TailCall;
+    };
+}
+
+} // namespace Quastra
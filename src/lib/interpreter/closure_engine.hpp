@@ -0,0 +1,129 @@
+#pragma once
+
+#include "interpreter.hpp"
+#include "../frontend/ast.hpp"
+#include "../runtime/quastra_value.hpp"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// The storage of one activation: the globals, a function call, or a block
+// that declares functions (which may capture it). Variables live in slots
+// numbered when the program is compiled.
+struct Frame : std::enable_shared_from_this<Frame> {
+    std::vector<QuastraValue> slots;
+    std::shared_ptr<Frame> parent;
+
+    Frame(size_t size, std::shared_ptr<Frame> parent);
+};
+
+// An alternative to the tree-walking Interpreter. Each AST node is compiled
+// once into a closure specialised for it: operators, literal values and
+// variable slots are resolved at compile time, so running the program is a
+// chain of calls through std::function with no visitor dispatch, operator
+// switch or name lookup. Blocks only get a frame of their own when they
+// declare a function; otherwise their variables live in the enclosing one.
+// Output, runtime error messages and tail-call behaviour match the
+// Interpreter's.
+class ClosureEngine {
+public:
+    // How a statement finished.
+    enum class Signal { Next, Return, TailCall };
+
+    using ExprCode = std::function<QuastraValue(Frame&)>;
+    using StmtCode = std::function<Signal(Frame&)>;
+
+    // The compiled form of a function declaration.
+    struct FunctionCode {
+        std::string name;
+        bool is_async = false; // Calls return a future of the result.
+        std::vector<size_t> parameters; // Slots the arguments go to.
+        size_t frame_size = 0;
+        std::vector<StmtCode> body;
+    };
+
+    // Calls nest in C++, so a program can only recurse as deep as the
+    // stack allows; beyond `max_call_depth` calls in progress (0 for no
+    // limit), a call fails with a runtime error instead.
+    explicit ClosureEngine(size_t max_call_depth = 0);
+
+    // Compiles and runs the statements at top level. Runtime errors are
+    // reported on stderr, like Interpreter::interpret.
+    void interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // Calls a function with the given arguments, running tail calls in
+    // constant stack. Async calls it leaves running finish before it
+    // returns, as at the end of interpret(). Runtime errors propagate as
+    // std::runtime_error.
+    QuastraValue call(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments);
+
+    // The value of a global, or nullptr if it is not defined (yet).
+    const QuastraValue* get_global(const std::string& name) const;
+
+private:
+    // A compile-time scope. `declared` holds the names declared so far, in
+    // source order; `all` every name the scope declares. Code in the same
+    // function sees `declared`; nested functions run later and see `all`.
+    struct Scope {
+        std::map<std::string, size_t> declared;
+        std::map<std::string, size_t> all;
+        bool owns_frame = false;
+        size_t frame_owner = 0; // Index of the scope whose frame holds the slots.
+        size_t frame_size = 0;  // Slots allocated, when owns_frame.
+        int function_depth = 0;
+    };
+
+    // Where a name lives: `hops` frames up, in `slot`. `checked` reads test
+    // for the undefined marker, for names that may not be declared yet.
+    struct Binding {
+        size_t hops = 0;
+        size_t slot = 0;
+        bool checked = false;
+    };
+
+    // call() within the program, which is already running on a loop.
+    QuastraValue invoke(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments);
+    // Runs an async function's body on a fiber of the current EventLoop,
+    // until it first awaits a pending future; returns the future of the
+    // body's result.
+    std::shared_ptr<QuastraFuture> start_async(std::shared_ptr<const FunctionCode> code, std::shared_ptr<Frame> frame);
+    // Runs `body` with an event loop of its own, then the async calls it
+    // left running.
+    void drive(const std::function<void()>& body);
+
+    void push_scope(bool owns_frame);
+    void predeclare(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    size_t declare_slot(Scope& scope, const std::string& name);
+    size_t declare(const std::string& name);
+    bool resolve(const std::string& name, Binding& binding) const;
+
+    std::vector<StmtCode> compile_block(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    StmtCode compile(const AST::Stmt& stmt);
+    ExprCode compile(const AST::Expr& expr);
+    ExprCode compile_binary(const AST::Binary& expr);
+    ExprCode compile_call(const AST::Call& expr);
+    StmtCode compile_tail_call(const AST::Call& expr);
+
+    std::vector<Scope> scopes;
+    int function_depth = 0;
+    size_t max_call_depth;
+    size_t call_depth = 0;
+    // Whether interpret() or call() is running, and with it an event loop.
+    bool driving = false;
+    std::shared_ptr<Frame> globals;
+
+    // Set by `return` for the call that is running it.
+    QuastraValue return_value;
+    std::shared_ptr<QuastraCallable> tail_function;
+    std::vector<QuastraValue> tail_arguments;
+
+    // Native functions take the interpreter calling them. They only use it
+    // for callbacks into Quastra code, which none of them make.
+    Interpreter host;
+};
+
+} // namespace Quastra
@@ -0,0 +1,122 @@
+#include "environment_collector.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace Quastra {
+
+void EnvironmentCollector::track(const std::shared_ptr<Environment>& environment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto* scope = &environment; *scope && !(*scope)->tracked; scope = &(*scope)->get_enclosing()) {
+        (*scope)->tracked = true;
+        young.push_back(*scope);
+    }
+    if (young.size() < young_limit || TaskScheduler::concurrent()) return;
+    collect(young);
+    if (old.size() >= old_limit) collect_all();
+}
+
+size_t EnvironmentCollector::collect() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return collect_all();
+}
+
+size_t EnvironmentCollector::collect_all() {
+    std::vector<std::weak_ptr<Environment>> all = std::move(old);
+    old.clear();
+    all.insert(all.end(), young.begin(), young.end());
+    young.clear();
+    size_t reclaimed = collect(all);
+    old_limit = std::max(young_limit, 2 * old.size());
+    return reclaimed;
+}
+
+// Collects the environments in `generation`; references from anything
+// outside it count as external. Survivors join the old generation.
+size_t EnvironmentCollector::collect(std::vector<std::weak_ptr<Environment>>& generation) {
+    struct Node {
+        std::shared_ptr<Environment> environment;
+        long references = 0; // Left once references from the generation are taken out.
+        bool reachable = false;
+    };
+    std::vector<Node> nodes;
+    std::unordered_map<const Environment*, size_t> index;
+    for (const auto& weak : generation) {
+        if (auto environment = weak.lock()) {
+            index.emplace(environment.get(), nodes.size());
+            nodes.push_back({std::move(environment)});
+        }
+    }
+    generation.clear();
+    auto find = [&](const Environment* environment) -> Node* {
+        auto it = index.find(environment);
+        return it == index.end() ? nullptr : &nodes[it->second];
+    };
+    // Calls `visit` for every QuastraFunction stored in the environment.
+    auto for_each_function = [](const Environment& environment, auto visit) {
+        for (const auto& [name, value] : environment.get_values()) {
+            const auto* callable = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+            const auto* function = callable ? dynamic_cast<const QuastraFunction*>(callable->get()) : nullptr;
+            if (function) visit(*function, callable->use_count());
+        }
+    };
+
+    // `nodes` holds one reference to each environment itself.
+    for (auto& node : nodes) node.references = node.environment.use_count() - 1;
+
+    // Take out the references from the generation: enclosing pointers, and
+    // closures of functions that only the generation holds.
+    struct FunctionUse {
+        long holders = 0;  // All references to the function.
+        long internal = 0; // Those from environments in the generation.
+    };
+    std::unordered_map<const QuastraFunction*, FunctionUse> functions;
+    for (auto& node : nodes) {
+        if (Node* enclosing = find(node.environment->get_enclosing().get())) enclosing->references--;
+        for_each_function(*node.environment, [&](const QuastraFunction& function, long holders) {
+            FunctionUse& use = functions[&function];
+            use.holders = holders;
+            use.internal++;
+        });
+    }
+    std::vector<Node*> pending;
+    for (const auto& [function, use] : functions) {
+        Node* closure = find(function->get_closure().get());
+        if (!closure) continue;
+        if (use.internal == use.holders) {
+            closure->references--;
+        } else {
+            pending.push_back(closure); // The function is held from outside.
+        }
+    }
+
+    // Whatever is referenced from outside is a root; mark what it reaches.
+    for (auto& node : nodes) {
+        if (node.references > 0) pending.push_back(&node);
+    }
+    while (!pending.empty()) {
+        Node* node = pending.back();
+        pending.pop_back();
+        if (node->reachable) continue;
+        node->reachable = true;
+        if (Node* enclosing = find(node->environment->get_enclosing().get())) pending.push_back(enclosing);
+        for_each_function(*node->environment, [&](const QuastraFunction& function, long) {
+            if (Node* closure = find(function.get_closure().get())) pending.push_back(closure);
+        });
+    }
+
+    // Clearing the garbage drops the functions in it, and with them the
+    // closure references that kept it alive.
+    size_t reclaimed = 0;
+    for (auto& node : nodes) {
+        if (node.reachable) {
+            old.push_back(node.environment);
+        } else {
+            node.environment->clear();
+            ++reclaimed;
+        }
+    }
+    return reclaimed;
+}
+
+} // namespace Quastra
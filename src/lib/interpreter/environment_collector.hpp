@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../runtime/environment.hpp"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Quastra {
+
+// Reclaims environments that only reference cycles keep alive. A function
+// holds its closure environment, which often holds the function itself (or
+// an enclosing scope does), so shared_ptr alone never frees them.
+//
+// Only environments a function has captured, and the scopes enclosing them,
+// can be part of such a cycle, so only those are tracked. A collection works
+// like CPython's cycle collector: it counts the references to each tracked
+// environment that come from the tracked set itself (enclosing pointers, and
+// the closures of functions stored only in tracked environments). An
+// environment with more references than that is reachable from outside: from
+// the interpreter, the C++ stack or the host. Everything reachable from those
+// survives; the rest is garbage and is cleared, which breaks its cycles.
+//
+// Pauses are bounded by generations: newly tracked environments are
+// collected on their own once there are `young_limit` of them, treating
+// references from older ones as external, and survivors join the old
+// generation, which is collected in full only when it has doubled.
+//
+// Spawned tasks share one collector. Tracking is locked, and no collection
+// starts on its own while tasks may run, since a collection reads every
+// tracked environment; a due generation is collected once they are done.
+class EnvironmentCollector {
+public:
+    static constexpr size_t young_limit = 1000;
+
+    // Tracks `environment` and the scopes enclosing it, which a function has
+    // just captured, and collects if a generation is due.
+    void track(const std::shared_ptr<Environment>& environment);
+
+    // Collects every tracked environment now. Returns how many were reclaimed.
+    size_t collect();
+
+    // Tracked environments that may still be alive.
+    size_t tracked() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return young.size() + old.size();
+    }
+
+private:
+    // Both expect `mutex` to be held.
+    size_t collect_all();
+    size_t collect(std::vector<std::weak_ptr<Environment>>& generation);
+
+    std::vector<std::weak_ptr<Environment>> young;
+    std::vector<std::weak_ptr<Environment>> old;
+    size_t old_limit = young_limit;
+    mutable std::mutex mutex;
+};
+
+} // namespace Quastra
@@ -1,6 +1,8 @@
 #include "interpreter.hpp"
 #include "../runtime/quastra_callable.hpp"
-#include "../runtime/native_functions.hpp" // Include our new native function
+#include "../runtime/core_io.hpp"
+#include "../runtime/event_loop.hpp"
+#include "../runtime/native_registry.hpp"
 #include <stdexcept>
 
 namespace Quastra {
@@ -12,20 +14,75 @@ bool is_truthy(const QuastraValue& value) {
 }
 bool is_equal(const QuastraValue& a, const QuastraValue& b) { return a == b; }
 
-Interpreter::Interpreter() {
+// The specialisation of an operator for two number operands.
+static AST::BinarySpecialization number_specialization(TokenType op) {
+    using Specialization = AST::BinarySpecialization;
+    switch (op) {
+        case TokenType::Plus: return Specialization::AddNumbers;
+        case TokenType::Minus: return Specialization::SubtractNumbers;
+        case TokenType::Star: return Specialization::MultiplyNumbers;
+        case TokenType::Slash: return Specialization::DivideNumbers;
+        case TokenType::Less: return Specialization::LessNumbers;
+        case TokenType::LessEqual: return Specialization::LessEqualNumbers;
+        case TokenType::Greater: return Specialization::GreaterNumbers;
+        case TokenType::GreaterEqual: return Specialization::GreaterEqualNumbers;
+        case TokenType::EqualEqual: return Specialization::EqualNumbers;
+        case TokenType::BangEqual: return Specialization::NotEqualNumbers;
+        default: return Specialization::Generic;
+    }
+}
+
+Interpreter::Interpreter() : collector(std::make_shared<EnvironmentCollector>()) {
     environment = std::make_shared<Environment>();
-    // Define the native println function in the global scope.
-    environment->define("println", std::make_shared<PrintlnFunction>());
+    globals = environment;
+    // Define the native functions in the global scope.
+    for (const auto& native : native_registry().all()) {
+        environment->define(native.name, native.function);
+    }
+}
+
+Interpreter::Interpreter(const Interpreter& parent, std::shared_ptr<Environment> scope)
+    : globals(parent.globals), limits(parent.limits), collector(parent.collector), is_task(true) {
+    environment = std::move(scope);
+}
+
+Interpreter::~Interpreter() {
+    // Once the interpreter lets go of its scopes, only cycles and the host
+    // keep them alive.
+    environment.reset();
+    globals.reset();
+    last_evaluated_value = false;
+    tail_arguments.clear();
+    if (!is_task) collector->collect();
+}
+
+std::shared_ptr<QuastraFunction> Interpreter::make_function(const AST::FunctionStmt& declaration,
+                                                            std::shared_ptr<Environment> closure) {
+    collector->track(closure);
+    return std::make_shared<QuastraFunction>(declaration, std::move(closure));
 }
 
 void Interpreter::interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    TaskScheduler::Program program;
+    TaskGroup group(TaskScheduler::shared());
+    TaskGroup* previous = tasks;
+    tasks = &group;
+    EventLoop loop;
+    EventLoop::Installed installed(loop);
     try {
         for (const auto& statement : statements) {
             if (statement) statement->accept(*this);
         }
+        loop.run();
+        group.wait();
+        if (group.failed()) throw std::runtime_error(group.error());
     } catch (const std::runtime_error& error) {
+        group.wait();
+        standard_output().flush();
         std::cerr << "Runtime Error: " << error.what() << std::endl;
     }
+    standard_output().flush();
+    tasks = previous;
 }
 
 // --- Statement Execution ---
@@ -41,7 +98,100 @@ void Interpreter::visit(const AST::VarDecl& stmt) {
 }
 
 void Interpreter::visit(const AST::Block& stmt) {
-    execute_block(stmt.statements, std::make_shared<Environment>(environment));
+    switch (stmt.kind) {
+        case AST::BlockKind::Plain:
+            execute_block(stmt.statements, std::make_shared<Environment>(environment));
+            return;
+        case AST::BlockKind::Scope:
+            run_joined(stmt.statements, std::make_shared<Environment>(environment));
+            return;
+        case AST::BlockKind::Spawn:
+            spawn(stmt);
+            return;
+    }
+}
+
+// The task gets an interpreter of its own, since this one carries on
+// meanwhile; the block's scope encloses the variables the task can see.
+void Interpreter::spawn(const AST::Block& stmt) {
+    auto scope = std::make_shared<Environment>(environment);
+    if (!tasks) {
+        execute_block(stmt.statements, std::move(scope));
+        return;
+    }
+    std::shared_ptr<Interpreter> task(new Interpreter(*this, std::move(scope)));
+    const auto& statements = stmt.statements;
+    tasks->spawn([task, &statements] {
+        // Async calls the task makes run on its thread's loop.
+        EventLoop loop;
+        EventLoop::Installed installed(loop);
+        task->join([&] {
+            task->execute_block(statements, task->environment);
+            loop.run();
+        });
+    });
+}
+
+void Interpreter::run_joined(const std::vector<std::unique_ptr<AST::Stmt>>& statements,
+                             std::shared_ptr<Environment> scope) {
+    join([&] { execute_block(statements, std::move(scope)); });
+}
+
+QuastraValue Interpreter::evaluate_joined(const AST::Expr& expr) {
+    TaskScheduler::Program program;
+    EventLoop loop;
+    EventLoop::Installed installed(loop);
+    QuastraValue value;
+    join([&] {
+        value = evaluate(expr);
+        loop.run();
+    });
+    return value;
+}
+
+// The body gets an interpreter of its own, since this one carries on when
+// the body waits. Tasks it spawns outside any `scope` are joined when it
+// ends.
+std::shared_ptr<QuastraFuture> Interpreter::run_async(const std::vector<std::unique_ptr<AST::Stmt>>& body,
+                                                      std::shared_ptr<Environment> scope) {
+    auto future = std::make_shared<QuastraFuture>();
+    std::shared_ptr<Interpreter> fiber(new Interpreter(*this, std::move(scope)));
+    fiber->call_depth = call_depth;
+    fiber->steps = steps;
+    EventLoop::current().start([fiber, future, &body] {
+        QuastraValue result = false;
+        try {
+            fiber->join([&] { fiber->execute_block(body, fiber->environment); });
+        } catch (const ReturnException& returned) {
+            result = returned.value;
+        }
+        future->complete(std::move(result));
+    });
+    steps = fiber->steps;
+    return future;
+}
+
+// The group is joined even when the body fails. Otherwise the first error
+// of one of its tasks becomes the body's error, also when the body leaves
+// by a return, as it does on the other engines.
+void Interpreter::join(const std::function<void()>& body) {
+    TaskGroup group(TaskScheduler::shared());
+    TaskGroup* previous = tasks;
+    tasks = &group;
+    try {
+        body();
+    } catch (const std::runtime_error&) {
+        tasks = previous;
+        throw; // The group waits for its tasks as it goes away.
+    } catch (...) {
+        tasks = previous;
+        group.wait();
+        if (group.failed()) throw std::runtime_error(group.error());
+        throw;
+    }
+    tasks = previous;
+    group.wait();
+    if (group.failed()) throw std::runtime_error(group.error());
 }
 
 // Public method to execute a block in a specific environment.
@@ -74,13 +224,21 @@ void Interpreter::visit(const AST::WhileStmt& stmt) {
 }
 
 void Interpreter::visit(const AST::FunctionStmt& stmt) {
-    auto function = std::make_shared<QuastraFunction>(stmt, environment);
-    environment->define(stmt.name.lexeme, function);
+    environment->define(stmt.name.lexeme, make_function(stmt, environment));
 }
 
 void Interpreter::visit(const AST::ReturnStmt& stmt) {
     QuastraValue value = false;
     if (stmt.value) {
+        // A tail call is only handed back when a trampoline is there to catch it.
+        auto call = dynamic_cast<const AST::Call*>(stmt.value.get());
+        if (call && call->is_tail_call && call_depth > 0) {
+            ValueStack::Scope scope(stack);
+            Arguments arguments(nullptr, 0);
+            auto function = prepare_call(*call, arguments);
+            tail_arguments.assign(std::make_move_iterator(arguments.begin()), std::make_move_iterator(arguments.end()));
+            throw TailCallException(std::move(function));
+        }
         value = evaluate(*stmt.value);
     }
     throw ReturnException(value);
@@ -89,6 +247,9 @@ void Interpreter::visit(const AST::ReturnStmt& stmt) {
 // --- Expression Evaluation ---
 
 QuastraValue Interpreter::evaluate(const AST::Expr& expr) {
+    if (limits.max_steps != 0 && ++steps > limits.max_steps) {
+        throw std::runtime_error("Step limit exceeded.");
+    }
     expr.accept(*this);
     return last_evaluated_value;
 }
@@ -97,6 +258,16 @@ void Interpreter::visit(const AST::Literal& expr) {
     if (expr.value.type == TokenType::IntLiteral) last_evaluated_value = std::stod(expr.value.lexeme);
     else if (expr.value.type == TokenType::True) last_evaluated_value = true;
     else if (expr.value.type == TokenType::False) last_evaluated_value = false;
+    else if (expr.value.type == TokenType::StringLiteral) {
+        if (expr.interned) {
+            last_evaluated_value = *expr.interned;
+        } else {
+            // Nodes are shared by concurrent tasks, which only read them.
+            const QuastraString& interned = QuastraString::intern(string_value(expr.value));
+            if (!TaskScheduler::concurrent()) expr.interned = &interned;
+            last_evaluated_value = interned;
+        }
+    }
     else last_evaluated_value = false;
 }
 
@@ -110,28 +281,78 @@ void Interpreter::visit(const AST::Assign& expr) {
     last_evaluated_value = value;
 }
 
-void Interpreter::visit(const AST::Call& expr) {
-    QuastraValue callee = evaluate(*expr.callee);
-
-    if (!std::holds_alternative<std::shared_ptr<QuastraCallable>>(callee)) {
-        throw std::runtime_error("Can only call functions and classes.");
+// A call to a global name keeps an inline cache of the function the name
+// was bound to. It stays valid until the global environment rebinds a
+// function, which changes its version, so repeated calls skip the lookup.
+// While tasks run, the version may change under the cache, which is then
+// neither used nor updated.
+std::shared_ptr<QuastraCallable> Interpreter::prepare_call(const AST::Call& expr, Arguments& arguments) {
+    std::shared_ptr<QuastraCallable> function;
+    bool cache = expr.is_global_call && !TaskScheduler::concurrent();
+    if (cache && expr.cached_version == globals->get_version()) {
+        function = expr.cached_callee->shared_from_this();
+    } else {
+        QuastraValue callee = expr.is_global_call
+            ? globals->get(dynamic_cast<const AST::Variable&>(*expr.callee).name)
+            : evaluate(*expr.callee);
+        if (!std::holds_alternative<std::shared_ptr<QuastraCallable>>(callee)) {
+            throw std::runtime_error("Can only call functions and classes.");
+        }
+        function = std::get<std::shared_ptr<QuastraCallable>>(callee);
+        if (cache) {
+            expr.cached_callee = function.get();
+            expr.cached_version = globals->get_version();
+        }
     }
-    auto function = std::get<std::shared_ptr<QuastraCallable>>(callee);
 
     if (expr.arguments.size() != static_cast<size_t>(function->arity())) {
         throw std::runtime_error("Expected " + std::to_string(function->arity()) + " arguments but got " + std::to_string(expr.arguments.size()) + ".");
     }
 
-    std::vector<QuastraValue> arguments;
-    for (const auto& arg_expr : expr.arguments) {
-        arguments.push_back(evaluate(*arg_expr));
+    QuastraValue* slots = stack.take(expr.arguments.size());
+    for (size_t i = 0; i < expr.arguments.size(); ++i) {
+        slots[i] = evaluate(*expr.arguments[i]);
     }
+    arguments = Arguments(slots, expr.arguments.size());
+    return function;
+}
+
+// Arguments live on `stack` for the duration of the call, so a call
+// allocates nothing for them.
+void Interpreter::visit(const AST::Call& expr) {
+    ValueStack::Scope scope(stack);
+    Arguments arguments(nullptr, 0);
+    auto function = prepare_call(expr, arguments);
+    if (tier && tier->try_call(*function, arguments, last_evaluated_value)) return;
 
+    if (limits.max_call_depth != 0 && call_depth >= limits.max_call_depth) {
+        throw std::runtime_error("Call depth limit exceeded.");
+    }
+    call_depth++;
     try {
-        last_evaluated_value = function->call(*this, arguments);
-    } catch (const ReturnException& returnValue) {
-        last_evaluated_value = returnValue.value;
+        // Tail calls come back here as exceptions and run in the same slot,
+        // so a chain of them uses constant stack and counts as one level.
+        while (true) {
+            try {
+                last_evaluated_value = function->call(*this, arguments);
+                break;
+            } catch (const ReturnException& returnValue) {
+                last_evaluated_value = returnValue.value;
+                break;
+            } catch (TailCallException& tail_call) {
+                function = std::move(tail_call.function);
+                scope.rewind();
+                QuastraValue* slots = stack.take(tail_arguments.size());
+                std::move(tail_arguments.begin(), tail_arguments.end(), slots);
+                arguments = Arguments(slots, tail_arguments.size());
+                tail_arguments.clear();
+            }
+        }
+    } catch (...) {
+        call_depth--;
+        throw;
     }
+    call_depth--;
 }
 
 void Interpreter::visit(const AST::Unary& expr) {
@@ -147,12 +368,52 @@ void Interpreter::visit(const AST::Unary& expr) {
         last_evaluated_value = !is_truthy(right);
         return;
     }
+    if (expr.op.type == TokenType::Await) {
+        auto* future = std::get_if<std::shared_ptr<QuastraFuture>>(&right);
+        if (!future) throw std::runtime_error("Can only await futures.");
+        last_evaluated_value = EventLoop::current().await(**future);
+        return;
+    }
 }
 
+// Binary nodes specialise themselves on the operand types they see. The
+// first execution picks a number-number variant when both operands are
+// numbers, and from then on the node only checks that they still are. If
+// that guard fails the node deoptimises to Generic for good, so a node
+// whose types vary does not keep flipping between the two. Concurrent
+// tasks use the specialisation a node has but leave it unchanged.
 void Interpreter::visit(const AST::Binary& expr) {
+    using Specialization = AST::BinarySpecialization;
     QuastraValue left = evaluate(*expr.left);
     QuastraValue right = evaluate(*expr.right);
 
+    bool adapt = !TaskScheduler::concurrent();
+    if (expr.specialization == Specialization::Uninitialized) {
+        bool numbers = std::holds_alternative<double>(left) && std::holds_alternative<double>(right);
+        if (adapt) expr.specialization = numbers ? number_specialization(expr.op.type) : Specialization::Generic;
+    } else if (expr.specialization != Specialization::Generic) {
+        const double* a = std::get_if<double>(&left);
+        const double* b = std::get_if<double>(&right);
+        if (a && b) {
+            switch (expr.specialization) {
+                case Specialization::AddNumbers: last_evaluated_value = *a + *b; return;
+                case Specialization::SubtractNumbers: last_evaluated_value = *a - *b; return;
+                case Specialization::MultiplyNumbers: last_evaluated_value = *a * *b; return;
+                case Specialization::DivideNumbers:
+                    if (*b == 0) throw std::runtime_error("Division by zero.");
+                    last_evaluated_value = *a / *b; return;
+                case Specialization::LessNumbers: last_evaluated_value = *a < *b; return;
+                case Specialization::LessEqualNumbers: last_evaluated_value = *a <= *b; return;
+                case Specialization::GreaterNumbers: last_evaluated_value = *a > *b; return;
+                case Specialization::GreaterEqualNumbers: last_evaluated_value = *a >= *b; return;
+                case Specialization::EqualNumbers: last_evaluated_value = *a == *b; return;
+                case Specialization::NotEqualNumbers: last_evaluated_value = *a != *b; return;
+                default: break;
+            }
+        }
+        if (adapt) expr.specialization = Specialization::Generic;
+    }
+
     switch (expr.op.type) {
         case TokenType::EqualEqual: last_evaluated_value = is_equal(left, right); return;
         case TokenType::BangEqual: last_evaluated_value = !is_equal(left, right); return;
@@ -175,7 +436,11 @@ void Interpreter::visit(const AST::Binary& expr) {
         case TokenType::Plus:
             if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
                 last_evaluated_value = std::get<double>(left) + std::get<double>(right); return;
-            } throw std::runtime_error("Operands must be numbers for addition.");
+            }
+            if (std::holds_alternative<QuastraString>(left) && std::holds_alternative<QuastraString>(right)) {
+                last_evaluated_value = QuastraString::concat(std::get<QuastraString>(left), std::get<QuastraString>(right));
+                return;
+            } throw std::runtime_error("Operands must be two numbers or two strings for addition.");
         case TokenType::Minus:
             if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
                 last_evaluated_value = std::get<double>(left) - std::get<double>(right); return;
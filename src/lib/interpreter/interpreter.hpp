@@ -2,6 +2,10 @@
 
 #include "../frontend/ast.hpp"
 #include "../runtime/environment.hpp"
+#include "../runtime/task_scheduler.hpp"
+#include "../runtime/value_stack.hpp"
+#include "environment_collector.hpp"
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -14,20 +18,100 @@ public:
     ReturnException(QuastraValue value) : value(std::move(value)) {}
 };
 
+class QuastraCallable;
+class QuastraFunction;
+
+// Thrown by `return f(...)` in tail position. The caller's frame unwinds
+// first, then the trampoline in visit(Call) makes the call in its place,
+// with the arguments left in Interpreter::tail_arguments.
+class TailCallException {
+public:
+    std::shared_ptr<QuastraCallable> function;
+    TailCallException(std::shared_ptr<QuastraCallable> function) : function(std::move(function)) {}
+};
+
+// Bounds on how much work a single evaluation may do. Used to sandbox
+// compile-time evaluation; a zero means "no limit".
+struct ExecutionLimits {
+    size_t max_steps = 0;      // Expressions evaluated before giving up.
+    size_t max_call_depth = 0; // Nested calls before giving up.
+};
+
+// A faster way to run some calls, such as the baseline JIT or the native
+// tier. The Interpreter offers it every call before making the call itself.
+class ExecutionTier {
+public:
+    virtual ~ExecutionTier() = default;
+    // Runs the call and stores its result, or returns false if the
+    // interpreter should run it.
+    virtual bool try_call(QuastraCallable& function, Arguments arguments, QuastraValue& result) = 0;
+};
+
 class Interpreter : public AST::ExprVisitor, public AST::StmtVisitor {
 public:
     Interpreter();
+    // Reclaims the environments the program left in reference cycles.
+    ~Interpreter();
 
+    // Runs the statements, then the async calls they left running, then
+    // waits for the tasks they spawned outside any `scope`. A task's runtime
+    // error is reported like the program's own.
     void interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
     void execute_block(const std::vector<std::unique_ptr<AST::Stmt>>& statements, std::shared_ptr<Environment> environment);
 
+    // Evaluates a single expression in the current environment. Runtime errors
+    // (including exceeded limits) propagate to the caller as std::runtime_error.
+    QuastraValue evaluate(const AST::Expr& expr);
+    // The same, but tasks spawned outside any `scope` join a group of the
+    // evaluation's own, which is waited for before the value is returned;
+    // a task's runtime error is thrown as the evaluation's. Async calls it
+    // leaves running finish first. Used to call main once interpret() has
+    // run the program.
+    QuastraValue evaluate_joined(const AST::Expr& expr);
+
+    // Runs the body of an async function, with its parameters bound in
+    // `scope`, on a fiber of the current EventLoop: until it first awaits
+    // a pending future, then whenever the loop resumes it. Returns the
+    // future of what the body returns.
+    std::shared_ptr<QuastraFuture> run_async(const std::vector<std::unique_ptr<AST::Stmt>>& body,
+                                             std::shared_ptr<Environment> scope);
+
+    // Installs new limits and resets the step counter.
+    void set_limits(const ExecutionLimits& new_limits) { limits = new_limits; steps = 0; }
+    // Steps counted since the limits were last set.
+    size_t steps_taken() const { return steps; }
+
     std::shared_ptr<Environment> get_environment() const { return environment; }
 
+    // Creates a function closing over `closure`, which the environment
+    // collector then tracks. Every QuastraFunction should be made here.
+    std::shared_ptr<QuastraFunction> make_function(const AST::FunctionStmt& declaration,
+                                                   std::shared_ptr<Environment> closure);
+
+    // Collects every tracked environment now; returns how many were reclaimed.
+    size_t collect_environments() { return collector->collect(); }
+
+    // Offers every call to `tier` first. Only used without limits, which
+    // compiled code does not count against.
+    void set_tier(ExecutionTier* new_tier) { tier = new_tier; }
+
 protected:
     QuastraValue last_evaluated_value;
     std::shared_ptr<Environment> environment;
 
 private:
+    // Runs a spawned task's statements in `scope`, sharing the globals and
+    // collector of `parent`, on whichever thread picks the task up.
+    Interpreter(const Interpreter& parent, std::shared_ptr<Environment> scope);
+
+    // Spawns the block on `tasks`, or runs it now if there is no group to
+    // join it (a host calling into Quastra outside interpret()).
+    void spawn(const AST::Block& stmt);
+    // Runs the statements with a group of their own, then joins it.
+    void run_joined(const std::vector<std::unique_ptr<AST::Stmt>>& statements, std::shared_ptr<Environment> scope);
+    // Runs `body` with a group of its own, then joins it.
+    void join(const std::function<void()>& body);
+
     // Statement visitors
     void visit(const AST::VarDecl& stmt) override;
     void visit(const AST::ExprStmt& stmt) override;
@@ -45,7 +129,27 @@ private:
     void visit(const AST::Assign& expr) override;
     void visit(const AST::Call& expr) override;
 
-    QuastraValue evaluate(const AST::Expr& expr);
+    // Evaluates the callee of a call, checks the arity and evaluates the
+    // arguments into slots taken from `stack`.
+    std::shared_ptr<QuastraCallable> prepare_call(const AST::Call& expr, Arguments& arguments);
+
+    // The outermost scope; global calls are looked up and cached here.
+    std::shared_ptr<Environment> globals;
+    // Arguments of the calls in progress.
+    ValueStack stack;
+    // The arguments of a tail call in flight; kept to reuse its capacity.
+    std::vector<QuastraValue> tail_arguments;
+    ExecutionLimits limits;
+    size_t steps = 0;
+    size_t call_depth = 0;
+    ExecutionTier* tier = nullptr;
+    // Shared with the interpreters of spawned tasks; the one that made it
+    // collects when it goes away.
+    std::shared_ptr<EnvironmentCollector> collector;
+    bool is_task = false;
+    // The group `spawn` blocks join: that of the innermost `scope`, the
+    // running task or interpret().
+    TaskGroup* tasks = nullptr;
 };
 
 } // namespace Quastra
@@ -0,0 +1,111 @@
+#include "ir.hpp"
+#include <sstream>
+
+namespace Quastra::IR {
+
+const char* to_string(Opcode op) {
+    switch (op) {
+        case Opcode::Const: return "const";
+        case Opcode::Param: return "param";
+        case Opcode::Neg: return "neg";
+        case Opcode::Not: return "not";
+        case Opcode::Add: return "add";
+        case Opcode::Sub: return "sub";
+        case Opcode::Mul: return "mul";
+        case Opcode::Div: return "div";
+        case Opcode::Eq: return "eq";
+        case Opcode::Ne: return "ne";
+        case Opcode::Lt: return "lt";
+        case Opcode::Le: return "le";
+        case Opcode::Gt: return "gt";
+        case Opcode::Ge: return "ge";
+        case Opcode::Call: return "call";
+        case Opcode::LoadGlobal: return "load";
+        case Opcode::StoreGlobal: return "store";
+        case Opcode::Phi: return "phi";
+        case Opcode::Jump: return "jmp";
+        case Opcode::Branch: return "br";
+        case Opcode::Return: return "ret";
+    }
+    return "unknown";
+}
+
+static void print_instruction(std::ostream& out, const Instruction& inst) {
+    out << "    ";
+    if (inst.result != NoRegister) {
+        out << "%" << inst.result << ": " << Quastra::to_string(inst.type) << " = ";
+    }
+    out << to_string(inst.op);
+
+    switch (inst.op) {
+        case Opcode::Const:
+            if (inst.type == Type::Bool) out << (inst.immediate ? " true" : " false");
+            else out << " " << inst.immediate;
+            break;
+        case Opcode::Param:
+            out << " " << inst.immediate;
+            break;
+        case Opcode::Phi:
+            for (size_t i = 0; i < inst.operands.size(); ++i) {
+                out << (i ? ", " : " ") << "[%" << inst.operands[i] << ", bb" << inst.blocks[i] << "]";
+            }
+            break;
+        case Opcode::Call:
+        case Opcode::LoadGlobal:
+        case Opcode::StoreGlobal:
+            out << " @" << inst.name;
+            for (size_t i = 0; i < inst.operands.size(); ++i) {
+                out << (i ? ", " : " ") << "%" << inst.operands[i];
+            }
+            break;
+        default:
+            for (size_t i = 0; i < inst.operands.size(); ++i) {
+                out << (i ? ", " : " ") << "%" << inst.operands[i];
+            }
+            for (size_t i = 0; i < inst.blocks.size(); ++i) {
+                out << ((i || !inst.operands.empty()) ? ", " : " ") << "bb" << inst.blocks[i];
+            }
+            break;
+    }
+    out << "\n";
+}
+
+std::string to_string(const Function& function) {
+    std::ostringstream out;
+    out << "fn " << function.name << "(";
+    for (size_t i = 0; i < function.params.size(); ++i) {
+        int reg = function.params[i];
+        out << (i ? ", " : "") << "%" << reg << ": " << Quastra::to_string(function.register_types[reg]);
+    }
+    out << ") -> " << Quastra::to_string(function.return_type) << " {\n";
+    for (const auto& block : function.blocks) {
+        out << "bb" << block.id << ":";
+        if (!block.predecessors.empty()) {
+            out << " ; preds";
+            for (int pred : block.predecessors) out << " bb" << pred;
+        }
+        out << "\n";
+        for (const auto& inst : block.instructions) {
+            // The signature already names the parameters.
+            if (inst.op == Opcode::Param) continue;
+            print_instruction(out, inst);
+        }
+    }
+    out << "}\n";
+    return out.str();
+}
+
+std::string to_string(const Module& module) {
+    std::ostringstream out;
+    for (const auto& global : module.globals) {
+        out << "global @" << global.name << ": " << Quastra::to_string(global.type) << "\n";
+    }
+    if (!module.globals.empty()) out << "\n";
+    for (size_t i = 0; i < module.functions.size(); ++i) {
+        if (i) out << "\n";
+        out << to_string(module.functions[i]);
+    }
+    return out.str();
+}
+
+} // namespace Quastra::IR
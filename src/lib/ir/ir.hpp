@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../semantic/type.hpp"
+#include <string>
+#include <vector>
+
+namespace Quastra::IR {
+
+// A typed SSA intermediate representation sitting between the checked AST and
+// the backends. Every value lives in a virtual register that is defined by
+// exactly one instruction; control flow merges values with phi instructions.
+
+enum class Opcode {
+    // Values
+    Const,       // immediate
+    Param,       // immediate = parameter index
+    Neg, Not,
+    Add, Sub, Mul, Div,
+    Eq, Ne, Lt, Le, Gt, Ge,
+    Call,        // name = callee
+    LoadGlobal,  // name = global
+    StoreGlobal, // name = global, operands[0] = value
+    Phi,         // operands[i] flows in from blocks[i]
+    // Terminators
+    Jump,        // blocks[0]
+    Branch,      // operands[0] = condition, blocks = {then, else}
+    Return,      // operands = {} or {value}
+};
+
+// Marks an instruction that defines no register.
+constexpr int NoRegister = -1;
+
+struct Instruction {
+    Opcode op;
+    Type type = Type::Void;     // Type of the result register.
+    int result = NoRegister;
+    std::vector<int> operands;  // Registers read by the instruction.
+    std::vector<int> blocks;    // Successor blocks, or phi incoming blocks.
+    long long immediate = 0;    // Const value (bools are 0/1) or Param index.
+    std::string name;           // Callee or global name.
+
+    bool is_terminator() const {
+        return op == Opcode::Jump || op == Opcode::Branch || op == Opcode::Return;
+    }
+};
+
+struct BasicBlock {
+    int id = 0;
+    std::vector<int> predecessors;
+    std::vector<Instruction> instructions; // Phis first, terminator last.
+};
+
+struct Function {
+    std::string name;
+    std::vector<int> params;          // Registers holding the parameters.
+    Type return_type = Type::Int;
+    std::vector<BasicBlock> blocks;   // blocks[0] is the entry; ids equal indices.
+    std::vector<Type> register_types; // Indexed by register number.
+};
+
+struct Global {
+    std::string name;
+    Type type;
+};
+
+// Top-level statements are lowered into a function named InitFunction, which
+// the backends run before main.
+constexpr const char* InitFunction = "__init";
+
+struct Module {
+    std::vector<Global> globals;
+    std::vector<Function> functions;
+};
+
+// Textual form used by --emit-ir and the tests.
+const char* to_string(Opcode op);
+std::string to_string(const Function& function);
+std::string to_string(const Module& module);
+
+} // namespace Quastra::IR
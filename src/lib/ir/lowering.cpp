@@ -0,0 +1,623 @@
+#include "lowering.hpp"
+#include <iostream>
+
+namespace Quastra {
+
+// A function returns the type of its first return statement's value. Calls
+// can only be typed with what the previous round found, so the module is
+// lowered again until no function's return type changes, giving up after
+// one round per function.
+bool IRLowering::lower(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    function_arity.clear();
+    return_types.clear();
+    for (const auto& stmt : statements) {
+        if (const auto* fn = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            function_arity[fn->name.lexeme] = static_cast<int>(fn->params.size());
+            return_types[fn->name.lexeme] = Type::Int;
+        }
+    }
+
+    for (size_t round = 0;; ++round) {
+        lower_round(statements);
+        bool settled = true;
+        for (const auto& lowered : module.functions) {
+            auto it = return_types.find(lowered.name);
+            if (it == return_types.end() || it->second == lowered.return_type) continue;
+            it->second = lowered.return_type;
+            settled = false;
+        }
+        if (settled) break;
+        if (round == return_types.size()) {
+            error("The return types of the functions do not settle.");
+            break;
+        }
+    }
+
+    for (const auto& message : errors) std::cerr << "IR Error: " << message << "\n";
+    return errors.empty();
+}
+
+void IRLowering::lower_round(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    module = IR::Module();
+    global_index.clear();
+    errors.clear();
+
+    bool has_top_level_code = false;
+    for (const auto& stmt : statements) {
+        if (stmt && !dynamic_cast<const AST::FunctionStmt*>(stmt.get())) has_top_level_code = true;
+    }
+
+    // Top-level code goes first so the types of globals are known by the
+    // time function bodies read them.
+    if (has_top_level_code) {
+        in_init = true;
+        begin_function(IR::InitFunction, Type::Void);
+        for (const auto& stmt : statements) {
+            if (current_block < 0) break;
+            if (stmt && !dynamic_cast<const AST::FunctionStmt*>(stmt.get())) stmt->accept(*this);
+        }
+        end_function();
+        in_init = false;
+    }
+
+    for (const auto& stmt : statements) {
+        const auto* fn = dynamic_cast<const AST::FunctionStmt*>(stmt.get());
+        if (!fn) continue;
+        if (fn->is_async) {
+            error("Async function '" + fn->name.lexeme + "' is not supported in the IR.");
+            continue;
+        }
+        // Parameters are ints; the return type is set by the first return.
+        begin_function(fn->name.lexeme, Type::Int);
+        return_type_known = false;
+        for (size_t i = 0; i < fn->params.size(); ++i) {
+            IR::Instruction param;
+            param.op = IR::Opcode::Param;
+            param.type = Type::Int;
+            param.immediate = static_cast<long long>(i);
+            int reg = emit(param);
+            function->params.push_back(reg);
+            write_variable(declare_variable(fn->params[i].lexeme, Type::Int), current_block, reg);
+        }
+        lower_statements(fn->body);
+        end_function();
+    }
+}
+
+void IRLowering::error(const std::string& message) {
+    errors.push_back(message);
+}
+
+// --- Function Construction ---
+
+void IRLowering::begin_function(const std::string& name, Type return_type) {
+    module.functions.emplace_back();
+    function = &module.functions.back();
+    function->name = name;
+    function->return_type = return_type;
+
+    scopes.assign(1, {});
+    variable_types.clear();
+    current_def.clear();
+    sealed.clear();
+    incomplete_phis.clear();
+    phis.clear();
+    phi_location.clear();
+
+    current_block = new_block();
+    seal_block(current_block); // The entry block has no predecessors.
+}
+
+void IRLowering::end_function() {
+    // Falling off the end returns a default value.
+    if (current_block >= 0) {
+        IR::Instruction ret;
+        ret.op = IR::Opcode::Return;
+        if (function->return_type != Type::Void) {
+            ret.operands.push_back(emit_const(function->return_type, 0));
+        }
+        terminate(ret);
+    }
+
+    for (size_t b = 0; b < function->blocks.size(); ++b) {
+        auto& instructions = function->blocks[b].instructions;
+        instructions.insert(instructions.begin(), phis[b].begin(), phis[b].end());
+    }
+    remove_trivial_phis();
+    renumber_registers();
+    function = nullptr;
+}
+
+void IRLowering::lower_statements(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& statement : statements) {
+        // Everything after a return is unreachable.
+        if (current_block < 0) break;
+        if (statement) statement->accept(*this);
+    }
+}
+
+int IRLowering::lower(const AST::Expr& expr) {
+    expr.accept(*this);
+    return last_value;
+}
+
+// --- Blocks and Instructions ---
+
+int IRLowering::new_block() {
+    int id = static_cast<int>(function->blocks.size());
+    function->blocks.emplace_back();
+    function->blocks.back().id = id;
+    current_def.emplace_back();
+    sealed.push_back(false);
+    incomplete_phis.emplace_back();
+    phis.emplace_back();
+    return id;
+}
+
+void IRLowering::add_edge(int from, int to) {
+    function->blocks[to].predecessors.push_back(from);
+}
+
+void IRLowering::seal_block(int block) {
+    for (const auto& [variable, phi] : incomplete_phis[block]) {
+        add_phi_operands(variable, phi, block);
+    }
+    incomplete_phis[block].clear();
+    sealed[block] = true;
+}
+
+int IRLowering::new_register(Type type) {
+    function->register_types.push_back(type);
+    return static_cast<int>(function->register_types.size()) - 1;
+}
+
+int IRLowering::emit(IR::Instruction inst) {
+    if (inst.type != Type::Void && inst.result == IR::NoRegister) {
+        inst.result = new_register(inst.type);
+    }
+    int result = inst.result;
+    function->blocks[current_block].instructions.push_back(std::move(inst));
+    return result;
+}
+
+int IRLowering::emit_const(Type type, long long value) {
+    IR::Instruction inst;
+    inst.op = IR::Opcode::Const;
+    inst.type = type;
+    inst.immediate = value;
+    return emit(inst);
+}
+
+void IRLowering::terminate(IR::Instruction inst) {
+    emit(std::move(inst));
+    current_block = -1;
+}
+
+// --- SSA Variable Tracking ---
+
+int IRLowering::declare_variable(const std::string& name, Type type) {
+    int variable = static_cast<int>(variable_types.size());
+    variable_types.push_back(type);
+    scopes.back()[name] = variable;
+    return variable;
+}
+
+const int* IRLowering::lookup_variable(const std::string& name) const {
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+        auto found = it->find(name);
+        if (found != it->end()) return &found->second;
+    }
+    return nullptr;
+}
+
+void IRLowering::write_variable(int variable, int block, int value) {
+    current_def[block][variable] = value;
+}
+
+int IRLowering::read_variable(int variable, int block) {
+    auto it = current_def[block].find(variable);
+    if (it != current_def[block].end()) return it->second;
+    return read_variable_recursive(variable, block);
+}
+
+int IRLowering::read_variable_recursive(int variable, int block) {
+    const auto& preds = function->blocks[block].predecessors;
+    int value;
+    if (!sealed[block]) {
+        // Not all predecessors are known yet: leave a placeholder phi.
+        value = new_phi(block, variable_types[variable]);
+        incomplete_phis[block].push_back({variable, value});
+    } else if (preds.size() == 1) {
+        value = read_variable(variable, preds[0]);
+    } else if (preds.empty()) {
+        // Only possible in the entry block, for a variable that has no
+        // definition on any path.
+        error("Variable read before it is defined.");
+        value = new_phi(block, variable_types[variable]);
+    } else {
+        // Write the phi first to break cycles through loops.
+        value = new_phi(block, variable_types[variable]);
+        write_variable(variable, block, value);
+        add_phi_operands(variable, value, block);
+    }
+    write_variable(variable, block, value);
+    return value;
+}
+
+int IRLowering::new_phi(int block, Type type) {
+    IR::Instruction phi;
+    phi.op = IR::Opcode::Phi;
+    phi.type = type;
+    phi.result = new_register(type);
+    phi_location[phi.result] = {block, phis[block].size()};
+    phis[block].push_back(phi);
+    return phi.result;
+}
+
+void IRLowering::add_phi_operands(int variable, int phi, int block) {
+    const std::vector<int> preds = function->blocks[block].predecessors;
+    for (int pred : preds) {
+        int operand = read_variable(variable, pred);
+        // Look the phi up again: reading may have created more phis.
+        auto [phi_block, index] = phi_location[phi];
+        phis[phi_block][index].operands.push_back(operand);
+        phis[phi_block][index].blocks.push_back(pred);
+    }
+}
+
+// A phi whose operands are all the same value (or the phi itself) is replaced
+// by that value. Removing one can make others trivial, so repeat until stable.
+void IRLowering::remove_trivial_phis() {
+    std::map<int, int> alias;
+    auto resolve = [&alias](int reg) {
+        for (auto it = alias.find(reg); it != alias.end(); it = alias.find(reg)) reg = it->second;
+        return reg;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (const auto& block : function->blocks) {
+            for (const auto& inst : block.instructions) {
+                if (inst.op != IR::Opcode::Phi || alias.count(inst.result)) continue;
+                int same = IR::NoRegister;
+                bool trivial = true;
+                for (int operand : inst.operands) {
+                    int value = resolve(operand);
+                    if (value == same || value == inst.result) continue;
+                    if (same != IR::NoRegister) {
+                        trivial = false;
+                        break;
+                    }
+                    same = value;
+                }
+                if (trivial && same != IR::NoRegister) {
+                    alias[inst.result] = same;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (auto& block : function->blocks) {
+        std::vector<IR::Instruction> kept;
+        for (auto& inst : block.instructions) {
+            if (inst.op == IR::Opcode::Phi && alias.count(inst.result)) continue;
+            for (int& operand : inst.operands) operand = resolve(operand);
+            kept.push_back(std::move(inst));
+        }
+        block.instructions = std::move(kept);
+    }
+}
+
+// Gives registers dense numbers in definition order, which keeps dumps and
+// generated code readable after phis were removed.
+void IRLowering::renumber_registers() {
+    std::map<int, int> renumbered;
+    std::vector<Type> types;
+    for (auto& block : function->blocks) {
+        for (auto& inst : block.instructions) {
+            if (inst.result == IR::NoRegister) continue;
+            renumbered[inst.result] = static_cast<int>(types.size());
+            types.push_back(inst.type);
+        }
+    }
+    for (auto& block : function->blocks) {
+        for (auto& inst : block.instructions) {
+            if (inst.result != IR::NoRegister) inst.result = renumbered[inst.result];
+            for (int& operand : inst.operands) operand = renumbered[operand];
+        }
+    }
+    for (int& param : function->params) param = renumbered[param];
+    function->register_types = std::move(types);
+}
+
+// --- Statement Visitors ---
+
+void IRLowering::visit(const AST::VarDecl& stmt) {
+    int value = stmt.initializer ? lower(*stmt.initializer) : emit_const(Type::Int, 0);
+    Type type = function->register_types[value];
+
+    // Declarations at the top level of the program are globals.
+    if (in_init && scopes.size() == 1) {
+        auto it = global_index.find(stmt.name.lexeme);
+        if (it == global_index.end()) {
+            global_index[stmt.name.lexeme] = module.globals.size();
+            module.globals.push_back({stmt.name.lexeme, type});
+        } else if (module.globals[it->second].type != type) {
+            error("Global '" + stmt.name.lexeme + "' redeclared with a different type.");
+        }
+        IR::Instruction store;
+        store.op = IR::Opcode::StoreGlobal;
+        store.operands.push_back(value);
+        store.name = stmt.name.lexeme;
+        emit(store);
+        return;
+    }
+
+    write_variable(declare_variable(stmt.name.lexeme, type), current_block, value);
+}
+
+void IRLowering::visit(const AST::ExprStmt& stmt) {
+    lower(*stmt.expression);
+}
+
+void IRLowering::visit(const AST::Block& stmt) {
+    scopes.emplace_back();
+    lower_statements(stmt.statements);
+    scopes.pop_back();
+}
+
+void IRLowering::visit(const AST::IfStmt& stmt) {
+    int condition = lower(*stmt.condition);
+    if (function->register_types[condition] != Type::Bool) error("If condition must be a boolean.");
+
+    int from = current_block;
+    IR::Instruction branch;
+    branch.op = IR::Opcode::Branch;
+    branch.operands.push_back(condition);
+    terminate(branch);
+
+    int then_block = new_block();
+    add_edge(from, then_block);
+    seal_block(then_block);
+    int else_block = -1;
+    if (stmt.else_branch) {
+        else_block = new_block();
+        add_edge(from, else_block);
+        seal_block(else_block);
+    }
+
+    std::vector<int> exits;
+    current_block = then_block;
+    stmt.then_branch->accept(*this);
+    if (current_block >= 0) exits.push_back(current_block);
+    if (stmt.else_branch) {
+        current_block = else_block;
+        stmt.else_branch->accept(*this);
+        if (current_block >= 0) exits.push_back(current_block);
+    }
+
+    // Without an else branch the false edge goes straight to the merge block.
+    if (!stmt.else_branch) exits.push_back(from);
+    if (exits.empty()) {
+        function->blocks[from].instructions.back().blocks = {then_block, else_block};
+        current_block = -1;
+        return;
+    }
+
+    int merge = new_block();
+    function->blocks[from].instructions.back().blocks = {then_block, stmt.else_branch ? else_block : merge};
+    for (int exit : exits) {
+        if (exit != from) {
+            current_block = exit;
+            IR::Instruction jump;
+            jump.op = IR::Opcode::Jump;
+            jump.blocks.push_back(merge);
+            emit(jump);
+        }
+        add_edge(exit, merge);
+    }
+    seal_block(merge);
+    current_block = merge;
+}
+
+void IRLowering::visit(const AST::WhileStmt& stmt) {
+    int header = new_block();
+    IR::Instruction enter;
+    enter.op = IR::Opcode::Jump;
+    enter.blocks.push_back(header);
+    add_edge(current_block, header);
+    terminate(enter);
+
+    // The header stays unsealed until the back edge is known.
+    current_block = header;
+    int condition = lower(*stmt.condition);
+    if (function->register_types[condition] != Type::Bool) error("While condition must be a boolean.");
+    int condition_end = current_block;
+    IR::Instruction branch;
+    branch.op = IR::Opcode::Branch;
+    branch.operands.push_back(condition);
+    terminate(branch);
+
+    int body = new_block();
+    add_edge(condition_end, body);
+    seal_block(body);
+    current_block = body;
+    stmt.body->accept(*this);
+    if (current_block >= 0) {
+        IR::Instruction back_edge;
+        back_edge.op = IR::Opcode::Jump;
+        back_edge.blocks.push_back(header);
+        add_edge(current_block, header);
+        terminate(back_edge);
+    }
+    seal_block(header);
+
+    int exit = new_block();
+    add_edge(condition_end, exit);
+    seal_block(exit);
+    function->blocks[condition_end].instructions.back().blocks = {body, exit};
+    current_block = exit;
+}
+
+void IRLowering::visit(const AST::FunctionStmt& stmt) {
+    // Top-level functions are lowered by lower(); anything reaching here is nested.
+    error("Nested function '" + stmt.name.lexeme + "' is not supported in the IR.");
+}
+
+void IRLowering::visit(const AST::ReturnStmt& stmt) {
+    if (in_init) {
+        error("Cannot return from top-level code.");
+        return;
+    }
+    IR::Instruction ret;
+    ret.op = IR::Opcode::Return;
+    int value = stmt.value ? lower(*stmt.value) : emit_const(function->return_type, 0);
+    if (!return_type_known) {
+        function->return_type = function->register_types[value];
+        return_type_known = true;
+    } else if (function->register_types[value] != function->return_type) {
+        error("Return value type does not match the return type of '" + function->name +
+              "': every return must give an int, or every return a bool.");
+    }
+    ret.operands.push_back(value);
+    terminate(ret);
+}
+
+// --- Expression Visitors ---
+
+void IRLowering::visit(const AST::Literal& expr) {
+    switch (expr.value.type) {
+        case TokenType::IntLiteral: last_value = emit_const(Type::Int, std::stoll(expr.value.lexeme)); break;
+        case TokenType::True: last_value = emit_const(Type::Bool, 1); break;
+        case TokenType::False: last_value = emit_const(Type::Bool, 0); break;
+        default:
+            error("Unsupported literal '" + expr.value.lexeme + "'.");
+            last_value = emit_const(Type::Int, 0);
+            break;
+    }
+}
+
+void IRLowering::visit(const AST::Unary& expr) {
+    int operand = lower(*expr.right);
+    if (expr.op.type == TokenType::Await) {
+        error("'await' is not supported in the IR.");
+        last_value = operand;
+        return;
+    }
+    IR::Instruction inst;
+    inst.operands.push_back(operand);
+    if (expr.op.type == TokenType::Minus) {
+        inst.op = IR::Opcode::Neg;
+        inst.type = Type::Int;
+    } else {
+        inst.op = IR::Opcode::Not;
+        inst.type = Type::Bool;
+    }
+    if (function->register_types[operand] != inst.type) {
+        error("Operand of '" + expr.op.lexeme + "' has the wrong type.");
+    }
+    last_value = emit(inst);
+}
+
+void IRLowering::visit(const AST::Binary& expr) {
+    int left = lower(*expr.left);
+    int right = lower(*expr.right);
+    IR::Instruction inst;
+    inst.operands = {left, right};
+    inst.type = Type::Bool;
+    bool arithmetic_operands = true;
+    switch (expr.op.type) {
+        case TokenType::Plus: inst.op = IR::Opcode::Add; inst.type = Type::Int; break;
+        case TokenType::Minus: inst.op = IR::Opcode::Sub; inst.type = Type::Int; break;
+        case TokenType::Star: inst.op = IR::Opcode::Mul; inst.type = Type::Int; break;
+        case TokenType::Slash: inst.op = IR::Opcode::Div; inst.type = Type::Int; break;
+        case TokenType::Less: inst.op = IR::Opcode::Lt; break;
+        case TokenType::LessEqual: inst.op = IR::Opcode::Le; break;
+        case TokenType::Greater: inst.op = IR::Opcode::Gt; break;
+        case TokenType::GreaterEqual: inst.op = IR::Opcode::Ge; break;
+        case TokenType::EqualEqual: inst.op = IR::Opcode::Eq; arithmetic_operands = false; break;
+        case TokenType::BangEqual: inst.op = IR::Opcode::Ne; arithmetic_operands = false; break;
+        default:
+            error("Unsupported binary operator '" + expr.op.lexeme + "'.");
+            last_value = emit_const(Type::Int, 0);
+            return;
+    }
+    Type left_type = function->register_types[left];
+    Type right_type = function->register_types[right];
+    if (arithmetic_operands ? (left_type != Type::Int || right_type != Type::Int) : left_type != right_type) {
+        error("Operands of '" + expr.op.lexeme + "' have the wrong type.");
+    }
+    last_value = emit(inst);
+}
+
+void IRLowering::visit(const AST::Variable& expr) {
+    const std::string& name = expr.name.lexeme;
+    if (const int* variable = lookup_variable(name)) {
+        last_value = read_variable(*variable, current_block);
+        return;
+    }
+    auto global = global_index.find(name);
+    if (global != global_index.end()) {
+        IR::Instruction load;
+        load.op = IR::Opcode::LoadGlobal;
+        load.type = module.globals[global->second].type;
+        load.name = name;
+        last_value = emit(load);
+        return;
+    }
+    if (function_arity.count(name)) {
+        error("Function '" + name + "' used as a value is not supported in the IR.");
+    } else {
+        error("Undefined variable '" + name + "'.");
+    }
+    last_value = emit_const(Type::Int, 0);
+}
+
+void IRLowering::visit(const AST::Assign& expr) {
+    int value = lower(*expr.value);
+    Type type = function->register_types[value];
+    const std::string& name = expr.name.lexeme;
+
+    if (const int* variable = lookup_variable(name)) {
+        if (variable_types[*variable] != type) error("Type mismatch in assignment to '" + name + "'.");
+        write_variable(*variable, current_block, value);
+    } else if (global_index.count(name)) {
+        if (module.globals[global_index[name]].type != type) error("Type mismatch in assignment to '" + name + "'.");
+        IR::Instruction store;
+        store.op = IR::Opcode::StoreGlobal;
+        store.operands.push_back(value);
+        store.name = name;
+        emit(store);
+    } else {
+        error("Assignment to undeclared variable '" + name + "'.");
+    }
+    last_value = value;
+}
+
+void IRLowering::visit(const AST::Call& expr) {
+    IR::Instruction call;
+    call.op = IR::Opcode::Call;
+    call.type = Type::Int;
+
+    const auto* callee = dynamic_cast<const AST::Variable*>(expr.callee.get());
+    if (!callee || lookup_variable(callee->name.lexeme)) {
+        error("Indirect calls are not supported in the IR.");
+    } else {
+        call.name = callee->name.lexeme;
+        auto arity = function_arity.find(call.name);
+        if (arity != function_arity.end() && arity->second != static_cast<int>(expr.arguments.size())) {
+            error("Wrong number of arguments in call to '" + call.name + "'.");
+        }
+        auto result = return_types.find(call.name);
+        if (result != return_types.end()) call.type = result->second;
+    }
+    // Unknown callees (such as natives) are external calls returning an int.
+    for (const auto& argument : expr.arguments) {
+        call.operands.push_back(lower(*argument));
+    }
+    last_value = emit(call);
+}
+
+} // namespace Quastra
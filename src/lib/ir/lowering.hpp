@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ir.hpp"
+#include "../frontend/ast.hpp"
+#include <vector>
+#include <memory>
+#include <map>
+#include <set>
+#include <string>
+
+namespace Quastra {
+
+// Lowers a checked AST into the SSA IR.
+// SSA form is built during the walk with the algorithm of Braun et al.
+// ("Simple and Efficient Construction of Static Single Assignment Form"): the
+// current definition of every variable is tracked per block, and a phi is only
+// created when a read reaches a join point. Blocks are "sealed" once all their
+// predecessors are known; reads in unsealed loop headers create placeholder
+// phis that are completed when the loop is closed.
+class IRLowering : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    // Returns true if the whole program could be lowered.
+    bool lower(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    const IR::Module& get_module() const { return module; }
+    IR::Module& get_module() { return module; }
+
+private:
+    // Statement visitors
+    void visit(const AST::VarDecl& stmt) override;
+    void visit(const AST::ExprStmt& stmt) override;
+    void visit(const AST::Block& stmt) override;
+    void visit(const AST::IfStmt& stmt) override;
+    void visit(const AST::WhileStmt& stmt) override;
+    void visit(const AST::FunctionStmt& stmt) override;
+    void visit(const AST::ReturnStmt& stmt) override;
+
+    // Expression visitors
+    void visit(const AST::Literal& expr) override;
+    void visit(const AST::Unary& expr) override;
+    void visit(const AST::Binary& expr) override;
+    void visit(const AST::Variable& expr) override;
+    void visit(const AST::Assign& expr) override;
+    void visit(const AST::Call& expr) override;
+
+    // Lowers every statement once, with the return types found so far.
+    void lower_round(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // Function construction
+    void begin_function(const std::string& name, Type return_type);
+    void end_function();
+    void lower_statements(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    int lower(const AST::Expr& expr);
+
+    // Blocks and instructions
+    int new_block();
+    void add_edge(int from, int to);
+    void seal_block(int block);
+    int new_register(Type type);
+    int emit(IR::Instruction inst);
+    int emit_const(Type type, long long value);
+    void terminate(IR::Instruction inst);
+
+    // SSA variable tracking
+    int declare_variable(const std::string& name, Type type);
+    const int* lookup_variable(const std::string& name) const;
+    void write_variable(int variable, int block, int value);
+    int read_variable(int variable, int block);
+    int read_variable_recursive(int variable, int block);
+    int new_phi(int block, Type type);
+    void add_phi_operands(int variable, int phi, int block);
+    void remove_trivial_phis();
+    void renumber_registers();
+
+    void error(const std::string& message);
+
+    IR::Module module;
+    std::map<std::string, int> function_arity; // Known top-level functions.
+    // Their return types as the previous round found them; calls are typed
+    // with these.
+    std::map<std::string, Type> return_types;
+    std::map<std::string, size_t> global_index;
+    // Kept until the last round, since earlier ones may use stale types.
+    std::vector<std::string> errors;
+
+    // State for the function being built.
+    IR::Function* function = nullptr;
+    bool in_init = false;
+    bool return_type_known = false; // Set by the function's first return.
+    int current_block = -1; // -1 after a return: the code is unreachable.
+    int last_value = IR::NoRegister;
+    std::vector<std::map<std::string, int>> scopes; // Name -> variable.
+    std::vector<Type> variable_types;
+    std::vector<std::map<int, int>> current_def;    // Per block: variable -> register.
+    std::vector<bool> sealed;
+    std::vector<std::vector<std::pair<int, int>>> incomplete_phis; // Per block: (variable, phi).
+    std::vector<std::vector<IR::Instruction>> phis;                // Per block, merged at the end.
+    std::map<int, std::pair<int, size_t>> phi_location;             // Phi register -> (block, index).
+};
+
+} // namespace Quastra
@@ -0,0 +1,248 @@
+#include "verifier.hpp"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace Quastra {
+
+bool IRVerifier::verify(const IR::Module& module) {
+    errors.clear();
+    std::set<std::string> names;
+    for (const auto& global : module.globals) {
+        if (!names.insert(global.name).second) errors.push_back("global @" + global.name + " is declared twice");
+    }
+    globals.clear();
+    for (const auto& global : module.globals) globals[global.name] = global.type;
+    for (const auto& function : module.functions) {
+        verify_function(function);
+    }
+    return errors.empty();
+}
+
+void IRVerifier::error(const IR::Function& function, const std::string& message) {
+    errors.push_back("in " + function.name + ": " + message);
+}
+
+static std::vector<int> successors(const IR::BasicBlock& block) {
+    if (block.instructions.empty()) return {};
+    const auto& terminator = block.instructions.back();
+    if (terminator.op == IR::Opcode::Jump || terminator.op == IR::Opcode::Branch) return terminator.blocks;
+    return {};
+}
+
+void IRVerifier::verify_function(const IR::Function& function) {
+    const int block_count = static_cast<int>(function.blocks.size());
+    const int register_count = static_cast<int>(function.register_types.size());
+    if (block_count == 0) {
+        error(function, "function has no blocks");
+        return;
+    }
+    if (!function.blocks[0].predecessors.empty()) error(function, "entry block has predecessors");
+
+    // Block shape and branch targets.
+    bool shape_ok = true;
+    for (int b = 0; b < block_count; ++b) {
+        const auto& block = function.blocks[b];
+        std::string where = "bb" + std::to_string(b) + ": ";
+        if (block.id != b) error(function, where + "block id does not match its position");
+        if (block.instructions.empty() || !block.instructions.back().is_terminator()) {
+            error(function, where + "block does not end in a terminator");
+            shape_ok = false;
+            continue;
+        }
+        bool past_phis = false;
+        for (size_t i = 0; i < block.instructions.size(); ++i) {
+            const auto& inst = block.instructions[i];
+            if (inst.is_terminator() && i + 1 != block.instructions.size()) {
+                error(function, where + "terminator in the middle of a block");
+            }
+            if (inst.op == IR::Opcode::Phi && past_phis) error(function, where + "phi after a non-phi instruction");
+            if (inst.op != IR::Opcode::Phi) past_phis = true;
+        }
+        for (int target : successors(block)) {
+            if (target < 0 || target >= block_count) {
+                error(function, where + "branch to a missing block");
+                shape_ok = false;
+            }
+        }
+    }
+    if (!shape_ok) return;
+
+    // Predecessor lists must agree with the terminators.
+    std::vector<std::vector<int>> expected_preds(block_count);
+    for (int b = 0; b < block_count; ++b) {
+        for (int target : successors(function.blocks[b])) expected_preds[target].push_back(b);
+    }
+    for (int b = 0; b < block_count; ++b) {
+        std::vector<int> actual = function.blocks[b].predecessors;
+        std::sort(actual.begin(), actual.end());
+        std::sort(expected_preds[b].begin(), expected_preds[b].end());
+        if (actual != expected_preds[b]) error(function, "bb" + std::to_string(b) + ": predecessor list does not match the branches");
+    }
+
+    // Single definition of every register.
+    std::vector<int> def_block(register_count, -1);
+    std::vector<size_t> def_index(register_count, 0);
+    for (int b = 0; b < block_count; ++b) {
+        const auto& instructions = function.blocks[b].instructions;
+        for (size_t i = 0; i < instructions.size(); ++i) {
+            const auto& inst = instructions[i];
+            if (inst.result == IR::NoRegister) continue;
+            if (inst.result < 0 || inst.result >= register_count) {
+                error(function, "register %" + std::to_string(inst.result) + " has no type");
+                return;
+            }
+            if (def_block[inst.result] != -1) error(function, "register %" + std::to_string(inst.result) + " is defined twice");
+            if (function.register_types[inst.result] != inst.type) {
+                error(function, "register %" + std::to_string(inst.result) + " does not match its declared type");
+            }
+            def_block[inst.result] = b;
+            def_index[inst.result] = i;
+        }
+    }
+    for (int param : function.params) {
+        if (param < 0 || param >= register_count || def_block[param] != 0) error(function, "parameter register is not defined in the entry block");
+    }
+
+    // Dominators of the reachable blocks, by the simple iterative algorithm.
+    std::vector<bool> reachable(block_count, false);
+    std::vector<int> worklist = {0};
+    reachable[0] = true;
+    while (!worklist.empty()) {
+        int b = worklist.back();
+        worklist.pop_back();
+        for (int target : successors(function.blocks[b])) {
+            if (!reachable[target]) {
+                reachable[target] = true;
+                worklist.push_back(target);
+            }
+        }
+    }
+    std::vector<std::vector<bool>> dominators(block_count, std::vector<bool>(block_count, true));
+    dominators[0].assign(block_count, false);
+    dominators[0][0] = true;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 1; b < block_count; ++b) {
+            if (!reachable[b]) continue;
+            std::vector<bool> dom(block_count, true);
+            for (int pred : function.blocks[b].predecessors) {
+                if (!reachable[pred]) continue;
+                for (int d = 0; d < block_count; ++d) dom[d] = dom[d] && dominators[pred][d];
+            }
+            dom[b] = true;
+            if (dom != dominators[b]) {
+                dominators[b] = dom;
+                changed = true;
+            }
+        }
+    }
+
+    auto dominates_use = [&](int reg, int block, size_t index) {
+        if (reg < 0 || reg >= register_count || def_block[reg] == -1) return false;
+        if (def_block[reg] == block) return def_index[reg] < index;
+        return static_cast<bool>(dominators[block][def_block[reg]]);
+    };
+    auto type_of = [&](int reg) {
+        return (reg >= 0 && reg < register_count) ? function.register_types[reg] : Type::Error;
+    };
+
+    for (int b = 0; b < block_count; ++b) {
+        const auto& block = function.blocks[b];
+        std::string where = "bb" + std::to_string(b) + ": ";
+        for (size_t i = 0; i < block.instructions.size(); ++i) {
+            const auto& inst = block.instructions[i];
+            std::string what = where + IR::to_string(inst.op) + ": ";
+
+            // Uses must be dominated by their definitions.
+            if (reachable[b]) {
+                for (size_t k = 0; k < inst.operands.size(); ++k) {
+                    int reg = inst.operands[k];
+                    bool ok = inst.op == IR::Opcode::Phi
+                        ? k < inst.blocks.size() && inst.blocks[k] >= 0 && inst.blocks[k] < block_count &&
+                          (!reachable[inst.blocks[k]] ||
+                           dominates_use(reg, inst.blocks[k], function.blocks[inst.blocks[k]].instructions.size()))
+                        : dominates_use(reg, b, i);
+                    if (!ok) error(function, what + "use of %" + std::to_string(reg) + " is not dominated by its definition");
+                }
+            }
+
+            // Operand counts and types.
+            auto expect = [&](bool condition, const std::string& message) {
+                if (!condition) error(function, what + message);
+            };
+            size_t n = inst.operands.size();
+            switch (inst.op) {
+                case IR::Opcode::Const:
+                    expect(n == 0 && (inst.type == Type::Int || inst.type == Type::Bool), "malformed constant");
+                    break;
+                case IR::Opcode::Param:
+                    expect(b == 0 && inst.immediate >= 0 && inst.immediate < static_cast<long long>(function.params.size()), "malformed parameter");
+                    break;
+                case IR::Opcode::Neg:
+                    expect(n == 1 && type_of(inst.operands[0]) == Type::Int && inst.type == Type::Int, "expects an int");
+                    break;
+                case IR::Opcode::Not:
+                    expect(n == 1 && type_of(inst.operands[0]) == Type::Bool && inst.type == Type::Bool, "expects a bool");
+                    break;
+                case IR::Opcode::Add:
+                case IR::Opcode::Sub:
+                case IR::Opcode::Mul:
+                case IR::Opcode::Div:
+                    expect(n == 2 && type_of(inst.operands[0]) == Type::Int && type_of(inst.operands[1]) == Type::Int &&
+                           inst.type == Type::Int, "expects two ints");
+                    break;
+                case IR::Opcode::Lt:
+                case IR::Opcode::Le:
+                case IR::Opcode::Gt:
+                case IR::Opcode::Ge:
+                    expect(n == 2 && type_of(inst.operands[0]) == Type::Int && type_of(inst.operands[1]) == Type::Int &&
+                           inst.type == Type::Bool, "expects two ints");
+                    break;
+                case IR::Opcode::Eq:
+                case IR::Opcode::Ne:
+                    expect(n == 2 && type_of(inst.operands[0]) == type_of(inst.operands[1]) && inst.type == Type::Bool,
+                           "operands must have the same type");
+                    break;
+                case IR::Opcode::Call:
+                    expect(!inst.name.empty() && inst.result != IR::NoRegister, "malformed call");
+                    break;
+                case IR::Opcode::LoadGlobal:
+                    expect(n == 0 && globals.count(inst.name) && globals[inst.name] == inst.type, "unknown global or wrong type");
+                    break;
+                case IR::Opcode::StoreGlobal:
+                    expect(n == 1 && globals.count(inst.name) && globals[inst.name] == type_of(inst.operands[0]),
+                           "unknown global or wrong type");
+                    break;
+                case IR::Opcode::Phi: {
+                    std::vector<int> incoming = inst.blocks;
+                    std::vector<int> preds = block.predecessors;
+                    std::sort(incoming.begin(), incoming.end());
+                    std::sort(preds.begin(), preds.end());
+                    expect(n == inst.blocks.size() && incoming == preds, "needs one operand per predecessor");
+                    for (int operand : inst.operands) {
+                        expect(type_of(operand) == inst.type, "operand type differs from the phi");
+                    }
+                    break;
+                }
+                case IR::Opcode::Jump:
+                    expect(n == 0 && inst.blocks.size() == 1, "malformed jump");
+                    break;
+                case IR::Opcode::Branch:
+                    expect(n == 1 && inst.blocks.size() == 2 && type_of(inst.operands[0]) == Type::Bool,
+                           "expects a bool condition and two targets");
+                    break;
+                case IR::Opcode::Return:
+                    if (function.return_type == Type::Void) {
+                        expect(n == 0, "returns a value from a void function");
+                    } else {
+                        expect(n == 1 && type_of(inst.operands[0]) == function.return_type, "returns the wrong type");
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+} // namespace Quastra
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ir.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// Checks the structural and type invariants of an IR module: every block ends
+// in exactly one terminator, predecessor lists match the terminators, phis
+// sit at the top of their block with one operand per predecessor, every
+// register is defined once and dominates its uses, and operand types agree.
+// Passes that transform the IR should leave it verifiable.
+class IRVerifier {
+public:
+    bool verify(const IR::Module& module);
+
+    const std::vector<std::string>& get_errors() const { return errors; }
+
+private:
+    void verify_function(const IR::Function& function);
+    void error(const IR::Function& function, const std::string& message);
+
+    std::vector<std::string> errors;
+    std::map<std::string, Type> globals;
+};
+
+} // namespace Quastra
@@ -0,0 +1,478 @@
+#include "jit.hpp"
+#include "numeric_functions.hpp"
+#include "x86_64_assembler.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define QUASTRA_JIT_SUPPORTED 1
+#else
+#define QUASTRA_JIT_SUPPORTED 0
+#endif
+
+namespace Quastra {
+
+namespace {
+
+using Assembler = X86Assembler;
+
+// Nested compiled calls before bailing out.
+constexpr int32_t max_native_depth = 50000;
+
+bool is_comparison(TokenType type) {
+    return type == TokenType::Less || type == TokenType::LessEqual || type == TokenType::Greater ||
+           type == TokenType::GreaterEqual || type == TokenType::EqualEqual || type == TokenType::BangEqual;
+}
+
+// Translates one function body. Numbers live in xmm0 while they are
+// computed. Locals sit below rbp; temporaries, including the argument arrays
+// of calls, sit above rsp, one slot per nesting depth, so that the
+// arguments of a call are contiguous. Compiled functions take a pointer to
+// their arguments in rdi and return in xmm0, like `double f(const double*)`.
+class FunctionCompiler {
+public:
+    FunctionCompiler(const std::map<std::string, const AST::FunctionStmt*>& globals, unsigned char* bailed_out,
+                     uint32_t* depth, std::map<const AST::FunctionStmt*, void*>& entry_slots)
+        : globals(globals), bailed_out(bailed_out), depth(depth), entry_slots(entry_slots) {}
+
+    // Returns false if the function uses anything the JIT does not support.
+    bool compile(const AST::FunctionStmt& function) {
+        if (function.is_async) return false; // Calls return futures.
+        declaration = &function;
+        epilogue = code.new_label();
+        bail = code.new_label();
+        body = code.new_label();
+
+        code.push_rbp();
+        code.mov_rbp_rsp();
+        size_t frame_size = code.sub_rsp_imm32(0);
+        // Deep recursion is left to the interpreter, whose tail calls do
+        // not grow the stack.
+        code.mov_rax_imm64(reinterpret_cast<uint64_t>(depth));
+        code.add_dword_at_rax(1);
+        code.cmp_dword_at_rax(max_native_depth);
+        code.jcc(Assembler::Above, bail);
+        scopes.emplace_back();
+        for (size_t i = 0; i < function.params.size(); ++i) {
+            size_t slot = declare(function.params[i].lexeme);
+            code.movsd_load(Assembler::XMM0, Assembler::RDI, static_cast<int32_t>(8 * i));
+            code.movsd_store(Assembler::RBP, local(slot), Assembler::XMM0);
+        }
+        code.bind(body);
+        for (const auto& stmt : function.body) {
+            if (!statement(*stmt)) return false;
+        }
+        // Falling off the end returns false, which is not a number.
+        code.jmp(bail);
+
+        code.bind(bail);
+        code.mov_rax_imm64(reinterpret_cast<uint64_t>(bailed_out));
+        code.mov_byte_at_rax(1);
+        code.bind(epilogue);
+        code.mov_rax_imm64(reinterpret_cast<uint64_t>(depth));
+        code.add_dword_at_rax(-1);
+        code.leave();
+        code.ret();
+
+        size_t size = 8 * (locals + temps);
+        code.patch_imm32(frame_size, static_cast<int32_t>((size + 15) / 16 * 16));
+        return code.is_complete();
+    }
+
+    const Assembler& assembler() const { return code; }
+    const std::set<const AST::FunctionStmt*>& get_callees() const { return callees; }
+
+private:
+    size_t declare(const std::string& name) {
+        auto it = scopes.back().find(name);
+        if (it != scopes.back().end()) return it->second;
+        scopes.back()[name] = locals;
+        return locals++;
+    }
+
+    bool lookup(const std::string& name, size_t& slot) const {
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            auto found = it->find(name);
+            if (found != it->end()) {
+                slot = found->second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static int32_t local(size_t slot) { return -static_cast<int32_t>(8 * (slot + 1)); }
+
+    int32_t temp(size_t depth) {
+        if (depth + 1 > temps) temps = depth + 1;
+        return static_cast<int32_t>(8 * depth);
+    }
+
+    bool statement(const AST::Stmt& stmt) {
+        if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+            return expression(*expr_stmt->expression, 0);
+        }
+        if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+            // `let x;` holds false, which is not a number.
+            if (!decl->initializer || !expression(*decl->initializer, 0)) return false;
+            code.movsd_store(Assembler::RBP, local(declare(decl->name.lexeme)), Assembler::XMM0);
+            return true;
+        }
+        if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+            if (block->kind != AST::BlockKind::Plain) return false; // Tasks stay interpreted.
+            scopes.emplace_back();
+            for (const auto& inner : block->statements) {
+                if (!statement(*inner)) return false;
+            }
+            scopes.pop_back();
+            return true;
+        }
+        if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+            auto otherwise = code.new_label();
+            if (!condition(*if_stmt->condition, otherwise) || !statement(*if_stmt->then_branch)) return false;
+            if (!if_stmt->else_branch) {
+                code.bind(otherwise);
+                return true;
+            }
+            auto end = code.new_label();
+            code.jmp(end);
+            code.bind(otherwise);
+            if (!statement(*if_stmt->else_branch)) return false;
+            code.bind(end);
+            return true;
+        }
+        if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+            auto top = code.new_label();
+            auto exit = code.new_label();
+            code.bind(top);
+            if (!condition(*while_stmt->condition, exit) || !statement(*while_stmt->body)) return false;
+            code.jmp(top);
+            code.bind(exit);
+            return true;
+        }
+        if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+            if (!return_stmt->value) return false;
+            auto* call = dynamic_cast<const AST::Call*>(return_stmt->value.get());
+            if (call && call->is_tail_call) return tail_call(*call);
+            if (!expression(*return_stmt->value, 0)) return false;
+            code.jmp(epilogue);
+            return true;
+        }
+        return false;
+    }
+
+    // Jumps to `otherwise` when the condition is false.
+    bool condition(const AST::Expr& expr, Assembler::Label otherwise) {
+        auto* literal = dynamic_cast<const AST::Literal*>(&expr);
+        if (literal && literal->value.type == TokenType::True) return true;
+        if (literal && literal->value.type == TokenType::False) {
+            code.jmp(otherwise);
+            return true;
+        }
+        auto* binary = dynamic_cast<const AST::Binary*>(&expr);
+        if (!binary || !is_comparison(binary->op.type) || !operands(*binary, 0)) return false;
+
+        // xmm0 holds the left operand and xmm1 the right one. Comparisons
+        // with NaN are unordered (CF, ZF and PF set) and must come out false.
+        switch (binary->op.type) {
+            case TokenType::Less:
+                code.ucomisd(Assembler::XMM1, Assembler::XMM0);
+                code.jcc(Assembler::BelowEqual, otherwise);
+                break;
+            case TokenType::LessEqual:
+                code.ucomisd(Assembler::XMM1, Assembler::XMM0);
+                code.jcc(Assembler::Below, otherwise);
+                break;
+            case TokenType::Greater:
+                code.ucomisd(Assembler::XMM0, Assembler::XMM1);
+                code.jcc(Assembler::BelowEqual, otherwise);
+                break;
+            case TokenType::GreaterEqual:
+                code.ucomisd(Assembler::XMM0, Assembler::XMM1);
+                code.jcc(Assembler::Below, otherwise);
+                break;
+            case TokenType::EqualEqual:
+                code.ucomisd(Assembler::XMM0, Assembler::XMM1);
+                code.jcc(Assembler::Parity, otherwise);
+                code.jcc(Assembler::NotEqual, otherwise);
+                break;
+            default: { // BangEqual
+                auto taken = code.new_label();
+                code.ucomisd(Assembler::XMM0, Assembler::XMM1);
+                code.jcc(Assembler::Parity, taken);
+                code.jcc(Assembler::Equal, otherwise);
+                code.bind(taken);
+                break;
+            }
+        }
+        return true;
+    }
+
+    // Leaves the left operand in xmm0 and the right one in xmm1.
+    bool operands(const AST::Binary& expr, size_t depth) {
+        if (!expression(*expr.left, depth)) return false;
+        code.movsd_store(Assembler::RSP, temp(depth), Assembler::XMM0);
+        if (!expression(*expr.right, depth + 1)) return false;
+        code.movapd(Assembler::XMM1, Assembler::XMM0);
+        code.movsd_load(Assembler::XMM0, Assembler::RSP, temp(depth));
+        return true;
+    }
+
+    bool expression(const AST::Expr& expr, size_t depth) {
+        if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+            if (literal->value.type != TokenType::IntLiteral) return false;
+            double value = std::stod(literal->value.lexeme);
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof bits);
+            code.mov_rax_imm64(bits);
+            code.movq_xmm_rax(Assembler::XMM0);
+            return true;
+        }
+        if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+            size_t slot;
+            if (!lookup(variable->name.lexeme, slot)) return false;
+            code.movsd_load(Assembler::XMM0, Assembler::RBP, local(slot));
+            return true;
+        }
+        if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+            size_t slot;
+            if (!lookup(assign->name.lexeme, slot) || !expression(*assign->value, depth)) return false;
+            code.movsd_store(Assembler::RBP, local(slot), Assembler::XMM0);
+            return true;
+        }
+        if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+            if (unary->op.type != TokenType::Minus || !expression(*unary->right, depth)) return false;
+            code.mov_rax_imm64(0x8000000000000000ull);
+            code.movq_xmm_rax(Assembler::XMM1);
+            code.xorpd(Assembler::XMM0, Assembler::XMM1);
+            return true;
+        }
+        if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+            switch (binary->op.type) {
+                case TokenType::Plus:
+                    if (!operands(*binary, depth)) return false;
+                    code.addsd(Assembler::XMM0, Assembler::XMM1);
+                    return true;
+                case TokenType::Minus:
+                    if (!operands(*binary, depth)) return false;
+                    code.subsd(Assembler::XMM0, Assembler::XMM1);
+                    return true;
+                case TokenType::Star:
+                    if (!operands(*binary, depth)) return false;
+                    code.mulsd(Assembler::XMM0, Assembler::XMM1);
+                    return true;
+                case TokenType::Slash: {
+                    if (!operands(*binary, depth)) return false;
+                    // Division by zero is the interpreter's to report.
+                    auto divide = code.new_label();
+                    code.xorpd(Assembler::XMM2, Assembler::XMM2);
+                    code.ucomisd(Assembler::XMM1, Assembler::XMM2);
+                    code.jcc(Assembler::Parity, divide);
+                    code.jcc(Assembler::Equal, bail);
+                    code.bind(divide);
+                    code.divsd(Assembler::XMM0, Assembler::XMM1);
+                    return true;
+                }
+                default:
+                    return false; // Comparisons produce booleans.
+            }
+        }
+        if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+            return direct_call(*call, depth);
+        }
+        return false;
+    }
+
+    // The function a call binds to, or nullptr if it is not a direct call
+    // to a known top-level function with the right number of arguments.
+    const AST::FunctionStmt* callee_of(const AST::Call& call) const {
+        auto* variable = dynamic_cast<const AST::Variable*>(call.callee.get());
+        size_t slot;
+        if (!variable || lookup(variable->name.lexeme, slot)) return nullptr;
+        auto it = globals.find(variable->name.lexeme);
+        if (it == globals.end() || it->second->params.size() != call.arguments.size()) return nullptr;
+        return it->second;
+    }
+
+    // Evaluates the arguments into temporaries depth, depth + 1, ...
+    bool arguments(const AST::Call& call, size_t depth) {
+        for (size_t i = 0; i < call.arguments.size(); ++i) {
+            if (!expression(*call.arguments[i], depth + i)) return false;
+            code.movsd_store(Assembler::RSP, temp(depth + i), Assembler::XMM0);
+        }
+        return true;
+    }
+
+    bool direct_call(const AST::Call& call, size_t depth) {
+        const AST::FunctionStmt* callee = callee_of(call);
+        if (!callee || !arguments(call, depth)) return false;
+        callees.insert(callee);
+        code.lea_rdi(Assembler::RSP, temp(depth));
+        code.mov_rax_imm64(reinterpret_cast<uint64_t>(entry_slots[callee]));
+        code.call_at_rax();
+        // Stop as soon as a callee has bailed out.
+        code.mov_rax_imm64(reinterpret_cast<uint64_t>(bailed_out));
+        code.cmp_byte_at_rax(0);
+        code.jcc(Assembler::NotEqual, epilogue);
+        return true;
+    }
+
+    // Self tail calls jump back to the top of the body. Other tail calls
+    // are ordinary calls, bounded by max_native_depth.
+    bool tail_call(const AST::Call& call) {
+        if (callee_of(call) != declaration) {
+            if (!direct_call(call, 0)) return false;
+            code.jmp(epilogue);
+            return true;
+        }
+        if (!arguments(call, 0)) return false;
+        for (size_t i = 0; i < call.arguments.size(); ++i) {
+            size_t slot;
+            lookup(declaration->params[i].lexeme, slot);
+            code.movsd_load(Assembler::XMM0, Assembler::RSP, temp(i));
+            code.movsd_store(Assembler::RBP, local(slot), Assembler::XMM0);
+        }
+        code.jmp(body);
+        return true;
+    }
+
+    const std::map<std::string, const AST::FunctionStmt*>& globals;
+    unsigned char* bailed_out;
+    uint32_t* depth;
+    std::map<const AST::FunctionStmt*, void*>& entry_slots;
+
+    Assembler code;
+    Assembler::Label epilogue = 0, bail = 0, body = 0;
+    const AST::FunctionStmt* declaration = nullptr;
+    std::vector<std::map<std::string, size_t>> scopes;
+    std::set<const AST::FunctionStmt*> callees;
+    size_t locals = 0;
+    size_t temps = 0;
+};
+
+} // namespace
+
+BaselineJit::BaselineJit(const std::vector<std::unique_ptr<AST::Stmt>>& program, JitOptions options)
+    : options(options) {
+    for (const auto& [name, declaration] : bindable_functions(program)) {
+        Function& function = functions[declaration];
+        function.declaration = declaration;
+        by_name[name] = &function;
+    }
+}
+
+BaselineJit::~BaselineJit() {
+#if QUASTRA_JIT_SUPPORTED
+    for (auto& [declaration, function] : functions) {
+        if (function.memory) munmap(function.memory, function.memory_size);
+    }
+#endif
+}
+
+bool BaselineJit::is_supported() { return QUASTRA_JIT_SUPPORTED; }
+
+std::vector<std::string> BaselineJit::compiled_functions() const {
+    std::vector<std::string> names;
+    for (const auto& [name, function] : by_name) {
+        if (function->state == State::Compiled) names.push_back(name);
+    }
+    return names;
+}
+
+bool BaselineJit::try_call(QuastraCallable& callable, Arguments arguments, QuastraValue& result) {
+    auto* quastra_function = dynamic_cast<QuastraFunction*>(&callable);
+    if (!quastra_function) return false;
+    auto it = functions.find(&quastra_function->get_declaration());
+    if (it == functions.end()) return false;
+    Function& function = it->second;
+    if (function.state == State::Rejected) return false;
+    if (function.state == State::Cold) {
+        if (++function.calls <= options.threshold || !compile(function, callable)) return false;
+    }
+
+    double values[16];
+    if (arguments.size() > 16) return false;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        const double* number = std::get_if<double>(&arguments[i]);
+        if (!number) return false;
+        values[i] = *number;
+    }
+    bailed_out = 0;
+    depth = 0;
+    double value = function.entry(values);
+    if (bailed_out) return false;
+    result = value;
+    return true;
+}
+
+// Compiles the function and everything it calls, or nothing.
+bool BaselineJit::compile(Function& function, QuastraCallable& callable) {
+#if QUASTRA_JIT_SUPPORTED
+    auto* quastra_function = dynamic_cast<QuastraFunction*>(&callable);
+    std::map<std::string, const AST::FunctionStmt*> globals;
+    std::map<const AST::FunctionStmt*, void*> entry_slots;
+    for (const auto& [name, known] : by_name) {
+        globals[name] = known->declaration;
+        entry_slots[known->declaration] = &known->entry;
+    }
+
+    std::vector<Function*> group{&function};
+    std::vector<std::vector<uint8_t>> code;
+    for (size_t i = 0; i < group.size(); ++i) {
+        Function& member = *group[i];
+        FunctionCompiler compiler(globals, &bailed_out, &depth, entry_slots);
+        if (!compiler.compile(*member.declaration)) {
+            // Whatever called it through the group cannot be compiled either,
+            // but that is only certain for the function that got hot.
+            member.state = State::Rejected;
+            function.state = State::Rejected;
+            return false;
+        }
+        code.push_back(compiler.assembler().code());
+        for (const AST::FunctionStmt* callee : compiler.get_callees()) {
+            Function& target = functions.at(callee);
+            if (target.state == State::Compiled) continue;
+            if (target.state == State::Rejected) {
+                function.state = State::Rejected;
+                return false;
+            }
+            bool queued = false;
+            for (Function* member_function : group) queued = queued || member_function == &target;
+            if (!queued) group.push_back(&target);
+        }
+    }
+
+    // The interpreter would fail a call to a function it has not defined
+    // yet; wait until every function in the group is.
+    for (Function* member : group) {
+        if (!is_defined_as(*quastra_function->get_closure(), *member->declaration)) {
+            function.calls = 0;
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < group.size(); ++i) {
+        Function& member = *group[i];
+        size_t size = code[i].size();
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return false;
+        std::memcpy(memory, code[i].data(), size);
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return false;
+        }
+        member.memory = memory;
+        member.memory_size = size;
+        member.entry = reinterpret_cast<Entry>(memory);
+        member.state = State::Compiled;
+    }
+    return true;
+#else
+    (void)callable;
+    function.state = State::Rejected;
+    return false;
+#endif
+}
+
+} // namespace Quastra
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include "../interpreter/interpreter.hpp"
+#include "../runtime/quastra_value.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Quastra {
+
+class QuastraCallable;
+
+struct JitOptions {
+    size_t threshold = 100; // Calls a function takes before it is compiled.
+};
+
+// A baseline JIT for the tree-walking Interpreter. It counts calls to
+// top-level functions and, once one is hot, compiles it and every function
+// it calls to x86-64 machine code in mmap'd executable memory.
+//
+// Only purely numeric code is compiled: number parameters and locals,
+// arithmetic, comparisons in `if` and `while` conditions, `return` of a
+// number, and direct calls to top-level functions that are declared once
+// and never assigned; self tail calls become jumps. A function using
+// anything else, or calling one that does, stays in the interpreter. Since
+// compiled code has no side effects, anything it cannot finish the way the
+// interpreter would (a division by zero, falling off the end of a function,
+// recursion deeper than a fixed limit) makes it bail out and the
+// interpreter runs the whole call again.
+//
+// Supported on x86-64 Linux; elsewhere nothing is ever compiled.
+class BaselineJit : public ExecutionTier {
+public:
+    BaselineJit(const std::vector<std::unique_ptr<AST::Stmt>>& program, JitOptions options = {});
+    ~BaselineJit();
+
+    BaselineJit(const BaselineJit&) = delete;
+    BaselineJit& operator=(const BaselineJit&) = delete;
+
+    // Counts the call, compiles the function once it is hot and runs the
+    // machine code when the arguments are all numbers.
+    bool try_call(QuastraCallable& function, Arguments arguments, QuastraValue& result) override;
+
+    // Names of the functions compiled so far.
+    std::vector<std::string> compiled_functions() const;
+
+    static bool is_supported();
+
+private:
+    using Entry = double (*)(const double* arguments);
+
+    enum class State { Cold, Compiled, Rejected };
+
+    struct Function {
+        const AST::FunctionStmt* declaration = nullptr;
+        size_t calls = 0;
+        State state = State::Cold;
+        Entry entry = nullptr; // Compiled calls go through this slot.
+        void* memory = nullptr;
+        size_t memory_size = 0;
+    };
+
+    bool compile(Function& function, QuastraCallable& callable);
+
+    JitOptions options;
+    // Top-level functions a call can be bound to directly.
+    std::map<std::string, Function*> by_name;
+    std::unordered_map<const AST::FunctionStmt*, Function> functions;
+    // Set by compiled code that has to give up.
+    unsigned char bailed_out = 0;
+    // Compiled calls currently on the stack.
+    uint32_t depth = 0;
+};
+
+} // namespace Quastra
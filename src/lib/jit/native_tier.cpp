@@ -0,0 +1,163 @@
+#include "native_tier.hpp"
+#include "numeric_functions.hpp"
+#include "../backend/codegen.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fstream>
+#include <set>
+#include <unistd.h>
+
+namespace Quastra {
+
+NativeTier::NativeTier(const std::vector<std::unique_ptr<AST::Stmt>>& program, NativeTierOptions options)
+    : options(std::move(options)), bindable(bindable_functions(program)) {
+    for (const auto& [name, declaration] : bindable) {
+        functions[declaration].declaration = declaration;
+    }
+}
+
+NativeTier::~NativeTier() {
+    for (auto& build : builds) {
+        if (build->thread.joinable()) build->thread.join();
+    }
+    for (void* library : libraries) dlclose(library);
+    for (const auto& directory : directories) {
+        std::remove((directory + "/native.cpp").c_str());
+        std::remove((directory + "/native.so").c_str());
+        std::remove((directory + "/build.log").c_str());
+        rmdir(directory.c_str());
+    }
+}
+
+std::vector<std::string> NativeTier::compiled_functions() const {
+    std::vector<std::string> names;
+    for (const auto& [name, declaration] : bindable) {
+        if (functions.at(declaration).state == State::Compiled) names.push_back(name);
+    }
+    return names;
+}
+
+bool NativeTier::try_call(QuastraCallable& callable, Arguments arguments, QuastraValue& result) {
+    if (!builds.empty()) finish_builds();
+
+    auto* quastra_function = dynamic_cast<QuastraFunction*>(&callable);
+    if (!quastra_function) return false;
+    auto it = functions.find(&quastra_function->get_declaration());
+    if (it == functions.end()) return false;
+    Function& function = it->second;
+    if (function.state == State::Cold && ++function.calls > options.threshold) {
+        start_build(function, callable);
+        if (options.wait_for_compiler) finish_builds();
+    }
+    if (function.state != State::Compiled) return false;
+
+    double values[16];
+    if (arguments.size() > 16) return false;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        const double* number = std::get_if<double>(&arguments[i]);
+        if (!number) return false;
+        values[i] = *number;
+    }
+    double value = 0;
+    if (!function.entry(values, &value)) return false;
+    result = value;
+    return true;
+}
+
+// Generates C++ for the function and everything it calls and starts
+// compiling it, unless some of it is not numeric or not defined yet.
+void NativeTier::start_build(Function& function, QuastraCallable& callable) {
+    std::vector<Function*> group{&function};
+    std::vector<const AST::FunctionStmt*> declarations;
+    for (size_t i = 0; i < group.size(); ++i) {
+        Function& member = *group[i];
+        std::set<const AST::FunctionStmt*> callees;
+        if (!is_numeric_function(*member.declaration, bindable, callees)) {
+            member.state = State::Rejected;
+            function.state = State::Rejected;
+            return;
+        }
+        declarations.push_back(member.declaration);
+        for (const AST::FunctionStmt* callee : callees) {
+            Function& target = functions.at(callee);
+            if (target.state == State::Rejected) {
+                function.state = State::Rejected;
+                return;
+            }
+            bool queued = false;
+            for (Function* queued_function : group) queued = queued || queued_function == &target;
+            if (!queued) group.push_back(&target);
+        }
+    }
+
+    auto& globals = *dynamic_cast<QuastraFunction&>(callable).get_closure();
+    for (Function* member : group) {
+        if (!is_defined_as(globals, *member->declaration)) {
+            function.calls = 0;
+            return;
+        }
+    }
+
+    // Functions already compiled in another library are compiled again;
+    // each library is self-contained.
+    char directory[] = "/tmp/quastra-native-XXXXXX";
+    if (!mkdtemp(directory)) {
+        function.state = State::Rejected;
+        return;
+    }
+    directories.push_back(directory);
+    {
+        std::ofstream source(std::string(directory) + "/native.cpp");
+        source << CodeGen().generate_native(declarations);
+    }
+
+    auto build = std::make_unique<Build>();
+    build->directory = directory;
+    build->library = build->directory + "/native.so";
+    for (Function* member : group) {
+        if (member->state == State::Cold) {
+            member->state = State::Building;
+            build->group.push_back(member);
+        }
+    }
+    std::string command = options.compiler + " -std=c++17 -O2 -shared -fPIC -o " + build->library + " " +
+                          build->directory + "/native.cpp > " + build->directory + "/build.log 2>&1";
+    Build* running = build.get();
+    build->thread = std::thread([running, command] {
+        running->succeeded = std::system(command.c_str()) == 0;
+        running->done = true;
+    });
+    builds.push_back(std::move(build));
+}
+
+// Loads every build that has finished since the last call.
+void NativeTier::finish_builds() {
+    for (auto it = builds.begin(); it != builds.end();) {
+        Build& build = **it;
+        if (!options.wait_for_compiler && !build.done) {
+            ++it;
+            continue;
+        }
+        build.thread.join();
+        load(build);
+        it = builds.erase(it);
+    }
+}
+
+void NativeTier::load(Build& build) {
+    void* library = build.succeeded ? dlopen(build.library.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+    for (Function* member : build.group) {
+        Entry entry = nullptr;
+        if (library) {
+            std::string symbol = "quastra_native_" + member->declaration->name.lexeme;
+            entry = reinterpret_cast<Entry>(dlsym(library, symbol.c_str()));
+        }
+        member->entry = entry;
+        member->state = entry ? State::Compiled : State::Rejected;
+    }
+    if (library) libraries.push_back(library);
+}
+
+} // namespace Quastra
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include "../interpreter/interpreter.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Quastra {
+
+struct NativeTierOptions {
+    size_t threshold = 200;          // Calls a function takes before it is compiled.
+    std::string compiler = "g++";    // Invoked through the shell.
+    bool wait_for_compiler = false;  // Compile at the hot call instead of in the background.
+};
+
+// Tiered execution for the tree-walking Interpreter. Calls to top-level
+// functions are counted; once one is hot and numeric (see
+// is_numeric_function), CodeGen::generate_native turns it and everything it
+// calls into C++, which a background thread compiles into a shared object.
+// The next call after the build finishes dlopens it and from then on calls
+// go to the native code through the ABI described at generate_native.
+// Calls the native code gives back, and every call while the build runs or
+// after it failed, are interpreted as before.
+class NativeTier : public ExecutionTier {
+public:
+    NativeTier(const std::vector<std::unique_ptr<AST::Stmt>>& program, NativeTierOptions options = {});
+    // Waits for builds still running and removes their files.
+    ~NativeTier();
+
+    NativeTier(const NativeTier&) = delete;
+    NativeTier& operator=(const NativeTier&) = delete;
+
+    bool try_call(QuastraCallable& function, Arguments arguments, QuastraValue& result) override;
+
+    // Names of the functions whose native code is in use.
+    std::vector<std::string> compiled_functions() const;
+
+private:
+    using Entry = int (*)(const double* arguments, double* result);
+
+    enum class State { Cold, Building, Compiled, Rejected };
+
+    struct Function {
+        const AST::FunctionStmt* declaration = nullptr;
+        size_t calls = 0;
+        State state = State::Cold;
+        Entry entry = nullptr;
+    };
+
+    // One shared object being compiled for a group of functions.
+    struct Build {
+        std::vector<Function*> group;
+        std::string directory;
+        std::string library;
+        std::thread thread;
+        std::atomic<bool> done{false};
+        bool succeeded = false;
+    };
+
+    void start_build(Function& function, QuastraCallable& callable);
+    void finish_builds();
+    void load(Build& build);
+
+    NativeTierOptions options;
+    std::map<std::string, const AST::FunctionStmt*> bindable;
+    std::unordered_map<const AST::FunctionStmt*, Function> functions;
+    std::vector<std::unique_ptr<Build>> builds; // Still running.
+    std::vector<std::string> directories;       // To remove when done.
+    std::vector<void*> libraries;
+};
+
+} // namespace Quastra
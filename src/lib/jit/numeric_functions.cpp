@@ -0,0 +1,220 @@
+#include "numeric_functions.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <stdexcept>
+
+namespace Quastra {
+
+namespace {
+
+void collect_assigned(const AST::Expr& expr, std::set<std::string>& names) {
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        names.insert(assign->name.lexeme);
+        collect_assigned(*assign->value, names);
+    } else if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        collect_assigned(*unary->right, names);
+    } else if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        collect_assigned(*binary->left, names);
+        collect_assigned(*binary->right, names);
+    } else if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        collect_assigned(*call->callee, names);
+        for (const auto& argument : call->arguments) collect_assigned(*argument, names);
+    }
+}
+
+// Every name assigned anywhere in the program, in any scope.
+void collect_assigned(const AST::Stmt& stmt, std::set<std::string>& names) {
+    if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        collect_assigned(*expr_stmt->expression, names);
+    } else if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        if (decl->initializer) collect_assigned(*decl->initializer, names);
+    } else if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& inner : block->statements) collect_assigned(*inner, names);
+    } else if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        collect_assigned(*if_stmt->condition, names);
+        collect_assigned(*if_stmt->then_branch, names);
+        if (if_stmt->else_branch) collect_assigned(*if_stmt->else_branch, names);
+    } else if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        collect_assigned(*while_stmt->condition, names);
+        collect_assigned(*while_stmt->body, names);
+    } else if (auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        for (const auto& inner : function->body) collect_assigned(*inner, names);
+    } else if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        if (return_stmt->value) collect_assigned(*return_stmt->value, names);
+    }
+}
+
+bool reads(const AST::Expr& expr, const std::string& name) {
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) return variable->name.lexeme == name;
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        return assign->name.lexeme == name || reads(*assign->value, name);
+    }
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) return reads(*unary->right, name);
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return reads(*binary->left, name) || reads(*binary->right, name);
+    }
+    if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        for (const auto& argument : call->arguments) {
+            if (reads(*argument, name)) return true;
+        }
+    }
+    return false;
+}
+
+class NumericChecker {
+public:
+    NumericChecker(const std::map<std::string, const AST::FunctionStmt*>& bindable,
+                   std::set<const AST::FunctionStmt*>& callees)
+        : bindable(bindable), callees(callees) {}
+
+    bool check(const AST::FunctionStmt& function) {
+        if (function.is_async) return false; // Calls return futures.
+        // Parameters and the body's own declarations share a scope in C++.
+        scopes.emplace_back();
+        for (const auto& param : function.params) {
+            if (!declare(param.lexeme)) return false;
+        }
+        for (const auto& stmt : function.body) {
+            if (!stmt || !statement(*stmt)) return false;
+        }
+        return true;
+    }
+
+private:
+    bool declare(const std::string& name) { return scopes.back().insert(name).second; }
+
+    bool is_local(const std::string& name) const {
+        for (const auto& scope : scopes) {
+            if (scope.count(name)) return true;
+        }
+        return false;
+    }
+
+    bool statement(const AST::Stmt& stmt) {
+        if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) return number(*expr_stmt->expression);
+        if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+            return decl->initializer && !reads(*decl->initializer, decl->name.lexeme) &&
+                   number(*decl->initializer) && declare(decl->name.lexeme);
+        }
+        if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+            if (block->kind != AST::BlockKind::Plain) return false; // Tasks stay interpreted.
+            scopes.emplace_back();
+            for (const auto& inner : block->statements) {
+                if (!inner || !statement(*inner)) return false;
+            }
+            scopes.pop_back();
+            return true;
+        }
+        if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+            return condition(*if_stmt->condition) && statement(*if_stmt->then_branch) &&
+                   (!if_stmt->else_branch || statement(*if_stmt->else_branch));
+        }
+        if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+            return condition(*while_stmt->condition) && statement(*while_stmt->body);
+        }
+        if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+            return return_stmt->value && number(*return_stmt->value);
+        }
+        return false;
+    }
+
+    bool condition(const AST::Expr& expr) {
+        if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+            return literal->value.type == TokenType::True || literal->value.type == TokenType::False;
+        }
+        auto* binary = dynamic_cast<const AST::Binary*>(&expr);
+        if (!binary) return false;
+        switch (binary->op.type) {
+            case TokenType::Less:
+            case TokenType::LessEqual:
+            case TokenType::Greater:
+            case TokenType::GreaterEqual:
+            case TokenType::EqualEqual:
+            case TokenType::BangEqual:
+                return number(*binary->left) && number(*binary->right);
+            default:
+                return false;
+        }
+    }
+
+    bool number(const AST::Expr& expr) {
+        if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+            return literal->value.type == TokenType::IntLiteral;
+        }
+        if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) return is_local(variable->name.lexeme);
+        if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+            return is_local(assign->name.lexeme) && number(*assign->value);
+        }
+        if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+            return unary->op.type == TokenType::Minus && number(*unary->right);
+        }
+        if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+            switch (binary->op.type) {
+                case TokenType::Plus:
+                case TokenType::Minus:
+                case TokenType::Star:
+                case TokenType::Slash:
+                    return number(*binary->left) && number(*binary->right);
+                default:
+                    return false;
+            }
+        }
+        if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+            auto* callee = dynamic_cast<const AST::Variable*>(call->callee.get());
+            if (!callee || is_local(callee->name.lexeme)) return false;
+            auto it = bindable.find(callee->name.lexeme);
+            if (it == bindable.end() || it->second->params.size() != call->arguments.size()) return false;
+            for (const auto& argument : call->arguments) {
+                if (!number(*argument)) return false;
+            }
+            callees.insert(it->second);
+            return true;
+        }
+        return false;
+    }
+
+    const std::map<std::string, const AST::FunctionStmt*>& bindable;
+    std::set<const AST::FunctionStmt*>& callees;
+    std::vector<std::set<std::string>> scopes;
+};
+
+} // namespace
+
+std::map<std::string, const AST::FunctionStmt*> bindable_functions(
+    const std::vector<std::unique_ptr<AST::Stmt>>& program) {
+    std::set<std::string> assigned;
+    std::map<std::string, int> declarations;
+    std::map<std::string, const AST::FunctionStmt*> functions;
+    for (const auto& stmt : program) {
+        if (!stmt) continue;
+        collect_assigned(*stmt, assigned);
+        if (auto* decl = dynamic_cast<const AST::VarDecl*>(stmt.get())) declarations[decl->name.lexeme]++;
+        if (auto* function = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            declarations[function->name.lexeme]++;
+            functions[function->name.lexeme] = function;
+        }
+    }
+    std::map<std::string, const AST::FunctionStmt*> bindable;
+    for (const auto& [name, function] : functions) {
+        if (declarations[name] == 1 && !assigned.count(name)) bindable[name] = function;
+    }
+    return bindable;
+}
+
+bool is_defined_as(Environment& globals, const AST::FunctionStmt& declaration) {
+    try {
+        QuastraValue value = globals.get(declaration.name);
+        auto* defined = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+        auto* function = defined ? dynamic_cast<QuastraFunction*>(defined->get()) : nullptr;
+        return function && &function->get_declaration() == &declaration;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+bool is_numeric_function(const AST::FunctionStmt& function,
+                         const std::map<std::string, const AST::FunctionStmt*>& bindable,
+                         std::set<const AST::FunctionStmt*>& callees) {
+    return NumericChecker(bindable, callees).check(function);
+}
+
+} // namespace Quastra
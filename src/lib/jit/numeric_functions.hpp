@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include "../runtime/environment.hpp"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// Helpers shared by the tiers that compile hot numeric functions (the
+// BaselineJit and the NativeTier).
+
+// The top-level functions a call can be bound to by name: declared once at
+// top level and never assigned anywhere, so the name always means them.
+std::map<std::string, const AST::FunctionStmt*> bindable_functions(
+    const std::vector<std::unique_ptr<AST::Stmt>>& program);
+
+// True if `name` is currently defined in `globals` as the function declared
+// by `declaration`. Compiled code calls its callees directly, which must not
+// happen before the interpreter would find them.
+bool is_defined_as(Environment& globals, const AST::FunctionStmt& declaration);
+
+// True if every value the function computes is a number, so that it can be
+// compiled with doubles throughout: number locals with initializers,
+// arithmetic, comparisons only as `if` and `while` conditions, returns with
+// a value, and direct calls to `bindable` functions, which are added to
+// `callees`. It also rejects what C++ would read differently: a name
+// declared twice in one scope, or a `let` whose initializer reads the name
+// it declares.
+bool is_numeric_function(const AST::FunctionStmt& function,
+                         const std::map<std::string, const AST::FunctionStmt*>& bindable,
+                         std::set<const AST::FunctionStmt*>& callees);
+
+} // namespace Quastra
@@ -0,0 +1,159 @@
+#include "x86_64_assembler.hpp"
+
+namespace Quastra {
+
+X86Assembler::Label X86Assembler::new_label() {
+    labels.push_back(-1);
+    return labels.size() - 1;
+}
+
+void X86Assembler::bind(Label label) {
+    labels[label] = static_cast<long>(bytes.size());
+    for (const auto& fixup : fixups) {
+        if (fixup.label == label) patch_imm32(fixup.offset, static_cast<int32_t>(bytes.size() - (fixup.offset + 4)));
+    }
+}
+
+bool X86Assembler::is_complete() const {
+    for (const auto& fixup : fixups) {
+        if (labels[fixup.label] < 0) return false;
+    }
+    return true;
+}
+
+void X86Assembler::emit32(int32_t value) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    for (int i = 0; i < 4; ++i) emit(static_cast<uint8_t>(bits >> (8 * i)));
+}
+
+void X86Assembler::patch_imm32(size_t offset, int32_t value) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    for (int i = 0; i < 4; ++i) bytes[offset + i] = static_cast<uint8_t>(bits >> (8 * i));
+}
+
+// ModRM with a 32-bit displacement (mod = 10). rsp as a base needs a SIB byte.
+void X86Assembler::memory_operand(uint8_t reg, Register base, int32_t disp) {
+    emit(static_cast<uint8_t>(0x80 | (reg << 3) | base));
+    if (base == RSP) emit(0x24);
+    emit32(disp);
+}
+
+void X86Assembler::sse(uint8_t prefix, uint8_t opcode, Xmm dst, Xmm src) {
+    emit(prefix);
+    emit(0x0F);
+    emit(opcode);
+    emit(static_cast<uint8_t>(0xC0 | (dst << 3) | src));
+}
+
+void X86Assembler::push_rbp() { emit(0x55); }
+
+void X86Assembler::mov_rbp_rsp() {
+    emit(0x48);
+    emit(0x89);
+    emit(0xE5);
+}
+
+size_t X86Assembler::sub_rsp_imm32(int32_t value) {
+    emit(0x48);
+    emit(0x81);
+    emit(0xEC);
+    size_t offset = bytes.size();
+    emit32(value);
+    return offset;
+}
+
+void X86Assembler::leave() { emit(0xC9); }
+void X86Assembler::ret() { emit(0xC3); }
+
+void X86Assembler::movsd_load(Xmm dst, Register base, int32_t disp) {
+    emit(0xF2);
+    emit(0x0F);
+    emit(0x10);
+    memory_operand(dst, base, disp);
+}
+
+void X86Assembler::movsd_store(Register base, int32_t disp, Xmm src) {
+    emit(0xF2);
+    emit(0x0F);
+    emit(0x11);
+    memory_operand(src, base, disp);
+}
+
+void X86Assembler::movapd(Xmm dst, Xmm src) { sse(0x66, 0x28, dst, src); }
+void X86Assembler::addsd(Xmm dst, Xmm src) { sse(0xF2, 0x58, dst, src); }
+void X86Assembler::subsd(Xmm dst, Xmm src) { sse(0xF2, 0x5C, dst, src); }
+void X86Assembler::mulsd(Xmm dst, Xmm src) { sse(0xF2, 0x59, dst, src); }
+void X86Assembler::divsd(Xmm dst, Xmm src) { sse(0xF2, 0x5E, dst, src); }
+void X86Assembler::xorpd(Xmm dst, Xmm src) { sse(0x66, 0x57, dst, src); }
+void X86Assembler::ucomisd(Xmm a, Xmm b) { sse(0x66, 0x2E, a, b); }
+
+void X86Assembler::mov_rax_imm64(uint64_t value) {
+    emit(0x48);
+    emit(0xB8);
+    for (int i = 0; i < 8; ++i) emit(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void X86Assembler::movq_xmm_rax(Xmm dst) {
+    emit(0x66);
+    emit(0x48);
+    emit(0x0F);
+    emit(0x6E);
+    emit(static_cast<uint8_t>(0xC0 | (dst << 3) | RAX));
+}
+
+void X86Assembler::lea_rdi(Register base, int32_t disp) {
+    emit(0x48);
+    emit(0x8D);
+    memory_operand(RDI, base, disp);
+}
+
+void X86Assembler::mov_byte_at_rax(uint8_t value) {
+    emit(0xC6);
+    emit(0x00);
+    emit(value);
+}
+
+void X86Assembler::cmp_byte_at_rax(uint8_t value) {
+    emit(0x80);
+    emit(0x38);
+    emit(value);
+}
+
+void X86Assembler::add_dword_at_rax(int8_t value) {
+    emit(0x83);
+    emit(0x00);
+    emit(static_cast<uint8_t>(value));
+}
+
+void X86Assembler::cmp_dword_at_rax(int32_t value) {
+    emit(0x81);
+    emit(0x38);
+    emit32(value);
+}
+
+void X86Assembler::call_at_rax() {
+    emit(0xFF);
+    emit(0x10);
+}
+
+void X86Assembler::jump_to(Label label) {
+    if (labels[label] >= 0) {
+        emit32(static_cast<int32_t>(labels[label] - static_cast<long>(bytes.size() + 4)));
+    } else {
+        fixups.push_back({bytes.size(), label});
+        emit32(0);
+    }
+}
+
+void X86Assembler::jmp(Label label) {
+    emit(0xE9);
+    jump_to(label);
+}
+
+void X86Assembler::jcc(Condition condition, Label label) {
+    emit(0x0F);
+    emit(static_cast<uint8_t>(0x80 | condition));
+    jump_to(label);
+}
+
+} // namespace Quastra
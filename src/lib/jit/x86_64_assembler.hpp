@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Quastra {
+
+// Encodes the handful of x86-64 instructions the baseline JIT emits: SSE2
+// scalar double arithmetic, loads and stores relative to rbp and rsp,
+// calls and jumps. Jumps go to labels that may be bound later; their
+// offsets are patched in when the label is bound.
+class X86Assembler {
+public:
+    // Registers are named by their encoding.
+    enum Register : uint8_t { RAX = 0, RSP = 4, RBP = 5, RDI = 7 };
+    enum Xmm : uint8_t { XMM0 = 0, XMM1 = 1, XMM2 = 2 };
+
+    // Condition codes for jcc, as in the 0F 8x opcodes.
+    enum Condition : uint8_t {
+        Below = 0x2,
+        AboveEqual = 0x3,
+        Equal = 0x4,
+        NotEqual = 0x5,
+        BelowEqual = 0x6,
+        Above = 0x7,
+        Parity = 0xA,
+    };
+
+    using Label = size_t;
+
+    Label new_label();
+    void bind(Label label);
+
+    void push_rbp();
+    void mov_rbp_rsp();
+    // `sub rsp, imm32`; returns the offset of the immediate for patch_imm32.
+    size_t sub_rsp_imm32(int32_t value);
+    void leave();
+    void ret();
+
+    void movsd_load(Xmm dst, Register base, int32_t disp);
+    void movsd_store(Register base, int32_t disp, Xmm src);
+    void movapd(Xmm dst, Xmm src);
+    void addsd(Xmm dst, Xmm src);
+    void subsd(Xmm dst, Xmm src);
+    void mulsd(Xmm dst, Xmm src);
+    void divsd(Xmm dst, Xmm src);
+    void xorpd(Xmm dst, Xmm src);
+    void ucomisd(Xmm a, Xmm b);
+
+    void mov_rax_imm64(uint64_t value);
+    void movq_xmm_rax(Xmm dst);
+    void lea_rdi(Register base, int32_t disp);
+    void mov_byte_at_rax(uint8_t value);
+    void cmp_byte_at_rax(uint8_t value);
+    void add_dword_at_rax(int8_t value);
+    void cmp_dword_at_rax(int32_t value);
+    void call_at_rax(); // call qword [rax]
+
+    void jmp(Label label);
+    void jcc(Condition condition, Label label);
+
+    void patch_imm32(size_t offset, int32_t value);
+
+    const std::vector<uint8_t>& code() const { return bytes; }
+    // False if a label used by a jump was never bound.
+    bool is_complete() const;
+
+private:
+    void emit(uint8_t byte) { bytes.push_back(byte); }
+    void emit32(int32_t value);
+    void memory_operand(uint8_t reg, Register base, int32_t disp);
+    void sse(uint8_t prefix, uint8_t opcode, Xmm dst, Xmm src);
+    void jump_to(Label label);
+
+    struct Fixup {
+        size_t offset; // Of the rel32 field.
+        Label label;
+    };
+
+    std::vector<uint8_t> bytes;
+    std::vector<long> labels; // Bound offsets, or -1.
+    std::vector<Fixup> fixups;
+};
+
+} // namespace Quastra
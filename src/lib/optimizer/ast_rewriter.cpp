@@ -0,0 +1,76 @@
+#include "ast_rewriter.hpp"
+#include <algorithm>
+
+namespace Quastra {
+
+void ASTRewriter::rewrite(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    begin_scope();
+    rewrite_statements(statements);
+    end_scope();
+}
+
+void ASTRewriter::rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (auto& statement : statements) {
+        rewrite_stmt(statement);
+    }
+    // Statements a pass removed are left as empty slots.
+    statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+}
+
+void ASTRewriter::rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) {
+    if (stmt) rewrite_children(*stmt);
+}
+
+void ASTRewriter::rewrite_expr(std::unique_ptr<AST::Expr>& expr) {
+    if (expr) rewrite_children(*expr);
+}
+
+void ASTRewriter::rewrite_children(AST::Stmt& stmt) {
+    if (auto* decl = dynamic_cast<AST::VarDecl*>(&stmt)) {
+        if (decl->initializer) rewrite_expr(decl->initializer);
+        declare(decl->name, decl);
+    } else if (auto* expr_stmt = dynamic_cast<AST::ExprStmt*>(&stmt)) {
+        rewrite_expr(expr_stmt->expression);
+    } else if (auto* block = dynamic_cast<AST::Block*>(&stmt)) {
+        begin_scope();
+        rewrite_statements(block->statements);
+        end_scope();
+    } else if (auto* if_stmt = dynamic_cast<AST::IfStmt*>(&stmt)) {
+        rewrite_expr(if_stmt->condition);
+        rewrite_stmt(if_stmt->then_branch);
+        if (if_stmt->else_branch) rewrite_stmt(if_stmt->else_branch);
+    } else if (auto* while_stmt = dynamic_cast<AST::WhileStmt*>(&stmt)) {
+        rewrite_expr(while_stmt->condition);
+        rewrite_stmt(while_stmt->body);
+    } else if (auto* function = dynamic_cast<AST::FunctionStmt*>(&stmt)) {
+        // The name is visible inside the body so that recursion resolves.
+        declare(function->name, nullptr);
+        begin_scope();
+        for (const auto& param : function->params) {
+            declare(param, nullptr);
+        }
+        rewrite_statements(function->body);
+        end_scope();
+    } else if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(&stmt)) {
+        if (return_stmt->value) rewrite_expr(return_stmt->value);
+    }
+}
+
+void ASTRewriter::rewrite_children(AST::Expr& expr) {
+    if (auto* unary = dynamic_cast<AST::Unary*>(&expr)) {
+        rewrite_expr(unary->right);
+    } else if (auto* binary = dynamic_cast<AST::Binary*>(&expr)) {
+        rewrite_expr(binary->left);
+        rewrite_expr(binary->right);
+    } else if (auto* assign = dynamic_cast<AST::Assign*>(&expr)) {
+        rewrite_expr(assign->value);
+    } else if (auto* call = dynamic_cast<AST::Call*>(&expr)) {
+        rewrite_expr(call->callee);
+        for (auto& argument : call->arguments) {
+            rewrite_expr(argument);
+        }
+    }
+    // Literals and variables have no children.
+}
+
+} // namespace Quastra
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+// Base class for passes that rewrite the AST in place.
+// The const visitors used by the analyses cannot replace nodes, so a rewriter
+// walks the owning unique_ptr slots instead. A pass overrides rewrite_stmt or
+// rewrite_expr, and calls the base version to recurse into the children.
+// A pass removes a statement from a list by resetting its slot; slots that are
+// not in a list (loop bodies, if branches) must be replaced instead.
+class ASTRewriter {
+public:
+    virtual ~ASTRewriter() = default;
+
+    // Rewrites a whole program (or any statement list) in place.
+    void rewrite(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+protected:
+    virtual void rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    virtual void rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt);
+    virtual void rewrite_expr(std::unique_ptr<AST::Expr>& expr);
+
+    // Scope hooks, called around blocks and function bodies, and for every
+    // name a declaration introduces. Passes that track bindings override these.
+    virtual void begin_scope() {}
+    virtual void end_scope() {}
+    virtual void declare(const Token& name, const AST::VarDecl* decl) { (void)name; (void)decl; }
+
+    // Recurse into the children of a node without replacing the node itself.
+    void rewrite_children(AST::Stmt& stmt);
+    void rewrite_children(AST::Expr& expr);
+};
+
+} // namespace Quastra
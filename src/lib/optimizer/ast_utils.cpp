@@ -0,0 +1,334 @@
+#include "ast_utils.hpp"
+#include <cmath>
+#include <string>
+
+namespace Quastra {
+
+std::optional<QuastraValue> literal_value(const AST::Expr& expr) {
+    if (const auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        switch (literal->value.type) {
+            case TokenType::IntLiteral: return QuastraValue(std::stod(literal->value.lexeme));
+            case TokenType::True: return QuastraValue(true);
+            case TokenType::False: return QuastraValue(false);
+            default: return std::nullopt;
+        }
+    }
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        const auto* operand = dynamic_cast<const AST::Literal*>(unary->right.get());
+        if (unary->op.type == TokenType::Minus && operand && operand->value.type == TokenType::IntLiteral) {
+            return QuastraValue(-std::stod(operand->value.lexeme));
+        }
+    }
+    return std::nullopt;
+}
+
+std::unique_ptr<AST::Expr> make_literal(const QuastraValue& value, int line) {
+    if (const bool* flag = std::get_if<bool>(&value)) {
+        if (*flag) return std::make_unique<AST::Literal>(Token{TokenType::True, "true", line});
+        return std::make_unique<AST::Literal>(Token{TokenType::False, "false", line});
+    }
+    if (const double* number = std::get_if<double>(&value)) {
+        if (!has_literal_form(value)) return nullptr;
+        long long integer = static_cast<long long>(std::fabs(*number));
+        auto literal = std::make_unique<AST::Literal>(Token{TokenType::IntLiteral, std::to_string(integer), line});
+        if (*number < 0) {
+            // Negative numbers are written as a unary minus so the backends never
+            // see a lexeme like `-3` next to another operator.
+            return std::make_unique<AST::Unary>(Token{TokenType::Minus, "-", line}, std::move(literal));
+        }
+        return literal;
+    }
+    return nullptr;
+}
+
+bool has_literal_form(const QuastraValue& value) {
+    if (std::holds_alternative<bool>(value)) return true;
+    if (const double* number = std::get_if<double>(&value)) {
+        // Beyond 2^53 a double no longer round-trips through an integer lexeme.
+        return std::isfinite(*number) && std::trunc(*number) == *number && std::fabs(*number) <= 9007199254740992.0;
+    }
+    return false;
+}
+
+bool is_truthy_value(const QuastraValue& value) {
+    if (const bool* flag = std::get_if<bool>(&value)) return *flag;
+    return true;
+}
+
+std::optional<QuastraValue> fold_unary(TokenType op, const QuastraValue& operand) {
+    if (op == TokenType::Minus) {
+        if (const double* number = std::get_if<double>(&operand)) return QuastraValue(-*number);
+        return std::nullopt;
+    }
+    if (op == TokenType::Bang) return QuastraValue(!is_truthy_value(operand));
+    return std::nullopt;
+}
+
+std::optional<QuastraValue> fold_binary(TokenType op, const QuastraValue& left, const QuastraValue& right) {
+    if (op == TokenType::EqualEqual) return QuastraValue(left == right);
+    if (op == TokenType::BangEqual) return QuastraValue(left != right);
+
+    const double* l = std::get_if<double>(&left);
+    const double* r = std::get_if<double>(&right);
+    if (!l || !r) return std::nullopt;
+    switch (op) {
+        case TokenType::Greater: return QuastraValue(*l > *r);
+        case TokenType::GreaterEqual: return QuastraValue(*l >= *r);
+        case TokenType::Less: return QuastraValue(*l < *r);
+        case TokenType::LessEqual: return QuastraValue(*l <= *r);
+        case TokenType::Plus: return QuastraValue(*l + *r);
+        case TokenType::Minus: return QuastraValue(*l - *r);
+        case TokenType::Star: return QuastraValue(*l * *r);
+        case TokenType::Slash:
+            if (*r == 0) return std::nullopt;
+            return QuastraValue(*l / *r);
+        default: return std::nullopt;
+    }
+}
+
+bool has_side_effects(const AST::Expr& expr) {
+    if (dynamic_cast<const AST::Assign*>(&expr) || dynamic_cast<const AST::Call*>(&expr)) return true;
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        // Other fibers run while an await waits.
+        return unary->op.type == TokenType::Await || has_side_effects(*unary->right);
+    }
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return has_side_effects(*binary->left) || has_side_effects(*binary->right);
+    }
+    return false;
+}
+
+bool can_fail(const AST::Expr& expr) {
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        return unary->op.type == TokenType::Await || can_fail(*unary->right);
+    }
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        if (binary->op.type == TokenType::Slash) {
+            auto divisor = literal_value(*binary->right);
+            const double* number = divisor ? std::get_if<double>(&*divisor) : nullptr;
+            if (!number || *number == 0) return true;
+        }
+        return can_fail(*binary->left) || can_fail(*binary->right);
+    }
+    if (const auto* assign = dynamic_cast<const AST::Assign*>(&expr)) return can_fail(*assign->value);
+    // A call runs arbitrary code.
+    return dynamic_cast<const AST::Call*>(&expr) != nullptr;
+}
+
+bool always_returns(const AST::Stmt& stmt) {
+    if (dynamic_cast<const AST::ReturnStmt*>(&stmt)) return true;
+    if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s && always_returns(*s)) return true;
+        }
+        return false;
+    }
+    if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return if_stmt->else_branch && always_returns(*if_stmt->then_branch) && always_returns(*if_stmt->else_branch);
+    }
+    if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        // There is no `break`, so `while (true)` only ends by returning.
+        auto condition = literal_value(*while_stmt->condition);
+        return condition && is_truthy_value(*condition);
+    }
+    return false;
+}
+
+bool contains_return(const AST::Stmt& stmt) {
+    if (dynamic_cast<const AST::ReturnStmt*>(&stmt)) return true;
+    if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s && contains_return(*s)) return true;
+        }
+        return false;
+    }
+    if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return contains_return(*if_stmt->then_branch) || (if_stmt->else_branch && contains_return(*if_stmt->else_branch));
+    }
+    if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) return contains_return(*while_stmt->body);
+    return false;
+}
+
+bool contains_tasks(const AST::Stmt& stmt) {
+    if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        return block->kind != AST::BlockKind::Plain || contains_tasks(block->statements);
+    }
+    if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return contains_tasks(*if_stmt->then_branch) || (if_stmt->else_branch && contains_tasks(*if_stmt->else_branch));
+    }
+    if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) return contains_tasks(*while_stmt->body);
+    if (const auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) return contains_tasks(function->body);
+    return false;
+}
+
+bool contains_tasks(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& stmt : statements) {
+        if (stmt && contains_tasks(*stmt)) return true;
+    }
+    return false;
+}
+
+std::unique_ptr<AST::Expr> clone(const AST::Expr& expr) {
+    if (const auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        return std::make_unique<AST::Literal>(literal->value);
+    }
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        return std::make_unique<AST::Unary>(unary->op, clone(*unary->right));
+    }
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return std::make_unique<AST::Binary>(clone(*binary->left), binary->op, clone(*binary->right));
+    }
+    if (const auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        return std::make_unique<AST::Variable>(variable->name);
+    }
+    if (const auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        return std::make_unique<AST::Assign>(assign->name, clone(*assign->value));
+    }
+    const auto& call = dynamic_cast<const AST::Call&>(expr);
+    std::vector<std::unique_ptr<AST::Expr>> arguments;
+    for (const auto& argument : call.arguments) {
+        arguments.push_back(clone(*argument));
+    }
+    auto copy = std::make_unique<AST::Call>(clone(*call.callee), call.paren, std::move(arguments));
+    // Transforms run after the Resolver, so keep what it found. A cloned
+    // tail call is only a tail call again where it is still returned, and
+    // the inliner turns a callee's returns into assignments.
+    copy->is_tail_call = call.is_tail_call;
+    copy->is_global_call = call.is_global_call;
+    return copy;
+}
+
+static std::vector<std::unique_ptr<AST::Stmt>> clone(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::vector<std::unique_ptr<AST::Stmt>> copies;
+    for (const auto& stmt : statements) {
+        if (stmt) copies.push_back(clone(*stmt));
+    }
+    return copies;
+}
+
+std::unique_ptr<AST::Stmt> clone(const AST::Stmt& stmt) {
+    if (const auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        return std::make_unique<AST::VarDecl>(decl->name, decl->initializer ? clone(*decl->initializer) : nullptr,
+                                              decl->is_mutable, decl->is_const);
+    }
+    if (const auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        return std::make_unique<AST::ExprStmt>(clone(*expr_stmt->expression));
+    }
+    if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        return std::make_unique<AST::Block>(clone(block->statements), block->kind);
+    }
+    if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return std::make_unique<AST::IfStmt>(clone(*if_stmt->condition), clone(*if_stmt->then_branch),
+                                             if_stmt->else_branch ? clone(*if_stmt->else_branch) : nullptr);
+    }
+    if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return std::make_unique<AST::WhileStmt>(clone(*while_stmt->condition), clone(*while_stmt->body));
+    }
+    if (const auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        return std::make_unique<AST::FunctionStmt>(function->name, function->params, clone(function->body),
+                                                   function->is_async);
+    }
+    const auto& return_stmt = dynamic_cast<const AST::ReturnStmt&>(stmt);
+    return std::make_unique<AST::ReturnStmt>(return_stmt.keyword, return_stmt.value ? clone(*return_stmt.value) : nullptr);
+}
+
+namespace {
+
+// Collects the names assigned anywhere inside a function body.
+void collect_function_writes(const AST::Expr& expr, bool in_function, std::set<std::string>& writes) {
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        if (in_function) writes.insert(assign->name.lexeme);
+        collect_function_writes(*assign->value, in_function, writes);
+    } else if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        collect_function_writes(*unary->right, in_function, writes);
+    } else if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        collect_function_writes(*binary->left, in_function, writes);
+        collect_function_writes(*binary->right, in_function, writes);
+    } else if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        collect_function_writes(*call->callee, in_function, writes);
+        for (const auto& argument : call->arguments) {
+            collect_function_writes(*argument, in_function, writes);
+        }
+    }
+}
+
+void collect_function_writes(const AST::Stmt& stmt, bool in_function, std::set<std::string>& writes) {
+    if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        if (decl->initializer) collect_function_writes(*decl->initializer, in_function, writes);
+    } else if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        collect_function_writes(*expr_stmt->expression, in_function, writes);
+    } else if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s) collect_function_writes(*s, in_function, writes);
+        }
+    } else if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        collect_function_writes(*if_stmt->condition, in_function, writes);
+        collect_function_writes(*if_stmt->then_branch, in_function, writes);
+        if (if_stmt->else_branch) collect_function_writes(*if_stmt->else_branch, in_function, writes);
+    } else if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        collect_function_writes(*while_stmt->condition, in_function, writes);
+        collect_function_writes(*while_stmt->body, in_function, writes);
+    } else if (auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        for (const auto& s : function->body) {
+            if (s) collect_function_writes(*s, true, writes);
+        }
+    } else if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        if (return_stmt->value) collect_function_writes(*return_stmt->value, in_function, writes);
+    }
+}
+
+} // namespace
+
+std::set<std::string> names_written_by_functions(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::set<std::string> writes;
+    for (const auto& stmt : statements) {
+        if (stmt) collect_function_writes(*stmt, false, writes);
+    }
+    return writes;
+}
+
+size_t count_nodes(const AST::Expr& expr) {
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) return 1 + count_nodes(*unary->right);
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return 1 + count_nodes(*binary->left) + count_nodes(*binary->right);
+    }
+    if (const auto* assign = dynamic_cast<const AST::Assign*>(&expr)) return 1 + count_nodes(*assign->value);
+    if (const auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        size_t count = 1 + count_nodes(*call->callee);
+        for (const auto& argument : call->arguments) {
+            count += count_nodes(*argument);
+        }
+        return count;
+    }
+    return 1;
+}
+
+size_t count_nodes(const AST::Stmt& stmt) {
+    if (const auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        return 1 + (decl->initializer ? count_nodes(*decl->initializer) : 0);
+    }
+    if (const auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) return 1 + count_nodes(*expr_stmt->expression);
+    if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) return 1 + count_nodes(block->statements);
+    if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return 1 + count_nodes(*if_stmt->condition) + count_nodes(*if_stmt->then_branch) +
+               (if_stmt->else_branch ? count_nodes(*if_stmt->else_branch) : 0);
+    }
+    if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return 1 + count_nodes(*while_stmt->condition) + count_nodes(*while_stmt->body);
+    }
+    if (const auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) return 1 + count_nodes(function->body);
+    if (const auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        return 1 + (return_stmt->value ? count_nodes(*return_stmt->value) : 0);
+    }
+    return 1;
+}
+
+size_t count_nodes(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    size_t count = 0;
+    for (const auto& stmt : statements) {
+        if (stmt) count += count_nodes(*stmt);
+    }
+    return count;
+}
+
+} // namespace Quastra
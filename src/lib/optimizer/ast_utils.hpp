@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include "../runtime/quastra_value.hpp"
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// Returns the value of an expression if it is a literal, including a negated
+// integer literal such as `-3`. Returns nullopt for anything else.
+std::optional<QuastraValue> literal_value(const AST::Expr& expr);
+
+// Builds a literal expression for a compile-time value, or returns nullptr if
+// the value has no source representation. Only integral numbers and booleans
+// can be written back, since the backends treat number literals as integers.
+std::unique_ptr<AST::Expr> make_literal(const QuastraValue& value, int line);
+
+// True if make_literal can write the value back into the source.
+bool has_literal_form(const QuastraValue& value);
+
+// Applies an operator to constant operands with the interpreter's semantics.
+// Returns nullopt wherever the interpreter would raise a runtime error (such
+// as division by zero), so that folding never hides one.
+std::optional<QuastraValue> fold_unary(TokenType op, const QuastraValue& operand);
+std::optional<QuastraValue> fold_binary(TokenType op, const QuastraValue& left, const QuastraValue& right);
+
+// The interpreter's notion of truth: only `false` is false.
+bool is_truthy_value(const QuastraValue& value);
+
+// True if evaluating the expression may assign a variable or call a function.
+bool has_side_effects(const AST::Expr& expr);
+
+// True if evaluating the expression may raise a runtime error in a well-typed
+// program, which means a division by anything but a non-zero literal.
+// Passes must not delete or move such an expression past other effects.
+bool can_fail(const AST::Expr& expr);
+
+// True if control never reaches the statement after this one.
+bool always_returns(const AST::Stmt& stmt);
+
+// True if the statement contains a `return` outside of nested functions.
+bool contains_return(const AST::Stmt& stmt);
+
+// True if the statements contain a `spawn` or `scope` block, also inside
+// nested functions. Passes that move code between blocks leave these alone.
+bool contains_tasks(const AST::Stmt& stmt);
+bool contains_tasks(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+// The names assigned anywhere inside a function body. A call may change any
+// of them.
+std::set<std::string> names_written_by_functions(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+// Deep copies of AST fragments.
+std::unique_ptr<AST::Expr> clone(const AST::Expr& expr);
+std::unique_ptr<AST::Stmt> clone(const AST::Stmt& stmt);
+
+// The number of AST nodes in a fragment, a rough measure of code size.
+size_t count_nodes(const AST::Expr& expr);
+size_t count_nodes(const AST::Stmt& stmt);
+size_t count_nodes(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+} // namespace Quastra
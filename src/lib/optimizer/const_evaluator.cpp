@@ -0,0 +1,162 @@
+#include "const_evaluator.hpp"
+#include "ast_utils.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <iostream>
+#include <stdexcept>
+
+namespace Quastra {
+
+bool ConstEvaluator::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    had_error = false;
+    replaced = 0;
+    steps_used = 0;
+    results.clear();
+    tried.clear();
+    purity.analyze(statements);
+
+    // The sandbox only sees pure functions, so nothing evaluated in it can
+    // perform I/O or touch program state.
+    sandbox = std::make_unique<Interpreter>();
+    for (const auto& [name, function] : purity.pure_functions()) {
+        auto globals = sandbox->get_environment();
+        globals->define(name, sandbox->make_function(*function, globals));
+    }
+
+    rewrite(statements);
+    sandbox.reset();
+    results.clear();
+    tried.clear();
+    return !had_error;
+}
+
+void ConstEvaluator::rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) {
+    auto* decl = dynamic_cast<AST::VarDecl*>(stmt.get());
+    if (!decl || !decl->is_const) {
+        ASTRewriter::rewrite_stmt(stmt);
+        return;
+    }
+
+    rewrite_expr(decl->initializer);
+    std::optional<QuastraValue> value = literal_value(*decl->initializer);
+    if (!value && is_constant(*decl->initializer)) {
+        value = try_evaluate(*decl->initializer, true);
+        if (value) replace_with_literal(decl->initializer, *value, decl->name.line);
+    }
+    if (!value) {
+        std::cerr << "Semantic Error: Initializer of const '" << decl->name.lexeme << "' is not a compile-time constant.\n";
+        had_error = true;
+        scopes.back()[decl->name.lexeme] = std::nullopt;
+        return;
+    }
+
+    scopes.back()[decl->name.lexeme] = value;
+    // Global constants may be read by pure functions running in the sandbox.
+    if (scopes.size() == 1) sandbox->get_environment()->define(decl->name.lexeme, *value);
+}
+
+void ConstEvaluator::rewrite_expr(std::unique_ptr<AST::Expr>& expr) {
+    if (!expr) return;
+
+    if (auto* variable = dynamic_cast<AST::Variable*>(expr.get())) {
+        const auto* binding = lookup(variable->name.lexeme);
+        if (binding && binding->has_value()) {
+            replace_with_literal(expr, **binding, variable->name.line);
+        }
+        return;
+    }
+
+    ASTRewriter::rewrite_expr(expr);
+
+    auto* call = dynamic_cast<AST::Call*>(expr.get());
+    if (call && is_constant(*call)) {
+        if (auto value = try_evaluate(*call)) {
+            replace_with_literal(expr, *value, call->paren.line);
+        }
+    }
+}
+
+void ConstEvaluator::declare(const Token& name, const AST::VarDecl* decl) {
+    (void)decl;
+    // Any non-constant binding shadows a constant of the same name.
+    scopes.back()[name.lexeme] = std::nullopt;
+}
+
+const std::optional<QuastraValue>* ConstEvaluator::lookup(const std::string& name, size_t* depth) const {
+    for (size_t i = scopes.size(); i-- > 0;) {
+        auto it = scopes[i].find(name);
+        if (it != scopes[i].end()) {
+            if (depth) *depth = i;
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+bool ConstEvaluator::is_constant(const AST::Expr& expr) const {
+    if (dynamic_cast<const AST::Literal*>(&expr)) return true;
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        return unary->op.type != TokenType::Await && is_constant(*unary->right);
+    }
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return is_constant(*binary->left) && is_constant(*binary->right);
+    }
+    if (const auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        size_t depth = 0;
+        const auto* binding = lookup(variable->name.lexeme, &depth);
+        // Only global constants are known to the sandbox by name.
+        return binding && binding->has_value() && depth == 0;
+    }
+    if (const auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        const auto* callee = dynamic_cast<const AST::Variable*>(call->callee.get());
+        if (!callee || !purity.is_pure(callee->name.lexeme)) return false;
+        // The callee must resolve to the global function. At the top level it
+        // must also already be declared, or the call would fail at runtime.
+        size_t depth = 0;
+        const auto* binding = lookup(callee->name.lexeme, &depth);
+        if (binding ? depth != 0 : scopes.size() == 1) return false;
+        for (const auto& arg : call->arguments) {
+            if (!is_constant(*arg)) return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::optional<QuastraValue> ConstEvaluator::try_evaluate(const AST::Expr& expr, bool required) {
+    if (!required) {
+        auto known = results.find(&expr);
+        if (known != results.end()) return known->second;
+    }
+
+    ExecutionLimits remaining = limits;
+    if (!required && limits.max_steps != 0) {
+        remaining.max_steps = steps_used < limits.max_steps ? limits.max_steps - steps_used : 0;
+    }
+    std::optional<QuastraValue> value;
+    // No steps left: 0 would mean no limit at all.
+    if (required || limits.max_steps == 0 || remaining.max_steps != 0) {
+        sandbox->set_limits(remaining);
+        try {
+            value = sandbox->evaluate(expr);
+        } catch (const std::runtime_error&) {
+            // Leave the expression alone; it will fail the same way at runtime.
+        }
+        if (!required) steps_used += sandbox->steps_taken();
+    }
+
+    if (!required) {
+        tried.push_back(clone(expr));
+        results.emplace(tried.back().get(), value);
+    }
+    return value;
+}
+
+void ConstEvaluator::replace_with_literal(std::unique_ptr<AST::Expr>& expr, const QuastraValue& value, int line) {
+    if (literal_value(*expr)) return; // Already a literal.
+    if (auto literal = make_literal(value, line)) {
+        expr = std::move(literal);
+        replaced++;
+    }
+}
+
+} // namespace Quastra
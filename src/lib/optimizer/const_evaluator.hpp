@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ast_rewriter.hpp"
+#include "purity.hpp"
+#include "../frontend/ast_hash.hpp"
+#include "../interpreter/interpreter.hpp"
+#include <vector>
+#include <memory>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace Quastra {
+
+// Evaluates `const` declarations, and calls to pure functions with constant
+// arguments, at compile time and replaces them with literals.
+// Evaluation reuses the interpreter in a sandbox that only knows the pure
+// functions and runs under ExecutionLimits, so a runaway function cannot hang
+// the compiler. A call that fails at compile time (division by zero, limit
+// exceeded) is left in place so the error still happens at runtime.
+//
+// The step limit is a budget for the whole run: pure calls are folded only
+// as long as it lasts, and a call is evaluated at most once per distinct
+// expression, whether it succeeded or not. `const` initializers, which must
+// be evaluated, each get the full limit.
+class ConstEvaluator : private ASTRewriter {
+public:
+    explicit ConstEvaluator(ExecutionLimits limits = {100000, 256}) : limits(limits) {}
+
+    // Returns false if a `const` initializer could not be evaluated.
+    bool run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // The number of expressions replaced by literals in the last run.
+    int replacements() const { return replaced; }
+
+private:
+    void rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) override;
+    void rewrite_expr(std::unique_ptr<AST::Expr>& expr) override;
+    void begin_scope() override { scopes.emplace_back(); }
+    void end_scope() override { scopes.pop_back(); }
+    void declare(const Token& name, const AST::VarDecl* decl) override;
+
+    // Finds the innermost binding of a name. The optional holds the value if
+    // the binding is a constant; depth is 0 for the global scope.
+    const std::optional<QuastraValue>* lookup(const std::string& name, size_t* depth = nullptr) const;
+    bool is_constant(const AST::Expr& expr) const;
+    // Evaluates `expr` in the sandbox. Unless it is `required`, it draws on
+    // what is left of the step budget.
+    std::optional<QuastraValue> try_evaluate(const AST::Expr& expr, bool required = false);
+    void replace_with_literal(std::unique_ptr<AST::Expr>& expr, const QuastraValue& value, int line);
+
+    ExecutionLimits limits;
+    PurityAnalysis purity;
+    std::unique_ptr<Interpreter> sandbox;
+    std::vector<std::map<std::string, std::optional<QuastraValue>>> scopes;
+    // What each call tried so far gave, keyed by structure. Constant
+    // arguments are literals by then, so equal calls give equal results.
+    std::vector<std::unique_ptr<AST::Expr>> tried;
+    std::unordered_map<const AST::Expr*, std::optional<QuastraValue>, StructuralHash, StructuralEqual> results;
+    size_t steps_used = 0;
+    bool had_error = false;
+    int replaced = 0;
+};
+
+} // namespace Quastra
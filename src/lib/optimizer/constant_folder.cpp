@@ -0,0 +1,312 @@
+#include "constant_folder.hpp"
+#include "ast_utils.hpp"
+
+namespace Quastra {
+
+namespace {
+
+// Collects the names that some function assigns without declaring them
+// itself. A call may change such a variable behind the folder's back, so
+// bindings with these names are never treated as constant.
+class CaptureCollector : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    std::set<std::string> collect(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+        scopes.assign(1, {});
+        function_base = 0;
+        for (const auto& stmt : statements) {
+            if (stmt) stmt->accept(*this);
+        }
+        return captured;
+    }
+
+private:
+    // True if the name is declared by the function being visited.
+    bool is_own(const std::string& name) const {
+        for (size_t i = scopes.size(); i-- > function_base;) {
+            if (scopes[i].count(name)) return true;
+        }
+        return false;
+    }
+
+    void visit(const AST::VarDecl& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+        scopes.back().insert(stmt.name.lexeme);
+    }
+    void visit(const AST::ExprStmt& stmt) override { stmt.expression->accept(*this); }
+    void visit(const AST::Block& stmt) override {
+        scopes.emplace_back();
+        for (const auto& s : stmt.statements) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+    }
+    void visit(const AST::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.then_branch->accept(*this);
+        if (stmt.else_branch) stmt.else_branch->accept(*this);
+    }
+    void visit(const AST::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(const AST::FunctionStmt& stmt) override {
+        scopes.back().insert(stmt.name.lexeme);
+        size_t saved_base = function_base;
+        function_base = scopes.size();
+        scopes.emplace_back();
+        for (const auto& param : stmt.params) {
+            scopes.back().insert(param.lexeme);
+        }
+        for (const auto& s : stmt.body) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+        function_base = saved_base;
+    }
+    void visit(const AST::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+
+    void visit(const AST::Literal& expr) override { (void)expr; }
+    void visit(const AST::Unary& expr) override { expr.right->accept(*this); }
+    void visit(const AST::Binary& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(const AST::Variable& expr) override { (void)expr; }
+    void visit(const AST::Assign& expr) override {
+        if (function_base > 0 && !is_own(expr.name.lexeme)) captured.insert(expr.name.lexeme);
+        expr.value->accept(*this);
+    }
+    void visit(const AST::Call& expr) override {
+        expr.callee->accept(*this);
+        for (const auto& argument : expr.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    std::vector<std::set<std::string>> scopes;
+    size_t function_base = 0; // Index of the current function's outermost scope.
+    std::set<std::string> captured;
+};
+
+} // namespace
+
+int ConstantFolder::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    CaptureCollector collector;
+    captured = collector.collect(statements);
+    scopes.clear();
+    state = State{};
+    next_binding = 0;
+    rewriting = true;
+    changes = 0;
+    rewrite(statements);
+    return changes;
+}
+
+void ConstantFolder::end_scope() {
+    // Bindings going out of scope are no longer tracked.
+    for (const auto& [name, binding] : scopes.back()) {
+        state.constants.erase(binding);
+    }
+    scopes.pop_back();
+}
+
+void ConstantFolder::declare(const Token& name, const AST::VarDecl* decl) {
+    (void)decl;
+    int binding = next_binding++;
+    scopes.back()[name.lexeme] = binding;
+    state.constants.erase(binding);
+}
+
+const int* ConstantFolder::lookup(const std::string& name) const {
+    for (size_t i = scopes.size(); i-- > 0;) {
+        auto it = scopes[i].find(name);
+        if (it != scopes[i].end()) return &it->second;
+    }
+    return nullptr;
+}
+
+ConstantFolder::State ConstantFolder::meet(const State& a, const State& b) {
+    if (!a.reachable) return b;
+    if (!b.reachable) return a;
+    State result;
+    for (const auto& [binding, value] : a.constants) {
+        auto it = b.constants.find(binding);
+        if (it != b.constants.end() && it->second == value) result.constants.emplace(binding, value);
+    }
+    return result;
+}
+
+void ConstantFolder::rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) {
+    if (!stmt) return;
+
+    if (auto* decl = dynamic_cast<AST::VarDecl*>(stmt.get())) {
+        std::optional<QuastraValue> value;
+        if (decl->initializer) value = evaluate(decl->initializer);
+        declare(decl->name, decl);
+        // An uninitialized `let` differs between the backends, so it is left alone.
+        if (value && !captured.count(decl->name.lexeme)) {
+            state.constants[scopes.back()[decl->name.lexeme]] = *value;
+        }
+    } else if (auto* expr_stmt = dynamic_cast<AST::ExprStmt*>(stmt.get())) {
+        evaluate(expr_stmt->expression);
+    } else if (dynamic_cast<AST::IfStmt*>(stmt.get())) {
+        fold_if(stmt);
+    } else if (dynamic_cast<AST::WhileStmt*>(stmt.get())) {
+        fold_while(stmt);
+    } else if (auto* function = dynamic_cast<AST::FunctionStmt*>(stmt.get())) {
+        fold_function(*function);
+    } else if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(stmt.get())) {
+        if (return_stmt->value) evaluate(return_stmt->value);
+        state.reachable = false;
+    } else {
+        ASTRewriter::rewrite_stmt(stmt);
+    }
+}
+
+void ConstantFolder::rewrite_expr(std::unique_ptr<AST::Expr>& expr) {
+    evaluate(expr);
+}
+
+std::optional<QuastraValue> ConstantFolder::evaluate(std::unique_ptr<AST::Expr>& expr) {
+    std::optional<QuastraValue> value;
+
+    if (dynamic_cast<AST::Literal*>(expr.get())) {
+        return literal_value(*expr);
+    } else if (auto* variable = dynamic_cast<AST::Variable*>(expr.get())) {
+        const int* binding = lookup(variable->name.lexeme);
+        if (binding) {
+            auto it = state.constants.find(*binding);
+            if (it != state.constants.end()) value = it->second;
+        }
+    } else if (auto* unary = dynamic_cast<AST::Unary*>(expr.get())) {
+        auto operand = evaluate(unary->right);
+        if (operand) value = fold_unary(unary->op.type, *operand);
+    } else if (auto* binary = dynamic_cast<AST::Binary*>(expr.get())) {
+        auto left = evaluate(binary->left);
+        auto right = evaluate(binary->right);
+        if (left && right) value = fold_binary(binary->op.type, *left, *right);
+    } else if (auto* assign = dynamic_cast<AST::Assign*>(expr.get())) {
+        auto assigned = evaluate(assign->value);
+        const int* binding = lookup(assign->name.lexeme);
+        if (binding) {
+            if (assigned && !captured.count(assign->name.lexeme)) state.constants[*binding] = *assigned;
+            else state.constants.erase(*binding);
+        }
+        // The assignment itself has to stay, so its value is not reported.
+        return std::nullopt;
+    } else if (auto* call = dynamic_cast<AST::Call*>(expr.get())) {
+        evaluate(call->callee);
+        for (auto& argument : call->arguments) {
+            evaluate(argument);
+        }
+        return std::nullopt;
+    }
+
+    // Values without a literal form (like 7 / 2) would fold differently in
+    // the interpreter and in the C++ that CodeGen emits, so they stay opaque.
+    if (!value || !has_literal_form(*value)) return std::nullopt;
+
+    if (rewriting && !literal_value(*expr) && !has_side_effects(*expr)) {
+        int line = 0;
+        if (auto* variable = dynamic_cast<AST::Variable*>(expr.get())) line = variable->name.line;
+        else if (auto* unary = dynamic_cast<AST::Unary*>(expr.get())) line = unary->op.line;
+        else if (auto* binary = dynamic_cast<AST::Binary*>(expr.get())) line = binary->op.line;
+        expr = make_literal(*value, line);
+        ++changes;
+    }
+    return value;
+}
+
+// The value of a branch condition, if it is known and evaluating it has no
+// side effect that deleting it would lose.
+std::optional<QuastraValue> ConstantFolder::condition_value(std::unique_ptr<AST::Expr>& condition) {
+    auto value = evaluate(condition);
+    if (value && has_side_effects(*condition)) return std::nullopt;
+    return value;
+}
+
+void ConstantFolder::fold_if(std::unique_ptr<AST::Stmt>& stmt) {
+    auto* if_stmt = static_cast<AST::IfStmt*>(stmt.get());
+    auto condition = condition_value(if_stmt->condition);
+
+    if (condition) {
+        // Only the taken branch runs. The if statement is replaced by it, which
+        // keeps the interpreter's scoping: a branch runs in the enclosing scope.
+        std::unique_ptr<AST::Stmt>& taken = is_truthy_value(*condition) ? if_stmt->then_branch : if_stmt->else_branch;
+        rewrite_stmt(taken);
+        if (rewriting) {
+            std::unique_ptr<AST::Stmt> replacement = std::move(taken);
+            stmt = std::move(replacement);
+            ++changes;
+        }
+        return;
+    }
+
+    State before = state;
+    rewrite_stmt(if_stmt->then_branch);
+    if (!if_stmt->then_branch) {
+        if_stmt->then_branch = std::make_unique<AST::Block>(std::vector<std::unique_ptr<AST::Stmt>>{});
+    }
+    State after_then = state;
+    state = before;
+    if (if_stmt->else_branch) rewrite_stmt(if_stmt->else_branch);
+    state = meet(after_then, state);
+}
+
+void ConstantFolder::fold_while(std::unique_ptr<AST::Stmt>& stmt) {
+    auto* while_stmt = static_cast<AST::WhileStmt*>(stmt.get());
+
+    // Solve the loop head first, without rewriting: start from the entry
+    // state and lower it with each back edge until it stops changing. Each
+    // round can only forget constants, so this terminates.
+    State entry = state;
+    State head = entry;
+    bool saved_rewriting = rewriting;
+    rewriting = false;
+    while (true) {
+        state = head;
+        auto condition = condition_value(while_stmt->condition);
+        if (condition && !is_truthy_value(*condition)) break;
+        rewrite_stmt(while_stmt->body);
+        State next = meet(entry, state);
+        if (next == head) break;
+        head = next;
+    }
+    rewriting = saved_rewriting;
+
+    // Now rewrite the loop under the fixed point.
+    state = head;
+    auto condition = condition_value(while_stmt->condition);
+    if (condition && !is_truthy_value(*condition)) {
+        if (rewriting) {
+            stmt.reset();
+            ++changes;
+        }
+        return;
+    }
+    rewrite_stmt(while_stmt->body);
+    if (!while_stmt->body) {
+        while_stmt->body = std::make_unique<AST::Block>(std::vector<std::unique_ptr<AST::Stmt>>{});
+    }
+    // The loop exits from its head; a loop that is always true never exits.
+    state = head;
+    if (condition) state.reachable = false;
+}
+
+void ConstantFolder::fold_function(AST::FunctionStmt& function) {
+    // The body can run at any later time, so nothing known here holds in it.
+    declare(function.name, nullptr);
+    State outer = std::move(state);
+    state = State{};
+    begin_scope();
+    for (const auto& param : function.params) {
+        declare(param, nullptr);
+    }
+    rewrite_statements(function.body);
+    end_scope();
+    state = std::move(outer);
+}
+
+} // namespace Quastra
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "ast_rewriter.hpp"
+#include "../runtime/quastra_value.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <optional>
+
+namespace Quastra {
+
+// Constant folding with conditional constant propagation over the AST.
+// Tracks which bindings hold a known value at each point, folds operators
+// whose operands are known, and deletes `if` and `while` branches whose
+// condition is known. Like SCCP, loops are solved optimistically: a variable
+// only assigned in a branch that never runs stays constant.
+// Operations the interpreter would reject (division by zero, type errors) are
+// never folded, so those errors still happen at runtime.
+class ConstantFolder : private ASTRewriter {
+public:
+    // Returns the number of expressions and statements rewritten.
+    int run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+private:
+    // Known values by binding id, at one program point. A binding that is
+    // absent is not known to be constant.
+    struct State {
+        bool reachable = true;
+        std::map<int, QuastraValue> constants;
+
+        bool operator==(const State& other) const {
+            return reachable == other.reachable && constants == other.constants;
+        }
+    };
+
+    void rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) override;
+    void rewrite_expr(std::unique_ptr<AST::Expr>& expr) override;
+    void begin_scope() override { scopes.emplace_back(); }
+    void end_scope() override;
+    void declare(const Token& name, const AST::VarDecl* decl) override;
+
+    void fold_if(std::unique_ptr<AST::Stmt>& stmt);
+    void fold_while(std::unique_ptr<AST::Stmt>& stmt);
+    void fold_function(AST::FunctionStmt& function);
+
+    // Evaluates an expression over the current state, folding it when
+    // rewriting. Returns the value if it is a known constant.
+    std::optional<QuastraValue> evaluate(std::unique_ptr<AST::Expr>& expr);
+    std::optional<QuastraValue> condition_value(std::unique_ptr<AST::Expr>& condition);
+    const int* lookup(const std::string& name) const;
+    static State meet(const State& a, const State& b);
+
+    std::vector<std::map<std::string, int>> scopes;
+    std::set<std::string> captured; // Names assigned from inside a nested function.
+    State state;
+    int next_binding = 0;
+    bool rewriting = true; // False while a loop is being solved.
+    int changes = 0;
+};
+
+} // namespace Quastra
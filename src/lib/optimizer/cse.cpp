@@ -0,0 +1,176 @@
+#include "cse.hpp"
+#include "ast_utils.hpp"
+#include "../frontend/ast_hash.hpp"
+#include <algorithm>
+#include <map>
+
+namespace Quastra {
+
+namespace {
+
+void collect_names(const AST::Expr& expr, std::set<std::string>& names) {
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        names.insert(variable->name.lexeme);
+    } else if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        collect_names(*unary->right, names);
+    } else if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        collect_names(*binary->left, names);
+        collect_names(*binary->right, names);
+    }
+}
+
+// True for a statement that may take part in a basic block.
+bool is_straight_line(const AST::Stmt& stmt) {
+    return dynamic_cast<const AST::VarDecl*>(&stmt) || dynamic_cast<const AST::ExprStmt*>(&stmt) ||
+           dynamic_cast<const AST::ReturnStmt*>(&stmt);
+}
+
+// True if a computation in this expression can be moved in front of the
+// statement without passing an effect. The store of `x = ...` comes after
+// its value, so a top-level assignment is fine.
+bool may_hoist_from(const AST::Expr& expr) {
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) return !has_side_effects(*assign->value);
+    return !has_side_effects(expr);
+}
+
+int line_of(const AST::Expr& expr) {
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) return binary->op.line;
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) return unary->op.line;
+    return 0;
+}
+
+} // namespace
+
+int CommonSubexpressionEliminator::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    written_by_functions = names_written_by_functions(statements);
+    replaced = 0;
+    rewrite(statements);
+    return replaced;
+}
+
+void CommonSubexpressionEliminator::rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    // Nested statement lists are blocks of their own.
+    ASTRewriter::rewrite_statements(statements);
+
+    available.clear();
+    occurrences.clear();
+    first.clear();
+    for (size_t i = 0; i < statements.size(); ++i) {
+        AST::Stmt& stmt = *statements[i];
+        if (!is_straight_line(stmt)) {
+            available.clear();
+            continue;
+        }
+        if (auto* decl = dynamic_cast<AST::VarDecl*>(&stmt)) {
+            if (decl->initializer) number_expr(decl->initializer, i, may_hoist_from(*decl->initializer));
+            kill(decl->name.lexeme); // A new binding shadows the old one.
+        } else if (auto* expr_stmt = dynamic_cast<AST::ExprStmt*>(&stmt)) {
+            number_expr(expr_stmt->expression, i, may_hoist_from(*expr_stmt->expression));
+        } else if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(&stmt)) {
+            if (return_stmt->value) number_expr(return_stmt->value, i, may_hoist_from(*return_stmt->value));
+        }
+    }
+    eliminate(statements);
+}
+
+// Walks an expression in evaluation order, recording each computation of a
+// pure expression and dropping values that assignments and calls invalidate.
+void CommonSubexpressionEliminator::number_expr(std::unique_ptr<AST::Expr>& expr, size_t statement, bool may_hoist) {
+    auto* unary = dynamic_cast<AST::Unary*>(expr.get());
+    auto* binary = dynamic_cast<AST::Binary*>(expr.get());
+    if ((unary || binary) && !literal_value(*expr) && !has_side_effects(*expr)) {
+        size_t hash = structural_hash(*expr);
+        for (const auto& value : available) {
+            if (value.hash == hash && structurally_equal(*value.expr, *expr)) {
+                occurrences.push_back({&expr, statement, value.value});
+                first.push_back(false);
+                return;
+            }
+        }
+        // Its operands are computed first and may be reused on their own.
+        if (unary) number_expr(unary->right, statement, may_hoist);
+        if (binary) {
+            number_expr(binary->left, statement, may_hoist);
+            number_expr(binary->right, statement, may_hoist);
+        }
+        if (may_hoist) {
+            Available value{expr.get(), hash, next_value++, {}};
+            collect_names(*expr, value.names);
+            occurrences.push_back({&expr, statement, value.value});
+            first.push_back(true);
+            available.push_back(std::move(value));
+        }
+        return;
+    }
+
+    if (unary) {
+        number_expr(unary->right, statement, may_hoist);
+    } else if (binary) {
+        number_expr(binary->left, statement, may_hoist);
+        number_expr(binary->right, statement, may_hoist);
+    } else if (auto* assign = dynamic_cast<AST::Assign*>(expr.get())) {
+        number_expr(assign->value, statement, may_hoist);
+        kill(assign->name.lexeme);
+    } else if (auto* call = dynamic_cast<AST::Call*>(expr.get())) {
+        number_expr(call->callee, statement, may_hoist);
+        for (auto& argument : call->arguments) {
+            number_expr(argument, statement, may_hoist);
+        }
+        kill_written_by_functions();
+    }
+}
+
+void CommonSubexpressionEliminator::kill(const std::string& name) {
+    available.erase(std::remove_if(available.begin(), available.end(),
+                                   [&](const Available& value) { return value.names.count(name) > 0; }),
+                    available.end());
+}
+
+void CommonSubexpressionEliminator::kill_written_by_functions() {
+    for (const auto& name : written_by_functions) {
+        kill(name);
+    }
+}
+
+// Gives every value computed more than once a temporary, declared in front
+// of the statement that computes it first.
+void CommonSubexpressionEliminator::eliminate(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::map<int, int> uses;
+    for (const auto& occurrence : occurrences) {
+        uses[occurrence.value]++;
+    }
+
+    // Operands come before the expressions containing them, so an inner
+    // temporary is read by the outer one's declaration.
+    std::map<int, std::string> temps;
+    std::map<size_t, std::vector<std::unique_ptr<AST::Stmt>>> declarations;
+    for (size_t i = 0; i < occurrences.size(); ++i) {
+        const Occurrence& occurrence = occurrences[i];
+        if (uses[occurrence.value] < 2) continue;
+        int line = line_of(**occurrence.slot);
+        if (first[i]) {
+            std::string temp = "__cse" + std::to_string(next_temp++);
+            temps[occurrence.value] = temp;
+            declarations[occurrence.statement].push_back(std::make_unique<AST::VarDecl>(
+                Token{TokenType::Identifier, temp, line}, std::move(*occurrence.slot), false));
+        } else {
+            replaced++;
+        }
+        *occurrence.slot = std::make_unique<AST::Variable>(Token{TokenType::Identifier, temps[occurrence.value], line});
+    }
+    if (declarations.empty()) return;
+
+    std::vector<std::unique_ptr<AST::Stmt>> result;
+    for (size_t i = 0; i < statements.size(); ++i) {
+        auto it = declarations.find(i);
+        if (it != declarations.end()) {
+            for (auto& decl : it->second) {
+                result.push_back(std::move(decl));
+            }
+        }
+        result.push_back(std::move(statements[i]));
+    }
+    statements = std::move(result);
+}
+
+} // namespace Quastra
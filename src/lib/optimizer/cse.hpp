@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ast_rewriter.hpp"
+#include "../frontend/ast.hpp"
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+// Common subexpression elimination within basic blocks. A basic block is a
+// run of `let`, expression and return statements in one statement list;
+// any other statement ends it. Pure expressions (see has_side_effects) are
+// value-numbered with structural hashing, and when one is computed again
+// while its value is still available, both places read a `__cseN` temporary
+// declared in front of the first one instead.
+// A value stops being available when one of its variables is assigned or
+// redeclared, or, after a call, when any function body assigns one of them.
+// The first computation is only moved into a temporary when its statement
+// has no calls or nested assignments, so nothing is evaluated out of order.
+class CommonSubexpressionEliminator : private ASTRewriter {
+public:
+    // Returns the number of computations replaced by a temporary.
+    int run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+private:
+    // One computation of a pure expression in the block being processed.
+    struct Occurrence {
+        std::unique_ptr<AST::Expr>* slot;
+        size_t statement; // Index in the statement list.
+        int value;        // Occurrences with the same value compute the same thing.
+    };
+
+    // A value computed earlier in the block, and the names it reads.
+    struct Available {
+        const AST::Expr* expr;
+        size_t hash;
+        int value;
+        std::set<std::string> names;
+    };
+
+    void rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements) override;
+    void number_expr(std::unique_ptr<AST::Expr>& expr, size_t statement, bool may_hoist);
+    void kill(const std::string& name);
+    void kill_written_by_functions();
+    void eliminate(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    std::set<std::string> written_by_functions;
+    std::vector<Available> available;
+    std::vector<Occurrence> occurrences;
+    std::vector<bool> first; // Per occurrence: computes its value for the first time.
+    int next_value = 0;
+    int next_temp = 0;
+    int replaced = 0;
+};
+
+} // namespace Quastra
@@ -0,0 +1,449 @@
+#include "dead_code.hpp"
+#include "ast_utils.hpp"
+#include <algorithm>
+
+namespace Quastra {
+
+namespace {
+
+// Collects every name an AST fragment reads, including in nested functions.
+class NameCollector : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    explicit NameCollector(std::set<std::string>& names) : names(names) {}
+
+    void collect(const AST::Stmt& stmt) { stmt.accept(*this); }
+
+private:
+    void visit(const AST::VarDecl& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+    }
+    void visit(const AST::ExprStmt& stmt) override { stmt.expression->accept(*this); }
+    void visit(const AST::Block& stmt) override {
+        for (const auto& s : stmt.statements) {
+            if (s) s->accept(*this);
+        }
+    }
+    void visit(const AST::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.then_branch->accept(*this);
+        if (stmt.else_branch) stmt.else_branch->accept(*this);
+    }
+    void visit(const AST::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(const AST::FunctionStmt& stmt) override {
+        for (const auto& s : stmt.body) {
+            if (s) s->accept(*this);
+        }
+    }
+    void visit(const AST::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+
+    void visit(const AST::Literal& expr) override { (void)expr; }
+    void visit(const AST::Unary& expr) override { expr.right->accept(*this); }
+    void visit(const AST::Binary& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(const AST::Variable& expr) override { names.insert(expr.name.lexeme); }
+    void visit(const AST::Assign& expr) override { expr.value->accept(*this); }
+    void visit(const AST::Call& expr) override {
+        expr.callee->accept(*this);
+        for (const auto& argument : expr.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    std::set<std::string>& names;
+};
+
+// Gives every declaration an id and maps each reference to the id it
+// resolves to. Redeclaring a name in the same scope reuses the variable, as
+// the interpreter's Environment::define does. A binding is escaping if a
+// function other than its own refers to it, or if some function refers to
+// its name before it is declared (that lookup happens at runtime).
+class BindingResolver : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    BindingResolver(std::map<const void*, int>& bindings, std::set<int>& escaping)
+        : bindings(bindings), escaping(escaping) {}
+
+    void resolve(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+        scopes.assign(1, {});
+        for (const auto& stmt : statements) {
+            if (stmt) stmt->accept(*this);
+        }
+        for (const auto& [id, name] : names) {
+            if (free_names.count(name)) escaping.insert(id);
+        }
+    }
+
+private:
+    struct Binding {
+        int id;
+        int depth; // Function nesting depth of the declaration.
+    };
+
+    void declare(const std::string& name, const void* node) {
+        auto it = scopes.back().find(name);
+        if (it == scopes.back().end()) {
+            it = scopes.back().emplace(name, Binding{next_id++, depth}).first;
+            names[it->second.id] = name;
+        }
+        bindings[node] = it->second.id;
+    }
+
+    void reference(const std::string& name, const void* node) {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it == scope->end()) continue;
+            bindings[node] = it->second.id;
+            if (it->second.depth != depth) escaping.insert(it->second.id);
+            return;
+        }
+        if (depth > 0) free_names.insert(name);
+    }
+
+    void visit(const AST::VarDecl& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+        declare(stmt.name.lexeme, &stmt);
+    }
+    void visit(const AST::ExprStmt& stmt) override { stmt.expression->accept(*this); }
+    void visit(const AST::Block& stmt) override {
+        scopes.emplace_back();
+        for (const auto& s : stmt.statements) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+    }
+    void visit(const AST::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.then_branch->accept(*this);
+        if (stmt.else_branch) stmt.else_branch->accept(*this);
+    }
+    void visit(const AST::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(const AST::FunctionStmt& stmt) override {
+        declare(stmt.name.lexeme, &stmt);
+        ++depth;
+        scopes.emplace_back();
+        for (const auto& param : stmt.params) {
+            declare(param.lexeme, &param);
+        }
+        for (const auto& s : stmt.body) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+        --depth;
+    }
+    void visit(const AST::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+
+    void visit(const AST::Literal& expr) override { (void)expr; }
+    void visit(const AST::Unary& expr) override { expr.right->accept(*this); }
+    void visit(const AST::Binary& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(const AST::Variable& expr) override { reference(expr.name.lexeme, &expr); }
+    void visit(const AST::Assign& expr) override {
+        expr.value->accept(*this);
+        reference(expr.name.lexeme, &expr);
+    }
+    void visit(const AST::Call& expr) override {
+        expr.callee->accept(*this);
+        for (const auto& argument : expr.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    std::map<const void*, int>& bindings;
+    std::set<int>& escaping;
+    std::vector<std::map<std::string, Binding>> scopes;
+    std::map<int, std::string> names;
+    std::set<std::string> free_names;
+    int next_id = 0;
+    int depth = 0;
+};
+
+bool is_empty_block(const AST::Stmt& stmt) {
+    const auto* block = dynamic_cast<const AST::Block*>(&stmt);
+    return block && block->statements.empty();
+}
+
+std::unique_ptr<AST::Stmt> empty_block() {
+    return std::make_unique<AST::Block>(std::vector<std::unique_ptr<AST::Stmt>>{});
+}
+
+// True if an expression can be dropped without changing what the program does.
+bool is_removable(const AST::Expr& expr) {
+    return !has_side_effects(expr) && !can_fail(expr);
+}
+
+} // namespace
+
+int DeadCodeEliminator::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    bindings.clear();
+    escaping.clear();
+    referenced.clear();
+    function_depth = 0;
+    rewriting = true;
+    removed = 0;
+
+    remove_unreachable_functions(statements);
+    BindingResolver resolver(bindings, escaping);
+    resolver.resolve(statements);
+
+    LiveSet live;
+    sweep_statements(statements, live);
+    return removed;
+}
+
+void DeadCodeEliminator::remove_unreachable_functions(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::multimap<std::string, const AST::FunctionStmt*> functions;
+    std::set<std::string> roots;
+    NameCollector top_level(roots);
+    for (const auto& stmt : statements) {
+        if (auto* function = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            functions.emplace(function->name.lexeme, function);
+        } else if (stmt) {
+            // Top-level code runs before main, so whatever it names is live too.
+            top_level.collect(*stmt);
+        }
+    }
+    // A program without main is a library; any function may be called.
+    if (!functions.count("main")) return;
+
+    std::set<std::string> reached;
+    std::vector<std::string> worklist(roots.begin(), roots.end());
+    worklist.push_back("main");
+    while (!worklist.empty()) {
+        std::string name = worklist.back();
+        worklist.pop_back();
+        if (!functions.count(name) || !reached.insert(name).second) continue;
+
+        std::set<std::string> callees;
+        NameCollector collector(callees);
+        auto range = functions.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it) {
+            collector.collect(*it->second);
+        }
+        worklist.insert(worklist.end(), callees.begin(), callees.end());
+    }
+
+    for (auto& stmt : statements) {
+        auto* function = dynamic_cast<const AST::FunctionStmt*>(stmt.get());
+        if (function && !reached.count(function->name.lexeme)) remove(stmt);
+    }
+    statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+}
+
+void DeadCodeEliminator::remove(std::unique_ptr<AST::Stmt>& stmt) {
+    stmt.reset();
+    ++removed;
+}
+
+int DeadCodeEliminator::binding_of(const void* node) const {
+    auto it = bindings.find(node);
+    return it == bindings.end() ? -1 : it->second;
+}
+
+void DeadCodeEliminator::sweep_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements, LiveSet& live) {
+    size_t end = statements.size();
+    for (size_t i = 0; i < statements.size(); ++i) {
+        if (statements[i] && always_returns(*statements[i])) {
+            end = i + 1;
+            break;
+        }
+    }
+    if (rewriting && end < statements.size()) {
+        removed += static_cast<int>(statements.size() - end);
+        statements.resize(end);
+    }
+
+    for (size_t i = end; i-- > 0;) {
+        sweep_stmt(statements[i], live);
+    }
+    if (rewriting) {
+        statements.erase(std::remove(statements.begin(), statements.end(), nullptr), statements.end());
+    }
+}
+
+void DeadCodeEliminator::sweep_stmt(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live) {
+    if (!stmt) return;
+
+    if (dynamic_cast<AST::ExprStmt*>(stmt.get())) {
+        sweep_expr_stmt(stmt, live);
+    } else if (dynamic_cast<AST::VarDecl*>(stmt.get())) {
+        sweep_var_decl(stmt, live);
+    } else if (auto* block = dynamic_cast<AST::Block*>(stmt.get())) {
+        sweep_statements(block->statements, live);
+        if (rewriting && block->statements.empty()) remove(stmt);
+    } else if (dynamic_cast<AST::IfStmt*>(stmt.get())) {
+        sweep_if(stmt, live);
+    } else if (auto* while_stmt = dynamic_cast<AST::WhileStmt*>(stmt.get())) {
+        sweep_while(*while_stmt, live);
+    } else if (dynamic_cast<AST::FunctionStmt*>(stmt.get())) {
+        sweep_function(stmt);
+    } else if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(stmt.get())) {
+        // Nothing after a return is observed, except through escaping bindings.
+        live.clear();
+        if (return_stmt->value) add_uses(*return_stmt->value, live);
+    }
+}
+
+void DeadCodeEliminator::sweep_expr_stmt(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live) {
+    auto* expr_stmt = static_cast<AST::ExprStmt*>(stmt.get());
+
+    auto* assign = dynamic_cast<AST::Assign*>(expr_stmt->expression.get());
+    if (!assign) {
+        if (is_removable(*expr_stmt->expression)) {
+            if (rewriting) remove(stmt);
+            return;
+        }
+        add_uses(*expr_stmt->expression, live);
+        return;
+    }
+
+    int binding = binding_of(assign);
+    bool dead_store = binding >= 0 && !escaping.count(binding) && !live.count(binding);
+    if (!dead_store) {
+        if (binding >= 0) {
+            live.erase(binding);
+            if (rewriting) referenced.insert(binding);
+        }
+        add_uses(*assign->value, live);
+        return;
+    }
+
+    // The stored value is never read; keep only what computing it does.
+    if (is_removable(*assign->value)) {
+        if (rewriting) remove(stmt);
+        return;
+    }
+    add_uses(*assign->value, live);
+    if (rewriting) {
+        expr_stmt->expression = std::move(assign->value);
+        ++removed;
+    }
+}
+
+void DeadCodeEliminator::sweep_var_decl(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live) {
+    auto* decl = static_cast<AST::VarDecl*>(stmt.get());
+    int binding = binding_of(decl);
+    live.erase(binding);
+
+    // References are only known once everything after the declaration has
+    // been swept for real, so loops being solved keep every declaration.
+    if (rewriting && !escaping.count(binding) && !referenced.count(binding)) {
+        if (!decl->initializer || is_removable(*decl->initializer)) {
+            remove(stmt);
+            return;
+        }
+        stmt = std::make_unique<AST::ExprStmt>(std::move(decl->initializer));
+        ++removed;
+        add_uses(*static_cast<AST::ExprStmt*>(stmt.get())->expression, live);
+        return;
+    }
+    if (decl->initializer) add_uses(*decl->initializer, live);
+}
+
+void DeadCodeEliminator::sweep_if(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live) {
+    auto* if_stmt = static_cast<AST::IfStmt*>(stmt.get());
+
+    LiveSet then_live = live;
+    sweep_stmt(if_stmt->then_branch, then_live);
+    LiveSet else_live = live;
+    if (if_stmt->else_branch) sweep_stmt(if_stmt->else_branch, else_live);
+
+    if (rewriting) {
+        if (!if_stmt->then_branch) if_stmt->then_branch = empty_block();
+        if (!if_stmt->else_branch && is_empty_block(*if_stmt->then_branch) && is_removable(*if_stmt->condition)) {
+            remove(stmt);
+            return;
+        }
+    }
+
+    live = then_live;
+    live.insert(else_live.begin(), else_live.end());
+    add_uses(*if_stmt->condition, live);
+}
+
+void DeadCodeEliminator::sweep_while(AST::WhileStmt& stmt, LiveSet& live) {
+    // Solve liveness at the loop head without rewriting: whatever is live
+    // after the loop or at the top of the body is live at the head. Sets
+    // only grow, so this terminates.
+    LiveSet exit = live;
+    LiveSet head = exit;
+    bool saved_rewriting = rewriting;
+    rewriting = false;
+    add_uses(*stmt.condition, head);
+    while (true) {
+        LiveSet body = head;
+        sweep_stmt(stmt.body, body);
+        LiveSet next = exit;
+        next.insert(body.begin(), body.end());
+        add_uses(*stmt.condition, next);
+        if (next == head) break;
+        head = next;
+    }
+    rewriting = saved_rewriting;
+
+    // Now rewrite the body under the fixed point.
+    LiveSet body = head;
+    sweep_stmt(stmt.body, body);
+    if (!stmt.body) stmt.body = empty_block();
+    live = head;
+    add_uses(*stmt.condition, live);
+}
+
+void DeadCodeEliminator::sweep_function(std::unique_ptr<AST::Stmt>& stmt) {
+    auto* function = static_cast<AST::FunctionStmt*>(stmt.get());
+
+    // Top-level functions are kept or dropped by the call graph instead.
+    if (rewriting && function_depth > 0) {
+        int binding = binding_of(function);
+        if (!escaping.count(binding) && !referenced.count(binding)) {
+            remove(stmt);
+            return;
+        }
+    }
+
+    ++function_depth;
+    LiveSet live;
+    sweep_statements(function->body, live);
+    --function_depth;
+}
+
+void DeadCodeEliminator::add_uses(const AST::Expr& expr, LiveSet& live) {
+    if (const auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        int binding = binding_of(variable);
+        if (binding < 0) return;
+        live.insert(binding);
+        if (rewriting) referenced.insert(binding);
+    } else if (const auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        // A store nested in an expression is kept, so it needs its variable.
+        int binding = binding_of(assign);
+        if (binding >= 0) {
+            live.insert(binding);
+            if (rewriting) referenced.insert(binding);
+        }
+        add_uses(*assign->value, live);
+    } else if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        add_uses(*unary->right, live);
+    } else if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        add_uses(*binary->left, live);
+        add_uses(*binary->right, live);
+    } else if (const auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        add_uses(*call->callee, live);
+        for (const auto& argument : call->arguments) {
+            add_uses(*argument, live);
+        }
+    }
+}
+
+} // namespace Quastra
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+// Removes code whose result is never observed:
+//  - statements after a `return`,
+//  - stores to a variable that is not live afterwards, and `let` bindings
+//    that end up with no references, when their value has no side effect,
+//  - top-level functions that cannot be reached from `main` in the call graph.
+// The work is a backward liveness sweep over the statement lists. Variables
+// that a nested function reads or writes are left alone, since a call can
+// observe them at any time. An expression that may fail at runtime (see
+// can_fail) is kept, so removing code never hides an error.
+class DeadCodeEliminator {
+public:
+    // Returns the number of statements and functions removed.
+    int run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+private:
+    using LiveSet = std::set<int>;
+
+    void remove_unreachable_functions(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    void sweep_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements, LiveSet& live);
+    void sweep_stmt(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live);
+    void sweep_expr_stmt(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live);
+    void sweep_var_decl(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live);
+    void sweep_if(std::unique_ptr<AST::Stmt>& stmt, LiveSet& live);
+    void sweep_while(AST::WhileStmt& stmt, LiveSet& live);
+    void sweep_function(std::unique_ptr<AST::Stmt>& stmt);
+
+    // Adds the variables an expression reads (or assigns, when nested) to
+    // the live set.
+    void add_uses(const AST::Expr& expr, LiveSet& live);
+    int binding_of(const void* node) const;
+    void remove(std::unique_ptr<AST::Stmt>& stmt);
+
+    std::map<const void*, int> bindings; // Declaration or reference -> binding id.
+    std::set<int> escaping;              // Bindings visible to a nested function.
+    std::set<int> referenced;            // Bindings with a reference in kept code.
+    int function_depth = 0;
+    bool rewriting = true; // False while a loop is being solved.
+    int removed = 0;
+};
+
+} // namespace Quastra
@@ -0,0 +1,655 @@
+#include "inliner.hpp"
+#include "ast_rewriter.hpp"
+#include "ast_utils.hpp"
+#include <functional>
+#include <iterator>
+#include <sstream>
+
+namespace Quastra {
+
+namespace {
+
+// Summarizes how a function (or the top-level code) uses names.
+class NameSummary : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    std::set<std::string> free_names;  // Used but not declared inside.
+    std::set<std::string> free_calls;  // Free names called directly.
+    std::set<std::string> assigned;    // Every assignment target, free or not.
+    bool free_assignment = false;      // Assigns a name it does not declare.
+    bool indirect_call = false;        // Calls a local or a computed value.
+    bool nested_function = false;
+
+    void summarize(const std::vector<Token>& params, const std::vector<std::unique_ptr<AST::Stmt>>& body) {
+        scopes.emplace_back();
+        for (const auto& param : params) {
+            scopes.back().insert(param.lexeme);
+        }
+        for (const auto& stmt : body) {
+            if (stmt) stmt->accept(*this);
+        }
+        scopes.pop_back();
+    }
+
+private:
+    bool is_declared(const std::string& name) const {
+        for (const auto& scope : scopes) {
+            if (scope.count(name)) return true;
+        }
+        return false;
+    }
+
+    void visit(const AST::VarDecl& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+        scopes.back().insert(stmt.name.lexeme);
+    }
+    void visit(const AST::ExprStmt& stmt) override { stmt.expression->accept(*this); }
+    void visit(const AST::Block& stmt) override {
+        scopes.emplace_back();
+        for (const auto& s : stmt.statements) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+    }
+    void visit(const AST::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.then_branch->accept(*this);
+        if (stmt.else_branch) stmt.else_branch->accept(*this);
+    }
+    void visit(const AST::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    void visit(const AST::FunctionStmt& stmt) override {
+        nested_function = true;
+        scopes.back().insert(stmt.name.lexeme);
+        summarize(stmt.params, stmt.body);
+    }
+    void visit(const AST::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+
+    void visit(const AST::Literal& expr) override { (void)expr; }
+    void visit(const AST::Unary& expr) override { expr.right->accept(*this); }
+    void visit(const AST::Binary& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(const AST::Variable& expr) override {
+        if (!is_declared(expr.name.lexeme)) free_names.insert(expr.name.lexeme);
+    }
+    void visit(const AST::Assign& expr) override {
+        expr.value->accept(*this);
+        assigned.insert(expr.name.lexeme);
+        if (!is_declared(expr.name.lexeme)) {
+            free_names.insert(expr.name.lexeme);
+            free_assignment = true;
+        }
+    }
+    void visit(const AST::Call& expr) override {
+        const auto* callee = dynamic_cast<const AST::Variable*>(expr.callee.get());
+        if (callee && !is_declared(callee->name.lexeme)) {
+            free_calls.insert(callee->name.lexeme);
+        } else {
+            indirect_call = true;
+        }
+        expr.callee->accept(*this);
+        for (const auto& argument : expr.arguments) {
+            argument->accept(*this);
+        }
+    }
+
+    std::vector<std::set<std::string>> scopes;
+};
+
+// Gives the locals of an inlined body fresh names, so they cannot clash with
+// or capture the caller's variables. Names the body does not declare are
+// left alone.
+class Renamer : public ASTRewriter {
+public:
+    explicit Renamer(std::string prefix) : prefix(std::move(prefix)) { scopes.emplace_back(); }
+
+    std::string bind(const std::string& name) {
+        std::string fresh = prefix + name;
+        for (int n = 1; used.count(fresh); ++n) {
+            fresh = prefix + name + "_" + std::to_string(n);
+        }
+        used.insert(fresh);
+        scopes.back()[name] = fresh;
+        return fresh;
+    }
+
+    void rename(std::vector<std::unique_ptr<AST::Stmt>>& statements) { rewrite_statements(statements); }
+
+private:
+    void rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) override {
+        if (auto* decl = dynamic_cast<AST::VarDecl*>(stmt.get())) {
+            if (decl->initializer) rewrite_expr(decl->initializer);
+            decl->name.lexeme = bind(decl->name.lexeme);
+            return;
+        }
+        ASTRewriter::rewrite_stmt(stmt);
+    }
+
+    void rewrite_expr(std::unique_ptr<AST::Expr>& expr) override {
+        ASTRewriter::rewrite_expr(expr);
+        if (auto* variable = dynamic_cast<AST::Variable*>(expr.get())) {
+            variable->name.lexeme = lookup(variable->name.lexeme);
+        } else if (auto* assign = dynamic_cast<AST::Assign*>(expr.get())) {
+            assign->name.lexeme = lookup(assign->name.lexeme);
+        }
+    }
+
+    void begin_scope() override { scopes.emplace_back(); }
+    void end_scope() override { scopes.pop_back(); }
+
+    std::string lookup(const std::string& name) const {
+        for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+            auto it = scope->find(name);
+            if (it != scope->end()) return it->second;
+        }
+        return name;
+    }
+
+    std::string prefix;
+    std::set<std::string> used;
+    std::vector<std::map<std::string, std::string>> scopes;
+};
+
+std::vector<std::unique_ptr<AST::Stmt>> take_statements(std::unique_ptr<AST::Stmt>& stmt) {
+    std::vector<std::unique_ptr<AST::Stmt>> statements;
+    if (!stmt) return statements;
+    if (auto* block = dynamic_cast<AST::Block*>(stmt.get())) {
+        statements = std::move(block->statements);
+    } else {
+        statements.push_back(std::move(stmt));
+    }
+    stmt.reset();
+    return statements;
+}
+
+bool always_returns_list(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& stmt : statements) {
+        if (stmt && always_returns(*stmt)) return true;
+    }
+    return false;
+}
+
+std::unique_ptr<AST::Expr> make_assign(const std::string& name, std::unique_ptr<AST::Expr> value, int line) {
+    if (!value) value = make_literal(QuastraValue(false), line); // What falling off a function returns.
+    return std::make_unique<AST::Assign>(Token{TokenType::Identifier, name, line}, std::move(value));
+}
+
+// Rewrites a body so that it has no `return`: each return becomes an
+// assignment to 'result' and the statements after an `if` that may return
+// move into the branch that falls through. Returns false if that is not
+// possible without duplicating code, or if a loop contains a return.
+bool normalize_returns(std::vector<std::unique_ptr<AST::Stmt>>& statements, const std::string& result) {
+    for (size_t i = 0; i < statements.size(); ++i) {
+        if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(statements[i].get())) {
+            int line = return_stmt->keyword.line;
+            statements[i] = std::make_unique<AST::ExprStmt>(make_assign(result, std::move(return_stmt->value), line));
+            statements.resize(i + 1);
+            return true;
+        }
+        if (!statements[i] || !contains_return(*statements[i])) continue;
+
+        std::vector<std::unique_ptr<AST::Stmt>> rest(std::make_move_iterator(statements.begin() + i + 1),
+                                                     std::make_move_iterator(statements.end()));
+        statements.resize(i + 1);
+
+        if (auto* block = dynamic_cast<AST::Block*>(statements[i].get())) {
+            // The body's names are unique after renaming, so moving statements
+            // into the block cannot change what they refer to.
+            std::move(rest.begin(), rest.end(), std::back_inserter(block->statements));
+            return normalize_returns(block->statements, result);
+        }
+        auto* if_stmt = dynamic_cast<AST::IfStmt*>(statements[i].get());
+        if (!if_stmt) return false;
+
+        auto then_statements = take_statements(if_stmt->then_branch);
+        auto else_statements = take_statements(if_stmt->else_branch);
+        bool then_returns = always_returns_list(then_statements);
+        bool else_returns = always_returns_list(else_statements);
+        if (!rest.empty() && !(then_returns && else_returns)) {
+            if (then_returns) {
+                std::move(rest.begin(), rest.end(), std::back_inserter(else_statements));
+            } else if (else_returns) {
+                std::move(rest.begin(), rest.end(), std::back_inserter(then_statements));
+            } else {
+                return false;
+            }
+        }
+        if (!normalize_returns(then_statements, result) || !normalize_returns(else_statements, result)) return false;
+        if_stmt->then_branch = std::make_unique<AST::Block>(std::move(then_statements));
+        if (!else_statements.empty()) if_stmt->else_branch = std::make_unique<AST::Block>(std::move(else_statements));
+        return true;
+    }
+    return true;
+}
+
+// True if the only return is the body's last statement.
+bool is_single_exit(const std::vector<std::unique_ptr<AST::Stmt>>& body) {
+    for (size_t i = 0; i < body.size(); ++i) {
+        if (!body[i] || !contains_return(*body[i])) continue;
+        return i + 1 == body.size() && dynamic_cast<const AST::ReturnStmt*>(body[i].get());
+    }
+    return true;
+}
+
+// What a returned value is in the generated C++, as far as the expression
+// alone tells.
+enum class ValueKind { Unknown, Number, Bool };
+
+ValueKind kind_of(const AST::Expr& expr) {
+    if (const auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        switch (literal->value.type) {
+            case TokenType::IntLiteral: return ValueKind::Number;
+            case TokenType::True:
+            case TokenType::False: return ValueKind::Bool;
+            default: return ValueKind::Unknown;
+        }
+    }
+    if (const auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        if (unary->op.type == TokenType::Minus) return ValueKind::Number;
+        if (unary->op.type == TokenType::Bang) return ValueKind::Bool;
+        return ValueKind::Unknown;
+    }
+    if (const auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        switch (binary->op.type) {
+            case TokenType::Plus: // Also joins strings.
+                return kind_of(*binary->left) == ValueKind::Number && kind_of(*binary->right) == ValueKind::Number
+                           ? ValueKind::Number
+                           : ValueKind::Unknown;
+            case TokenType::Minus:
+            case TokenType::Star:
+            case TokenType::Slash: return ValueKind::Number;
+            default: return ValueKind::Bool; // Comparisons.
+        }
+    }
+    return ValueKind::Unknown;
+}
+
+// Adds the kind of every value `stmt` returns. A bare `return` gives false.
+void collect_return_kinds(const AST::Stmt& stmt, std::set<ValueKind>& kinds) {
+    if (const auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        kinds.insert(return_stmt->value ? kind_of(*return_stmt->value) : ValueKind::Bool);
+    } else if (const auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s) collect_return_kinds(*s, kinds);
+        }
+    } else if (const auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        collect_return_kinds(*if_stmt->then_branch, kinds);
+        if (if_stmt->else_branch) collect_return_kinds(*if_stmt->else_branch, kinds);
+    } else if (const auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        collect_return_kinds(*while_stmt->body, kinds);
+    }
+}
+
+// The one kind of value a body with several returns gives, counting the
+// false of falling off its end, or Unknown. The inlined result variable is
+// declared before the body runs, and in the generated C++ its initial value
+// fixes its type, so that has to be known.
+ValueKind result_kind(const std::vector<std::unique_ptr<AST::Stmt>>& body) {
+    std::set<ValueKind> kinds;
+    for (const auto& stmt : body) {
+        if (stmt) collect_return_kinds(*stmt, kinds);
+    }
+    if (!always_returns_list(body)) kinds.insert(ValueKind::Bool);
+    return kinds.size() == 1 ? *kinds.begin() : ValueKind::Unknown;
+}
+
+} // namespace
+
+int Inliner::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    decisions.clear();
+    inlined = 0;
+    next_instance = 0;
+    budget_left = options.budget;
+    analyze(statements);
+
+    for (bool loops : {true, false}) {
+        loops_only = loops;
+        for (AST::FunctionStmt* function : bottom_up) {
+            caller = function->name.lexeme;
+            in_function = true;
+            scopes.assign(2, {});
+            for (const auto& param : function->params) {
+                scopes.back().insert(param.lexeme);
+            }
+            inline_statements(function->body, 0);
+        }
+        caller = "<top level>";
+        in_function = false;
+        scopes.assign(1, {});
+        defined.clear();
+        inline_statements(statements, 0);
+    }
+    return inlined;
+}
+
+void Inliner::analyze(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    callees.clear();
+    bottom_up.clear();
+
+    std::multimap<std::string, AST::FunctionStmt*> functions;
+    std::set<std::string> top_level_lets;
+    for (auto& stmt : statements) {
+        if (auto* function = dynamic_cast<AST::FunctionStmt*>(stmt.get())) {
+            functions.emplace(function->name.lexeme, function);
+        } else if (auto* decl = dynamic_cast<AST::VarDecl*>(stmt.get())) {
+            top_level_lets.insert(decl->name.lexeme);
+        }
+    }
+    NameSummary program;
+    program.summarize({}, statements);
+
+    // Only a function that is defined once and never reassigned is known to
+    // be what a call by its name reaches.
+    std::set<std::string> stable;
+    for (const auto& [name, function] : functions) {
+        if (functions.count(name) == 1 && !top_level_lets.count(name) && !program.assigned.count(name)) {
+            stable.insert(name);
+        }
+    }
+
+    for (const auto& [name, function] : functions) {
+        if (!stable.count(name)) continue;
+        NameSummary summary;
+        summary.summarize(function->params, function->body);
+
+        Callee& callee = callees[name];
+        callee.function = function;
+        callee.free_names = summary.free_names;
+        for (const auto& used : summary.free_names) {
+            if (functions.count(used)) callee.calls.insert(used);
+        }
+        callee.writes_state = summary.free_assignment || summary.indirect_call;
+        for (const auto& called : summary.free_calls) {
+            // Calls to names that are not top-level functions reach natives,
+            // which cannot assign Quastra variables, unless a let holds them.
+            if (top_level_lets.count(called) || (functions.count(called) && !stable.count(called))) {
+                callee.writes_state = true;
+            }
+        }
+        if (function->is_async) {
+            callee.unsupported = "is async";
+        } else if (summary.nested_function) {
+            callee.unsupported = "declares a nested function";
+        } else if (contains_tasks(function->body)) {
+            callee.unsupported = "spawns tasks";
+        } else {
+            std::vector<std::unique_ptr<AST::Stmt>> copy;
+            for (const auto& stmt : function->body) {
+                if (stmt) copy.push_back(clone(*stmt));
+            }
+            if (!is_single_exit(copy) && result_kind(copy) == ValueKind::Unknown) {
+                callee.unsupported = "returns values of different or unknown types";
+            } else if (!normalize_returns(copy, "result")) {
+                callee.unsupported = "returns from a loop or an unsupported shape";
+            }
+        }
+    }
+
+    // Propagate writes_state through direct calls, and find recursion.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto& [name, callee] : callees) {
+            if (callee.writes_state) continue;
+            for (const auto& called : callee.calls) {
+                auto it = callees.find(called);
+                if (it != callees.end() && it->second.writes_state) {
+                    callee.writes_state = true;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    for (auto& [name, callee] : callees) {
+        std::set<std::string> seen;
+        std::vector<std::string> worklist(callee.calls.begin(), callee.calls.end());
+        while (!worklist.empty() && !callee.recursive) {
+            std::string next = worklist.back();
+            worklist.pop_back();
+            if (next == name) callee.recursive = true;
+            if (!seen.insert(next).second) continue;
+            auto it = callees.find(next);
+            if (it != callees.end()) worklist.insert(worklist.end(), it->second.calls.begin(), it->second.calls.end());
+        }
+        // A function that is not a callee (redefined, say) may call anything.
+        for (const auto& called : callee.calls) {
+            if (!callees.count(called)) callee.recursive = true;
+        }
+    }
+
+    // Order functions so that callees are processed before their callers,
+    // which lets an inlined body carry its own inlined calls along.
+    std::set<const AST::FunctionStmt*> visited;
+    std::function<void(AST::FunctionStmt*)> visit = [&](AST::FunctionStmt* function) {
+        if (!visited.insert(function).second) return;
+        auto it = callees.find(function->name.lexeme);
+        if (it != callees.end() && it->second.function == function) {
+            for (const auto& called : it->second.calls) {
+                auto range = functions.equal_range(called);
+                for (auto f = range.first; f != range.second; ++f) {
+                    visit(f->second);
+                }
+            }
+        }
+        bottom_up.push_back(function);
+    };
+    for (const auto& [name, function] : functions) {
+        visit(function);
+    }
+}
+
+bool Inliner::is_local(const std::string& name) const {
+    // scopes[0] is the global scope, shared by caller and callee alike.
+    for (size_t i = scopes.size(); i-- > 1;) {
+        if (scopes[i].count(name)) return true;
+    }
+    return false;
+}
+
+void Inliner::inline_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements, int loop_depth) {
+    for (size_t i = 0; i < statements.size(); ++i) {
+        if (!statements[i]) continue;
+        // A statement may make several calls; each one inlined leaves the
+        // next one first in evaluation order.
+        auto expansion = try_inline(*statements[i], loop_depth);
+        while (!expansion.empty()) {
+            size_t count = expansion.size();
+            statements.insert(statements.begin() + i, std::make_move_iterator(expansion.begin()),
+                              std::make_move_iterator(expansion.end()));
+            i += count;
+            expansion = try_inline(*statements[i], loop_depth);
+        }
+        inline_nested(*statements[i], loop_depth);
+    }
+}
+
+void Inliner::inline_nested(AST::Stmt& stmt, int loop_depth) {
+    if (auto* decl = dynamic_cast<AST::VarDecl*>(&stmt)) {
+        scopes.back().insert(decl->name.lexeme);
+    } else if (auto* block = dynamic_cast<AST::Block*>(&stmt)) {
+        scopes.emplace_back();
+        inline_statements(block->statements, loop_depth);
+        scopes.pop_back();
+    } else if (auto* if_stmt = dynamic_cast<AST::IfStmt*>(&stmt)) {
+        inline_nested(*if_stmt->then_branch, loop_depth);
+        if (if_stmt->else_branch) inline_nested(*if_stmt->else_branch, loop_depth);
+    } else if (auto* while_stmt = dynamic_cast<AST::WhileStmt*>(&stmt)) {
+        // The condition runs on every iteration, so there is no single place
+        // in front of it where a call could be spliced.
+        inline_nested(*while_stmt->body, loop_depth + 1);
+    } else if (auto* function = dynamic_cast<AST::FunctionStmt*>(&stmt)) {
+        if (!in_function && scopes.size() == 1) {
+            defined.insert(function->name.lexeme);
+            return; // Top-level functions are handled on their own.
+        }
+        scopes.back().insert(function->name.lexeme);
+        std::string saved_caller = caller;
+        bool saved_in_function = in_function;
+        caller = function->name.lexeme;
+        in_function = true;
+        scopes.emplace_back();
+        for (const auto& param : function->params) {
+            scopes.back().insert(param.lexeme);
+        }
+        inline_statements(function->body, 0);
+        scopes.pop_back();
+        caller = saved_caller;
+        in_function = saved_in_function;
+    }
+}
+
+std::vector<std::unique_ptr<AST::Stmt>> Inliner::try_inline(AST::Stmt& stmt, int loop_depth) {
+    if (loops_only != (loop_depth > 0)) return {};
+
+    std::unique_ptr<AST::Expr>* root = nullptr;
+    if (auto* decl = dynamic_cast<AST::VarDecl*>(&stmt)) {
+        if (decl->initializer) root = &decl->initializer;
+    } else if (auto* expr_stmt = dynamic_cast<AST::ExprStmt*>(&stmt)) {
+        root = &expr_stmt->expression;
+    } else if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(&stmt)) {
+        if (return_stmt->value) root = &return_stmt->value;
+    } else if (auto* if_stmt = dynamic_cast<AST::IfStmt*>(&stmt)) {
+        root = &if_stmt->condition;
+    }
+    if (!root) return {};
+
+    bool saw_effect = false;
+    bool saw_global_read = false;
+    std::unique_ptr<AST::Expr>* site = find_site(*root, saw_effect, saw_global_read);
+    if (!site) return {};
+
+    const auto& call = static_cast<const AST::Call&>(**site);
+    const std::string& name = static_cast<const AST::Variable&>(*call.callee).name.lexeme;
+    const Callee& callee = callees.at(name);
+    std::string reason = reject_reason(call, callee, loop_depth, saw_effect, saw_global_read);
+    if (!reason.empty()) {
+        record(call, name, false, reason);
+        return {};
+    }
+
+    size_t size = count_nodes(callee.function->body);
+    record(call, name, true, "size " + std::to_string(size));
+    budget_left -= size;
+    ++inlined;
+    return expand(*site, callee);
+}
+
+// Finds the first call, in evaluation order, to a function that might be
+// inlined. Also reports whether anything evaluated before it had an effect,
+// or read a variable the callee could change.
+std::unique_ptr<AST::Expr>* Inliner::find_site(std::unique_ptr<AST::Expr>& expr, bool& saw_effect, bool& saw_global_read) {
+    if (auto* variable = dynamic_cast<AST::Variable*>(expr.get())) {
+        if (!is_local(variable->name.lexeme)) saw_global_read = true;
+    } else if (auto* unary = dynamic_cast<AST::Unary*>(expr.get())) {
+        if (auto* site = find_site(unary->right, saw_effect, saw_global_read)) return site;
+        if (unary->op.type == TokenType::Await) saw_effect = true;
+    } else if (auto* binary = dynamic_cast<AST::Binary*>(expr.get())) {
+        if (auto* site = find_site(binary->left, saw_effect, saw_global_read)) return site;
+        return find_site(binary->right, saw_effect, saw_global_read);
+    } else if (auto* assign = dynamic_cast<AST::Assign*>(expr.get())) {
+        if (auto* site = find_site(assign->value, saw_effect, saw_global_read)) return site;
+        saw_effect = true;
+    } else if (auto* call = dynamic_cast<AST::Call*>(expr.get())) {
+        // Function names are stable, so reading the callee is not a hazard.
+        auto* callee = dynamic_cast<AST::Variable*>(call->callee.get());
+        if (!callee) {
+            if (auto* site = find_site(call->callee, saw_effect, saw_global_read)) return site;
+        }
+        for (auto& argument : call->arguments) {
+            if (auto* site = find_site(argument, saw_effect, saw_global_read)) return site;
+        }
+        if (callee && callees.count(callee->name.lexeme) && !is_local(callee->name.lexeme) &&
+            (in_function || defined.count(callee->name.lexeme))) {
+            return &expr;
+        }
+        saw_effect = true;
+    }
+    return nullptr;
+}
+
+std::string Inliner::reject_reason(const AST::Call& call, const Callee& callee, int loop_depth,
+                                   bool saw_effect, bool saw_global_read) const {
+    if (callee.recursive) return "recursive";
+    if (!callee.unsupported.empty()) return callee.unsupported;
+    if (call.arguments.size() != callee.function->params.size()) return "wrong number of arguments";
+
+    size_t size = count_nodes(callee.function->body);
+    size_t limit = options.max_callee_size * (loop_depth > 0 ? 2 : 1);
+    if (size > limit) return "too large (size " + std::to_string(size) + ", limit " + std::to_string(limit) + ")";
+
+    if (saw_effect || (saw_global_read && callee.writes_state)) return "would change evaluation order";
+    for (const auto& name : callee.free_names) {
+        if (is_local(name)) return "'" + name + "' is shadowed at the call site";
+    }
+    if (size > budget_left) return "budget exhausted";
+    return "";
+}
+
+std::vector<std::unique_ptr<AST::Stmt>> Inliner::expand(std::unique_ptr<AST::Expr>& site, const Callee& callee) {
+    auto& call = static_cast<AST::Call&>(*site);
+    int line = call.paren.line;
+    Renamer renamer("__inl" + std::to_string(next_instance++) + "_");
+
+    // Arguments are evaluated in order into the renamed parameters.
+    std::vector<std::unique_ptr<AST::Stmt>> expansion;
+    const auto& params = callee.function->params;
+    for (size_t i = 0; i < params.size(); ++i) {
+        Token name{TokenType::Identifier, renamer.bind(params[i].lexeme), line};
+        expansion.push_back(std::make_unique<AST::VarDecl>(name, std::move(call.arguments[i]), true));
+    }
+
+    std::vector<std::unique_ptr<AST::Stmt>> body;
+    for (const auto& stmt : callee.function->body) {
+        if (stmt) body.push_back(clone(*stmt));
+    }
+    renamer.rename(body);
+    Token result{TokenType::Identifier, renamer.bind("result"), line};
+
+    if (is_single_exit(body)) {
+        std::unique_ptr<AST::Expr> value;
+        if (!body.empty()) {
+            if (auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(body.back().get())) {
+                value = std::move(return_stmt->value);
+                body.pop_back();
+            }
+        }
+        if (!value) value = make_literal(QuastraValue(false), line);
+        body.push_back(std::make_unique<AST::VarDecl>(result, std::move(value), false));
+    } else {
+        // The initial value gives the variable its type in the generated
+        // C++, and is only read when the body can fall off its end, in which
+        // case the kind is Bool and the value false.
+        bool number = result_kind(body) == ValueKind::Number;
+        normalize_returns(body, result.lexeme);
+        auto initial = make_literal(number ? QuastraValue(0.0) : QuastraValue(false), line);
+        expansion.push_back(std::make_unique<AST::VarDecl>(result, std::move(initial), true));
+    }
+    std::move(body.begin(), body.end(), std::back_inserter(expansion));
+
+    site = std::make_unique<AST::Variable>(result);
+    return expansion;
+}
+
+void Inliner::record(const AST::Call& call, const std::string& callee, bool was_inlined, const std::string& reason) {
+    decisions.push_back({caller, callee, call.paren.line, was_inlined, reason});
+}
+
+std::string Inliner::report() const {
+    std::ostringstream out;
+    for (const auto& decision : decisions) {
+        out << decision.caller << ":" << decision.line << ": ";
+        if (decision.inlined) {
+            out << "inlined " << decision.callee << " (" << decision.reason << ")\n";
+        } else {
+            out << "did not inline " << decision.callee << ": " << decision.reason << "\n";
+        }
+    }
+    return out.str();
+}
+
+} // namespace Quastra
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+// Limits for the inliner's cost model. Sizes are in AST nodes.
+struct InlineOptions {
+    size_t max_callee_size = 40; // Largest body inlined; doubled for calls inside loops.
+    size_t budget = 400;         // Total growth allowed for the whole program.
+};
+
+// Why a call site was or was not inlined, for the --inline-report output.
+struct InlineDecision {
+    std::string caller; // The enclosing function, or "<top level>".
+    std::string callee;
+    int line;
+    bool inlined;
+    std::string reason;
+};
+
+// Replaces direct calls to small, non-recursive top-level functions with a
+// copy of their body. The copy's locals and parameters are renamed to fresh
+// `__inlN_` names, and a body with several returns is rewritten to assign a
+// single result variable, so the call can be spliced into the statement list
+// in front of the statement that made it. Calls inside loops are inlined
+// first, since that is where the call overhead is paid most often.
+// A call is skipped, with the reason recorded, when moving it in front of its
+// statement could change evaluation order, when a name the callee uses is
+// shadowed at the call site, or when it does not fit the cost model.
+class Inliner {
+public:
+    explicit Inliner(InlineOptions options = {}) : options(options) {}
+
+    // Returns the number of call sites inlined.
+    int run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    const std::vector<InlineDecision>& get_decisions() const { return decisions; }
+
+    // One line per decision, e.g. "main:12: inlined square (size 7)".
+    std::string report() const;
+
+private:
+    // What the inliner knows about a top-level function.
+    struct Callee {
+        AST::FunctionStmt* function = nullptr;
+        std::set<std::string> free_names; // Names it uses but does not declare.
+        std::set<std::string> calls;      // Top-level functions it may call.
+        bool writes_state = false;        // May assign a variable it does not own.
+        bool recursive = false;
+        std::string unsupported;          // Non-empty if the body cannot be inlined.
+    };
+
+    void analyze(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    void inline_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements, int loop_depth);
+    void inline_nested(AST::Stmt& stmt, int loop_depth);
+    std::vector<std::unique_ptr<AST::Stmt>> try_inline(AST::Stmt& stmt, int loop_depth);
+    std::unique_ptr<AST::Expr>* find_site(std::unique_ptr<AST::Expr>& expr, bool& saw_effect, bool& saw_global_read);
+    std::string reject_reason(const AST::Call& call, const Callee& callee, int loop_depth,
+                              bool saw_effect, bool saw_global_read) const;
+    std::vector<std::unique_ptr<AST::Stmt>> expand(std::unique_ptr<AST::Expr>& site, const Callee& callee);
+
+    bool is_local(const std::string& name) const;
+    void record(const AST::Call& call, const std::string& callee, bool inlined, const std::string& reason);
+
+    InlineOptions options;
+    size_t budget_left = 0;
+    std::map<std::string, Callee> callees;
+    std::vector<AST::FunctionStmt*> bottom_up; // Callees before their callers.
+    std::vector<std::set<std::string>> scopes; // Names declared by the current caller.
+    std::set<std::string> defined; // Top-level functions defined so far, at top level.
+    std::string caller;
+    bool in_function = false;
+    bool loops_only = true; // The first round only inlines calls inside loops.
+    int next_instance = 0;
+    int inlined = 0;
+    std::vector<InlineDecision> decisions;
+};
+
+} // namespace Quastra
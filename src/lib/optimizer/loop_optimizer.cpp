@@ -0,0 +1,321 @@
+#include "loop_optimizer.hpp"
+#include "ast_utils.hpp"
+#include "../frontend/ast_hash.hpp"
+#include <optional>
+
+namespace Quastra {
+
+namespace {
+
+// The value of an integer literal such as `3` or `-3`.
+std::optional<long long> integer_literal(const AST::Expr& expr) {
+    auto value = literal_value(expr);
+    if (!value || !std::holds_alternative<double>(*value) || !has_literal_form(*value)) return std::nullopt;
+    return static_cast<long long>(std::get<double>(*value));
+}
+
+// True if `expr` is `name * k` or `k * name`; sets `factor` to k.
+bool is_product_of(const AST::Expr& expr, const std::string& name, long long& factor) {
+    auto* binary = dynamic_cast<const AST::Binary*>(&expr);
+    if (!binary || binary->op.type != TokenType::Star) return false;
+    for (auto [variable, constant] : {std::make_pair(binary->left.get(), binary->right.get()),
+                                      std::make_pair(binary->right.get(), binary->left.get())}) {
+        auto* var = dynamic_cast<const AST::Variable*>(variable);
+        auto k = integer_literal(*constant);
+        if (var && var->name.lexeme == name && k) {
+            factor = *k;
+            return true;
+        }
+    }
+    return false;
+}
+
+int line_of(const AST::Expr& expr) {
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) return binary->op.line;
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) return unary->op.line;
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) return variable->name.line;
+    if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) return literal->value.line;
+    return 0;
+}
+
+// Finds the factors `name` is multiplied by in a loop, or replaces the
+// products with a variable. Nested functions are left alone.
+class ProductRewriter : public ASTRewriter {
+public:
+    ProductRewriter(std::string name, std::set<long long>& factors)
+        : name(std::move(name)), factors(factors) {}
+    ProductRewriter(std::string name, std::set<long long>& factors, long long factor, std::string temp)
+        : name(std::move(name)), factors(factors), factor(factor), temp(std::move(temp)) {}
+
+    void rewrite_loop(AST::WhileStmt& loop) {
+        rewrite_expr(loop.condition);
+        rewrite_stmt(loop.body);
+    }
+
+    int replaced = 0;
+
+protected:
+    void rewrite_stmt(std::unique_ptr<AST::Stmt>& stmt) override {
+        if (dynamic_cast<AST::FunctionStmt*>(stmt.get())) return;
+        ASTRewriter::rewrite_stmt(stmt);
+    }
+
+    void rewrite_expr(std::unique_ptr<AST::Expr>& expr) override {
+        long long k = 0;
+        if (expr && is_product_of(*expr, name, k)) {
+            if (temp.empty()) {
+                factors.insert(k);
+            } else if (k == factor) {
+                expr = std::make_unique<AST::Variable>(Token{TokenType::Identifier, temp, line_of(*expr)});
+                replaced++;
+            }
+            return;
+        }
+        ASTRewriter::rewrite_expr(expr);
+    }
+
+private:
+    std::string name;
+    std::set<long long>& factors;
+    long long factor = 0;
+    std::string temp; // Empty while only collecting factors.
+};
+
+} // namespace
+
+int LoopOptimizer::run(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    written_by_functions = names_written_by_functions(statements);
+    optimized = 0;
+    rewrite(statements);
+    return optimized;
+}
+
+void LoopOptimizer::scan(const AST::Stmt& stmt, LoopScan& result) {
+    if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        result.declared.insert(decl->name.lexeme);
+        if (decl->initializer) scan(*decl->initializer, result);
+    } else if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        scan(*expr_stmt->expression, result);
+    } else if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& s : block->statements) {
+            if (s) scan(*s, result);
+        }
+    } else if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        scan(*if_stmt->condition, result);
+        scan(*if_stmt->then_branch, result);
+        if (if_stmt->else_branch) scan(*if_stmt->else_branch, result);
+    } else if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        scan(*while_stmt->condition, result);
+        scan(*while_stmt->body, result);
+    } else if (auto* function = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        result.declared.insert(function->name.lexeme);
+    } else if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        if (return_stmt->value) scan(*return_stmt->value, result);
+    }
+}
+
+void LoopOptimizer::scan(const AST::Expr& expr, LoopScan& result) {
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        result.assignments[assign->name.lexeme]++;
+        scan(*assign->value, result);
+    } else if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        // Functions run by other fibers may write variables while it waits.
+        if (unary->op.type == TokenType::Await) result.has_call = true;
+        scan(*unary->right, result);
+    } else if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        scan(*binary->left, result);
+        scan(*binary->right, result);
+    } else if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        result.has_call = true;
+        scan(*call->callee, result);
+        for (const auto& argument : call->arguments) {
+            scan(*argument, result);
+        }
+    }
+}
+
+void LoopOptimizer::rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    // Inner loops are optimised first, while the base class recurses.
+    ASTRewriter::rewrite_statements(statements);
+    for (size_t i = 0; i < statements.size(); ++i) {
+        if (dynamic_cast<AST::WhileStmt*>(statements[i].get())) {
+            optimize_loop(statements, i);
+        }
+    }
+}
+
+bool LoopOptimizer::is_variant(const std::string& name, const LoopScan& loop) const {
+    return loop.assignments.count(name) || loop.declared.count(name) ||
+           (loop.has_call && written_by_functions.count(name));
+}
+
+bool LoopOptimizer::is_invariant(const AST::Expr& expr, const LoopScan& loop) const {
+    if (dynamic_cast<const AST::Literal*>(&expr)) return true;
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        return !is_variant(variable->name.lexeme, loop);
+    }
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        return unary->op.type != TokenType::Await && is_invariant(*unary->right, loop);
+    }
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        return is_invariant(*binary->left, loop) && is_invariant(*binary->right, loop);
+    }
+    return false; // Calls and assignments.
+}
+
+void LoopOptimizer::collect_invariants(std::unique_ptr<AST::Expr>& expr, const LoopScan& loop,
+                                       std::vector<std::unique_ptr<AST::Expr>*>& out) const {
+    auto* unary = dynamic_cast<AST::Unary*>(expr.get());
+    auto* binary = dynamic_cast<AST::Binary*>(expr.get());
+    if ((unary || binary) && !literal_value(*expr) && is_invariant(*expr, loop) && !can_fail(*expr)) {
+        out.push_back(&expr);
+        return;
+    }
+    if (unary) {
+        collect_invariants(unary->right, loop, out);
+    } else if (binary) {
+        collect_invariants(binary->left, loop, out);
+        collect_invariants(binary->right, loop, out);
+    } else if (auto* assign = dynamic_cast<AST::Assign*>(expr.get())) {
+        collect_invariants(assign->value, loop, out);
+    }
+}
+
+std::vector<LoopOptimizer::Induction> LoopOptimizer::find_inductions(
+        const std::vector<std::unique_ptr<AST::Stmt>>& statements, size_t index,
+        const AST::WhileStmt& loop, const LoopScan& names) const {
+    std::vector<Induction> result;
+    auto* body = dynamic_cast<const AST::Block*>(loop.body.get());
+    if (!body) return result;
+
+    for (const auto& stmt : body->statements) {
+        auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(stmt.get());
+        auto* assign = expr_stmt ? dynamic_cast<const AST::Assign*>(expr_stmt->expression.get()) : nullptr;
+        auto* binary = assign ? dynamic_cast<const AST::Binary*>(assign->value.get()) : nullptr;
+        if (!binary) continue;
+        const std::string& name = assign->name.lexeme;
+        if (names.assignments.at(name) != 1 || names.declared.count(name) ||
+            (names.has_call && written_by_functions.count(name))) {
+            continue;
+        }
+
+        // `i = i + c`, `i = c + i` or `i = i - c`.
+        auto* left = dynamic_cast<const AST::Variable*>(binary->left.get());
+        auto* right = dynamic_cast<const AST::Variable*>(binary->right.get());
+        std::optional<long long> step;
+        if (left && left->name.lexeme == name && (binary->op.type == TokenType::Plus || binary->op.type == TokenType::Minus)) {
+            step = integer_literal(*binary->right);
+            if (step && binary->op.type == TokenType::Minus) step = -*step;
+        } else if (right && right->name.lexeme == name && binary->op.type == TokenType::Plus) {
+            step = integer_literal(*binary->left);
+        }
+        if (!step) continue;
+
+        // The value on entry must be a known integer, so that the reduced
+        // variable stays exact. Look back through the statements before the
+        // loop for the assignment that sets it.
+        std::optional<long long> initial;
+        for (size_t i = index; i-- > 0;) {
+            const AST::Stmt& prev = *statements[i];
+            if (auto* decl = dynamic_cast<const AST::VarDecl*>(&prev); decl && decl->name.lexeme == name) {
+                if (decl->initializer) initial = integer_literal(*decl->initializer);
+                break;
+            }
+            if (auto* prev_expr = dynamic_cast<const AST::ExprStmt*>(&prev)) {
+                auto* store = dynamic_cast<const AST::Assign*>(prev_expr->expression.get());
+                if (store && store->name.lexeme == name) {
+                    initial = integer_literal(*store->value);
+                    break;
+                }
+            }
+            LoopScan effects;
+            scan(prev, effects);
+            if (effects.has_call || effects.assignments.count(name) || effects.declared.count(name)) break;
+        }
+        if (!initial) continue;
+
+        result.push_back({name, stmt.get(), *step, *initial});
+    }
+    return result;
+}
+
+void LoopOptimizer::optimize_loop(std::vector<std::unique_ptr<AST::Stmt>>& statements, size_t index) {
+    auto& loop = static_cast<AST::WhileStmt&>(*statements[index]);
+    // The guard evaluates the condition once more, so it must be pure.
+    if (has_side_effects(*loop.condition)) return;
+    // Tasks may read what the loop updates while later iterations run.
+    if (contains_tasks(*loop.body)) return;
+
+    LoopScan names;
+    scan(*loop.condition, names);
+    scan(*loop.body, names);
+    auto guard = clone(*loop.condition);
+    std::vector<std::unique_ptr<AST::Stmt>> preheader;
+
+    // Invariants in the condition and the straight-line start of the body are
+    // evaluated by every iteration that runs, including the first.
+    std::vector<std::unique_ptr<AST::Expr>*> invariants;
+    collect_invariants(loop.condition, names, invariants);
+    if (auto* body = dynamic_cast<AST::Block*>(loop.body.get())) {
+        for (auto& stmt : body->statements) {
+            LoopScan effects;
+            scan(*stmt, effects);
+            if (effects.has_call || contains_return(*stmt)) break;
+            if (auto* decl = dynamic_cast<AST::VarDecl*>(stmt.get()); decl && decl->initializer) {
+                collect_invariants(decl->initializer, names, invariants);
+            } else if (auto* expr_stmt = dynamic_cast<AST::ExprStmt*>(stmt.get())) {
+                collect_invariants(expr_stmt->expression, names, invariants);
+            }
+        }
+    }
+    // Structurally equal invariants share one temporary.
+    ExprTable classes;
+    std::vector<std::string> temps;
+    for (auto* slot : invariants) {
+        int line = line_of(**slot);
+        size_t id = classes.intern(**slot);
+        if (id == temps.size()) {
+            temps.push_back("__licm" + std::to_string(next_temp++));
+            preheader.push_back(std::make_unique<AST::VarDecl>(Token{TokenType::Identifier, temps[id], line}, std::move(*slot), false));
+        }
+        *slot = std::make_unique<AST::Variable>(Token{TokenType::Identifier, temps[id], line});
+        optimized++;
+    }
+
+    // Strength reduction: each `i * k` gets a variable that starts at
+    // `initial * k` and is bumped by `step * k` right after `i` is.
+    for (const auto& induction : find_inductions(statements, index, loop, names)) {
+        std::set<long long> factors;
+        ProductRewriter finder(induction.name, factors);
+        finder.rewrite_loop(loop);
+        for (long long factor : factors) {
+            QuastraValue start = static_cast<double>(induction.initial) * factor;
+            QuastraValue step = static_cast<double>(induction.step) * factor;
+            if (!has_literal_form(start) || !has_literal_form(step)) continue;
+
+            std::string temp = "__sr" + std::to_string(next_temp++);
+            ProductRewriter rewriter(induction.name, factors, factor, temp);
+            rewriter.rewrite_loop(loop);
+            optimized += rewriter.replaced;
+
+            Token name{TokenType::Identifier, temp, 0};
+            preheader.push_back(std::make_unique<AST::VarDecl>(name, make_literal(start, 0), true));
+            auto bump = std::make_unique<AST::Binary>(std::make_unique<AST::Variable>(name),
+                                                      Token{TokenType::Plus, "+", 0}, make_literal(step, 0));
+            auto update = std::make_unique<AST::ExprStmt>(std::make_unique<AST::Assign>(name, std::move(bump)));
+            auto& body = static_cast<AST::Block&>(*loop.body).statements;
+            for (size_t i = 0; i < body.size(); ++i) {
+                if (body[i].get() == induction.update) {
+                    body.insert(body.begin() + i + 1, std::move(update));
+                    break;
+                }
+            }
+        }
+    }
+
+    if (preheader.empty()) return;
+    preheader.push_back(std::move(statements[index]));
+    statements[index] = std::make_unique<AST::IfStmt>(std::move(guard), std::make_unique<AST::Block>(std::move(preheader)), nullptr);
+}
+
+} // namespace Quastra
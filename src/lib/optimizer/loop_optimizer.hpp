@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ast_rewriter.hpp"
+#include "../frontend/ast.hpp"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace Quastra {
+
+// Optimises `while` loops, innermost first:
+//  - loop-invariant code motion: pure expressions whose variables the loop
+//    never assigns or redeclares are computed once, before the loop;
+//  - strength reduction: `i * k`, where `i` steps by a constant and starts at
+//    a known integer, becomes a variable that steps by `k` times as much.
+// The hoisted code goes into a pre-header guarded by a copy of the loop
+// condition, `if (c) { let __licm0 = ...; while (c) {...} }`, so it only runs
+// when the first iteration would have run it too. Only expressions in the
+// condition and in the straight-line start of the body, before any call or
+// return, are hoisted, and none that may fail (see can_fail), so the pass
+// never makes an error happen earlier or at all.
+// Names are compared textually: a name declared anywhere inside the loop is
+// treated as changing on every iteration, which keeps shadowed bindings (a
+// nested `let counter` inside a loop over `counter`) apart.
+class LoopOptimizer : private ASTRewriter {
+public:
+    // Returns the number of expressions hoisted or strength-reduced.
+    int run(std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+private:
+    // What a loop does to the names it mentions.
+    struct LoopScan {
+        std::map<std::string, int> assignments;
+        std::set<std::string> declared;
+        bool has_call = false;
+    };
+
+    // A variable stepped by `name = name + step` once per iteration.
+    struct Induction {
+        std::string name;
+        AST::Stmt* update = nullptr; // The statement that steps it.
+        long long step = 0;
+        long long initial = 0;
+    };
+
+    // Nested functions are not entered; only their names count as declared.
+    static void scan(const AST::Stmt& stmt, LoopScan& result);
+    static void scan(const AST::Expr& expr, LoopScan& result);
+
+    void rewrite_statements(std::vector<std::unique_ptr<AST::Stmt>>& statements) override;
+    void optimize_loop(std::vector<std::unique_ptr<AST::Stmt>>& statements, size_t index);
+
+    bool is_variant(const std::string& name, const LoopScan& loop) const;
+    bool is_invariant(const AST::Expr& expr, const LoopScan& loop) const;
+    void collect_invariants(std::unique_ptr<AST::Expr>& expr, const LoopScan& loop,
+                            std::vector<std::unique_ptr<AST::Expr>*>& out) const;
+    std::vector<Induction> find_inductions(const std::vector<std::unique_ptr<AST::Stmt>>& statements,
+                                           size_t index, const AST::WhileStmt& loop, const LoopScan& names) const;
+
+    // Names that some function body assigns. A call inside a loop may change
+    // any of them.
+    std::set<std::string> written_by_functions;
+    int next_temp = 0;
+    int optimized = 0;
+};
+
+} // namespace Quastra
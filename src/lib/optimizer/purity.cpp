@@ -0,0 +1,148 @@
+#include "purity.hpp"
+
+namespace Quastra {
+
+namespace {
+
+// Checks a single function body against the current set of pure functions.
+class PurityChecker : public AST::ExprVisitor, public AST::StmtVisitor {
+public:
+    PurityChecker(const std::map<std::string, const AST::FunctionStmt*>& pure,
+                  const std::set<std::string>& global_constants)
+        : pure(pure), global_constants(global_constants) {}
+
+    bool check(const AST::FunctionStmt& function) {
+        // A call returns a new future each time.
+        if (function.is_async) return false;
+        is_pure = true;
+        scopes.clear();
+        scopes.emplace_back();
+        for (const auto& param : function.params) {
+            scopes.back().insert(param.lexeme);
+        }
+        for (const auto& stmt : function.body) {
+            if (stmt) stmt->accept(*this);
+        }
+        return is_pure;
+    }
+
+private:
+    bool is_local(const std::string& name) const {
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            if (it->count(name)) return true;
+        }
+        return false;
+    }
+
+    void visit(const AST::VarDecl& stmt) override {
+        if (stmt.initializer) stmt.initializer->accept(*this);
+        scopes.back().insert(stmt.name.lexeme);
+    }
+    void visit(const AST::ExprStmt& stmt) override { stmt.expression->accept(*this); }
+    void visit(const AST::Block& stmt) override {
+        // Compile-time evaluation stays on one thread.
+        if (stmt.kind != AST::BlockKind::Plain) is_pure = false;
+        scopes.emplace_back();
+        for (const auto& s : stmt.statements) {
+            if (s) s->accept(*this);
+        }
+        scopes.pop_back();
+    }
+    void visit(const AST::IfStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.then_branch->accept(*this);
+        if (stmt.else_branch) stmt.else_branch->accept(*this);
+    }
+    void visit(const AST::WhileStmt& stmt) override {
+        stmt.condition->accept(*this);
+        stmt.body->accept(*this);
+    }
+    // Nested functions capture their environment; keep it simple and give up.
+    void visit(const AST::FunctionStmt& stmt) override { (void)stmt; is_pure = false; }
+    void visit(const AST::ReturnStmt& stmt) override {
+        if (stmt.value) stmt.value->accept(*this);
+    }
+
+    void visit(const AST::Literal& expr) override { (void)expr; }
+    void visit(const AST::Unary& expr) override { expr.right->accept(*this); }
+    void visit(const AST::Binary& expr) override {
+        expr.left->accept(*this);
+        expr.right->accept(*this);
+    }
+    void visit(const AST::Variable& expr) override {
+        const std::string& name = expr.name.lexeme;
+        if (is_local(name) || global_constants.count(name) || pure.count(name)) return;
+        is_pure = false;
+    }
+    void visit(const AST::Assign& expr) override {
+        if (!is_local(expr.name.lexeme)) is_pure = false;
+        expr.value->accept(*this);
+    }
+    void visit(const AST::Call& expr) override {
+        // Only direct calls to global functions can be proven pure; a local
+        // holding a function value could hold anything.
+        const auto* callee = dynamic_cast<const AST::Variable*>(expr.callee.get());
+        if (!callee || is_local(callee->name.lexeme) || !pure.count(callee->name.lexeme)) {
+            is_pure = false;
+        }
+        for (const auto& arg : expr.arguments) {
+            arg->accept(*this);
+        }
+    }
+
+    const std::map<std::string, const AST::FunctionStmt*>& pure;
+    const std::set<std::string>& global_constants;
+    std::vector<std::set<std::string>> scopes;
+    bool is_pure = true;
+};
+
+} // namespace
+
+void PurityAnalysis::analyze(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    pure.clear();
+    global_constants.clear();
+
+    // A global name declared more than once is ambiguous, so it is neither a
+    // pure function nor a constant.
+    std::map<std::string, int> declarations;
+    for (const auto& stmt : statements) {
+        if (const auto* function = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            declarations[function->name.lexeme]++;
+        } else if (const auto* decl = dynamic_cast<const AST::VarDecl*>(stmt.get())) {
+            declarations[decl->name.lexeme]++;
+        }
+    }
+    for (const auto& stmt : statements) {
+        if (const auto* function = dynamic_cast<const AST::FunctionStmt*>(stmt.get())) {
+            if (declarations[function->name.lexeme] == 1) pure[function->name.lexeme] = function;
+        } else if (const auto* decl = dynamic_cast<const AST::VarDecl*>(stmt.get())) {
+            if (decl->is_const && declarations[decl->name.lexeme] == 1) global_constants.insert(decl->name.lexeme);
+        }
+    }
+
+    // Start optimistic, so mutually recursive functions can be pure, and drop
+    // candidates until nothing changes.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = pure.begin(); it != pure.end();) {
+            PurityChecker checker(pure, global_constants);
+            if (!checker.check(*it->second)) {
+                it = pure.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+bool PurityAnalysis::is_pure(const std::string& function_name) const {
+    return pure.count(function_name) != 0;
+}
+
+bool PurityAnalysis::is_global_constant(const std::string& name) const {
+    return global_constants.count(name) != 0;
+}
+
+} // namespace Quastra
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../frontend/ast.hpp"
+#include <vector>
+#include <memory>
+#include <map>
+#include <set>
+#include <string>
+
+namespace Quastra {
+
+// Works out which top-level functions are pure: they read only their own
+// parameters, locals and global constants, assign only to locals, and call only
+// other pure functions. A pure function always returns the same value for the
+// same arguments, so a call with constant arguments may be evaluated early.
+class PurityAnalysis {
+public:
+    void analyze(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    bool is_pure(const std::string& function_name) const;
+    bool is_global_constant(const std::string& name) const;
+
+    // The declarations of all pure functions, keyed by name.
+    const std::map<std::string, const AST::FunctionStmt*>& pure_functions() const { return pure; }
+
+private:
+    std::map<std::string, const AST::FunctionStmt*> pure;
+    std::set<std::string> global_constants;
+};
+
+} // namespace Quastra
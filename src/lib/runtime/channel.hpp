@@ -0,0 +1,564 @@
+#pragma once
+
+#include "task_scheduler.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+namespace Quastra {
+
+namespace ChannelDetail {
+
+// Keeps the producer and consumer ends of a queue on separate cache lines.
+constexpr size_t cache_line = 64;
+
+// Spins briefly, then yields the processor.
+class Backoff {
+public:
+    void snooze() {
+        if (step < 6) {
+            for (unsigned i = 0; i < (1u << step); ++i) std::atomic_signal_fence(std::memory_order_seq_cst);
+            step++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    unsigned step = 0;
+};
+
+// Uninitialised room for one T.
+template <typename T>
+struct Storage {
+    T* get() { return std::launder(reinterpret_cast<T*>(bytes)); }
+    alignas(T) unsigned char bytes[sizeof(T)];
+};
+
+} // namespace ChannelDetail
+
+// A lock-free multi-producer multi-consumer queue of at most `capacity`
+// values (after Dmitry Vyukov's bounded queue). Position p uses cell
+// p % capacity on lap p / capacity, and each cell carries a turn saying
+// whose it is: on lap L, 2L is the producer's and 2L + 1 the consumer's.
+// Claiming a position is a single CAS; the producer then publishes the
+// value by moving the cell to the consumer's turn, and the consumer hands
+// it to the producer of the next lap.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : cells(new Cell[capacity < 1 ? 1 : capacity]), size(capacity < 1 ? 1 : capacity) {
+        for (size_t i = 0; i < size; ++i) cells[i].turn.store(0, std::memory_order_relaxed);
+    }
+    ~BoundedQueue() {
+        size_t end = tail.load(std::memory_order_relaxed);
+        for (size_t position = head.load(std::memory_order_relaxed); position != end; ++position) {
+            cells[position % size].value.get()->~T();
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Moves `value` into the queue, or leaves it and returns false if the
+    // queue is full.
+    bool try_push(T& value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position % size];
+            size_t turn = 2 * (position / size);
+            intptr_t difference = static_cast<intptr_t>(cell.turn.load(std::memory_order_acquire) - turn);
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    new (cell.value.bytes) T(std::move(value));
+                    cell.turn.store(turn + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Moves the oldest value into `value`, or returns false if the queue is
+    // empty.
+    bool try_pop(T& value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells[position % size];
+            size_t turn = 2 * (position / size) + 1;
+            intptr_t difference = static_cast<intptr_t>(cell.turn.load(std::memory_order_acquire) - turn);
+            if (difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    T* slot = cell.value.get();
+                    value = std::move(*slot);
+                    slot->~T();
+                    cell.turn.store(turn + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Hints for parking; either may be stale by the time it returns.
+    bool maybe_empty() const { return head.load(std::memory_order_acquire) >= tail.load(std::memory_order_acquire); }
+    bool maybe_full() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) >= size;
+    }
+
+    size_t capacity() const { return size; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> turn;
+        ChannelDetail::Storage<T> value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    const size_t size;
+    alignas(ChannelDetail::cache_line) std::atomic<size_t> tail{0};
+    alignas(ChannelDetail::cache_line) std::atomic<size_t> head{0};
+};
+
+// A lock-free unbounded multi-producer multi-consumer queue: a linked list
+// of blocks of `block_capacity` slots (the design of crossbeam's SegQueue).
+// Producers and consumers claim slots by advancing a head or tail index
+// with a CAS; the index also encodes the slot's offset in its block, and
+// whoever claims a block's last slot links or moves to the next block.
+// Each slot records whether it has been written and read. The consumer of
+// a block's last slot frees it once every other slot in it has been read,
+// and otherwise the last reader to finish does.
+template <typename T>
+class SegmentedQueue {
+public:
+    SegmentedQueue() = default;
+    ~SegmentedQueue() {
+        size_t head_index = head.index.load(std::memory_order_relaxed) & ~has_next;
+        size_t tail_index = tail.index.load(std::memory_order_relaxed) & ~has_next;
+        Block* block = head.block.load(std::memory_order_relaxed);
+        // Drop the values left between the head and the tail.
+        while (head_index != tail_index) {
+            size_t offset = (head_index >> shift) % lap;
+            if (offset < block_capacity) {
+                block->slots[offset].value.get()->~T();
+            } else {
+                Block* next = block->next.load(std::memory_order_relaxed);
+                delete block;
+                block = next;
+            }
+            head_index += 1 << shift;
+        }
+        delete block;
+    }
+
+    SegmentedQueue(const SegmentedQueue&) = delete;
+    SegmentedQueue& operator=(const SegmentedQueue&) = delete;
+
+    void push(T value) {
+        ChannelDetail::Backoff backoff;
+        size_t index = tail.index.load(std::memory_order_acquire);
+        Block* block = tail.block.load(std::memory_order_acquire);
+        std::unique_ptr<Block> next_block;
+        while (true) {
+            size_t offset = (index >> shift) % lap;
+            // Another producer is installing the next block.
+            if (offset == block_capacity) {
+                backoff.snooze();
+                index = tail.index.load(std::memory_order_acquire);
+                block = tail.block.load(std::memory_order_acquire);
+                continue;
+            }
+            // About to fill the block: have the next one ready.
+            if (offset + 1 == block_capacity && !next_block) next_block = std::make_unique<Block>();
+            // The very first push installs the first block.
+            if (!block) {
+                auto first = std::make_unique<Block>();
+                Block* expected = nullptr;
+                if (tail.block.compare_exchange_strong(expected, first.get(), std::memory_order_release,
+                                                       std::memory_order_relaxed)) {
+                    head.block.store(first.get(), std::memory_order_release);
+                    block = first.release();
+                } else {
+                    next_block = std::move(first);
+                    index = tail.index.load(std::memory_order_acquire);
+                    block = tail.block.load(std::memory_order_acquire);
+                    continue;
+                }
+            }
+            size_t new_index = index + (1 << shift);
+            if (tail.index.compare_exchange_weak(index, new_index, std::memory_order_seq_cst,
+                                                 std::memory_order_acquire)) {
+                if (offset + 1 == block_capacity) {
+                    Block* next = next_block.release();
+                    tail.block.store(next, std::memory_order_release);
+                    tail.index.store(new_index + (1 << shift), std::memory_order_release);
+                    block->next.store(next, std::memory_order_release);
+                }
+                Slot& slot = block->slots[offset];
+                new (slot.value.bytes) T(std::move(value));
+                slot.state.fetch_or(slot_written, std::memory_order_release);
+                return;
+            }
+            block = tail.block.load(std::memory_order_acquire);
+        }
+    }
+
+    // Moves the oldest value into `value`, or returns false if the queue is
+    // empty.
+    bool try_pop(T& value) {
+        ChannelDetail::Backoff backoff;
+        size_t index = head.index.load(std::memory_order_acquire);
+        Block* block = head.block.load(std::memory_order_acquire);
+        while (true) {
+            size_t offset = (index >> shift) % lap;
+            // Another consumer is moving to the next block.
+            if (offset == block_capacity) {
+                backoff.snooze();
+                index = head.index.load(std::memory_order_acquire);
+                block = head.block.load(std::memory_order_acquire);
+                continue;
+            }
+            size_t new_index = index + (1 << shift);
+            if ((new_index & has_next) == 0) {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                size_t tail_index = tail.index.load(std::memory_order_relaxed);
+                if (index >> shift == tail_index >> shift) return false;
+                // The tail is in a later block, so this one has a successor.
+                if ((index >> shift) / lap != (tail_index >> shift) / lap) new_index |= has_next;
+            }
+            // The first push is still installing the first block.
+            if (!block) {
+                backoff.snooze();
+                index = head.index.load(std::memory_order_acquire);
+                block = head.block.load(std::memory_order_acquire);
+                continue;
+            }
+            if (head.index.compare_exchange_weak(index, new_index, std::memory_order_seq_cst,
+                                                 std::memory_order_acquire)) {
+                if (offset + 1 == block_capacity) {
+                    Block* next = block->wait_next();
+                    size_t next_index = (new_index & ~has_next) + (1 << shift);
+                    if (next->next.load(std::memory_order_relaxed)) next_index |= has_next;
+                    head.block.store(next, std::memory_order_release);
+                    head.index.store(next_index, std::memory_order_release);
+                }
+                Slot& slot = block->slots[offset];
+                slot.wait_write();
+                T* stored = slot.value.get();
+                value = std::move(*stored);
+                stored->~T();
+                if (offset + 1 == block_capacity) {
+                    Block::destroy(block, 0);
+                } else if (slot.state.fetch_or(slot_read, std::memory_order_acq_rel) & slot_destroy) {
+                    Block::destroy(block, offset + 1);
+                }
+                return true;
+            }
+            block = head.block.load(std::memory_order_acquire);
+        }
+    }
+
+    // A hint for parking; it may be stale by the time it returns.
+    bool maybe_empty() const {
+        return head.index.load(std::memory_order_acquire) >> shift ==
+               tail.index.load(std::memory_order_acquire) >> shift;
+    }
+
+private:
+    // Slot states.
+    static constexpr size_t slot_written = 1;
+    static constexpr size_t slot_read = 2;
+    static constexpr size_t slot_destroy = 4;
+    // Indices count in steps of 1 << shift; the low bit of the head index
+    // says the head block has a successor. One position per lap is the
+    // block's end, which has no slot.
+    static constexpr size_t shift = 1;
+    static constexpr size_t has_next = 1;
+    static constexpr size_t lap = 32;
+    static constexpr size_t block_capacity = lap - 1;
+
+    struct Slot {
+        void wait_write() const {
+            ChannelDetail::Backoff backoff;
+            while ((state.load(std::memory_order_acquire) & slot_written) == 0) backoff.snooze();
+        }
+
+        ChannelDetail::Storage<T> value;
+        std::atomic<size_t> state{0};
+    };
+
+    struct Block {
+        Block* wait_next() const {
+            ChannelDetail::Backoff backoff;
+            while (true) {
+                if (Block* block = next.load(std::memory_order_acquire)) return block;
+                backoff.snooze();
+            }
+        }
+
+        // Frees the block unless a reader of a slot from `start` on is still
+        // busy; that reader then sees `destroy` and carries on from there.
+        // The last slot's reader started the destruction, so it is skipped.
+        static void destroy(Block* block, size_t start) {
+            for (size_t i = start; i + 1 < block_capacity; ++i) {
+                Slot& slot = block->slots[i];
+                if ((slot.state.load(std::memory_order_acquire) & slot_read) == 0 &&
+                    (slot.state.fetch_or(slot_destroy, std::memory_order_acq_rel) & slot_read) == 0) {
+                    return;
+                }
+            }
+            delete block;
+        }
+
+        std::atomic<Block*> next{nullptr};
+        Slot slots[block_capacity];
+    };
+
+    struct alignas(ChannelDetail::cache_line) Position {
+        std::atomic<size_t> index{0};
+        std::atomic<Block*> block{nullptr};
+    };
+
+    Position head;
+    Position tail;
+};
+
+// A channel between tasks or threads, bounded or unbounded, backed by the
+// lock-free queues above. Sends and receives that can complete never take
+// a lock. One that cannot (the channel is full, or empty but open) spins
+// briefly and then parks the thread on a condition variable, as a
+// TaskScheduler::Blocking so a spare thread keeps running the pool's tasks
+// meanwhile; the other side only takes the lock to wake it up when a thread
+// is parked.
+//
+// Code that must not block its thread, such as a fiber of an event loop,
+// tries the operation and, if it cannot complete, asks to be told when it
+// may (when_not_full, when_not_empty), then tries again.
+//
+// Closing a channel wakes everyone up: sends then fail, and receives return
+// what was sent before the close, then report the end. Iterating a channel
+// receives until then.
+template <typename T>
+class Channel {
+public:
+    // A channel of `capacity` values at most, or unbounded for 0.
+    explicit Channel(size_t capacity = 0) : capacity(capacity) {
+        if (capacity != 0) bounded = std::make_unique<BoundedQueue<T>>(capacity);
+    }
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    // Sends `value`, waiting while the channel is full. Throws
+    // std::runtime_error if the channel is (or gets) closed.
+    void send(T value) {
+        ChannelDetail::Backoff backoff;
+        for (unsigned attempt = 0;; ++attempt) {
+            if (try_send(value)) return;
+            if (attempt < spins) {
+                backoff.snooze();
+            } else {
+                park(waiting_senders, not_full, [this] { return is_closed() || !bounded->maybe_full(); });
+            }
+        }
+    }
+
+    // Sends `value` (moving from it) if there is room right away. Throws
+    // std::runtime_error if the channel is closed.
+    bool try_send(T& value) {
+        // Sends in flight are counted next to the closed bit, so receivers
+        // know when every send that beat close() has landed.
+        if (state.fetch_add(sending, std::memory_order_acq_rel) & closed_bit) {
+            state.fetch_sub(sending, std::memory_order_release);
+            throw std::runtime_error("Send on a closed channel.");
+        }
+        bool sent = true;
+        if (bounded) {
+            sent = bounded->try_push(value);
+        } else {
+            unbounded.push(std::move(value));
+        }
+        state.fetch_sub(sending, std::memory_order_release);
+        if (sent) wake(waiting_receivers, not_empty, receiver_wakers);
+        return sent;
+    }
+
+    // Receives the oldest value into `value`, waiting while the channel is
+    // empty. Returns false once the channel is closed and drained.
+    bool receive(T& value) {
+        ChannelDetail::Backoff backoff;
+        for (unsigned attempt = 0;; ++attempt) {
+            if (try_receive(value)) return true;
+            if (drained()) return try_receive(value);
+            if (attempt < spins) {
+                backoff.snooze();
+            } else {
+                park(waiting_receivers, not_empty, [this] { return is_closed() || !maybe_empty(); });
+            }
+        }
+    }
+
+    // Receives a value if one is there right away.
+    bool try_receive(T& value) {
+        bool received = bounded ? bounded->try_pop(value) : unbounded.try_pop(value);
+        if (received && bounded) wake(waiting_senders, not_full, sender_wakers);
+        return received;
+    }
+
+    void close() {
+        state.fetch_or(closed_bit, std::memory_order_acq_rel);
+        std::deque<std::function<void()>> woken;
+        {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            woken = take(waiting_senders, sender_wakers);
+            for (auto& waker : take(waiting_receivers, receiver_wakers)) woken.push_back(std::move(waker));
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+        for (auto& waker : woken) waker();
+    }
+
+    // Runs `waker` once a send may succeed: a receive made room, or the
+    // channel was closed. It runs on the thread that made the change, so it
+    // should only pass the news on; or right away, if a send may succeed now.
+    // Each change wakes one waker, in the order they came (closing wakes
+    // them all), so a waiter that gives up must hand its wake on with
+    // wake_sender().
+    void when_not_full(std::function<void()> waker) {
+        watch(waiting_senders, sender_wakers, std::move(waker),
+              [this] { return is_closed() || !bounded || !bounded->maybe_full(); });
+    }
+    void wake_sender() { wake(waiting_senders, not_full, sender_wakers); }
+
+    // Runs `waker` once a receive may succeed: a value was sent, or the
+    // channel was closed. Like when_not_full.
+    void when_not_empty(std::function<void()> waker) {
+        watch(waiting_receivers, receiver_wakers, std::move(waker), [this] { return is_closed() || !maybe_empty(); });
+    }
+    void wake_receiver() { wake(waiting_receivers, not_empty, receiver_wakers); }
+
+    bool is_closed() const { return state.load(std::memory_order_acquire) & closed_bit; }
+
+    // Closed, with no send in flight: the queue holds all there will be.
+    bool drained() const { return state.load(std::memory_order_acquire) == closed_bit; }
+
+    // 0 for an unbounded channel.
+    size_t get_capacity() const { return capacity; }
+
+    // `for (T& value : channel)` receives until the channel is closed and
+    // drained.
+    class iterator {
+    public:
+        explicit iterator(Channel* channel) : channel(channel) { next(); }
+        T& operator*() { return value; }
+        iterator& operator++() {
+            next();
+            return *this;
+        }
+        bool operator!=(const iterator& other) const { return channel != other.channel; }
+
+    private:
+        void next() {
+            if (channel && !channel->receive(value)) channel = nullptr;
+        }
+
+        Channel* channel;
+        T value{};
+    };
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(nullptr); }
+
+private:
+    static constexpr size_t closed_bit = 1;
+    static constexpr size_t sending = 2;
+    // Failed attempts before a blocked send or receive parks.
+    static constexpr unsigned spins = 16;
+
+    bool maybe_empty() const { return bounded ? bounded->maybe_empty() : unbounded.maybe_empty(); }
+
+    // Parks until `ready` holds. A waker makes its change before it checks
+    // `waiting`, and a parker registers before it checks `ready`, with full
+    // fences between, so one of them always sees the other.
+    template <typename Ready>
+    void park(std::atomic<size_t>& waiting, std::condition_variable& condition, Ready ready) {
+        TaskScheduler::Blocking blocking;
+        std::unique_lock<std::mutex> lock(park_mutex);
+        waiting.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Like park, but registers `waker` instead of waiting; the wakers count
+    // as waiting too.
+    template <typename Ready>
+    void watch(std::atomic<size_t>& waiting, std::deque<std::function<void()>>& wakers,
+               std::function<void()> waker, Ready ready) {
+        {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            waiting.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready()) {
+                wakers.push_back(std::move(waker));
+                return;
+            }
+            waiting.fetch_sub(1, std::memory_order_relaxed);
+        }
+        waker();
+    }
+
+    // Wakes one parked thread and the oldest waker.
+    void wake(std::atomic<size_t>& waiting, std::condition_variable& condition,
+              std::deque<std::function<void()>>& wakers) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) == 0) return;
+        std::function<void()> waker;
+        {
+            std::lock_guard<std::mutex> lock(park_mutex);
+            if (!wakers.empty()) {
+                waker = std::move(wakers.front());
+                wakers.pop_front();
+                waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        condition.notify_one();
+        if (waker) waker();
+    }
+
+    // Removes the wakers, under park_mutex, and stops counting them.
+    static std::deque<std::function<void()>> take(std::atomic<size_t>& waiting,
+                                                  std::deque<std::function<void()>>& wakers) {
+        waiting.fetch_sub(wakers.size(), std::memory_order_relaxed);
+        return std::exchange(wakers, {});
+    }
+
+    const size_t capacity;
+    std::unique_ptr<BoundedQueue<T>> bounded;
+    SegmentedQueue<T> unbounded;
+    std::atomic<size_t> state{0};
+    std::atomic<size_t> waiting_senders{0};
+    std::atomic<size_t> waiting_receivers{0};
+    std::mutex park_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<std::function<void()>> sender_wakers;   // Guarded by park_mutex.
+    std::deque<std::function<void()>> receiver_wakers; // Guarded by park_mutex.
+};
+
+} // namespace Quastra
@@ -0,0 +1,118 @@
+#include "core_io.hpp"
+#include "quastra_channel.hpp"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace Quastra {
+
+BufferedWriter::BufferedWriter(std::ostream& stream, size_t capacity) : stream(stream), capacity(capacity) {
+    buffer.reserve(capacity);
+}
+
+BufferedWriter::~BufferedWriter() {
+    drain();
+}
+
+void BufferedWriter::set_capacity(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    drain();
+    capacity = size;
+    buffer.reserve(capacity);
+}
+
+void BufferedWriter::set_line_buffered(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    line_buffered = enabled;
+}
+
+void BufferedWriter::write(std::string_view text) {
+    std::lock_guard<std::mutex> lock(mutex);
+    append(text);
+    finish_write(!text.empty() && text.back() == '\n');
+}
+
+void BufferedWriter::print(const QuastraValue& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    append_value(value);
+    finish_write(false);
+}
+
+void BufferedWriter::println(const QuastraValue& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    append_value(value);
+    append("\n");
+    finish_write(true);
+}
+
+void BufferedWriter::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    drain();
+}
+
+void BufferedWriter::append(std::string_view text) {
+    buffer.append(text.data(), text.size());
+}
+
+void BufferedWriter::append_value(const QuastraValue& value) {
+    if (const double* number = std::get_if<double>(&value)) {
+        char text[number_buffer_size];
+        append(std::string_view(text, format_number(*number, text)));
+    } else if (const bool* flag = std::get_if<bool>(&value)) {
+        append(*flag ? "true" : "false");
+    } else if (const QuastraString* string = std::get_if<QuastraString>(&value)) {
+        append(string->view());
+    } else if (std::holds_alternative<std::shared_ptr<QuastraFuture>>(value)) {
+        append("<future>");
+    } else if (dynamic_cast<QuastraChannel*>(std::get_if<std::shared_ptr<QuastraCallable>>(&value)->get())) {
+        append("<channel>");
+    } else {
+        append("<function>");
+    }
+}
+
+void BufferedWriter::finish_write(bool ends_line) {
+    if (buffer.size() >= capacity || (ends_line && line_buffered)) drain();
+}
+
+void BufferedWriter::drain() {
+    if (!buffer.empty()) {
+        stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+    stream.flush();
+}
+
+BufferedWriter& standard_output() {
+    // Made after std::cout, so destroyed (and flushed) before it.
+    static BufferedWriter writer(std::cout);
+    return writer;
+}
+
+size_t format_number(double number, char* out) {
+    if (number > -1e6 && number < 1e6) {
+        long long whole = static_cast<long long>(number);
+        if (whole == number && !(whole == 0 && std::signbit(number))) {
+            char digits[8];
+            size_t count = 0;
+            unsigned long long rest = whole < 0 ? -whole : whole;
+            do {
+                digits[count++] = static_cast<char>('0' + rest % 10);
+                rest /= 10;
+            } while (rest);
+            size_t length = 0;
+            if (whole < 0) out[length++] = '-';
+            while (count) out[length++] = digits[--count];
+            return length;
+        }
+    }
+    int length = std::snprintf(out, number_buffer_size, "%g", number);
+    return length > 0 ? static_cast<size_t>(length) : 0;
+}
+
+bool read_line(std::string& line) {
+    standard_output().flush();
+    return static_cast<bool>(std::getline(std::cin, line));
+}
+
+} // namespace Quastra
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "quastra_value.hpp"
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace Quastra {
+
+// core.io: the output side of the print natives. Text collects in a buffer
+// and goes to the stream in one write when the buffer is full, on flush(),
+// before a read from stdin (see read_line) and when the writer is destroyed,
+// which for standard_output() is at exit. A log line then costs a copy into
+// memory rather than a system call. Engines flush when a program finishes
+// or fails, so their output comes before any error message.
+//
+// Writers are shared by every task of a program: each call holds a lock, so
+// a println never interleaves with another.
+class BufferedWriter {
+public:
+    static constexpr size_t default_capacity = 64 * 1024;
+
+    // Writes to whatever buffer `stream` has when the writer flushes.
+    explicit BufferedWriter(std::ostream& stream, size_t capacity = default_capacity);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    // Bytes held before they are written out; 0 writes every call through.
+    // Flushes what is held first.
+    void set_capacity(size_t capacity);
+    // Also flush after every write that ends a line, as for a terminal.
+    void set_line_buffered(bool line_buffered);
+
+    void write(std::string_view text);
+    // Writes a value as `print` shows it.
+    void print(const QuastraValue& value);
+    // The same followed by a newline, as one write.
+    void println(const QuastraValue& value);
+    // Writes out what is held and flushes the stream.
+    void flush();
+
+private:
+    // These expect the lock to be held.
+    void append(std::string_view text);
+    void append_value(const QuastraValue& value);
+    void finish_write(bool ends_line);
+    void drain();
+
+    std::ostream& stream;
+    std::mutex mutex;
+    std::string buffer;
+    size_t capacity;
+    bool line_buffered = false;
+};
+
+// The writer on std::cout the natives use.
+BufferedWriter& standard_output();
+
+// Characters format_number may write.
+constexpr size_t number_buffer_size = 32;
+
+// Writes `number` to `out` as `std::cout << number` shows it (six
+// significant digits, %g style) without going through a stream, and returns
+// the length. Whole numbers below a million, the common case, take no call
+// into the C library.
+size_t format_number(double number, char* out);
+
+// Flushes standard_output() so a prompt shows, then reads a line from
+// std::cin without its newline. Returns false at the end of the input.
+bool read_line(std::string& line);
+
+} // namespace Quastra
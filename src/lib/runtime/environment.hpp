@@ -2,55 +2,119 @@
 
 #include "quastra_value.hpp"
 #include "../frontend/token.hpp"
+#include "task_scheduler.hpp"
+#include <atomic>
+#include <cstdint>
 #include <map>
+#include <mutex>
 #include <string>
 #include <memory>
 
 namespace Quastra {
 
-// Manages the state of variables, including scopes.
+// Manages the state of variables, including scopes. While spawned tasks
+// may run (see TaskScheduler::concurrent), each scope is locked around
+// every access, since tasks share the scopes they were spawned in.
 class Environment {
 public:
     // Create a global scope.
-    Environment() : enclosing(nullptr) {}
+    Environment() : enclosing(nullptr), version(next_version()) { ++live_count(); }
     // Create a nested (local) scope.
-    Environment(std::shared_ptr<Environment> enclosing) : enclosing(enclosing) {}
+    Environment(std::shared_ptr<Environment> enclosing) : enclosing(enclosing) { ++live_count(); }
+    ~Environment() { --live_count(); }
+
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
 
     // Define a new variable in the current scope.
-    void define(const std::string& name, const QuastraValue& value) {
-        values[name] = value;
+    void define(const std::string& name, QuastraValue value) {
+        Guard guard(mutex);
+        auto it = values.find(name);
+        if (it == values.end()) {
+            values.emplace(name, std::move(value));
+            return;
+        }
+        rebind(it->second, std::move(value));
     }
 
     // Assign a new value to an existing variable.
     void assign(const Token& name, const QuastraValue& value) {
-        if (values.count(name.lexeme)) {
-            values[name.lexeme] = value;
-            return;
-        }
-
-        if (enclosing != nullptr) {
-            enclosing->assign(name, value);
-            return;
+        for (Environment* scope = this; scope != nullptr; scope = scope->enclosing.get()) {
+            Guard guard(scope->mutex);
+            auto it = scope->values.find(name.lexeme);
+            if (it != scope->values.end()) {
+                scope->rebind(it->second, value);
+                return;
+            }
         }
-
         throw std::runtime_error("Undefined variable '" + name.lexeme + "'.");
     }
 
-    // Get the value of a variable.
+    // Get the value of a variable, from the innermost scope that has it.
     QuastraValue get(const Token& name) {
-        if (values.count(name.lexeme)) {
-            return values.at(name.lexeme);
-        }
-        // If not in current scope, check the parent scope.
-        if (enclosing != nullptr) {
-            return enclosing->get(name);
+        for (Environment* scope = this; scope != nullptr; scope = scope->enclosing.get()) {
+            Guard guard(scope->mutex);
+            auto it = scope->values.find(name.lexeme);
+            if (it != scope->values.end()) return it->second;
         }
         throw std::runtime_error("Undefined variable '" + name.lexeme + "'.");
     }
 
+    // Changes whenever a global scope rebinds a name that was or becomes a
+    // function, so a cache of what a global name calls (see
+    // AST::Call::is_global_call) is valid while the version is the same.
+    // Versions are unique across environments; local scopes have none.
+    uint64_t get_version() const { return version; }
+
+    // For the EnvironmentCollector, which follows the references between
+    // environments and the functions stored in them.
+    const std::shared_ptr<Environment>& get_enclosing() const { return enclosing; }
+    const std::map<std::string, QuastraValue>& get_values() const { return values; }
+    // Drops every variable; used on environments only a cycle keeps alive.
+    void clear() { values.clear(); }
+    // Set once a collector tracks the environment.
+    bool tracked = false;
+
+    // Environments currently alive in the process, for leak checks.
+    static size_t live() { return live_count(); }
+
 private:
+    static std::atomic<size_t>& live_count() {
+        static std::atomic<size_t> count{0};
+        return count;
+    }
+
+    // Holds the lock only while tasks may run concurrently.
+    class Guard {
+    public:
+        explicit Guard(std::mutex& mutex) : mutex(TaskScheduler::concurrent() ? &mutex : nullptr) {
+            if (this->mutex) this->mutex->lock();
+        }
+        ~Guard() {
+            if (mutex) mutex->unlock();
+        }
+
+    private:
+        std::mutex* mutex;
+    };
+
+    static uint64_t next_version() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    void rebind(QuastraValue& slot, QuastraValue value) {
+        if (enclosing == nullptr && (std::holds_alternative<std::shared_ptr<QuastraCallable>>(slot) ||
+                                     std::holds_alternative<std::shared_ptr<QuastraCallable>>(value))) {
+            version = next_version();
+        }
+        slot = std::move(value);
+    }
+
     std::map<std::string, QuastraValue> values;
     std::shared_ptr<Environment> enclosing;
+    uint64_t version = 0;
+    std::mutex mutex;
 };
 
 } // namespace Quastra
@@ -0,0 +1,240 @@
+#include "event_loop.hpp"
+#include "mailbox.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <pthread.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+#if defined(__SANITIZE_THREAD__)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+namespace Quastra {
+
+namespace {
+
+thread_local EventLoop* installed_loop = nullptr;
+
+// Thrown out of park() to unwind a fiber whose loop goes away.
+struct Cancelled {};
+
+// How many stacks of finished fibers a loop keeps for new ones.
+constexpr size_t max_spare_stacks = 16;
+
+size_t thread_stack_size() {
+    size_t size = 8 << 20;
+    pthread_attr_t attributes;
+    if (pthread_getattr_np(pthread_self(), &attributes) == 0) {
+        pthread_attr_getstacksize(&attributes, &size);
+        pthread_attr_destroy(&attributes);
+    }
+    return size;
+}
+
+// ThreadSanitizer has to be told about every switch between stacks.
+void* current_sanitizer_fiber() {
+#if defined(__SANITIZE_THREAD__)
+    return __tsan_get_current_fiber();
+#else
+    return nullptr;
+#endif
+}
+
+void switch_sanitizer_fiber(void* fiber) {
+#if defined(__SANITIZE_THREAD__)
+    __tsan_switch_to_fiber(fiber, 0);
+#else
+    (void)fiber;
+#endif
+}
+
+} // namespace
+
+EventLoop::Stack::Stack(size_t size) : guard(static_cast<size_t>(sysconf(_SC_PAGESIZE))) {
+    // Pages are only committed once the fiber touches them.
+    length = (size + guard - 1) / guard * guard + guard;
+    void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (address == MAP_FAILED) throw std::runtime_error("Out of memory for an async call.");
+    memory = static_cast<char*>(address);
+    mprotect(memory, guard, PROT_NONE);
+}
+
+EventLoop::Stack::~Stack() {
+    munmap(memory, length);
+}
+
+// Every fiber that is neither running nor finished is inside park(), so
+// each unwinds from there.
+EventLoop::~EventLoop() {
+    std::vector<std::shared_ptr<Fiber>> left(ready.begin(), ready.end());
+    left.insert(left.end(), waiting.begin(), waiting.end());
+    ready.clear();
+    waiting.clear();
+    timers = {};
+    for (auto& fiber : left) {
+        fiber->parked = false;
+        fiber->cancelled = true;
+        resume(fiber);
+    }
+}
+
+EventLoop& EventLoop::current() {
+    if (installed_loop) return *installed_loop;
+    thread_local EventLoop own;
+    return own;
+}
+
+EventLoop::Installed::Installed(EventLoop& loop) : previous(installed_loop) {
+    installed_loop = &loop;
+}
+
+EventLoop::Installed::~Installed() {
+    installed_loop = previous;
+}
+
+void EventLoop::start(std::function<void()> body) {
+    auto fiber = std::make_shared<Fiber>();
+    fiber->body = std::move(body);
+    if (spare_stacks.empty()) {
+        if (stack_size == 0) stack_size = thread_stack_size();
+        fiber->stack = std::make_unique<Stack>(stack_size);
+    } else {
+        fiber->stack = std::move(spare_stacks.back());
+        spare_stacks.pop_back();
+    }
+    getcontext(&fiber->context);
+    fiber->context.uc_stack.ss_sp = fiber->stack->base();
+    fiber->context.uc_stack.ss_size = fiber->stack->size();
+    fiber->context.uc_link = nullptr;
+    auto address = reinterpret_cast<uintptr_t>(this);
+    makecontext(&fiber->context, reinterpret_cast<void (*)()>(&EventLoop::enter), 2,
+                static_cast<unsigned>(static_cast<uint64_t>(address) >> 32), static_cast<unsigned>(address));
+#if defined(__SANITIZE_THREAD__)
+    fiber->sanitizer_fiber = __tsan_create_fiber(0);
+#endif
+    resume(fiber);
+}
+
+void EventLoop::enter(unsigned high, unsigned low) {
+    auto* loop = reinterpret_cast<EventLoop*>(static_cast<uintptr_t>((static_cast<uint64_t>(high) << 32) | low));
+    Fiber& fiber = *loop->running;
+    try {
+        fiber.body();
+    } catch (...) {
+        // A cancelled fiber only unwinds; there is nobody to tell.
+        if (!fiber.cancelled) fiber.error = std::current_exception();
+    }
+    fiber.body = nullptr;
+    fiber.finished = true;
+    // The resumer frees the stack, once it is off it.
+    switch_sanitizer_fiber(fiber.sanitizer_resumer);
+    setcontext(fiber.resumer);
+}
+
+void EventLoop::resume(const std::shared_ptr<Fiber>& fiber) {
+    std::shared_ptr<Fiber> previous = std::move(running);
+    ucontext_t here;
+    fiber->resumer = &here;
+    fiber->sanitizer_resumer = current_sanitizer_fiber();
+    running = fiber;
+    switch_sanitizer_fiber(fiber->sanitizer_fiber);
+    swapcontext(&here, &fiber->context);
+    running = std::move(previous);
+    if (!fiber->finished) return;
+
+#if defined(__SANITIZE_THREAD__)
+    __tsan_destroy_fiber(fiber->sanitizer_fiber);
+#endif
+    if (spare_stacks.size() < max_spare_stacks) spare_stacks.push_back(std::move(fiber->stack));
+    fiber->stack.reset();
+    if (fiber->error) std::rethrow_exception(std::exchange(fiber->error, nullptr));
+}
+
+void EventLoop::wake_when(QuastraFuture& future, const std::shared_ptr<Fiber>& fiber) {
+    fiber->parked = true;
+    waiting.insert(fiber);
+    // The future may outlive the loop; a fiber that is gone or no longer
+    // parked (cancelled) leaves the loop alone.
+    future.on_complete([this, weak = std::weak_ptr<Fiber>(fiber)] {
+        std::shared_ptr<Fiber> woken = weak.lock();
+        if (!woken || !woken->parked) return;
+        woken->parked = false;
+        waiting.erase(woken);
+        ready.push_back(std::move(woken));
+    });
+}
+
+void EventLoop::park(QuastraFuture& future) {
+    Fiber& fiber = *running;
+    wake_when(future, running);
+    switch_sanitizer_fiber(fiber.sanitizer_resumer);
+    swapcontext(&fiber.context, fiber.resumer);
+    if (fiber.cancelled) throw Cancelled();
+}
+
+// Code outside any fiber queues up behind the fibers the future's
+// completion finds ready, as a fiber would, through a stand-in without a
+// stack of its own.
+QuastraValue EventLoop::await(QuastraFuture& future) {
+    if (future.is_done()) return future.get_value();
+    if (running) {
+        park(future);
+        return future.get_value();
+    }
+    auto caller = std::make_shared<Fiber>();
+    wake_when(future, caller);
+    try {
+        while (true) {
+            std::shared_ptr<Fiber> fiber = next();
+            if (!fiber) throw std::runtime_error("Awaited a future that can never complete.");
+            if (fiber == caller) break;
+            resume(fiber);
+        }
+    } catch (...) {
+        caller->parked = false;
+        waiting.erase(caller);
+        ready.erase(std::remove(ready.begin(), ready.end(), caller), ready.end());
+        throw;
+    }
+    return future.get_value();
+}
+
+std::shared_ptr<QuastraFuture> EventLoop::timer(double milliseconds) {
+    auto future = std::make_shared<QuastraFuture>();
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(std::max(milliseconds, 0.0)));
+    timers.push({std::chrono::steady_clock::now() + delay, timer_sequence++, future});
+    return future;
+}
+
+void EventLoop::run() {
+    while (std::shared_ptr<Fiber> fiber = next()) resume(fiber);
+}
+
+std::shared_ptr<EventLoop::Fiber> EventLoop::next() {
+    Mailbox& mailbox = *Mailbox::current();
+    while (true) {
+        mailbox.deliver();
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.top().deadline <= now) {
+            std::shared_ptr<QuastraFuture> future = timers.top().future;
+            timers.pop();
+            future->complete(false);
+        }
+        if (!ready.empty()) break;
+        if (!timers.empty()) {
+            mailbox.wait_until(timers.top().deadline);
+        } else if (!mailbox.wait()) {
+            return nullptr;
+        }
+    }
+    std::shared_ptr<Fiber> fiber = std::move(ready.front());
+    ready.pop_front();
+    return fiber;
+}
+
+} // namespace Quastra
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "quastra_future.hpp"
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+#include <ucontext.h>
+
+namespace Quastra {
+
+// Runs the async calls of the engines that walk the program (the
+// Interpreter and the ClosureEngine) without a thread each. Every call
+// gets a fiber: a stack of its own, on which the body runs until it
+// awaits a future that is still pending. The fiber then parks and its
+// caller carries on; once the future completes, the loop resumes the
+// fiber where it left off. Code outside any fiber that awaits a pending
+// future drives the loop itself, running ready fibers and waiting for
+// timers, until the future completes. The loop also delivers what other
+// threads post to its thread's Mailbox, such as a channel waking a fiber.
+//
+// A loop belongs to the thread that made it, as do its fibers and the
+// futures they wait on. Fibers get stacks the size of that thread's, so
+// they can recurse as deep as it can.
+class EventLoop {
+public:
+    EventLoop() = default;
+    // Unwinds the fibers still parked, without running them further.
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // The loop installed on the calling thread, or the thread's own one
+    // for code that runs outside any.
+    static EventLoop& current();
+
+    // Makes `loop` the calling thread's current one while it is alive.
+    class Installed {
+    public:
+        explicit Installed(EventLoop& loop);
+        ~Installed();
+
+        Installed(const Installed&) = delete;
+        Installed& operator=(const Installed&) = delete;
+
+    private:
+        EventLoop* previous;
+    };
+
+    // Runs `body` on a new fiber until it finishes or first parks. An
+    // exception it throws is rethrown here, or to whatever resumed it last.
+    void start(std::function<void()> body);
+
+    // The value of `future`, once it completes. A fiber parks meanwhile;
+    // other code runs the loop. Throws if nothing is left that could
+    // complete the future.
+    QuastraValue await(QuastraFuture& future);
+
+    // A future that completes with false after `milliseconds`.
+    std::shared_ptr<QuastraFuture> timer(double milliseconds);
+
+    // Runs fibers and timers until none are left.
+    void run();
+
+private:
+    // Memory for a fiber's stack, with a guard page below it.
+    class Stack {
+    public:
+        explicit Stack(size_t size);
+        ~Stack();
+
+        Stack(const Stack&) = delete;
+        Stack& operator=(const Stack&) = delete;
+
+        void* base() const { return memory + guard; }
+        size_t size() const { return length - guard; }
+
+    private:
+        char* memory;
+        size_t length;
+        size_t guard;
+    };
+
+    struct Fiber {
+        ucontext_t context;
+        ucontext_t* resumer = nullptr; // Where the fiber goes when it parks or ends.
+        std::unique_ptr<Stack> stack;
+        std::function<void()> body;
+        std::exception_ptr error;
+        bool parked = false;
+        bool finished = false;
+        bool cancelled = false;
+        void* sanitizer_fiber = nullptr;
+        void* sanitizer_resumer = nullptr;
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        size_t sequence; // Timers with the same deadline fire in order.
+        std::shared_ptr<QuastraFuture> future;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    // The first function on a fiber's stack; `high` and `low` make up the
+    // address of the loop, whose running fiber it is.
+    static void enter(unsigned high, unsigned low);
+    // Switches to `fiber` until it parks or finishes.
+    void resume(const std::shared_ptr<Fiber>& fiber);
+    // Makes `fiber` ready once `future` completes.
+    void wake_when(QuastraFuture& future, const std::shared_ptr<Fiber>& fiber);
+    // Parks the running fiber until `future` completes.
+    void park(QuastraFuture& future);
+    // Delivers the mailbox and fires the timers that are due, waiting for
+    // the first one, or for a post, if no fiber is ready; then takes the
+    // next ready fiber. Returns nullptr if there is nothing left to run.
+    std::shared_ptr<Fiber> next();
+
+    size_t stack_size = 0; // Found when the first fiber starts.
+    std::vector<std::unique_ptr<Stack>> spare_stacks;
+    std::shared_ptr<Fiber> running;
+    std::deque<std::shared_ptr<Fiber>> ready;
+    std::unordered_set<std::shared_ptr<Fiber>> waiting; // Parked, and not woken yet.
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    size_t timer_sequence = 0;
+};
+
+} // namespace Quastra
@@ -0,0 +1,85 @@
+#include "mailbox.hpp"
+#include "task_scheduler.hpp"
+#include <iterator>
+#include <utility>
+
+namespace Quastra {
+
+namespace {
+
+// Tasks do not post as they finish, so a thread waiting for them checks
+// this often whether any are left.
+constexpr std::chrono::milliseconds poll_interval(10);
+
+} // namespace
+
+const std::shared_ptr<Mailbox>& Mailbox::current() {
+    // Shared, so posts to a thread that has exited go nowhere harmlessly.
+    thread_local std::shared_ptr<Mailbox> mailbox = std::make_shared<Mailbox>();
+    return mailbox;
+}
+
+void Mailbox::expect(const std::shared_ptr<QuastraFuture>& future) {
+    expected.insert(future);
+    // Forgets the futures that no longer count every so often, so the set
+    // stays in proportion to those that do.
+    if (expected.size() >= 2 * pruned_size + 16) {
+        expecting();
+        pruned_size = expected.size();
+    }
+}
+
+void Mailbox::post(std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callbacks.push_back(std::move(callback));
+        pending.store(true, std::memory_order_release);
+    }
+    posted.notify_one();
+}
+
+bool Mailbox::deliver() {
+    if (!pending.load(std::memory_order_acquire)) return false;
+    std::vector<std::function<void()>> delivered;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        delivered.swap(callbacks);
+        pending.store(false, std::memory_order_relaxed);
+    }
+    for (auto& callback : delivered) callback();
+    return !delivered.empty();
+}
+
+void Mailbox::wait_until(std::chrono::steady_clock::time_point deadline) {
+    TaskScheduler::Blocking blocking;
+    std::unique_lock<std::mutex> lock(mutex);
+    posted.wait_until(lock, deadline, [this] { return !callbacks.empty(); });
+}
+
+// A task posts before it finishes, and posting takes the lock held here
+// between the two checks, so a post is never missed.
+bool Mailbox::wait() {
+    bool waits = expecting(); // Outside the lock: it may free futures.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!callbacks.empty()) return true;
+        if (!waits || !TaskScheduler::others_running()) return false;
+    }
+    TaskScheduler::Blocking blocking;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (callbacks.empty()) {
+        if (!TaskScheduler::others_running()) return false;
+        posted.wait_for(lock, poll_interval);
+    }
+    return true;
+}
+
+bool Mailbox::expecting() {
+    for (auto it = expected.begin(); it != expected.end();) {
+        std::shared_ptr<QuastraFuture> future = it->lock();
+        it = future && !future->is_done() ? std::next(it) : expected.erase(it);
+    }
+    return !expected.empty();
+}
+
+} // namespace Quastra
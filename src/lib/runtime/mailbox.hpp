@@ -0,0 +1,60 @@
+#pragma once
+
+#include "quastra_future.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace Quastra {
+
+// How other threads reach the event loop of a thread: they post callbacks
+// to the thread's mailbox, and its loop (an EventLoop, or the
+// VirtualMachine's) delivers them, on that thread, whenever it looks for a
+// fiber to run. A channel wakes the fibers waiting on it this way, since
+// the futures they wait for belong to their thread.
+class Mailbox {
+public:
+    // The calling thread's.
+    static const std::shared_ptr<Mailbox>& current();
+
+    // Notes that another thread is to post what completes `future`:
+    // wait() waits for posts while such a future is alive and pending.
+    // Only the mailbox's thread expects.
+    void expect(const std::shared_ptr<QuastraFuture>& future);
+
+    // Queues `callback` to run on the mailbox's thread. Any thread may post.
+    void post(std::function<void()> callback);
+
+    // Runs the callbacks posted so far, in order. Returns whether there
+    // were any. Only the mailbox's thread delivers.
+    bool deliver();
+
+    // Waits until something is posted or `deadline` passes.
+    void wait_until(std::chrono::steady_clock::time_point deadline);
+
+    // Waits until something is posted, for as long as a post is expected
+    // and a task or program the calling thread is not running could still
+    // make it. Returns false if nothing was posted and nothing could be.
+    bool wait();
+
+private:
+    std::mutex mutex;
+    std::condition_variable posted;
+    std::vector<std::function<void()>> callbacks;
+    std::atomic<bool> pending{false}; // Lets deliver() skip the lock.
+    // Only the mailbox's thread touches these. A future that was given up
+    // on, or completed, no longer counts.
+    std::set<std::weak_ptr<QuastraFuture>, std::owner_less<std::weak_ptr<QuastraFuture>>> expected;
+    size_t pruned_size = 0;
+
+    // Forgets the futures that no longer count; returns whether any are left.
+    bool expecting();
+};
+
+} // namespace Quastra
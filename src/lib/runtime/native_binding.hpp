@@ -0,0 +1,166 @@
+#pragma once
+
+#include "native_registry.hpp"
+#include "quastra_callable.hpp"
+#include "quastra_channel.hpp"
+#include "quastra_value.hpp"
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace Quastra {
+
+// Binds plain C++ functions as natives. Arity, parameter and result types
+// are read off the function's type at compile time:
+//
+//     register_native<double(double)>("sqrt", std::sqrt);
+//     register_native("shout", +[](std::string_view text) { return std::string(text) + "!"; });
+//
+// (the explicit signature picks one of an overloaded function's
+// overloads). Calls check every argument's type, left to right, then pass
+// them straight from the caller's values: numbers and booleans by value,
+// strings as a std::string_view of the argument's characters, so nothing is
+// allocated unless a parameter or the result is a std::string.
+
+// How a C++ parameter or result type maps to Quastra values and to the
+// TypeChecker's types.
+template <typename T, typename = void>
+struct NativeType;
+
+template <typename T>
+struct NativeType<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr Type type = Type::Int; // The TypeChecker's number type.
+    static constexpr const char* kind = "a number";
+    static bool accepts(const QuastraValue& value) { return std::holds_alternative<double>(value); }
+    static T from(const QuastraValue& value) { return static_cast<T>(*std::get_if<double>(&value)); }
+    static QuastraValue to(T value) { return static_cast<double>(value); }
+};
+
+template <>
+struct NativeType<bool> {
+    static constexpr Type type = Type::Bool;
+    static constexpr const char* kind = "a boolean";
+    static bool accepts(const QuastraValue& value) { return std::holds_alternative<bool>(value); }
+    static bool from(const QuastraValue& value) { return *std::get_if<bool>(&value); }
+    static QuastraValue to(bool value) { return value; }
+};
+
+template <>
+struct NativeType<std::string_view> {
+    static constexpr Type type = Type::String;
+    static constexpr const char* kind = "a string";
+    static bool accepts(const QuastraValue& value) { return std::holds_alternative<QuastraString>(value); }
+    // Valid for the whole call: the caller owns the argument.
+    static std::string_view from(const QuastraValue& value) { return std::get_if<QuastraString>(&value)->view(); }
+    static QuastraValue to(std::string_view value) { return QuastraString(value); }
+};
+
+template <>
+struct NativeType<std::string> : NativeType<std::string_view> {
+    static std::string from(const QuastraValue& value) { return std::get_if<QuastraString>(&value)->str(); }
+    static QuastraValue to(const std::string& value) { return QuastraString(value); }
+};
+
+template <>
+struct NativeType<QuastraString> : NativeType<std::string_view> {
+    static const QuastraString& from(const QuastraValue& value) { return *std::get_if<QuastraString>(&value); }
+    static QuastraValue to(QuastraString value) { return value; }
+};
+
+// Any value, passed through unchecked.
+template <>
+struct NativeType<QuastraValue> {
+    static constexpr Type type = Type::Error;
+    static constexpr const char* kind = "a value";
+    static bool accepts(const QuastraValue&) { return true; }
+    static const QuastraValue& from(const QuastraValue& value) { return value; }
+    static QuastraValue to(QuastraValue value) { return value; }
+};
+
+// A channel, which the TypeChecker cannot tell from other values.
+template <>
+struct NativeType<std::shared_ptr<QuastraChannel>> {
+    static constexpr Type type = Type::Error;
+    static constexpr const char* kind = "a channel";
+    static bool accepts(const QuastraValue& value) {
+        const auto* callable = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+        return callable && dynamic_cast<QuastraChannel*>(callable->get());
+    }
+    static std::shared_ptr<QuastraChannel> from(const QuastraValue& value) {
+        return std::static_pointer_cast<QuastraChannel>(*std::get_if<std::shared_ptr<QuastraCallable>>(&value));
+    }
+    static QuastraValue to(std::shared_ptr<QuastraChannel> value) { return std::shared_ptr<QuastraCallable>(std::move(value)); }
+};
+
+template <typename Signature>
+class NativeBinding;
+
+template <typename R, typename... Args>
+class NativeBinding<R(Args...)> : public QuastraCallable {
+public:
+    using Function = R (*)(Args...);
+
+    NativeBinding(std::string name, Function function) : name(std::move(name)), function(function) {}
+
+    int arity() const override { return static_cast<int>(sizeof...(Args)); }
+
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override {
+        (void)interpreter;
+        return invoke(arguments, std::index_sequence_for<Args...>());
+    }
+
+    static NativeSignature signature() {
+        Type result = Type::Void;
+        if constexpr (!std::is_void_v<R>) result = NativeType<std::decay_t<R>>::type;
+        return {result, {NativeType<std::decay_t<Args>>::type...}};
+    }
+
+private:
+    template <size_t... I>
+    QuastraValue invoke(Arguments arguments, std::index_sequence<I...>) {
+        (void)arguments;
+        (check<std::decay_t<Args>>(arguments[I], I), ...);
+        if constexpr (std::is_void_v<R>) {
+            function(NativeType<std::decay_t<Args>>::from(arguments[I])...);
+            return false; // Natives without a result return false, like println.
+        } else {
+            return NativeType<std::decay_t<R>>::to(function(NativeType<std::decay_t<Args>>::from(arguments[I])...));
+        }
+    }
+
+    template <typename T>
+    void check(const QuastraValue& argument, size_t index) const {
+        if (NativeType<T>::accepts(argument)) return;
+        std::string position = sizeof...(Args) == 1 ? "" : " " + std::to_string(index + 1);
+        throw std::runtime_error("Argument" + position + " to " + name + " must be " + NativeType<T>::kind + ".");
+    }
+
+    std::string name; // For error messages.
+    Function function;
+};
+
+// Functions declared noexcept bind like the others.
+template <typename R, typename... Args>
+class NativeBinding<R(Args...) noexcept> : public NativeBinding<R(Args...)> {
+public:
+    using NativeBinding<R(Args...)>::NativeBinding;
+};
+
+// Adds `function` to `registry` as the native `name`, with its signature.
+template <typename Signature>
+void register_native(NativeRegistry& registry, const std::string& name, Signature* function) {
+    using Binding = NativeBinding<Signature>;
+    registry.add(name, std::make_shared<Binding>(name, function), Binding::signature());
+}
+
+// Defines `function` as the native `name` in every engine created from now
+// on, and tells the TypeChecker its signature.
+template <typename Signature>
+void register_native(const std::string& name, Signature* function) {
+    register_native(native_registry(), name, function);
+}
+
+} // namespace Quastra
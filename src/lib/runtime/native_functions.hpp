@@ -1,25 +1,92 @@
 #pragma once
 
-#include "quastra_callable.hpp"
+#include "core_io.hpp"
+#include "event_loop.hpp"
+#include "quastra_channel.hpp"
+#include "quastra_future.hpp"
 #include "quastra_value.hpp"
-#include <iostream>
-#include <vector>
-
-namespace Quastra {
-
-// A native C++ implementation of a "println" function.
-class PrintlnFunction : public QuastraCallable {
-public:
-    // println takes one argument.
-    int arity() const override { return 1; }
-
-    // The core logic that gets executed when the function is called.
-    QuastraValue call(Interpreter& interpreter, const std::vector<QuastraValue>& arguments) override {
-        (void)interpreter; // Interpreter is unused in this simple function.
-        print_value(arguments[0]);
-        std::cout << std::endl;
-        return false; // println returns nothing (represented as false for now).
+#include "task_scheduler.hpp"
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// The core natives, as plain functions. native_registry() binds them with
+// register_native, which checks and unpacks their arguments.
+namespace Quastra::Natives {
+
+// println(value): writes the value and a newline through core.io's
+// buffered standard output. Tasks print whole lines, never interleaved ones.
+inline void println(const QuastraValue& value) {
+    standard_output().println(value);
+}
+
+// print(value): println without the newline.
+inline void print(const QuastraValue& value) {
+    standard_output().print(value);
+}
+
+// write(text): writes a string as it is and returns its length in bytes.
+inline double write(std::string_view text) {
+    standard_output().write(text);
+    return static_cast<double>(text.size());
+}
+
+// flush(): writes out everything printed so far.
+inline void flush() {
+    standard_output().flush();
+}
+
+// read_line(): the next line of stdin without its newline, or false at the
+// end of the input. Pending output is flushed first, so prompts show.
+inline QuastraValue read_line() {
+    std::string line;
+    bool read;
+    {
+        TaskScheduler::Blocking blocking;
+        read = Quastra::read_line(line);
     }
-};
+    if (!read) return false;
+    return QuastraString(line);
+}
+
+// sleep(ms): a future that completes after `ms` milliseconds, on the
+// calling thread's event loop, so other async calls run while it waits.
+// The VirtualMachine defines its own on the loop of its fibers.
+inline QuastraValue sleep(double milliseconds) {
+    return EventLoop::current().timer(milliseconds);
+}
+
+// channel(capacity): a channel of at most `capacity` values, or an
+// unbounded one for 0, for async calls and tasks to pass values through.
+// A bounded channel allocates room for all its values up front, hence the
+// limit.
+inline std::shared_ptr<QuastraChannel> channel(double capacity) {
+    constexpr double max_capacity = 1 << 20;
+    if (!(capacity >= 0 && capacity <= max_capacity) || capacity != std::floor(capacity)) {
+        throw std::runtime_error("Argument to channel must be a whole number from 0 to 1048576.");
+    }
+    return std::make_shared<QuastraChannel>(static_cast<size_t>(capacity));
+}
+
+// send(channel, value): a future that completes with true once the value
+// is in the channel, or with false if the channel is closed first. Awaiting
+// it parks the calling fiber while the channel is full.
+inline QuastraValue send(const std::shared_ptr<QuastraChannel>& channel, const QuastraValue& value) {
+    return channel->send(value);
+}
+
+// receive(channel): a future of the oldest value in the channel, or of
+// false once the channel is closed and drained.
+inline QuastraValue receive(const std::shared_ptr<QuastraChannel>& channel) {
+    return channel->receive();
+}
+
+// close(channel): ends the channel. Pending and later sends complete with
+// false; receives get what was sent before, then false.
+inline void close(const std::shared_ptr<QuastraChannel>& channel) {
+    channel->close();
+}
 
-} // namespace Quastra
+} // namespace Quastra::Natives
@@ -0,0 +1,50 @@
+#include "native_registry.hpp"
+#include "native_binding.hpp"
+#include "native_functions.hpp"
+#include <algorithm>
+
+namespace Quastra {
+
+void NativeRegistry::add(const std::string& name, std::shared_ptr<QuastraCallable> function,
+                         NativeSignature signature) {
+    for (Native& native : natives) {
+        if (native.name != name) continue;
+        native.function = std::move(function);
+        native.signature = std::move(signature);
+        return;
+    }
+    natives.push_back({name, std::move(function), std::move(signature)});
+}
+
+void NativeRegistry::remove(const std::string& name) {
+    natives.erase(std::remove_if(natives.begin(), natives.end(),
+                                 [&name](const Native& native) { return native.name == name; }),
+                  natives.end());
+}
+
+const NativeRegistry::Native* NativeRegistry::find(const std::string& name) const {
+    for (const Native& native : natives) {
+        if (native.name == name) return &native;
+    }
+    return nullptr;
+}
+
+NativeRegistry& native_registry() {
+    static NativeRegistry registry = [] {
+        NativeRegistry core;
+        register_native(core, "println", Natives::println);
+        register_native(core, "sleep", Natives::sleep);
+        register_native(core, "print", Natives::print);
+        register_native(core, "write", Natives::write);
+        register_native(core, "flush", Natives::flush);
+        register_native(core, "read_line", Natives::read_line);
+        register_native(core, "channel", Natives::channel);
+        register_native(core, "send", Natives::send);
+        register_native(core, "receive", Natives::receive);
+        register_native(core, "close", Natives::close);
+        return core;
+    }();
+    return registry;
+}
+
+} // namespace Quastra
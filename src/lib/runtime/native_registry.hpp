@@ -0,0 +1,52 @@
+#pragma once
+
+#include "quastra_value.hpp"
+#include "../semantic/type.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// What the TypeChecker knows about a native: the type of its result and of
+// each parameter. Type::Error stands for any value and is not checked.
+struct NativeSignature {
+    Type result = Type::Error;
+    std::vector<Type> parameters;
+};
+
+// The native functions every engine defines as globals, and the signatures
+// the TypeChecker checks their calls against. Most are bound from plain C++
+// functions with register_native (see native_binding.hpp).
+class NativeRegistry {
+public:
+    struct Native {
+        std::string name;
+        std::shared_ptr<QuastraCallable> function;
+        NativeSignature signature;
+    };
+
+    // Adds a native, or replaces the one of the same name.
+    void add(const std::string& name, std::shared_ptr<QuastraCallable> function, NativeSignature signature);
+
+    // Removes the native called `name`, if there is one; those after it move
+    // down a slot.
+    void remove(const std::string& name);
+
+    // The native called `name`, or nullptr.
+    const Native* find(const std::string& name) const;
+
+    // Every native, in the order they get global slots.
+    const std::vector<Native>& all() const { return natives; }
+
+private:
+    std::vector<Native> natives;
+};
+
+// The registry the engines, the Resolver and the TypeChecker read, holding
+// the core natives to begin with. Natives are stateless and shared by every
+// engine. It is not synchronised: register natives at startup, before any
+// program is checked or run.
+NativeRegistry& native_registry();
+
+} // namespace Quastra
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../interpreter/interpreter.hpp"
+#include "quastra_future.hpp"
 #include "quastra_value.hpp"
 #include <vector>
 #include <memory>
@@ -10,14 +11,16 @@ namespace Quastra {
 // Forward declare Interpreter to avoid circular dependencies.
 class Interpreter;
 
-// An interface for any object that can be called like a function.
-class QuastraCallable {
+// An interface for any object that can be called like a function. Callables
+// are always owned by shared_ptr.
+class QuastraCallable : public std::enable_shared_from_this<QuastraCallable> {
 public:
     virtual ~QuastraCallable() = default;
     // The number of arguments the function expects.
     virtual int arity() const = 0;
     // The core execution logic of the function.
-    virtual QuastraValue call(Interpreter& interpreter, const std::vector<QuastraValue>& arguments) = 0;
+    // The arguments are the caller's; see Arguments.
+    virtual QuastraValue call(Interpreter& interpreter, Arguments arguments) = 0;
 };
 
 // A runtime representation of a Quastra function declared in the source code.
@@ -30,18 +33,26 @@ public:
         return declaration.params.size();
     }
 
-    QuastraValue call(Interpreter& interpreter, const std::vector<QuastraValue>& arguments) override {
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override {
         // Create a new environment for the function's execution, enclosed by the function's closure.
         auto environment = std::make_shared<Environment>(closure);
         for (size_t i = 0; i < declaration.params.size(); ++i) {
-            environment->define(declaration.params[i].lexeme, arguments[i]);
+            environment->define(declaration.params[i].lexeme, std::move(arguments[i]));
         }
 
         // Execute the function's body in the new environment.
-        interpreter.execute_block(declaration.body, environment);
-        return false; // Default return value if no return statement is hit.
+        if (!declaration.is_async) {
+            interpreter.execute_block(declaration.body, environment);
+            return false; // Default return value if no return statement is hit.
+        }
+        // An async function runs on a fiber until it first waits. The
+        // resolver marks no tail calls in it, so only returns unwind there.
+        return interpreter.run_async(declaration.body, std::move(environment));
     }
 
+    const AST::FunctionStmt& get_declaration() const { return declaration; }
+    const std::shared_ptr<Environment>& get_closure() const { return closure; }
+
 private:
     const AST::FunctionStmt& declaration;
     std::shared_ptr<Environment> closure; // The environment where the function was declared.
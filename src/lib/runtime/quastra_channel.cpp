@@ -0,0 +1,93 @@
+#include "quastra_channel.hpp"
+#include "mailbox.hpp"
+#include <stdexcept>
+#include <utility>
+
+namespace Quastra {
+
+struct QuastraChannel::Sending : std::enable_shared_from_this<Sending> {
+    std::weak_ptr<QuastraChannel> target;
+    QuastraValue value;
+    std::weak_ptr<QuastraFuture> future;
+    std::shared_ptr<Mailbox> mailbox;
+
+    void attempt() {
+        std::shared_ptr<QuastraChannel> owner = target.lock();
+        if (!owner) return;
+        std::shared_ptr<QuastraFuture> waiter = future.lock();
+        if (!waiter) {
+            owner->channel.wake_sender(); // Given up: the next sender may go.
+            return;
+        }
+        try {
+            if (owner->channel.try_send(value)) {
+                waiter->complete(true);
+                return;
+            }
+        } catch (const std::runtime_error&) {
+            waiter->complete(false); // Closed.
+            return;
+        }
+        mailbox->expect(waiter);
+        owner->channel.when_not_full([self = shared_from_this()] {
+            self->mailbox->post([self] { self->attempt(); });
+        });
+    }
+};
+
+struct QuastraChannel::Receiving : std::enable_shared_from_this<Receiving> {
+    std::weak_ptr<QuastraChannel> target;
+    std::weak_ptr<QuastraFuture> future;
+    std::shared_ptr<Mailbox> mailbox;
+
+    void attempt() {
+        std::shared_ptr<QuastraChannel> owner = target.lock();
+        if (!owner) return;
+        std::shared_ptr<QuastraFuture> waiter = future.lock();
+        if (!waiter) {
+            owner->channel.wake_receiver();
+            return;
+        }
+        QuastraValue value;
+        bool drained = owner->channel.drained();
+        if (owner->channel.try_receive(value)) {
+            waiter->complete(std::move(value));
+        } else if (drained) {
+            waiter->complete(false);
+        } else {
+            mailbox->expect(waiter);
+            owner->channel.when_not_empty([self = shared_from_this()] {
+                self->mailbox->post([self] { self->attempt(); });
+            });
+        }
+    }
+};
+
+QuastraValue QuastraChannel::call(Interpreter& interpreter, Arguments arguments) {
+    (void)interpreter;
+    (void)arguments;
+    throw std::runtime_error("Can only call functions and classes.");
+}
+
+std::shared_ptr<QuastraFuture> QuastraChannel::send(QuastraValue value) {
+    auto future = std::make_shared<QuastraFuture>();
+    auto sending = std::make_shared<Sending>();
+    sending->target = std::static_pointer_cast<QuastraChannel>(shared_from_this());
+    sending->value = std::move(value);
+    sending->future = future;
+    sending->mailbox = Mailbox::current();
+    sending->attempt();
+    return future;
+}
+
+std::shared_ptr<QuastraFuture> QuastraChannel::receive() {
+    auto future = std::make_shared<QuastraFuture>();
+    auto receiving = std::make_shared<Receiving>();
+    receiving->target = std::static_pointer_cast<QuastraChannel>(shared_from_this());
+    receiving->future = future;
+    receiving->mailbox = Mailbox::current();
+    receiving->attempt();
+    return future;
+}
+
+} // namespace Quastra
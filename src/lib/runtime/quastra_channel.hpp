@@ -0,0 +1,47 @@
+#pragma once
+
+#include "channel.hpp"
+#include "quastra_callable.hpp"
+#include "quastra_future.hpp"
+#include "quastra_value.hpp"
+#include <cstddef>
+#include <memory>
+
+namespace Quastra {
+
+// A Channel of Quastra values, as the channel() native makes them. Sending
+// and receiving give futures, so a fiber that awaits one parks, and the
+// thread runs its other fibers, rather than blocking. The wait ends on the
+// thread that started it: the channel tells that thread's Mailbox when to
+// try again. A thread blocks only once every fiber of its loop waits, and
+// then only while tasks on other threads could still end the wait.
+//
+// Values are numbers, strings, callables and futures, so a channel is a
+// callable, which cannot be called.
+class QuastraChannel : public QuastraCallable {
+public:
+    // At most `capacity` values, or unbounded for 0.
+    explicit QuastraChannel(size_t capacity) : channel(capacity) {}
+
+    int arity() const override { return 0; }
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override;
+
+    // A future that completes with true once `value` is in the channel, or
+    // with false if the channel is closed first.
+    std::shared_ptr<QuastraFuture> send(QuastraValue value);
+    // A future of the oldest value, or of false once the channel is closed
+    // and drained.
+    std::shared_ptr<QuastraFuture> receive();
+    void close() { channel.close(); }
+
+private:
+    // One attempt at a send or receive; failing, it asks the channel to
+    // make the next one through the calling thread's mailbox. Attempts stop
+    // when nothing holds the future any more.
+    struct Sending;
+    struct Receiving;
+
+    Channel<QuastraValue> channel;
+};
+
+} // namespace Quastra
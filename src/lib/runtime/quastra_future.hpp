@@ -0,0 +1,53 @@
+#pragma once
+
+#include "quastra_value.hpp"
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace Quastra {
+
+// The result of calling an `async fn`, which `await` waits for. A future is
+// pending until complete() gives it a value; it then runs the callbacks
+// registered with on_complete(), in order. The event loops (the
+// VirtualMachine's, and EventLoop for the other engines) use those to wake
+// the fibers waiting for it.
+//
+// Futures belong to the thread running the program and are not
+// synchronised.
+class QuastraFuture {
+public:
+    QuastraFuture() = default;
+    explicit QuastraFuture(QuastraValue value) : done(true), value(std::move(value)) {}
+
+    QuastraFuture(const QuastraFuture&) = delete;
+    QuastraFuture& operator=(const QuastraFuture&) = delete;
+
+    bool is_done() const { return done; }
+    // The value, once done.
+    const QuastraValue& get_value() const { return value; }
+
+    void complete(QuastraValue result) {
+        done = true;
+        value = std::move(result);
+        std::vector<std::function<void()>> ready = std::move(waiters);
+        waiters.clear();
+        for (auto& waiter : ready) waiter();
+    }
+
+    // Runs `waiter` once the future completes, or now if it has.
+    void on_complete(std::function<void()> waiter) {
+        if (done) {
+            waiter();
+        } else {
+            waiters.push_back(std::move(waiter));
+        }
+    }
+
+private:
+    bool done = false;
+    QuastraValue value = false;
+    std::vector<std::function<void()>> waiters;
+};
+
+} // namespace Quastra
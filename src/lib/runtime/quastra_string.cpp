@@ -0,0 +1,141 @@
+#include "quastra_string.hpp"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Quastra {
+
+namespace {
+
+// Concatenations shorter than this are copied into a flat string; a rope
+// node costs more than copying a few dozen characters.
+constexpr size_t rope_threshold = 64;
+
+} // namespace
+
+// A flat buffer, or a rope node whose characters are those of `left`
+// followed by those of `right` until it is flattened. Flattening fills
+// `flat` and drops the halves, under `mutex`; `ready` says `flat` is final.
+struct QuastraString::Node {
+    explicit Node(std::string text) : length(text.size()), flat(std::move(text)), ready(true) {}
+    Node(QuastraString left, QuastraString right)
+        : length(left.size() + right.size()), left(std::move(left)), right(std::move(right)) {}
+
+    // Long appends make deep ropes; release them without recursing.
+    ~Node() {
+        std::vector<std::shared_ptr<Node>> pending;
+        if (left.node) pending.push_back(std::move(left.node));
+        if (right.node) pending.push_back(std::move(right.node));
+        while (!pending.empty()) {
+            std::shared_ptr<Node> node = std::move(pending.back());
+            pending.pop_back();
+            if (node.use_count() != 1) continue;
+            if (node->left.node) pending.push_back(std::move(node->left.node));
+            if (node->right.node) pending.push_back(std::move(node->right.node));
+        }
+    }
+
+    const std::string& flatten();
+
+    const size_t length;
+    std::string flat;
+    QuastraString left;
+    QuastraString right;
+    std::atomic<bool> ready{false};
+    std::mutex mutex;
+};
+
+// Walks the rope iteratively, since appending in a loop makes it as deep as
+// the loop is long.
+const std::string& QuastraString::Node::flatten() {
+    if (ready.load(std::memory_order_acquire)) return flat;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready.load(std::memory_order_relaxed)) return flat;
+
+    std::string text;
+    text.reserve(length);
+    std::vector<QuastraString> pending{right, left};
+    while (!pending.empty()) {
+        QuastraString part = std::move(pending.back());
+        pending.pop_back();
+        Node* node = part.node.get();
+        if (!node) {
+            text.append(part.small, part.small_size);
+            continue;
+        }
+        if (!node->ready.load(std::memory_order_acquire)) {
+            std::unique_lock<std::mutex> inner(node->mutex);
+            if (!node->ready.load(std::memory_order_relaxed)) {
+                pending.push_back(node->right);
+                pending.push_back(node->left);
+                continue;
+            }
+        }
+        text += node->flat;
+    }
+
+    flat = std::move(text);
+    left = QuastraString();
+    right = QuastraString();
+    ready.store(true, std::memory_order_release);
+    return flat;
+}
+
+QuastraString::QuastraString(std::string_view text) {
+    if (text.size() <= inline_capacity) {
+        std::memcpy(small, text.data(), text.size());
+        small_size = static_cast<uint8_t>(text.size());
+    } else {
+        node = std::make_shared<Node>(std::string(text));
+    }
+}
+
+const QuastraString& QuastraString::intern(std::string_view text) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, QuastraString> table;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = table.find(std::string(text));
+    if (it == table.end()) it = table.emplace(std::string(text), QuastraString(text)).first;
+    return it->second;
+}
+
+QuastraString QuastraString::concat(const QuastraString& left, const QuastraString& right) {
+    if (right.empty()) return left;
+    if (left.empty()) return right;
+    size_t length = left.size() + right.size();
+    if (length < rope_threshold) {
+        std::string text;
+        text.reserve(length);
+        text += left.view();
+        text += right.view();
+        return QuastraString(std::string_view(text));
+    }
+    return QuastraString(std::make_shared<Node>(left, right));
+}
+
+size_t QuastraString::size() const {
+    return node ? node->length : small_size;
+}
+
+std::string_view QuastraString::view() const {
+    if (!node) return std::string_view(small, small_size);
+    return node->flatten();
+}
+
+bool QuastraString::is_rope() const {
+    return node && !node->ready.load(std::memory_order_acquire);
+}
+
+bool QuastraString::operator==(const QuastraString& other) const {
+    if (node && node == other.node) return true;
+    if (size() != other.size()) return false;
+    return view() == other.view();
+}
+
+std::ostream& operator<<(std::ostream& os, const QuastraString& string) {
+    return os << string.view();
+}
+
+} // namespace Quastra
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace Quastra {
+
+// A Quastra string value. Strings are immutable, so copies share their
+// characters instead of duplicating them:
+//  - up to `inline_capacity` characters are stored in the value itself;
+//  - longer strings live in a reference-counted buffer;
+//  - concatenating long strings builds a rope node pointing at both halves,
+//    which is flattened into one buffer the first time its characters are
+//    read. Appending to a string in a loop is then linear, not quadratic.
+// Flattening is thread-safe, so values may be shared between threads.
+class QuastraString {
+public:
+    static constexpr size_t inline_capacity = 15;
+
+    QuastraString() = default;
+    QuastraString(std::string_view text);
+    QuastraString(const char* text) : QuastraString(std::string_view(text)) {}
+    QuastraString(const std::string& text) : QuastraString(std::string_view(text)) {}
+
+    // The one shared copy of `text`, which lives as long as the program. Used
+    // for string literals, so evaluating one never allocates.
+    static const QuastraString& intern(std::string_view text);
+
+    static QuastraString concat(const QuastraString& left, const QuastraString& right);
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+    // Flattens a rope first; the view is valid while any copy of the string is.
+    std::string_view view() const;
+    std::string str() const { return std::string(view()); }
+
+    // True if the string is a rope that has not been flattened yet.
+    bool is_rope() const;
+
+    bool operator==(const QuastraString& other) const;
+    bool operator!=(const QuastraString& other) const { return !(*this == other); }
+
+private:
+    struct Node;
+    QuastraString(std::shared_ptr<Node> node) : node(std::move(node)) {}
+
+    std::shared_ptr<Node> node; // Null for inline strings.
+    uint8_t small_size = 0;
+    char small[inline_capacity] = {};
+};
+
+std::ostream& operator<<(std::ostream& os, const QuastraString& string);
+
+} // namespace Quastra
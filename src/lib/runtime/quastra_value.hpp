@@ -1,16 +1,38 @@
 #pragma once
 
+#include "quastra_string.hpp"
 #include <variant>
 #include <string>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 namespace Quastra {
 
 class QuastraCallable; // Forward declaration
+class QuastraFuture;   // See quastra_future.hpp.
 
 // A variant-based class to represent any possible value in Quastra at runtime.
-using QuastraValue = std::variant<double, bool, std::string, std::shared_ptr<QuastraCallable>>;
+using QuastraValue = std::variant<double, bool, QuastraString, std::shared_ptr<QuastraCallable>,
+                                  std::shared_ptr<QuastraFuture>>;
+
+// The arguments of a call: a view of values the caller owns, usually slots
+// on the Interpreter's ValueStack. They stay valid for the whole call, and
+// the callee may move out of them.
+class Arguments {
+public:
+    Arguments(QuastraValue* data, size_t size) : values(data), count(size) {}
+    Arguments(std::vector<QuastraValue>& values) : values(values.data()), count(values.size()) {}
+
+    size_t size() const { return count; }
+    QuastraValue& operator[](size_t i) const { return values[i]; }
+    QuastraValue* begin() const { return values; }
+    QuastraValue* end() const { return values + count; }
+
+private:
+    QuastraValue* values;
+    size_t count;
+};
 
 // Helper function to print a QuastraValue, useful for debugging.
 inline void print_value(const QuastraValue& value) {
@@ -19,6 +41,8 @@ inline void print_value(const QuastraValue& value) {
             std::cout << (arg ? "true" : "false");
         } else if constexpr (std::is_same_v<decltype(arg), const std::shared_ptr<QuastraCallable>&>) {
             std::cout << "<function>";
+        } else if constexpr (std::is_same_v<decltype(arg), const std::shared_ptr<QuastraFuture>&>) {
+            std::cout << "<future>";
         } else {
             std::cout << arg;
         }
@@ -0,0 +1,256 @@
+#include "task_scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <utility>
+#include <stdexcept>
+
+namespace Quastra {
+
+namespace {
+
+// The pool of the worker or spare running on this thread, if any, and the
+// worker's deque; spares have none and use workers.size().
+thread_local TaskScheduler* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+// Tasks running on this thread: more than one while a task waits for a
+// group and runs queued tasks meanwhile.
+thread_local size_t running_here = 0;
+thread_local size_t programs_here = 0;
+
+size_t random_index(size_t bound) {
+    thread_local std::minstd_rand generator(static_cast<unsigned>(
+        std::hash<std::thread::id>()(std::this_thread::get_id())));
+    return std::uniform_int_distribution<size_t>(0, bound - 1)(generator);
+}
+
+} // namespace
+
+std::atomic<size_t>& TaskScheduler::active() {
+    static std::atomic<size_t> count{0};
+    return count;
+}
+
+std::atomic<size_t>& TaskScheduler::programs() {
+    static std::atomic<size_t> count{0};
+    return count;
+}
+
+bool TaskScheduler::others_running() {
+    return active().load(std::memory_order_acquire) + programs().load(std::memory_order_acquire) >
+           running_here + programs_here;
+}
+
+TaskScheduler::TaskScheduler() : TaskScheduler(std::max(1u, std::thread::hardware_concurrency())) {}
+
+TaskScheduler::TaskScheduler(size_t count) {
+    for (size_t i = 0; i < std::max<size_t>(count, 1); ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    retired.wait(lock, [this] { return spares == 0; });
+}
+
+TaskScheduler& TaskScheduler::shared() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+void TaskScheduler::submit(Task task) {
+    // Programs that never spawn never start a thread.
+    std::call_once(started, [this] {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i]->thread = std::thread([this, i] { work(i); });
+        }
+    });
+    active().fetch_add(1, std::memory_order_acq_rel);
+    size_t index = current_pool == this && current_worker < workers.size()
+        ? current_worker
+        : next_victim.fetch_add(1) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this with a worker about to sleep, so the
+    // notification cannot be lost.
+    { std::lock_guard<std::mutex> lock(idle_mutex); }
+    idle.notify_one();
+}
+
+bool TaskScheduler::run_one() {
+    Task task;
+    size_t own = current_pool == this ? current_worker : workers.size();
+    if ((own < workers.size() && pop(own, task)) || steal(own, task)) {
+        run(task);
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::work(size_t index) {
+    current_pool = this;
+    current_worker = index;
+    while (true) {
+        Task task;
+        if (pop(index, task) || steal(index, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        if (stopping) return;
+        idle.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) != 0; });
+    }
+}
+
+TaskScheduler::Blocking::Blocking() : pool(current_pool) {
+    if (pool) pool->begin_blocking();
+}
+
+TaskScheduler::Blocking::~Blocking() {
+    if (pool) pool->end_blocking();
+}
+
+TaskScheduler::Program::Program() {
+    programs_here++;
+    programs().fetch_add(1, std::memory_order_acq_rel);
+}
+
+TaskScheduler::Program::~Program() {
+    programs().fetch_sub(1, std::memory_order_acq_rel);
+    programs_here--;
+}
+
+void TaskScheduler::begin_blocking() {
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    blocked++;
+    if (!stopping && spares < blocked && spares < max_spares) {
+        spares++;
+        std::thread([this] { stand_in(); }).detach();
+    }
+}
+
+void TaskScheduler::end_blocking() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        blocked--;
+    }
+    idle.notify_all(); // A spare too many retires.
+}
+
+void TaskScheduler::stand_in() {
+    current_pool = this;
+    current_worker = workers.size();
+    std::unique_lock<std::mutex> lock(idle_mutex);
+    while (!stopping && spares <= blocked) {
+        lock.unlock();
+        Task task;
+        if (steal(workers.size(), task)) {
+            run(task);
+            lock.lock();
+            continue;
+        }
+        lock.lock();
+        idle.wait(lock, [this] {
+            return stopping || spares > blocked || queued.load(std::memory_order_acquire) != 0;
+        });
+    }
+    spares--;
+    // The destructor waits for this under the lock, so nothing of the pool
+    // is touched once the lock is released.
+    retired.notify_all();
+}
+
+// The owner takes its newest task.
+bool TaskScheduler::pop(size_t index, Task& task) {
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) return false;
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+// A thief takes the oldest task of the first victim that has one, starting
+// from a random worker other than itself.
+bool TaskScheduler::steal(size_t thief, Task& task) {
+    if (queued.load(std::memory_order_acquire) == 0) return false;
+    size_t start = random_index(workers.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        size_t victim = (start + i) % workers.size();
+        if (victim == thief) continue;
+        Worker& worker = *workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) continue;
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::run(Task& task) {
+    running_here++;
+    task();
+    // Release what the task captured before it stops counting as running.
+    task = nullptr;
+    running_here--;
+    active().fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void TaskGroup::spawn(std::function<void()> body) {
+    pending.fetch_add(1, std::memory_order_acq_rel);
+    scheduler.submit([this, body = std::move(body)]() mutable {
+        std::string error;
+        bool failed = false;
+        std::exception_ptr thrown;
+        try {
+            body();
+        } catch (const std::runtime_error& failure) {
+            error = failure.what();
+            failed = true;
+        } catch (...) {
+            thrown = std::current_exception();
+        }
+        body = nullptr;
+        // The waiter takes the mutex before it returns, so the group stays
+        // alive until this unlocks it.
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failed && !has_error) {
+            has_error = true;
+            first_error = std::move(error);
+        }
+        if (thrown && !exception) exception = std::move(thrown);
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) finished.notify_all();
+    });
+}
+
+void TaskGroup::wait() {
+    join();
+    if (exception) std::rethrow_exception(std::exchange(exception, nullptr));
+}
+
+void TaskGroup::join() {
+    while (pending.load(std::memory_order_acquire) != 0) {
+        if (scheduler.run_one()) continue;
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait_for(lock, std::chrono::milliseconds(1),
+                          [this] { return pending.load(std::memory_order_acquire) == 0; });
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+}
+
+} // namespace Quastra
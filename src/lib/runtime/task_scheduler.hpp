@@ -0,0 +1,166 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Quastra {
+
+// A work-stealing thread pool for `spawn`ed tasks. Each worker has a deque
+// of its own: it pushes the tasks it spawns at the back and runs them from
+// the back (newest first, while their data is warm), and an idle worker
+// steals the oldest task from the front of a randomly chosen victim's deque.
+// Tasks submitted from outside the pool are spread over the workers.
+//
+// Threads that wait for tasks (see TaskGroup) run queued tasks meanwhile
+// instead of blocking, so nested scopes cannot starve the pool. A worker
+// that has to block (see Blocking) is stood in for by a spare thread, up to
+// max_spares of them.
+class TaskScheduler {
+public:
+    using Task = std::function<void()>;
+
+    // One worker per hardware thread.
+    TaskScheduler();
+    explicit TaskScheduler(size_t workers);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // The pool the Interpreter spawns on.
+    static TaskScheduler& shared();
+
+    // Queues a task, starting the workers first if this is the first one.
+    void submit(Task task);
+
+    // Runs one queued task on the calling thread, taking it from the
+    // thread's own deque if it is a worker, else stealing one. Returns
+    // false if there was nothing to run.
+    bool run_one();
+
+    size_t worker_count() const { return workers.size(); }
+
+    // True while any task submitted to any pool has not finished. Code that
+    // caches into shared state (environments, AST nodes) checks this and
+    // takes locks or skips the cache while tasks may run concurrently.
+    static bool concurrent() { return active().load(std::memory_order_acquire) != 0; }
+
+    // True while a task or program other than those the calling thread is
+    // running has not finished, so something may yet happen that the
+    // thread waits for.
+    static bool others_running();
+
+    // Spare threads a pool runs at most. Past that, a blocked worker has no
+    // stand-in, and its queued tasks wait for a thread to come free.
+    static constexpr size_t max_spares = 64;
+
+    // Marks the calling thread as blocked while it is alive, e.g. waiting
+    // on a channel. If the thread is one of a pool's, a spare thread runs
+    // queued tasks in its place until it is done, so a task waiting for
+    // another one cannot keep that one from running, however few workers
+    // there are (while fewer than max_spares are blocked).
+    class Blocking {
+    public:
+        Blocking();
+        ~Blocking();
+
+        Blocking(const Blocking&) = delete;
+        Blocking& operator=(const Blocking&) = delete;
+
+    private:
+        TaskScheduler* pool;
+    };
+
+    // Counts the calling thread as running a program's top level while it
+    // is alive. That thread spawns the tasks, and may pass them values, so
+    // others_running() counts it as it does a task.
+    class Program {
+    public:
+        Program();
+        ~Program();
+
+        Program(const Program&) = delete;
+        Program& operator=(const Program&) = delete;
+    };
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    static std::atomic<size_t>& active();
+    static std::atomic<size_t>& programs();
+
+    void work(size_t index);
+    // Runs stolen tasks while more threads are blocked than spares run.
+    void stand_in();
+    void begin_blocking();
+    void end_blocking();
+    bool pop(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    void run(Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::once_flag started;
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_victim{0};
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    bool stopping = false;
+    // Guarded by idle_mutex: pool threads inside a Blocking, and the spare
+    // threads alive, which signal `retired` as they exit.
+    size_t blocked = 0;
+    size_t spares = 0;
+    std::condition_variable retired;
+};
+
+// The tasks a `scope` (or a whole program, or a task) waits for. The first
+// runtime error a task raises is kept for the waiter to report; any other
+// exception is rethrown to the waiter.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskScheduler& scheduler) : scheduler(scheduler) {}
+    // A group is always waited for before it goes away.
+    ~TaskGroup() { join(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Runs `body` as a task of the group. A std::runtime_error it throws is
+    // recorded rather than propagated; the first other exception is kept
+    // for wait() to rethrow.
+    void spawn(std::function<void()> body);
+
+    // Returns once every task of the group has finished, running queued
+    // tasks while it waits. Then rethrows the exception kept by spawn, if any.
+    void wait();
+
+    // After wait(): whether a task failed, and the first failure's message.
+    bool failed() const { return has_error; }
+    const std::string& error() const { return first_error; }
+
+private:
+    // wait() without the rethrow.
+    void join();
+
+    TaskScheduler& scheduler;
+    std::atomic<size_t> pending{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool has_error = false;
+    std::string first_error;
+    std::exception_ptr exception;
+};
+
+} // namespace Quastra
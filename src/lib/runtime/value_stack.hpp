@@ -0,0 +1,91 @@
+#pragma once
+
+#include "quastra_value.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace Quastra {
+
+// The Interpreter's stack of call arguments. Each call takes a run of
+// contiguous slots, evaluates its arguments straight into them and hands
+// them to the callee as Arguments. Slots live in fixed segments that are
+// never moved or freed, so a run stays where it is while nested calls push
+// more, and once the stack has grown to a program's depth calls allocate
+// nothing. Segments start small and double in size up to segment_size, so
+// an interpreter that only makes a few calls, like those of tasks and
+// async calls, stays cheap.
+class ValueStack {
+public:
+    // A position to release back to.
+    struct Mark {
+        size_t segment;
+        size_t top;
+    };
+
+    // Releases everything taken after it was made, when it goes out of scope.
+    class Scope {
+    public:
+        explicit Scope(ValueStack& stack) : stack(stack), mark(stack.mark()) {}
+        ~Scope() { stack.release(mark); }
+        // Releases what was taken so far, keeping the scope open.
+        void rewind() { stack.release(mark); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        ValueStack& stack;
+        Mark mark;
+    };
+
+    Mark mark() const { return {current, segments.empty() ? 0 : segments[current].top}; }
+
+    // `count` contiguous slots, each holding 0 until assigned.
+    QuastraValue* take(size_t count) {
+        if (segments.empty()) segments.emplace_back(std::max(count, first_segment_size));
+        if (segments[current].top + count > segments[current].capacity) {
+            ++current;
+            if (current == segments.size()) {
+                size_t size = std::min(segments.back().capacity * 2, segment_size);
+                segments.emplace_back(std::max(count, size));
+            } else if (segments[current].capacity < count) {
+                segments[current] = Segment(count);
+            }
+        }
+        Segment& segment = segments[current];
+        QuastraValue* slots = segment.values.get() + segment.top;
+        segment.top += count;
+        return slots;
+    }
+
+    // Clears the slots taken since `mark`, dropping what they refer to.
+    void release(Mark mark) {
+        if (segments.empty()) return;
+        while (current > mark.segment) {
+            clear(segments[current], 0);
+            --current;
+        }
+        clear(segments[current], mark.top);
+    }
+
+private:
+    static constexpr size_t first_segment_size = 16;
+    static constexpr size_t segment_size = 1024;
+
+    struct Segment {
+        explicit Segment(size_t capacity) : values(new QuastraValue[capacity]), capacity(capacity) {}
+        std::unique_ptr<QuastraValue[]> values;
+        size_t capacity;
+        size_t top = 0;
+    };
+
+    static void clear(Segment& segment, size_t top) {
+        for (size_t i = top; i < segment.top; ++i) segment.values[i] = 0.0;
+        segment.top = top;
+    }
+
+    std::vector<Segment> segments;
+    size_t current = 0;
+};
+
+} // namespace Quastra
@@ -1,11 +1,36 @@
 #include "resolver.hpp"
+#include "../runtime/native_registry.hpp"
 #include <iostream>
 
 namespace Quastra {
 
+namespace {
+
+// The natives every engine defines in the global scope.
+bool is_native(const std::string& name) {
+    return native_registry().find(name) != nullptr;
+}
+
+} // namespace
+
 bool Resolver::resolve(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
-    // Create the global scope before starting.
+    // Create the global scope before starting. Natives and top-level
+    // functions are visible everywhere, so calls may come before definitions.
     begin_scope();
+    for (const auto& native : native_registry().all()) {
+        scopes.back()[native.name] = true;
+    }
+    for (const std::string& name : predefined) {
+        scopes.back()[name] = true;
+    }
+    for (const auto& statement : statements) {
+        if (auto function = dynamic_cast<const AST::FunctionStmt*>(statement.get())) {
+            scopes.back()[function->name.lexeme] = true;
+            globals.insert(function->name.lexeme);
+        } else if (auto var = dynamic_cast<const AST::VarDecl*>(statement.get())) {
+            globals.insert(var->name.lexeme);
+        }
+    }
     for (const auto& statement : statements) {
         if (statement) {
             statement->accept(*this);
@@ -13,6 +38,14 @@ bool Resolver::resolve(const std::vector<std::unique_ptr<AST::Stmt>>& statements
     }
     // Clean up the global scope at the end.
     end_scope();
+    // A name that is never declared locally always means the global, even
+    // in a closure that runs after a later local declaration.
+    for (const AST::Call* call : global_calls) {
+        auto callee = dynamic_cast<const AST::Variable*>(call->callee.get());
+        call->is_global_call = !local_names.count(callee->name.lexeme);
+    }
+    global_calls.clear();
+    local_names.clear();
     return !had_error;
 }
 
@@ -24,14 +57,29 @@ void Resolver::end_scope() {
     scopes.pop_back();
 }
 
+bool Resolver::is_declared(const std::string& name) const {
+    if (scope_of(name) >= 0) return true;
+    return !functions.empty() && globals.count(name);
+}
+
+int Resolver::scope_of(const std::string& name) const {
+    for (int i = static_cast<int>(scopes.size()) - 1; i >= 0; --i) {
+        if (scopes[i].count(name)) return i;
+    }
+    return -1;
+}
+
 // --- Visitor Implementations ---
 
 void Resolver::visit(const AST::Block& stmt) {
+    bool spawned = stmt.kind == AST::BlockKind::Spawn;
+    if (spawned) task_depth++;
     begin_scope();
     for (const auto& statement : stmt.statements) {
-        statement->accept(*this);
+        if (statement) statement->accept(*this);
     }
     end_scope();
+    if (spawned) task_depth--;
 }
 
 void Resolver::visit(const AST::VarDecl& stmt) {
@@ -44,6 +92,8 @@ void Resolver::visit(const AST::VarDecl& stmt) {
         }
     }
 
+    if (scopes.size() > 1) local_names.insert(stmt.name.lexeme);
+
     // Add the variable to the current scope.
     // We mark it as "defined" but not yet "initialized".
     if (!scopes.empty()) {
@@ -63,12 +113,7 @@ void Resolver::visit(const AST::VarDecl& stmt) {
 
 void Resolver::visit(const AST::Variable& expr) {
     // Check if the variable exists in any scope, starting from the innermost.
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-        if (it->count(expr.name.lexeme)) {
-            // Found it. A real compiler might store more info here.
-            return;
-        }
-    }
+    if (is_declared(expr.name.lexeme)) return;
 
     std::cerr << "Semantic Error: Undefined variable '" << expr.name.lexeme << "'.\n";
     had_error = true;
@@ -78,11 +123,7 @@ void Resolver::visit(const AST::Assign& expr) {
     // First, resolve the expression being assigned to ensure it's valid.
     expr.value->accept(*this);
     // Then, check if the variable we're assigning to exists.
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-        if (it->count(expr.name.lexeme)) {
-            return; // It's a valid assignment target.
-        }
-    }
+    if (is_declared(expr.name.lexeme)) return;
 
     std::cerr << "Semantic Error: Assignment to undeclared variable '" << expr.name.lexeme << "'.\n";
     had_error = true;
@@ -110,24 +151,60 @@ void Resolver::visit(const AST::WhileStmt& stmt) {
 }
 
 void Resolver::visit(const AST::FunctionStmt& stmt) {
-    // For now, we'll just resolve the body.
-    // A full implementation would handle parameters.
+    // The name is declared before the body so the function can call itself.
+    scopes.back()[stmt.name.lexeme] = true;
+    if (scopes.size() > 1) local_names.insert(stmt.name.lexeme);
+    functions.emplace_back(&stmt, static_cast<int>(scopes.size()) - 1);
+    // A function declared in a task returns from its own calls.
+    int enclosing_task_depth = task_depth;
+    task_depth = 0;
+
+    // Parameters get a scope of their own; the body may shadow them.
+    begin_scope();
+    for (const auto& param : stmt.params) {
+        scopes.back()[param.lexeme] = true;
+        local_names.insert(param.lexeme);
+    }
     begin_scope();
     for(const auto& s : stmt.body) {
         s->accept(*this);
     }
     end_scope();
+    end_scope();
+    task_depth = enclosing_task_depth;
+    functions.pop_back();
 }
 
 void Resolver::visit(const AST::ReturnStmt& stmt) {
-    if (stmt.value) {
-        stmt.value->accept(*this);
+    if (task_depth > 0) {
+        std::cerr << "Semantic Error: Cannot return from a spawned task.\n";
+        had_error = true;
     }
+    if (!stmt.value) return;
+    stmt.value->accept(*this);
+
+    // Nothing runs after `return f(...)` in the caller, so the call can
+    // replace the caller's frame instead of growing the stack.
+    auto call = dynamic_cast<const AST::Call*>(stmt.value.get());
+    if (!call || functions.empty() || task_depth > 0) return;
+    const auto& [function, function_scope] = functions.back();
+    // An async function returns a future of the call's result, not the call.
+    if (function->is_async) return;
+    call->is_tail_call = true;
+    auto callee = dynamic_cast<const AST::Variable*>(call->callee.get());
+    call->is_self_call = callee && callee->name.lexeme == function->name.lexeme &&
+                         scope_of(callee->name.lexeme) == function_scope &&
+                         call->arguments.size() == function->params.size();
 }
 
 void Resolver::visit(const AST::Literal& expr) { (void)expr; /* Literals need no resolution */ }
 
 void Resolver::visit(const AST::Unary& expr) {
+    // Top-level code may await too; it runs until the future completes.
+    if (expr.op.type == TokenType::Await && !functions.empty() && !functions.back().first->is_async) {
+        std::cerr << "Semantic Error: Cannot use 'await' outside an async function.\n";
+        had_error = true;
+    }
     expr.right->accept(*this);
 }
 
@@ -137,6 +214,12 @@ void Resolver::visit(const AST::Binary& expr) {
 }
 
 void Resolver::visit(const AST::Call& expr) {
+    expr.is_global_call = false;
+    auto callee = dynamic_cast<const AST::Variable*>(expr.callee.get());
+    if (callee && scope_of(callee->name.lexeme) <= 0 &&
+        (globals.count(callee->name.lexeme) || is_native(callee->name.lexeme))) {
+        global_calls.push_back(&expr);
+    }
     expr.callee->accept(*this);
     for (const auto& arg : expr.arguments) {
         arg->accept(*this);
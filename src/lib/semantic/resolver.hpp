@@ -5,14 +5,23 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <set>
 #include <string>
 
 namespace Quastra {
 
 // The Resolver walks the AST to perform semantic analysis, such as
-// resolving variables and checking for scope-related errors.
+// resolving variables and checking for scope-related errors. It also marks
+// calls in tail position (see AST::Call::is_tail_call) for the interpreter
+// and the code generator, and calls to global names no local can shadow
+// (see AST::Call::is_global_call).
 class Resolver : public AST::ExprVisitor, public AST::StmtVisitor {
 public:
+    Resolver() = default;
+    // A resolver for programs that may also use `predefined` globals, such
+    // as those restored from a snapshot.
+    explicit Resolver(std::vector<std::string> predefined) : predefined(std::move(predefined)) {}
+
     // The main entry point. Takes an AST and returns true if no errors were found.
     bool resolve(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
 
@@ -20,6 +29,9 @@ private:
     // Scope management
     void begin_scope();
     void end_scope();
+    bool is_declared(const std::string& name) const;
+    // Index of the innermost scope declaring `name`, or -1.
+    int scope_of(const std::string& name) const;
 
     // Statement visitors
     void visit(const AST::Block& stmt) override;
@@ -41,6 +53,20 @@ private:
     // The Symbol Table: a stack of scopes.
     // The map stores variable names and a boolean indicating if they've been initialized.
     std::vector<std::map<std::string, bool>> scopes;
+    std::vector<std::string> predefined;
+    // Names declared anywhere at top level. A function body may use a global
+    // declared after it, since it only runs once it is called.
+    std::set<std::string> globals;
+    // Names declared anywhere below top level: parameters, locals and
+    // nested functions.
+    std::set<std::string> local_names;
+    // Calls whose callee is a global name, to mark once all local names
+    // are known.
+    std::vector<const AST::Call*> global_calls;
+    // The functions being resolved, with the scope their name lives in.
+    std::vector<std::pair<const AST::FunctionStmt*, int>> functions;
+    // `spawn` blocks around the current statement in the current function.
+    int task_depth = 0;
     bool had_error = false;
 };
 
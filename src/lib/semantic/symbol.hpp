@@ -4,12 +4,15 @@
 
 namespace Quastra {
 
+struct NativeSignature;
+
 // Represents a variable or function in the symbol table.
 // It stores all the semantic information we know about an identifier.
 struct Symbol {
     Type type;
     bool is_mutable;
     bool is_initialized;
+    const NativeSignature* signature = nullptr; // Set for natives; calls are checked against it.
 };
 
 } // namespace Quastra
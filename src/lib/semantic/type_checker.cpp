@@ -1,9 +1,15 @@
 #include "type_checker.hpp"
+#include "../runtime/native_registry.hpp"
 #include <iostream>
 
 namespace Quastra {
 
 bool TypeChecker::check(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    // The natives get a scope of their own, so programs may redefine them.
+    begin_scope();
+    for (const auto& native : native_registry().all()) {
+        scopes.back()[native.name] = {native.signature.result, false, true, &native.signature};
+    }
     begin_scope();
     for (const auto& statement : statements) {
         if (statement) {
@@ -11,6 +17,7 @@ bool TypeChecker::check(const std::vector<std::unique_ptr<AST::Stmt>>& statement
         }
     }
     end_scope();
+    end_scope();
     return !had_error;
 }
 
@@ -131,6 +138,7 @@ void TypeChecker::visit(const AST::Literal& expr) {
     if (expr.value.type == TokenType::IntLiteral) last_type = Type::Int;
     else if (expr.value.type == TokenType::True) last_type = Type::Bool;
     else if (expr.value.type == TokenType::False) last_type = Type::Bool;
+    else if (expr.value.type == TokenType::StringLiteral) last_type = Type::String;
     else last_type = Type::Error;
 }
 
@@ -168,6 +176,7 @@ void TypeChecker::visit(const AST::Call& expr) {
     if (const auto* var = dynamic_cast<const AST::Variable*>(expr.callee.get())) {
         const Symbol* symbol = resolve(var->name);
         if (symbol) {
+            if (symbol->signature) check_native_call(expr, var->name.lexeme, *symbol->signature);
             // For now, we assume all callable things are functions and return their declared type.
             // A full implementation would handle function types, arity, etc.
             last_type = symbol->type;
@@ -180,6 +189,22 @@ void TypeChecker::visit(const AST::Call& expr) {
     last_type = Type::Error;
 }
 
+// Natives know their parameter types, so their calls are checked in full.
+void TypeChecker::check_native_call(const AST::Call& expr, const std::string& name,
+                                    const NativeSignature& signature) {
+    if (expr.arguments.size() != signature.parameters.size()) {
+        std::cerr << "Type Error: Expected " << signature.parameters.size() << " arguments but got "
+                  << expr.arguments.size() << " in call to '" << name << "'.\n";
+        had_error = true;
+        return;
+    }
+    for (size_t i = 0; i < expr.arguments.size(); ++i) {
+        Type argument = type_of(*expr.arguments[i]);
+        if (signature.parameters[i] == Type::Error) continue;
+        check_type(signature.parameters[i], argument,
+                   "Argument " + std::to_string(i + 1) + " to '" + name + "' has the wrong type.");
+    }
+}
 
 void TypeChecker::visit(const AST::Unary& expr) {
     Type right_type = type_of(*expr.right);
@@ -189,6 +214,10 @@ void TypeChecker::visit(const AST::Unary& expr) {
     } else if (expr.op.type == TokenType::Bang) {
         check_type(Type::Bool, right_type, "Operand for logical not must be a boolean.");
         last_type = Type::Bool;
+    } else if (expr.op.type == TokenType::Await) {
+        // Calls of async functions have their declared type, which is
+        // what awaiting them gives.
+        last_type = right_type;
     } else {
         last_type = Type::Error;
     }
@@ -200,6 +229,11 @@ void TypeChecker::visit(const AST::Binary& expr) {
 
     switch (expr.op.type) {
         case TokenType::Plus:
+            if (left_type == Type::String && right_type == Type::String) {
+                last_type = Type::String;
+                break;
+            }
+            [[fallthrough]];
         case TokenType::Minus:
         case TokenType::Star:
         case TokenType::Slash:
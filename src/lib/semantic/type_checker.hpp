@@ -19,6 +19,7 @@ private:
     void end_scope();
     Type type_of(const AST::Expr& expr);
     void check_type(Type expected, Type actual, const std::string& error_message);
+    void check_native_call(const AST::Call& expr, const std::string& name, const NativeSignature& signature);
     void define(const Token& name, const Symbol& symbol);
     const Symbol* resolve(const Token& name);
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../runtime/quastra_value.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Quastra::Bytecode {
+
+// Stack-based bytecode run by the VirtualMachine. Operands are popped from
+// and results pushed to the operand stack; variables live in heap frames
+// with slots numbered at compile time, as in the ClosureEngine. `hops`
+// counts frames up the chain from the current one.
+
+enum class Opcode : uint8_t {
+    Constant,     // a = constant index
+    Undefined,    // a = name index; the name resolves nowhere
+    GetLocal,     // a = slot in the current frame
+    GetOuter,     // a = hops, b = slot
+    GetChecked,   // a = hops, b = slot, c = name index; may not be declared yet
+    Set,          // a = hops, b = slot; leaves the value on the stack
+    SetChecked,   // a = hops, b = slot, c = name index
+    Define,       // a = slot in the current frame; pops the value
+    Pop,
+    Negate, Not,
+    Add, Subtract, Multiply, Divide,
+    Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+    InvalidBinary,
+    Jump,         // a = target
+    JumpIfFalse,  // a = target; pops the condition
+    PushFrame,    // a = slots; for blocks that declare functions
+    PopFrame,
+    Closure,      // a = index in Function::functions
+    CheckCall,    // a = argument count; checks the callee on top of the stack
+    Call,         // a = argument count; the callee is below the arguments
+    TailCall,     // a = argument count; replaces the current call
+    Return,       // pops the result
+    Await,        // replaces the future on top of the stack by its value,
+                  // suspending the fiber until it completes
+};
+
+struct Instruction {
+    Opcode op;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    uint32_t c = 0;
+};
+
+// A compiled function body, or the top-level statements of a program.
+struct Function {
+    std::string name;
+    bool is_async = false; // Runs in a fiber of its own; calls return a future.
+    std::vector<uint32_t> parameters; // Slots the arguments go to.
+    uint32_t frame_size = 0;
+    std::vector<Instruction> code;
+    std::vector<QuastraValue> constants;
+    std::vector<std::string> names; // For error messages.
+    std::vector<std::shared_ptr<const Function>> functions; // Declared in this body.
+};
+
+} // namespace Quastra::Bytecode
@@ -0,0 +1,350 @@
+#include "bytecode_compiler.hpp"
+#include "../runtime/native_registry.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <stdexcept>
+
+namespace Quastra {
+
+using Bytecode::Opcode;
+
+namespace {
+
+// True if the statement declares a function outside any nested function
+// body. Such blocks need a frame of their own for the function to capture.
+bool declares_function(const AST::Stmt& stmt) {
+    if (dynamic_cast<const AST::FunctionStmt*>(&stmt)) return true;
+    if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        for (const auto& inner : block->statements) {
+            if (declares_function(*inner)) return true;
+        }
+    } else if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        return declares_function(*if_stmt->then_branch) ||
+               (if_stmt->else_branch && declares_function(*if_stmt->else_branch));
+    } else if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        return declares_function(*while_stmt->body);
+    }
+    return false;
+}
+
+} // namespace
+
+BytecodeCompiler::BytecodeCompiler() {
+    scopes.emplace_back();
+    scopes.back().owns_frame = true;
+    // The natives the VirtualMachine defines.
+    for (const auto& native : native_registry().all()) {
+        declare_global(native.name);
+    }
+}
+
+std::shared_ptr<const Bytecode::Function> BytecodeCompiler::compile(
+    const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    auto script = std::make_shared<Bytecode::Function>();
+    script->name = "<script>";
+    function = script.get();
+    predeclare(statements);
+    for (const auto& statement : statements) {
+        if (statement) compile(*statement);
+    }
+    emit(Opcode::Constant, constant(false));
+    emit(Opcode::Return);
+    function = nullptr;
+    return script;
+}
+
+uint32_t BytecodeCompiler::declare_global(const std::string& name) {
+    Scope& globals = scopes.front();
+    uint32_t slot = declare_slot(globals, name);
+    globals.declared[name] = slot;
+    return slot;
+}
+
+bool BytecodeCompiler::global_slot(const std::string& name, uint32_t& slot) const {
+    const Scope& globals = scopes.front();
+    auto it = globals.all.find(name);
+    if (it == globals.all.end()) return false;
+    slot = it->second;
+    return true;
+}
+
+void BytecodeCompiler::restore_globals(std::map<std::string, uint32_t> names, uint32_t size) {
+    Scope& globals = scopes.front();
+    globals.declared = names;
+    globals.all = std::move(names);
+    globals.frame_size = size;
+}
+
+// --- Scopes ---
+
+void BytecodeCompiler::push_scope(bool owns_frame) {
+    Scope scope;
+    scope.owns_frame = owns_frame;
+    scope.frame_owner = owns_frame ? scopes.size() : scopes.back().frame_owner;
+    scope.function_depth = function_depth;
+    scopes.push_back(std::move(scope));
+}
+
+void BytecodeCompiler::predeclare(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    for (const auto& statement : statements) {
+        if (auto* decl = dynamic_cast<const AST::VarDecl*>(statement.get())) {
+            declare_slot(scopes.back(), decl->name.lexeme);
+        } else if (auto* declaration = dynamic_cast<const AST::FunctionStmt*>(statement.get())) {
+            declare_slot(scopes.back(), declaration->name.lexeme);
+        }
+    }
+}
+
+uint32_t BytecodeCompiler::declare_slot(Scope& scope, const std::string& name) {
+    auto it = scope.all.find(name);
+    if (it != scope.all.end()) return it->second;
+    uint32_t slot = scopes[scope.frame_owner].frame_size++;
+    scope.all[name] = slot;
+    return slot;
+}
+
+uint32_t BytecodeCompiler::declare(const std::string& name) {
+    Scope& scope = scopes.back();
+    uint32_t slot = declare_slot(scope, name);
+    scope.declared[name] = slot;
+    return slot;
+}
+
+bool BytecodeCompiler::resolve(const std::string& name, Binding& binding) const {
+    uint32_t hops = 0;
+    for (size_t i = scopes.size(); i-- > 0;) {
+        const Scope& scope = scopes[i];
+        bool same_function = scope.function_depth == function_depth;
+        const auto& names = same_function ? scope.declared : scope.all;
+        auto it = names.find(name);
+        if (it != names.end()) {
+            binding = {hops, it->second, !same_function};
+            return true;
+        }
+        if (scope.owns_frame) hops++;
+    }
+    return false;
+}
+
+// --- Emission ---
+
+size_t BytecodeCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+    function->code.push_back({op, a, b, c});
+    return function->code.size() - 1;
+}
+
+uint32_t BytecodeCompiler::constant(QuastraValue value) {
+    function->constants.push_back(std::move(value));
+    return static_cast<uint32_t>(function->constants.size() - 1);
+}
+
+uint32_t BytecodeCompiler::name(const std::string& name) {
+    function->names.push_back(name);
+    return static_cast<uint32_t>(function->names.size() - 1);
+}
+
+void BytecodeCompiler::patch(size_t index) {
+    function->code[index].a = static_cast<uint32_t>(function->code.size());
+}
+
+// --- Statements ---
+
+void BytecodeCompiler::compile(const AST::Stmt& stmt) {
+    if (auto* expr_stmt = dynamic_cast<const AST::ExprStmt*>(&stmt)) {
+        compile(*expr_stmt->expression);
+        emit(Opcode::Pop);
+        return;
+    }
+
+    if (auto* decl = dynamic_cast<const AST::VarDecl*>(&stmt)) {
+        // The initializer still sees any outer binding of the name.
+        if (decl->initializer) {
+            compile(*decl->initializer);
+        } else {
+            emit(Opcode::Constant, constant(false));
+        }
+        emit(Opcode::Define, declare(decl->name.lexeme));
+        return;
+    }
+
+    if (auto* block = dynamic_cast<const AST::Block*>(&stmt)) {
+        bool owns_frame = declares_function(stmt);
+        push_scope(owns_frame);
+        size_t push = owns_frame ? emit(Opcode::PushFrame) : 0;
+        predeclare(block->statements);
+        for (const auto& statement : block->statements) {
+            compile(*statement);
+        }
+        if (owns_frame) {
+            function->code[push].a = scopes.back().frame_size;
+            emit(Opcode::PopFrame);
+        }
+        scopes.pop_back();
+        return;
+    }
+
+    if (auto* if_stmt = dynamic_cast<const AST::IfStmt*>(&stmt)) {
+        compile(*if_stmt->condition);
+        size_t to_else = emit(Opcode::JumpIfFalse);
+        compile(*if_stmt->then_branch);
+        if (!if_stmt->else_branch) {
+            patch(to_else);
+            return;
+        }
+        size_t to_end = emit(Opcode::Jump);
+        patch(to_else);
+        compile(*if_stmt->else_branch);
+        patch(to_end);
+        return;
+    }
+
+    if (auto* while_stmt = dynamic_cast<const AST::WhileStmt*>(&stmt)) {
+        auto loop = static_cast<uint32_t>(function->code.size());
+        compile(*while_stmt->condition);
+        size_t exit = emit(Opcode::JumpIfFalse);
+        compile(*while_stmt->body);
+        emit(Opcode::Jump, loop);
+        patch(exit);
+        return;
+    }
+
+    if (auto* declaration = dynamic_cast<const AST::FunctionStmt*>(&stmt)) {
+        uint32_t slot = declare(declaration->name.lexeme);
+        auto code = compile_function(*declaration);
+        function->functions.push_back(std::move(code));
+        emit(Opcode::Closure, static_cast<uint32_t>(function->functions.size() - 1));
+        emit(Opcode::Define, slot);
+        return;
+    }
+
+    if (auto* return_stmt = dynamic_cast<const AST::ReturnStmt*>(&stmt)) {
+        auto* call = dynamic_cast<const AST::Call*>(return_stmt->value.get());
+        if (call && call->is_tail_call && function_depth > 0) {
+            compile_call(*call, Opcode::TailCall);
+            return;
+        }
+        if (return_stmt->value) {
+            compile(*return_stmt->value);
+        } else {
+            emit(Opcode::Constant, constant(false));
+        }
+        emit(Opcode::Return);
+        return;
+    }
+
+    throw std::runtime_error("Unsupported statement.");
+}
+
+// Parameters and the body share a scope, as in the Interpreter.
+std::shared_ptr<const Bytecode::Function> BytecodeCompiler::compile_function(const AST::FunctionStmt& stmt) {
+    auto code = std::make_shared<Bytecode::Function>();
+    code->name = stmt.name.lexeme;
+    code->is_async = stmt.is_async;
+    Bytecode::Function* enclosing = function;
+    function = code.get();
+    function_depth++;
+    push_scope(true);
+    for (const auto& param : stmt.params) {
+        code->parameters.push_back(declare(param.lexeme));
+    }
+    predeclare(stmt.body);
+    for (const auto& statement : stmt.body) {
+        compile(*statement);
+    }
+    emit(Opcode::Constant, constant(false)); // Falling off the end returns false.
+    emit(Opcode::Return);
+    code->frame_size = scopes.back().frame_size;
+    scopes.pop_back();
+    function_depth--;
+    function = enclosing;
+    return code;
+}
+
+// --- Expressions ---
+
+void BytecodeCompiler::compile(const AST::Expr& expr) {
+    if (auto* literal = dynamic_cast<const AST::Literal*>(&expr)) {
+        QuastraValue value = false;
+        if (literal->value.type == TokenType::IntLiteral) value = std::stod(literal->value.lexeme);
+        else if (literal->value.type == TokenType::True) value = true;
+        else if (literal->value.type == TokenType::StringLiteral) value = QuastraString::intern(string_value(literal->value));
+        emit(Opcode::Constant, constant(std::move(value)));
+        return;
+    }
+
+    if (auto* variable = dynamic_cast<const AST::Variable*>(&expr)) {
+        Binding binding;
+        if (!resolve(variable->name.lexeme, binding)) {
+            emit(Opcode::Undefined, name(variable->name.lexeme));
+        } else if (binding.checked) {
+            emit(Opcode::GetChecked, binding.hops, binding.slot, name(variable->name.lexeme));
+        } else if (binding.hops == 0) {
+            emit(Opcode::GetLocal, binding.slot);
+        } else {
+            emit(Opcode::GetOuter, binding.hops, binding.slot);
+        }
+        return;
+    }
+
+    if (auto* assign = dynamic_cast<const AST::Assign*>(&expr)) {
+        compile(*assign->value);
+        Binding binding;
+        if (!resolve(assign->name.lexeme, binding)) {
+            emit(Opcode::Undefined, name(assign->name.lexeme));
+        } else if (binding.checked) {
+            emit(Opcode::SetChecked, binding.hops, binding.slot, name(assign->name.lexeme));
+        } else {
+            emit(Opcode::Set, binding.hops, binding.slot);
+        }
+        return;
+    }
+
+    if (auto* unary = dynamic_cast<const AST::Unary*>(&expr)) {
+        compile(*unary->right);
+        switch (unary->op.type) {
+            case TokenType::Minus: emit(Opcode::Negate); break;
+            case TokenType::Await: emit(Opcode::Await); break;
+            default: emit(Opcode::Not); break;
+        }
+        return;
+    }
+
+    if (auto* binary = dynamic_cast<const AST::Binary*>(&expr)) {
+        compile(*binary->left);
+        compile(*binary->right);
+        switch (binary->op.type) {
+            case TokenType::Plus: emit(Opcode::Add); break;
+            case TokenType::Minus: emit(Opcode::Subtract); break;
+            case TokenType::Star: emit(Opcode::Multiply); break;
+            case TokenType::Slash: emit(Opcode::Divide); break;
+            case TokenType::EqualEqual: emit(Opcode::Equal); break;
+            case TokenType::BangEqual: emit(Opcode::NotEqual); break;
+            case TokenType::Less: emit(Opcode::Less); break;
+            case TokenType::LessEqual: emit(Opcode::LessEqual); break;
+            case TokenType::Greater: emit(Opcode::Greater); break;
+            case TokenType::GreaterEqual: emit(Opcode::GreaterEqual); break;
+            default: emit(Opcode::InvalidBinary); break;
+        }
+        return;
+    }
+
+    if (auto* call = dynamic_cast<const AST::Call*>(&expr)) {
+        compile_call(*call, Opcode::Call);
+        return;
+    }
+
+    throw std::runtime_error("Unsupported expression.");
+}
+
+// The callee is checked before the arguments are evaluated, as in the
+// Interpreter.
+void BytecodeCompiler::compile_call(const AST::Call& expr, Opcode op) {
+    auto count = static_cast<uint32_t>(expr.arguments.size());
+    compile(*expr.callee);
+    emit(Opcode::CheckCall, count);
+    for (const auto& argument : expr.arguments) {
+        compile(*argument);
+    }
+    emit(op, count);
+}
+
+} // namespace Quastra
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "../frontend/ast.hpp"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Quastra {
+
+// Compiles the AST to bytecode for the VirtualMachine. Names are resolved to
+// frame slots with the ClosureEngine's rules: blocks only get a frame of
+// their own when they declare a function, code sees the names its function
+// has declared so far and nested functions see every name of the scopes
+// around them. The global scope persists, so later programs see the globals
+// of earlier ones. A copy carries on from the same globals.
+class BytecodeCompiler {
+public:
+    // Declares the natives first, so they have the same slots everywhere.
+    BytecodeCompiler();
+
+    // Compiles top-level statements into a function of no arguments that
+    // runs them in the global frame.
+    std::shared_ptr<const Bytecode::Function> compile(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // Declares a global, such as a native function, and returns its slot.
+    uint32_t declare_global(const std::string& name);
+
+    // The slot of a global declared so far, or false if there is none.
+    bool global_slot(const std::string& name, uint32_t& slot) const;
+
+    // Slots the global frame needs.
+    uint32_t globals_size() const { return scopes.front().frame_size; }
+
+    // Every global declared so far, with its slot.
+    const std::map<std::string, uint32_t>& global_names() const { return scopes.front().all; }
+
+    // Replaces the globals by `names`, in a frame of `size` slots, as
+    // global_names() and globals_size() gave them; for restoring a snapshot.
+    void restore_globals(std::map<std::string, uint32_t> names, uint32_t size);
+
+private:
+    // A compile-time scope; see ClosureEngine::Scope.
+    struct Scope {
+        std::map<std::string, uint32_t> declared;
+        std::map<std::string, uint32_t> all;
+        bool owns_frame = false;
+        size_t frame_owner = 0;
+        uint32_t frame_size = 0;
+        int function_depth = 0;
+    };
+
+    struct Binding {
+        uint32_t hops = 0;
+        uint32_t slot = 0;
+        bool checked = false;
+    };
+
+    void push_scope(bool owns_frame);
+    void predeclare(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+    uint32_t declare_slot(Scope& scope, const std::string& name);
+    uint32_t declare(const std::string& name);
+    bool resolve(const std::string& name, Binding& binding) const;
+
+    void compile(const AST::Stmt& stmt);
+    void compile(const AST::Expr& expr);
+    void compile_call(const AST::Call& expr, Bytecode::Opcode op);
+    std::shared_ptr<const Bytecode::Function> compile_function(const AST::FunctionStmt& stmt);
+
+    size_t emit(Bytecode::Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+    uint32_t constant(QuastraValue value);
+    uint32_t name(const std::string& name);
+    // Points the jump at `index` to the next instruction.
+    void patch(size_t index);
+
+    std::vector<Scope> scopes;
+    int function_depth = 0;
+    Bytecode::Function* function = nullptr; // Being compiled.
+};
+
+} // namespace Quastra
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "../interpreter/closure_engine.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include <memory>
+
+namespace Quastra {
+
+class VirtualMachine;
+
+// A Quastra function compiled to bytecode, with the frame it was declared in.
+// Calling it from outside runs the body on the machine that made it.
+class BytecodeFunction : public QuastraCallable {
+public:
+    BytecodeFunction(std::shared_ptr<const Bytecode::Function> code, std::shared_ptr<Frame> closure,
+                     VirtualMachine& machine)
+        : code(std::move(code)), closure(std::move(closure)), machine(machine) {}
+
+    int arity() const override { return static_cast<int>(code->parameters.size()); }
+
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override;
+
+    std::shared_ptr<const Bytecode::Function> code;
+    std::shared_ptr<Frame> closure;
+    VirtualMachine& machine;
+};
+
+} // namespace Quastra
@@ -0,0 +1,8 @@
+#include "compiled_program.hpp"
+
+namespace Quastra {
+
+CompiledProgram::CompiledProgram(const std::vector<std::unique_ptr<AST::Stmt>>& statements)
+    : script(compiler.compile(statements)) {}
+
+} // namespace Quastra
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "bytecode_compiler.hpp"
+#include "../frontend/ast.hpp"
+#include <memory>
+#include <vector>
+
+namespace Quastra {
+
+// A program compiled to bytecode once, for any number of VirtualMachines to
+// run. It keeps no reference to the AST it was compiled from and never
+// changes afterwards, so machines on different threads may share one: each
+// has its own globals, stacks and fibers and only reads the code. The
+// driver's compile_program() builds one from source.
+class CompiledProgram {
+public:
+    // Compiles statements the Resolver has accepted.
+    explicit CompiledProgram(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    CompiledProgram(const CompiledProgram&) = delete;
+    CompiledProgram& operator=(const CompiledProgram&) = delete;
+
+    // The top-level statements, as a function of no arguments.
+    const std::shared_ptr<const Bytecode::Function>& get_script() const { return script; }
+    // The global slots the script uses, natives included.
+    const BytecodeCompiler& get_globals() const { return compiler; }
+
+private:
+    BytecodeCompiler compiler;
+    std::shared_ptr<const Bytecode::Function> script;
+};
+
+} // namespace Quastra
@@ -0,0 +1,626 @@
+#include "virtual_machine.hpp"
+#include "bytecode_function.hpp"
+#include "../runtime/quastra_channel.hpp"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// VirtualMachine::save_snapshot and restore_snapshot. A snapshot holds, in
+// the byte order of the machine that wrote it:
+//
+//   the magic "QSNP" and the format version;
+//   the global names with their slots, and the size of the global frame;
+//   the bytecode functions, each after the ones it declares;
+//   the size and parent of every frame, the globals' first;
+//   the values in the slots of every frame, in the same order.
+//
+// Functions refer to their code and closure frame by index, so restoring is
+// one pass over the mapped file with no lookups by name but the natives'.
+
+namespace Quastra {
+
+namespace {
+
+const char magic[4] = {'Q', 'S', 'N', 'P'};
+// Bumped whenever the layout or the opcodes change.
+const uint32_t format_version = 1;
+const uint32_t no_parent = UINT32_MAX;
+
+enum class Tag : uint8_t { Number, Bool, String, Function, Native, Undefined };
+
+std::runtime_error corrupt() {
+    return std::runtime_error("Snapshot is corrupt.");
+}
+
+class SnapshotWriter {
+public:
+    using Natives = std::vector<std::pair<std::string, std::shared_ptr<QuastraCallable>>>;
+
+    SnapshotWriter(const VirtualMachine& machine, const Natives& natives) : machine(machine), natives(natives) {}
+
+    std::string write(const BytecodeCompiler& layout, const std::shared_ptr<Frame>& globals) {
+        // Number every frame and function the globals can reach.
+        add_frame(globals.get());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            for (const QuastraValue& value : frames[i]->slots) {
+                auto* function = as_function(value);
+                if (!function) continue;
+                add_function(function->code);
+                add_frame(function->closure.get());
+            }
+        }
+
+        out.append(magic, sizeof(magic));
+        u32(format_version);
+        u32(static_cast<uint32_t>(layout.global_names().size()));
+        for (const auto& [name, slot] : layout.global_names()) {
+            text(name);
+            u32(slot);
+        }
+        u32(layout.globals_size());
+
+        u32(static_cast<uint32_t>(functions.size()));
+        for (const Bytecode::Function* function : functions) {
+            write_function(*function);
+        }
+
+        u32(static_cast<uint32_t>(frames.size()));
+        for (const Frame* frame : frames) {
+            u32(static_cast<uint32_t>(frame->slots.size()));
+            u32(frame->parent ? frame_ids.at(frame->parent.get()) : no_parent);
+        }
+        for (const Frame* frame : frames) {
+            for (const QuastraValue& value : frame->slots) write_value(value);
+        }
+        return std::move(out);
+    }
+
+private:
+    // A function of this machine, or nullptr for any other value.
+    const BytecodeFunction* as_function(const QuastraValue& value) const {
+        auto* callable = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+        auto* function = callable ? dynamic_cast<const BytecodeFunction*>(callable->get()) : nullptr;
+        return function && &function->machine == &machine ? function : nullptr;
+    }
+
+    void add_frame(const Frame* frame) {
+        while (frame && frame_ids.emplace(frame, static_cast<uint32_t>(frames.size())).second) {
+            frames.push_back(frame);
+            frame = frame->parent.get();
+        }
+    }
+
+    // Declared functions come first, so the reader has them by the time it
+    // reads the function declaring them.
+    void add_function(const std::shared_ptr<const Bytecode::Function>& function) {
+        if (function_ids.count(function.get())) return;
+        for (const auto& declared : function->functions) add_function(declared);
+        function_ids.emplace(function.get(), static_cast<uint32_t>(functions.size()));
+        functions.push_back(function.get());
+    }
+
+    void write_function(const Bytecode::Function& function) {
+        text(function.name);
+        u8(function.is_async);
+        u32(static_cast<uint32_t>(function.parameters.size()));
+        for (uint32_t slot : function.parameters) u32(slot);
+        u32(function.frame_size);
+        u32(static_cast<uint32_t>(function.code.size()));
+        for (const Bytecode::Instruction& instruction : function.code) {
+            u8(static_cast<uint8_t>(instruction.op));
+            u32(instruction.a);
+            u32(instruction.b);
+            u32(instruction.c);
+        }
+        u32(static_cast<uint32_t>(function.constants.size()));
+        for (const QuastraValue& constant : function.constants) write_value(constant);
+        u32(static_cast<uint32_t>(function.names.size()));
+        for (const std::string& name : function.names) text(name);
+        u32(static_cast<uint32_t>(function.functions.size()));
+        for (const auto& declared : function.functions) u32(function_ids.at(declared.get()));
+    }
+
+    void write_value(const QuastraValue& value) {
+        if (const double* number = std::get_if<double>(&value)) {
+            u8(static_cast<uint8_t>(Tag::Number));
+            out.append(reinterpret_cast<const char*>(number), sizeof(double));
+        } else if (const bool* flag = std::get_if<bool>(&value)) {
+            u8(static_cast<uint8_t>(Tag::Bool));
+            u8(*flag);
+        } else if (const QuastraString* string = std::get_if<QuastraString>(&value)) {
+            u8(static_cast<uint8_t>(Tag::String));
+            text(string->view());
+        } else if (std::holds_alternative<std::shared_ptr<QuastraFuture>>(value)) {
+            throw std::runtime_error("Cannot save a future in a snapshot.");
+        } else if (const BytecodeFunction* function = as_function(value)) {
+            u8(static_cast<uint8_t>(Tag::Function));
+            u32(function_ids.at(function->code.get()));
+            u32(frame_ids.at(function->closure.get()));
+        } else {
+            const auto& callable = std::get<std::shared_ptr<QuastraCallable>>(value);
+            if (!callable) {
+                u8(static_cast<uint8_t>(Tag::Undefined));
+                return;
+            }
+            if (dynamic_cast<const QuastraChannel*>(callable.get())) {
+                throw std::runtime_error("Cannot save a channel in a snapshot.");
+            }
+            for (const auto& [name, native] : natives) {
+                if (native != callable) continue;
+                u8(static_cast<uint8_t>(Tag::Native));
+                text(name);
+                return;
+            }
+            throw std::runtime_error("Cannot save a native function the machine did not define in a snapshot.");
+        }
+    }
+
+    void u8(uint8_t value) { out.push_back(static_cast<char>(value)); }
+    void u32(uint32_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void text(std::string_view value) {
+        u32(static_cast<uint32_t>(value.size()));
+        out.append(value.data(), value.size());
+    }
+
+    const VirtualMachine& machine;
+    const Natives& natives;
+    std::string out;
+    std::vector<const Frame*> frames;
+    std::unordered_map<const Frame*, uint32_t> frame_ids;
+    std::vector<const Bytecode::Function*> functions;
+    std::unordered_map<const Bytecode::Function*, uint32_t> function_ids;
+};
+
+// A file mapped read-only for as long as this lives.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Could not open snapshot '" + path + "'.");
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data = static_cast<const char*>(mapped);
+                size = static_cast<size_t>(info.st_size);
+            }
+        }
+        ::close(fd);
+    }
+
+    ~MappedFile() {
+        if (data) ::munmap(const_cast<char*>(data), size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size) : data(data), end(data + size) {}
+
+    uint8_t u8() { return static_cast<uint8_t>(*take(1)); }
+
+    uint32_t u32() {
+        uint32_t value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    double number() {
+        double value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    std::string_view text() {
+        uint32_t size = u32();
+        return std::string_view(take(size), size);
+    }
+
+    // A count of items at least `item_size` bytes each, checked against
+    // what is left so a corrupt count cannot ask for a huge allocation.
+    uint32_t count(size_t item_size) {
+        uint32_t value = u32();
+        if (static_cast<size_t>(end - data) / item_size < value) throw corrupt();
+        return value;
+    }
+
+    const char* take(size_t size) {
+        if (static_cast<size_t>(end - data) < size) throw std::runtime_error("Snapshot is truncated.");
+        const char* start = data;
+        data += size;
+        return start;
+    }
+
+private:
+    const char* data;
+    const char* end;
+};
+
+// Checks restored bytecode before the machine may run it: every operand
+// within its table, every jump within the code, no path that falls off the
+// end, and, along every path, enough values on the stack for each
+// instruction, frames for each hop and slots in them, and calls only of
+// callees CheckCall has checked for that many arguments. Join points must
+// agree, as they do in what BytecodeCompiler emits.
+class BytecodeVerifier {
+public:
+    // The slots of a frame and of its parents. Links are shared, so equal
+    // chains are the same pointer; nullptr is the empty chain.
+    struct Link {
+        uint32_t size;
+        const Link* next;
+        uint32_t depth;
+    };
+
+    // Lexical nesting deeper than this is taken for corruption.
+    static constexpr uint32_t max_depth = 1 << 10;
+
+    const Link* chain(uint32_t size, const Link* next) {
+        uint32_t depth = next ? next->depth + 1 : 1;
+        if (depth > max_depth) throw corrupt();
+        auto& link = links[{size, next}];
+        if (!link) link.reset(new Link{size, next, depth});
+        return link.get();
+    }
+
+    // Checks `function` run in a frame whose enclosing frames are `outer`.
+    void verify(const Bytecode::Function& function, const Link* outer) {
+        if (!verified.insert({&function, outer}).second) return;
+        for (uint32_t slot : function.parameters) {
+            if (slot >= function.frame_size) throw corrupt();
+        }
+        const auto& code = function.code;
+        if (code.empty()) throw corrupt();
+
+        std::vector<bool> targets(code.size());
+        for (const Bytecode::Instruction& instruction : code) {
+            if (instruction.op != Opcode::Jump && instruction.op != Opcode::JumpIfFalse) continue;
+            if (instruction.a >= code.size()) throw corrupt();
+            targets[instruction.a] = true;
+        }
+
+        // The state at each jump target, and the targets still to walk from.
+        std::map<uint32_t, State> at_target;
+        std::vector<uint32_t> pending;
+        auto reach = [&](uint32_t pc, const State& state) {
+            auto [it, added] = at_target.emplace(pc, state);
+            if (added) {
+                pending.push_back(pc);
+            } else if (!(it->second == state)) {
+                throw corrupt();
+            }
+        };
+        reach(0, State{});
+        while (!pending.empty()) {
+            uint32_t pc = pending.back();
+            pending.pop_back();
+            State state = at_target.at(pc);
+            while (true) {
+                if (!step(function, outer, code[pc], state, reach)) break;
+                if (++pc >= code.size()) throw corrupt();
+                if (targets[pc]) {
+                    reach(pc, state);
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    using Opcode = Bytecode::Opcode;
+    static constexpr int value = -1; // A stack entry that is not a checked callee.
+    static constexpr size_t max_stack = 1 << 16;
+
+    struct State {
+        std::vector<int> stack;       // value, or the argument count CheckCall checked.
+        std::vector<uint32_t> frames; // Sizes of the frames PushFrame made, innermost last.
+        bool operator==(const State& other) const { return stack == other.stack && frames == other.frames; }
+    };
+
+    // The slots of the frame `hops` out from the current one.
+    static uint32_t frame_size(const Bytecode::Function& function, const Link* outer, const State& state,
+                               uint32_t hops) {
+        if (hops < state.frames.size()) return state.frames[state.frames.size() - 1 - hops];
+        hops -= static_cast<uint32_t>(state.frames.size());
+        if (hops == 0) return function.frame_size;
+        if (!outer || hops > outer->depth) throw corrupt();
+        while (--hops) outer = outer->next;
+        return outer->size;
+    }
+
+    static void pop(State& state, size_t count) {
+        if (state.stack.size() < count) throw corrupt();
+        state.stack.resize(state.stack.size() - count);
+    }
+
+    static void push(State& state) {
+        if (state.stack.size() >= max_stack) throw corrupt();
+        state.stack.push_back(value);
+    }
+
+    static void check_call(State& state, uint32_t count) {
+        if (state.stack.size() <= count || state.stack[state.stack.size() - 1 - count] != static_cast<int>(count)) {
+            throw corrupt();
+        }
+        if (count > max_stack) throw corrupt();
+        pop(state, count + 1);
+    }
+
+    // Applies one instruction to `state`. Returns false if control does not
+    // go on to the next one.
+    template <typename Reach>
+    bool step(const Bytecode::Function& function, const Link* outer,
+              const Bytecode::Instruction& instruction, State& state, Reach& reach) {
+        switch (instruction.op) {
+            case Opcode::Constant:
+                if (instruction.a >= function.constants.size()) throw corrupt();
+                push(state);
+                return true;
+            case Opcode::Undefined:
+                if (instruction.a >= function.names.size()) throw corrupt();
+                return false;
+            case Opcode::GetLocal:
+                if (instruction.a >= frame_size(function, outer, state, 0)) throw corrupt();
+                push(state);
+                return true;
+            case Opcode::GetOuter:
+            case Opcode::GetChecked:
+            case Opcode::Set:
+            case Opcode::SetChecked: {
+                bool checked = instruction.op == Opcode::GetChecked || instruction.op == Opcode::SetChecked;
+                if (checked && instruction.c >= function.names.size()) throw corrupt();
+                if (instruction.b >= frame_size(function, outer, state, instruction.a)) throw corrupt();
+                if (instruction.op == Opcode::GetOuter || instruction.op == Opcode::GetChecked) {
+                    push(state);
+                } else if (state.stack.empty()) {
+                    throw corrupt();
+                }
+                return true;
+            }
+            case Opcode::Define:
+                if (instruction.a >= frame_size(function, outer, state, 0)) throw corrupt();
+                pop(state, 1);
+                return true;
+            case Opcode::Pop:
+                pop(state, 1);
+                return true;
+            case Opcode::Negate:
+            case Opcode::Not:
+            case Opcode::Await:
+                pop(state, 1);
+                push(state);
+                return true;
+            case Opcode::Add:
+            case Opcode::Subtract:
+            case Opcode::Multiply:
+            case Opcode::Divide:
+            case Opcode::Equal:
+            case Opcode::NotEqual:
+            case Opcode::Less:
+            case Opcode::LessEqual:
+            case Opcode::Greater:
+            case Opcode::GreaterEqual:
+                pop(state, 2);
+                push(state);
+                return true;
+            case Opcode::InvalidBinary:
+                return false;
+            case Opcode::Jump:
+                reach(instruction.a, state);
+                return false;
+            case Opcode::JumpIfFalse:
+                pop(state, 1);
+                reach(instruction.a, state);
+                return true;
+            case Opcode::PushFrame:
+                if (state.frames.size() >= max_depth) throw corrupt();
+                // Each slot is defined by an instruction, as the function's are.
+                if (instruction.a > function.code.size()) throw corrupt();
+                state.frames.push_back(instruction.a);
+                return true;
+            case Opcode::PopFrame:
+                if (state.frames.empty()) throw corrupt();
+                state.frames.pop_back();
+                return true;
+            case Opcode::Closure: {
+                if (instruction.a >= function.functions.size()) throw corrupt();
+                // The closure's enclosing frames are this one's chain.
+                const Link* enclosing = chain(function.frame_size, outer);
+                for (uint32_t size : state.frames) enclosing = chain(size, enclosing);
+                verify(*function.functions[instruction.a], enclosing);
+                push(state);
+                return true;
+            }
+            case Opcode::CheckCall:
+                if (instruction.a > max_stack) throw corrupt();
+                pop(state, 1);
+                state.stack.push_back(static_cast<int>(instruction.a));
+                return true;
+            case Opcode::Call:
+                check_call(state, instruction.a);
+                push(state);
+                return true;
+            case Opcode::TailCall:
+                check_call(state, instruction.a);
+                return false;
+            case Opcode::Return:
+                pop(state, 1);
+                return false;
+        }
+        throw corrupt();
+    }
+
+    std::map<std::pair<uint32_t, const Link*>, std::unique_ptr<Link>> links;
+    std::set<std::pair<const Bytecode::Function*, const Link*>> verified;
+};
+
+} // namespace
+
+void VirtualMachine::save_snapshot(const std::string& path) const {
+    if (!frames.empty() || current != main) {
+        throw std::runtime_error("Cannot save a snapshot of a machine that is still running.");
+    }
+    std::string contents = SnapshotWriter(*this, natives).write(layout(), globals);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    if (!file) throw std::runtime_error("Could not write snapshot '" + path + "'.");
+}
+
+void VirtualMachine::restore_snapshot(const std::string& path) {
+    MappedFile file(path);
+    SnapshotReader in(file.data, file.size);
+    if (std::memcmp(in.take(sizeof(magic)), magic, sizeof(magic)) != 0) {
+        throw std::runtime_error("'" + path + "' is not a snapshot.");
+    }
+    if (in.u32() != format_version) {
+        throw std::runtime_error("Snapshot '" + path + "' was written by another version.");
+    }
+
+    std::map<std::string, uint32_t> names;
+    uint32_t globals_size = 0;
+    std::vector<std::shared_ptr<Frame>> restored;
+    try {
+        for (uint32_t i = 0, count = in.count(8); i < count; ++i) {
+            std::string name(in.text());
+            names[name] = in.u32();
+        }
+        // Every global slot holds a value further on, of a byte at least.
+        globals_size = in.count(1);
+        for (const auto& [name, slot] : names) {
+            if (slot >= globals_size) throw corrupt();
+        }
+
+        // Frames are made before any value is read, so functions can refer to
+        // frames that come later.
+        std::vector<std::shared_ptr<Bytecode::Function>> functions;
+        BytecodeVerifier verifier;
+        std::vector<const BytecodeVerifier::Link*> chains; // Each frame's, for the functions closed over it.
+        std::function<QuastraValue()> value = [&]() -> QuastraValue {
+            switch (static_cast<Tag>(in.u8())) {
+                case Tag::Number:
+                    return in.number();
+                case Tag::Bool:
+                    return in.u8() != 0;
+                case Tag::String:
+                    return QuastraString(in.text());
+                case Tag::Function: {
+                    uint32_t code = in.u32();
+                    uint32_t closure = in.u32();
+                    if (code >= functions.size() || closure >= restored.size()) throw corrupt();
+                    verifier.verify(*functions[code], chains[closure]);
+                    return std::make_shared<BytecodeFunction>(functions[code], restored[closure], *this);
+                }
+                case Tag::Native: {
+                    std::string_view name = in.text();
+                    for (const auto& [native_name, native] : natives) {
+                        if (native_name == name) return native;
+                    }
+                    throw std::runtime_error("Snapshot refers to an unknown native '" + std::string(name) + "'.");
+                }
+                case Tag::Undefined:
+                    return std::shared_ptr<QuastraCallable>();
+            }
+            throw corrupt();
+        };
+
+        for (uint32_t i = 0, count = in.count(1); i < count; ++i) {
+            auto function = std::make_shared<Bytecode::Function>();
+            function->name = in.text();
+            function->is_async = in.u8() != 0;
+            function->parameters.resize(in.count(4));
+            for (uint32_t& slot : function->parameters) slot = in.u32();
+            // Each slot is defined by an instruction further on.
+            function->frame_size = in.count(1);
+            function->code.resize(in.count(13));
+            for (Bytecode::Instruction& instruction : function->code) {
+                uint8_t op = in.u8();
+                if (op > static_cast<uint8_t>(Bytecode::Opcode::Await)) throw corrupt();
+                instruction.op = static_cast<Bytecode::Opcode>(op);
+                instruction.a = in.u32();
+                instruction.b = in.u32();
+                instruction.c = in.u32();
+            }
+            // Constants are numbers, booleans and strings, which need no frames.
+            function->constants.resize(in.count(2));
+            for (QuastraValue& constant : function->constants) constant = value();
+            function->names.resize(in.count(4));
+            for (std::string& name : function->names) name = in.text();
+            function->functions.resize(in.count(4));
+            for (auto& declared : function->functions) {
+                uint32_t id = in.u32();
+                if (id >= functions.size()) throw corrupt();
+                declared = functions[id];
+            }
+            functions.push_back(std::move(function));
+        }
+
+        uint32_t frame_count = in.count(8);
+        if (frame_count == 0) throw corrupt();
+        std::vector<uint32_t> parents;
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            restored.push_back(std::make_shared<Frame>(in.count(1), nullptr));
+            parents.push_back(in.u32());
+        }
+        // The globals come first, with no parent and a slot for every global.
+        if (parents[0] != no_parent || restored[0]->slots.size() != globals_size) throw corrupt();
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            if (parents[i] == no_parent) continue;
+            if (parents[i] >= frame_count) throw corrupt();
+            restored[i]->parent = restored[parents[i]];
+        }
+        // Parents must not form a cycle, which would also never be freed.
+        chains.resize(frame_count, nullptr);
+        std::vector<uint8_t> visited(frame_count); // 1 while its parents are walked, 2 once done.
+        for (uint32_t i = 0; i < frame_count; ++i) {
+            std::vector<uint32_t> path;
+            uint32_t frame = i;
+            while (frame != no_parent && visited[frame] == 0) {
+                visited[frame] = 1;
+                path.push_back(frame);
+                frame = parents[frame];
+            }
+            if (frame != no_parent && visited[frame] == 1) throw corrupt();
+            for (auto it = path.rbegin(); it != path.rend(); ++it) {
+                const BytecodeVerifier::Link* rest = parents[*it] == no_parent ? nullptr : chains[parents[*it]];
+                chains[*it] = verifier.chain(static_cast<uint32_t>(restored[*it]->slots.size()), rest);
+                visited[*it] = 2;
+            }
+        }
+        for (const auto& frame : restored) {
+            for (QuastraValue& slot : frame->slots) slot = value();
+        }
+    } catch (const std::bad_alloc&) {
+        throw corrupt();
+    } catch (const std::length_error&) {
+        throw corrupt();
+    }
+
+    // Nothing can fail from here on.
+    program.reset();
+    compiler.restore_globals(std::move(names), globals_size);
+    globals = restored.front();
+    script.reset();
+    reset_fibers();
+    frames.clear();
+    stack.clear();
+    error.clear();
+}
+
+} // namespace Quastra
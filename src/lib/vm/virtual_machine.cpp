@@ -0,0 +1,560 @@
+#include "virtual_machine.hpp"
+#include "bytecode_function.hpp"
+#include "../runtime/quastra_callable.hpp"
+#include "../runtime/core_io.hpp"
+#include "../runtime/mailbox.hpp"
+#include "../runtime/native_registry.hpp"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace Quastra {
+
+using Bytecode::Opcode;
+
+namespace {
+
+// Slots hold this until their variable is declared, as in the ClosureEngine.
+QuastraValue undefined() { return std::shared_ptr<QuastraCallable>(); }
+
+bool is_undefined(const QuastraValue& value) {
+    auto* function = std::get_if<std::shared_ptr<QuastraCallable>>(&value);
+    return function && !*function;
+}
+
+bool truthy(const QuastraValue& value) {
+    auto* flag = std::get_if<bool>(&value);
+    return !flag || *flag;
+}
+
+Frame& frame_at(Frame& frame, size_t hops) {
+    Frame* current = &frame;
+    for (size_t i = 0; i < hops; ++i) current = current->parent.get();
+    return *current;
+}
+
+std::runtime_error undefined_variable(const std::string& name) {
+    return std::runtime_error("Undefined variable '" + name + "'.");
+}
+
+// Replaces the top two values on the stack by `op` of them, which must be
+// numbers.
+template <typename Op>
+void numeric(std::vector<QuastraValue>& stack, const char* message, Op op) {
+    QuastraValue& left = stack[stack.size() - 2];
+    const double* x = std::get_if<double>(&left);
+    const double* y = std::get_if<double>(&stack.back());
+    if (!x || !y) throw std::runtime_error(message);
+    QuastraValue result = op(*x, *y);
+    stack.pop_back();
+    stack.back() = std::move(result);
+}
+
+// sleep(ms) on the machine's event loop: other fibers run while it waits.
+class TimerFunction : public QuastraCallable {
+public:
+    explicit TimerFunction(VirtualMachine& machine) : machine(machine) {}
+
+    int arity() const override { return 1; }
+
+    QuastraValue call(Interpreter& interpreter, Arguments arguments) override {
+        (void)interpreter;
+        const double* milliseconds = std::get_if<double>(&arguments[0]);
+        if (!milliseconds) throw std::runtime_error("Argument to sleep must be a number.");
+        return machine.timer(*milliseconds);
+    }
+
+private:
+    VirtualMachine& machine;
+};
+
+} // namespace
+
+QuastraValue BytecodeFunction::call(Interpreter& interpreter, Arguments arguments) {
+    (void)interpreter; // The body runs on the machine that compiled it.
+    return machine.call(shared_from_this(), std::vector<QuastraValue>(std::make_move_iterator(arguments.begin()),
+                                                                      std::make_move_iterator(arguments.end())));
+}
+
+VirtualMachine::VirtualMachine(VmOptions options)
+    : options(options), main(std::make_shared<Fiber>()), current(main) {
+    globals = std::make_shared<Frame>(compiler.globals_size(), nullptr);
+    define_natives();
+}
+
+VirtualMachine::VirtualMachine(std::shared_ptr<const CompiledProgram> program, VmOptions options)
+    : options(options), program(std::move(program)), main(std::make_shared<Fiber>()), current(main) {
+    globals = std::make_shared<Frame>(layout().globals_size(), nullptr);
+    define_natives();
+    start(this->program->get_script());
+}
+
+VirtualMachine::~VirtualMachine() {
+    release_frames();
+}
+
+void VirtualMachine::release_frames() {
+    std::vector<std::shared_ptr<Frame>> reached;
+    std::unordered_set<const Frame*> seen;
+    auto reach_frame = [&](const std::shared_ptr<Frame>& frame) {
+        if (frame && seen.insert(frame.get()).second) reached.push_back(frame);
+    };
+    // Futures may hold functions too, as their values.
+    std::function<void(const QuastraValue&)> reach_value = [&](const QuastraValue& value) {
+        if (auto* callable = std::get_if<std::shared_ptr<QuastraCallable>>(&value)) {
+            auto* function = dynamic_cast<BytecodeFunction*>(callable->get());
+            if (function && &function->machine == this) reach_frame(function->closure);
+        } else if (auto* future = std::get_if<std::shared_ptr<QuastraFuture>>(&value)) {
+            if (*future && (*future)->is_done()) reach_value((*future)->get_value());
+        }
+    };
+    auto reach_fiber = [&](const std::vector<CallFrame>& calls, const std::vector<QuastraValue>& values) {
+        for (const CallFrame& call : calls) reach_frame(call.environment);
+        for (const QuastraValue& value : values) reach_value(value);
+    };
+
+    reach_frame(globals);
+    reach_fiber(frames, stack);
+    if (current != main) reach_fiber(main->frames, main->stack);
+    for (const auto& fiber : ready) reach_fiber(fiber->frames, fiber->stack);
+    for (const auto& fiber : waiting) reach_fiber(fiber->frames, fiber->stack);
+    for (size_t i = 0; i < reached.size(); ++i) {
+        reach_frame(reached[i]->parent);
+        for (const QuastraValue& slot : reached[i]->slots) reach_value(slot);
+    }
+
+    // `reached` keeps the frames alive while their slots are emptied.
+    for (const auto& frame : reached) frame->slots.clear();
+    reset_fibers();
+    frames.clear();
+    stack.clear();
+}
+
+void VirtualMachine::define_natives() {
+    natives.clear();
+    for (const auto& native : native_registry().all()) {
+        natives.emplace_back(native.name,
+                             native.name == "sleep" ? std::make_shared<TimerFunction>(*this) : native.function);
+    }
+    uint32_t slot;
+    for (const auto& [name, function] : natives) {
+        if (layout().global_slot(name, slot)) globals->slots[slot] = function;
+    }
+}
+
+void VirtualMachine::interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    try {
+        load(statements);
+    } catch (const std::runtime_error& failure) {
+        error = failure.what();
+        standard_output().flush();
+        std::cerr << "Runtime Error: " << error << std::endl;
+        return;
+    }
+    if (resume() == Status::Failed) std::cerr << "Runtime Error: " << error << std::endl;
+}
+
+void VirtualMachine::load(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    if (program) {
+        compiler = program->get_globals();
+        program.reset();
+    }
+    start(compiler.compile(statements));
+}
+
+void VirtualMachine::start(std::shared_ptr<const Bytecode::Function> code) {
+    script = std::move(code);
+    globals->slots.resize(layout().globals_size(), undefined());
+    reset_fibers();
+    frames.clear();
+    stack.clear();
+    stack.push_back(false); // Stands in for the callee.
+    frames.push_back({script.get(), 0, globals, 0});
+}
+
+VirtualMachine::Status VirtualMachine::resume(size_t budget) {
+    if (frames.empty() && current == main) return Status::Finished;
+    try {
+        if (!execute(main, 0, budget)) return Status::Suspended;
+    } catch (const std::runtime_error& failure) {
+        error = failure.what();
+        reset_fibers();
+        frames.clear();
+        stack.clear();
+        standard_output().flush();
+        return Status::Failed;
+    }
+    stack.clear();
+    standard_output().flush();
+    return Status::Finished;
+}
+
+QuastraValue VirtualMachine::call(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments) {
+    if (arguments.size() != static_cast<size_t>(function->arity())) {
+        throw std::runtime_error("Expected " + std::to_string(function->arity()) + " arguments but got " +
+                                 std::to_string(arguments.size()) + ".");
+    }
+    std::shared_ptr<Fiber> home = current;
+    size_t floor = frames.size();
+    size_t base = stack.size();
+    stack.push_back(std::move(function));
+    for (auto& argument : arguments) {
+        stack.push_back(std::move(argument));
+    }
+    try {
+        call_value(arguments.size(), false);
+        execute(home, floor, 0);
+    } catch (...) {
+        // Drop the fiber that failed and go back to the caller's.
+        if (current != home) {
+            ready.erase(std::remove(ready.begin(), ready.end(), home), ready.end());
+            waiting.erase(home);
+            frames.clear();
+            stack.clear();
+            switch_to(home);
+        }
+        frames.erase(frames.begin() + floor, frames.end());
+        stack.resize(base);
+        throw;
+    }
+    QuastraValue result = std::move(stack.back());
+    stack.resize(base);
+    return result;
+}
+
+const QuastraValue* VirtualMachine::get_global(const std::string& name) const {
+    uint32_t slot;
+    if (!layout().global_slot(name, slot) || slot >= globals->slots.size()) return nullptr;
+    const QuastraValue& value = globals->slots[slot];
+    return is_undefined(value) ? nullptr : &value;
+}
+
+std::vector<std::string> VirtualMachine::global_names() const {
+    std::vector<std::string> names;
+    for (const auto& [name, slot] : layout().global_names()) {
+        if (slot < globals->slots.size() && !is_undefined(globals->slots[slot])) names.push_back(name);
+    }
+    return names;
+}
+
+std::shared_ptr<QuastraFuture> VirtualMachine::timer(double milliseconds) {
+    auto future = std::make_shared<QuastraFuture>();
+    auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(std::max(milliseconds, 0.0)));
+    timers.push({std::chrono::steady_clock::now() + delay, timer_sequence++, future});
+    return future;
+}
+
+void VirtualMachine::call_value(size_t count, bool tail) {
+    size_t callee = stack.size() - count - 1;
+    auto* function = dynamic_cast<BytecodeFunction*>(std::get<std::shared_ptr<QuastraCallable>>(stack[callee]).get());
+    if (!function || &function->machine != this) {
+        auto& native = std::get<std::shared_ptr<QuastraCallable>>(stack[callee]);
+        QuastraValue result = native->call(host, Arguments(stack.data() + callee + 1, count));
+        stack.resize(callee);
+        if (tail) {
+            finish_frame(std::move(result));
+        } else {
+            stack.push_back(std::move(result));
+        }
+        return;
+    }
+
+    const Bytecode::Function& code = *function->code;
+    if (!tail && !code.is_async && frames.size() >= options.max_call_depth) {
+        throw std::runtime_error("Call depth limit exceeded.");
+    }
+    auto environment = std::make_shared<Frame>(code.frame_size, function->closure);
+    for (size_t i = 0; i < count; ++i) {
+        environment->slots[code.parameters[i]] = std::move(stack[callee + 1 + i]);
+    }
+    if (code.is_async) {
+        start_fiber(code, callee, std::move(environment), tail);
+        return;
+    }
+    if (!tail) {
+        stack.resize(callee + 1);
+        frames.push_back({&code, 0, std::move(environment), callee});
+        return;
+    }
+    // The new callee takes the place of the current one, which keeps `code` alive.
+    CallFrame& frame = frames.back();
+    stack[frame.base] = std::move(stack[callee]);
+    stack.resize(frame.base + 1);
+    frame.code = &code;
+    frame.pc = 0;
+    frame.environment = std::move(environment);
+}
+
+void VirtualMachine::finish_frame(QuastraValue result) {
+    size_t base = frames.back().base;
+    frames.pop_back();
+    stack.resize(base);
+    stack.push_back(std::move(result));
+}
+
+// --- Fibers ---
+
+void VirtualMachine::start_fiber(const Bytecode::Function& code, size_t callee, std::shared_ptr<Frame> environment,
+                                 bool tail) {
+    auto fiber = std::make_shared<Fiber>();
+    fiber->future = std::make_shared<QuastraFuture>();
+    QuastraValue result = fiber->future;
+    // The callee keeps `code` alive at the bottom of the new stack.
+    fiber->stack.push_back(std::move(stack[callee]));
+    fiber->frames.push_back({&code, 0, std::move(environment), 0});
+    stack.resize(callee);
+    if (tail) {
+        finish_frame(std::move(result));
+    } else {
+        stack.push_back(std::move(result));
+    }
+    // The body runs until it first waits, as a plain call would; its
+    // caller carries on next.
+    ready.push_front(current);
+    switch_to(std::move(fiber));
+}
+
+void VirtualMachine::wait_for(QuastraFuture& future) {
+    waiting.insert(current);
+    future.on_complete([this, weak = std::weak_ptr<Fiber>(current)] {
+        std::shared_ptr<Fiber> fiber = weak.lock();
+        if (fiber && waiting.erase(fiber)) ready.push_back(std::move(fiber));
+    });
+}
+
+bool VirtualMachine::yield(const std::shared_ptr<Fiber>& home, size_t floor) {
+    if (switch_fiber()) return false;
+    size_t home_frames = current == home ? frames.size() : home->frames.size();
+    if (home_frames > floor) throw std::runtime_error("Awaited a future that can never complete.");
+    switch_to(home);
+    return true;
+}
+
+bool VirtualMachine::switch_fiber() {
+    Mailbox& mailbox = *Mailbox::current();
+    while (true) {
+        mailbox.deliver();
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.top().deadline <= now) {
+            std::shared_ptr<QuastraFuture> future = timers.top().future;
+            timers.pop();
+            future->complete(false);
+        }
+        if (!ready.empty()) break;
+        if (!timers.empty()) {
+            mailbox.wait_until(timers.top().deadline);
+        } else if (!mailbox.wait()) {
+            return false;
+        }
+    }
+    std::shared_ptr<Fiber> next = std::move(ready.front());
+    ready.pop_front();
+    switch_to(std::move(next));
+    return true;
+}
+
+void VirtualMachine::switch_to(std::shared_ptr<Fiber> fiber) {
+    if (fiber == current) return;
+    current->frames = std::move(frames);
+    current->stack = std::move(stack);
+    current = std::move(fiber);
+    frames = std::move(current->frames);
+    stack = std::move(current->stack);
+    current->frames.clear();
+    current->stack.clear();
+}
+
+void VirtualMachine::reset_fibers() {
+    if (current != main) {
+        frames.clear();
+        stack.clear();
+        switch_to(main);
+    }
+    ready.clear();
+    waiting.clear();
+    timers = {};
+}
+
+bool VirtualMachine::execute(const std::shared_ptr<Fiber>& home, size_t floor, size_t budget) {
+    struct Nesting {
+        size_t& depth;
+        explicit Nesting(size_t& depth) : depth(depth) { depth++; }
+        ~Nesting() { depth--; }
+    } nested(nesting);
+    size_t remaining = budget;
+    while (true) {
+        if (current == home && frames.size() <= floor) {
+            // Once the top level is done, the fibers it started run to
+            // completion.
+            if (floor != 0 || yield(home, floor)) return true;
+            continue;
+        }
+        if (frames.empty()) {
+            // A fiber ran to completion; its result is all its stack holds.
+            if (current->future) current->future->complete(std::move(stack.back()));
+            stack.clear();
+            if (yield(home, floor)) return true;
+            continue;
+        }
+        if (budget != 0 && remaining-- == 0) return false;
+        CallFrame& frame = frames.back();
+        const Bytecode::Instruction& instruction = frame.code->code[frame.pc++];
+        switch (instruction.op) {
+            case Opcode::Constant:
+                stack.push_back(frame.code->constants[instruction.a]);
+                break;
+            case Opcode::Undefined:
+                throw undefined_variable(frame.code->names[instruction.a]);
+            case Opcode::GetLocal:
+                stack.push_back(frame.environment->slots[instruction.a]);
+                break;
+            case Opcode::GetOuter:
+                stack.push_back(frame_at(*frame.environment, instruction.a).slots[instruction.b]);
+                break;
+            case Opcode::GetChecked: {
+                const QuastraValue& value = frame_at(*frame.environment, instruction.a).slots[instruction.b];
+                if (is_undefined(value)) throw undefined_variable(frame.code->names[instruction.c]);
+                stack.push_back(value);
+                break;
+            }
+            case Opcode::Set:
+                frame_at(*frame.environment, instruction.a).slots[instruction.b] = stack.back();
+                break;
+            case Opcode::SetChecked: {
+                QuastraValue& slot = frame_at(*frame.environment, instruction.a).slots[instruction.b];
+                if (is_undefined(slot)) throw undefined_variable(frame.code->names[instruction.c]);
+                slot = stack.back();
+                break;
+            }
+            case Opcode::Define:
+                frame.environment->slots[instruction.a] = std::move(stack.back());
+                stack.pop_back();
+                break;
+            case Opcode::Pop:
+                stack.pop_back();
+                break;
+            case Opcode::Negate: {
+                double* number = std::get_if<double>(&stack.back());
+                if (!number) throw std::runtime_error("Operand must be a number for unary minus.");
+                *number = -*number;
+                break;
+            }
+            case Opcode::Not:
+                stack.back() = !truthy(stack.back());
+                break;
+            case Opcode::Add: {
+                QuastraValue& left = stack[stack.size() - 2];
+                const QuastraValue& right = stack.back();
+                double* x = std::get_if<double>(&left);
+                const double* y = std::get_if<double>(&right);
+                const QuastraString* s = std::get_if<QuastraString>(&left);
+                const QuastraString* t = std::get_if<QuastraString>(&right);
+                if (x && y) {
+                    *x += *y;
+                } else if (s && t) {
+                    left = QuastraString::concat(*s, *t);
+                } else {
+                    throw std::runtime_error("Operands must be two numbers or two strings for addition.");
+                }
+                stack.pop_back();
+                break;
+            }
+            case Opcode::Subtract:
+                numeric(stack, "Operands must be numbers for subtraction.", [](double a, double b) { return a - b; });
+                break;
+            case Opcode::Multiply:
+                numeric(stack, "Operands must be numbers for multiplication.", [](double a, double b) { return a * b; });
+                break;
+            case Opcode::Divide:
+                numeric(stack, "Operands must be numbers for division.", [](double a, double b) {
+                    if (b == 0) throw std::runtime_error("Division by zero.");
+                    return a / b;
+                });
+                break;
+            case Opcode::Equal:
+            case Opcode::NotEqual: {
+                bool equal = stack[stack.size() - 2] == stack.back();
+                stack.pop_back();
+                stack.back() = instruction.op == Opcode::Equal ? equal : !equal;
+                break;
+            }
+            case Opcode::Less:
+                numeric(stack, "Operands must be numbers for comparison.", [](double a, double b) { return a < b; });
+                break;
+            case Opcode::LessEqual:
+                numeric(stack, "Operands must be numbers for comparison.", [](double a, double b) { return a <= b; });
+                break;
+            case Opcode::Greater:
+                numeric(stack, "Operands must be numbers for comparison.", [](double a, double b) { return a > b; });
+                break;
+            case Opcode::GreaterEqual:
+                numeric(stack, "Operands must be numbers for comparison.", [](double a, double b) { return a >= b; });
+                break;
+            case Opcode::InvalidBinary:
+                throw std::runtime_error("Invalid binary operation.");
+            case Opcode::Jump:
+                frame.pc = instruction.a;
+                break;
+            case Opcode::JumpIfFalse: {
+                bool condition = truthy(stack.back());
+                stack.pop_back();
+                if (!condition) frame.pc = instruction.a;
+                break;
+            }
+            case Opcode::PushFrame:
+                frame.environment = std::make_shared<Frame>(instruction.a, std::move(frame.environment));
+                break;
+            case Opcode::PopFrame: {
+                std::shared_ptr<Frame> parent = frame.environment->parent;
+                frame.environment = std::move(parent);
+                break;
+            }
+            case Opcode::Closure:
+                stack.push_back(std::make_shared<BytecodeFunction>(frame.code->functions[instruction.a],
+                                                                   frame.environment, *this));
+                break;
+            case Opcode::CheckCall: {
+                auto* function = std::get_if<std::shared_ptr<QuastraCallable>>(&stack.back());
+                if (!function || !*function) throw std::runtime_error("Can only call functions and classes.");
+                if (instruction.a != static_cast<uint32_t>((*function)->arity())) {
+                    throw std::runtime_error("Expected " + std::to_string((*function)->arity()) +
+                                             " arguments but got " + std::to_string(instruction.a) + ".");
+                }
+                break;
+            }
+            case Opcode::Call:
+                call_value(instruction.a, false);
+                break;
+            case Opcode::TailCall:
+                call_value(instruction.a, true);
+                break;
+            case Opcode::Return: {
+                QuastraValue result = std::move(stack.back());
+                finish_frame(std::move(result));
+                break;
+            }
+            case Opcode::Await: {
+                auto* future = std::get_if<std::shared_ptr<QuastraFuture>>(&stack.back());
+                if (!future) throw std::runtime_error("Can only await futures.");
+                if ((*future)->is_done()) {
+                    // Copied first: the slot may hold the only reference to
+                    // the future, which overwriting it frees.
+                    QuastraValue value = (*future)->get_value();
+                    stack.back() = std::move(value);
+                    break;
+                }
+                // A native's callback cannot give the event loop back its
+                // caller's fiber.
+                if (nesting > 1) throw std::runtime_error("Cannot await a pending future in a nested call.");
+                frame.pc--; // Awaits again, and finds it done, once woken.
+                wait_for(**future);
+                if (yield(home, floor)) return true;
+                break;
+            }
+        }
+    }
+}
+
+} // namespace Quastra
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "bytecode.hpp"
+#include "bytecode_compiler.hpp"
+#include "compiled_program.hpp"
+#include "../interpreter/closure_engine.hpp"
+#include "../interpreter/interpreter.hpp"
+#include "../runtime/quastra_future.hpp"
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace Quastra {
+
+struct VmOptions {
+    // Quastra calls that may be in progress at once. Frames live on the heap,
+    // so this is the only bound on recursion.
+    size_t max_call_depth = 1000000;
+};
+
+// Runs programs compiled to bytecode. Calls between Quastra functions do
+// not recurse in C++: each one pushes a CallFrame onto a growable vector,
+// with its variables in a heap Frame and its temporaries on an operand
+// stack, so recursion is only bounded by `max_call_depth`, which is
+// reported as a runtime error rather than overflowing the native stack.
+//
+// Since the whole state of the program is in those stacks, execution can
+// stop after any instruction and carry on later: resume() runs a bounded
+// number of instructions, which lets a host interleave many scripts on one
+// thread. Output and runtime error messages match the Interpreter's.
+//
+// The same property makes `async fn` cheap: each call of one runs in a
+// fiber, a call stack and operand stack of its own, starting at once and
+// running until it awaits a future that is still pending. The fiber is then
+// parked on the future and the event loop switches to the next ready fiber,
+// or sleeps until the earliest `sleep` timer is due, so thousands of waits
+// cost a few heap frames each rather than a thread. A fiber that finishes
+// completes the future its call returned, which makes its waiters ready. A
+// program's fibers all run before interpret() returns.
+//
+// A machine is used by one thread at a time. To serve many requests at
+// once, compile the program once into a CompiledProgram and give each
+// thread or request a machine of its own running it: machines share the
+// program's code but not their globals.
+class VirtualMachine {
+public:
+    enum class Status { Finished, Suspended, Failed };
+
+    explicit VirtualMachine(VmOptions options = {});
+
+    // A machine with `program` loaded, as if by load(), and globals of its
+    // own. Nothing is parsed or compiled again.
+    explicit VirtualMachine(std::shared_ptr<const CompiledProgram> program, VmOptions options = {});
+
+    // Functions hold the frames they close over, globals included, so the
+    // frames a program leaves behind form cycles. They are broken here;
+    // functions the host still holds can no longer be called.
+    ~VirtualMachine();
+
+    // Compiles and runs the statements at top level. Runtime errors are
+    // reported on stderr, like Interpreter::interpret.
+    void interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // Compiles the statements and makes them the program resume() runs, in
+    // place of any suspended one. The bytecode does not refer to the AST.
+    // The statements see the globals defined so far.
+    void load(const std::vector<std::unique_ptr<AST::Stmt>>& statements);
+
+    // Runs the loaded program until it finishes or fails, or until it has
+    // run `budget` instructions (0 for no limit) and is suspended; the next
+    // call carries on from there. A failure's message is in get_error().
+    Status resume(size_t budget = 0);
+
+    const std::string& get_error() const { return error; }
+
+    // Calls a function to completion with the given arguments. Runtime
+    // errors propagate as std::runtime_error.
+    QuastraValue call(std::shared_ptr<QuastraCallable> function, std::vector<QuastraValue> arguments);
+
+    // The value of a global, or nullptr if it is not defined (yet).
+    const QuastraValue* get_global(const std::string& name) const;
+
+    // The names of the globals defined so far, natives included.
+    std::vector<std::string> global_names() const;
+
+    // Writes the globals to the file at `path`, with the bytecode of every
+    // function they can reach and the frames those functions closed over,
+    // so a later process can restore_snapshot() instead of parsing,
+    // compiling and running the code that made them. The machine must have
+    // finished; futures and foreign natives cannot be saved. Failures throw
+    // std::runtime_error.
+    void save_snapshot(const std::string& path) const;
+
+    // Replaces the machine's globals and code by those saved at `path`,
+    // reading the file through a memory map. The machine is then finished,
+    // as if it had run the code that defined them, and load() compiles
+    // code that sees them. Failures throw std::runtime_error and leave the
+    // machine as it was.
+    void restore_snapshot(const std::string& path);
+
+    // Quastra calls in progress in the running fiber, including the top
+    // level.
+    size_t call_depth() const { return frames.size(); }
+
+    // A future the event loop completes with false once `milliseconds` have
+    // passed, for the `sleep` native.
+    std::shared_ptr<QuastraFuture> timer(double milliseconds);
+
+private:
+    struct CallFrame {
+        const Bytecode::Function* code;
+        size_t pc = 0;
+        std::shared_ptr<Frame> environment;
+        size_t base = 0; // Operand stack index of the callee.
+    };
+
+    // The state of a fiber while another one runs. The running fiber's
+    // state is in `frames` and `stack`.
+    struct Fiber {
+        std::vector<CallFrame> frames;
+        std::vector<QuastraValue> stack;
+        // Completed with the result of the async call the fiber runs; null
+        // for the top level.
+        std::shared_ptr<QuastraFuture> future;
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        uint64_t sequence; // Timers due at once fire in creation order.
+        std::shared_ptr<QuastraFuture> future;
+
+        bool operator>(const Timer& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    // Runs until the fiber `home` has only `floor` frames left, then returns
+    // true; or returns false once `budget` instructions have run (0 for no
+    // limit). When the top level finishes (`floor` is 0), the other fibers
+    // run until none can.
+    bool execute(const std::shared_ptr<Fiber>& home, size_t floor, size_t budget);
+    // Calls the function whose callee and `count` arguments are on top of
+    // the operand stack. Quastra functions get a new frame, which replaces
+    // the current one for a tail call; natives run now.
+    void call_value(size_t count, bool tail);
+    // Pops the current frame and leaves `result` in place of its callee.
+    void finish_frame(QuastraValue result);
+    // Starts a fiber for an async call whose frame is `environment`,
+    // leaving its future in place of the callee, and runs it right away.
+    void start_fiber(const Bytecode::Function& code, size_t callee, std::shared_ptr<Frame> environment, bool tail);
+    // Parks the running fiber until `future` completes.
+    void wait_for(QuastraFuture& future);
+    // The running fiber finished or parked: switches to the next one.
+    // Returns true if none is left to run and `home` is done, which is then
+    // the running fiber again.
+    bool yield(const std::shared_ptr<Fiber>& home, size_t floor);
+    // Makes the next ready fiber the running one, delivering the thread's
+    // Mailbox, firing due timers, and waiting for the next timer or post if
+    // no fiber is ready. Returns false if no fiber can run.
+    bool switch_fiber();
+    void switch_to(std::shared_ptr<Fiber> fiber);
+    // Forgets every fiber but the top level's, after a failure or a load.
+    void reset_fibers();
+    // Makes `code` the top level resume() runs, with a slot for every global.
+    void start(std::shared_ptr<const Bytecode::Function> code);
+    void define_natives();
+    // Empties every frame the machine can reach, so the cycles between
+    // frames and the functions in them are freed.
+    void release_frames();
+    // The compiler that numbered the global slots.
+    const BytecodeCompiler& layout() const { return program ? program->get_globals() : compiler; }
+
+    VmOptions options;
+    // The native functions define_natives() made, by global name.
+    std::vector<std::pair<std::string, std::shared_ptr<QuastraCallable>>> natives;
+    // The program the machine was made from, whose slots the globals use
+    // until load() compiles more code with a copy of its compiler.
+    std::shared_ptr<const CompiledProgram> program;
+    BytecodeCompiler compiler;
+    std::shared_ptr<Frame> globals;
+    std::shared_ptr<const Bytecode::Function> script;
+    std::vector<CallFrame> frames;
+    std::vector<QuastraValue> stack;
+    std::string error;
+
+    std::shared_ptr<Fiber> main;    // The top level's.
+    std::shared_ptr<Fiber> current; // The running one.
+    std::deque<std::shared_ptr<Fiber>> ready;
+    // Fibers parked on a future. The future's waiter only holds a weak
+    // reference, so a fiber awaiting a future it holds is no cycle.
+    std::unordered_set<std::shared_ptr<Fiber>> waiting;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    uint64_t timer_sequence = 0;
+    // execute() calls in progress; fibers only park in the outermost.
+    size_t nesting = 0;
+
+    // Native functions take the interpreter calling them. They only use it
+    // for callbacks into Quastra code, which none of them make.
+    Interpreter host;
+};
+
+} // namespace Quastra
@@ -1,12 +1,34 @@
 #include "lib/frontend/lexer.hpp"
 #include "lib/frontend/parser.hpp"
 #include "lib/backend/codegen.hpp"
+#include "lib/driver/pass_manager.hpp"
+#include "lib/driver/pipeline.hpp"
+#include "lib/interpreter/closure_engine.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/ir/lowering.hpp"
+#include "lib/jit/jit.hpp"
+#include "lib/jit/native_tier.hpp"
+#include "lib/ir/verifier.hpp"
+#include "lib/runtime/core_io.hpp"
+#include "lib/runtime/quastra_callable.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <functional>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <memory>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The tree and closure engines recurse in C++ for every Quastra call, so
+// they run on a thread with a stack sized for their call depth limit:
+// `stack_per_call` bytes per level, which is several times what a call takes.
+static constexpr size_t default_recursive_call_depth = 100000;
+static constexpr size_t stack_per_call = 4096;
 
 // Function to read a source file into a string.
 static std::string read_file(const std::string& path) {
@@ -20,51 +42,354 @@ static std::string read_file(const std::string& path) {
     return buffer.str();
 }
 
-// The main compiler pipeline.
-static void run(const std::string& source) {
-    Quastra::Lexer lexer(source);
-    auto tokens = lexer.scan_tokens();
-    Quastra::Parser parser(tokens);
-    auto statements = parser.parse();
+// Command line options for the driver.
+struct Options {
+    bool emit_ir = false; // Print the SSA IR instead of C++.
+    bool via_ir = false;  // Generate C++ from the IR rather than the AST.
+    bool run = false;     // Interpret the program instead of compiling it.
+    bool time_passes = false; // Print the pass manager's report to stderr.
+    std::string engine = "tree"; // What --run executes with: "tree", "closure" or "vm".
+    bool jit = false;     // Compile hot functions to machine code (tree engine).
+    bool tiered = false;  // Compile hot functions with g++ and load them (tree engine).
+    std::string restore_snapshot; // Start the vm engine from this snapshot.
+    std::string save_snapshot;    // Snapshot the vm engine's globals here once the program has run.
+    size_t output_buffer = Quastra::BufferedWriter::default_capacity; // Bytes of output held before a write.
+    size_t max_call_depth = 0; // Quastra calls in progress at once; 0 for the engine's default.
+    Quastra::PipelineOptions pipeline;
+    std::string source_path;
+};
+
+// Lowers the program to IR and verifies it. Returns false on any error.
+static bool lower_to_ir(const std::vector<std::unique_ptr<Quastra::AST::Stmt>>& statements, Quastra::IRLowering& lowering) {
+    if (!lowering.lower(statements)) return false;
+    Quastra::IRVerifier verifier;
+    if (!verifier.verify(lowering.get_module())) {
+        for (const auto& error : verifier.get_errors()) {
+            std::cerr << "IR Verification Error: " << error << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
 
-    // Check for parsing errors.
-    // A real compiler would have better error reporting.
+static bool has_main(const std::vector<std::unique_ptr<Quastra::AST::Stmt>>& statements) {
     for (const auto& stmt : statements) {
-        if (!stmt) {
-            std::cerr << "Error: Parsing failed." << std::endl;
-            return;
+        auto* function = dynamic_cast<const Quastra::AST::FunctionStmt*>(stmt.get());
+        if (function && function->name.lexeme == "main") return true;
+    }
+    return false;
+}
+
+// The process exit code for main's return value: the value when it is a number.
+static int exit_code(const Quastra::QuastraValue& result) {
+    if (const double* code = std::get_if<double>(&result)) return static_cast<int>(*code);
+    return 0;
+}
+
+// Interprets the program, then calls main if it defines one. Returns the
+// process exit code.
+static int interpret(const std::vector<std::unique_ptr<Quastra::AST::Stmt>>& statements, const Options& options,
+                     size_t max_call_depth) {
+    Quastra::BaselineJit jit(statements);
+    Quastra::NativeTier native_tier(statements);
+    Quastra::Interpreter interpreter;
+    interpreter.set_limits({0, max_call_depth});
+    if (options.jit) interpreter.set_tier(&jit);
+    if (options.tiered) interpreter.set_tier(&native_tier);
+    interpreter.interpret(statements);
+    if (!has_main(statements)) return 0;
+
+    Quastra::AST::Call call(std::make_unique<Quastra::AST::Variable>(Quastra::Token{Quastra::TokenType::Identifier, "main", 0}),
+                            Quastra::Token{Quastra::TokenType::RightParen, ")", 0}, {});
+    try {
+        // main's tasks join a group that lives as long as the call does.
+        return exit_code(interpreter.evaluate_joined(call));
+    } catch (const std::runtime_error& error) {
+        Quastra::standard_output().flush(); // What main printed comes first.
+        std::cerr << "Runtime Error: " << error.what() << std::endl;
+        return 70; // Internal software error
+    }
+}
+
+// The same on the closure-compiling engine.
+static int run_closures(const std::vector<std::unique_ptr<Quastra::AST::Stmt>>& statements, size_t max_call_depth) {
+    Quastra::ClosureEngine engine(max_call_depth);
+    engine.interpret(statements);
+    if (!has_main(statements)) return 0;
+
+    const Quastra::QuastraValue* main_function = engine.get_global("main");
+    auto* function = main_function ? std::get_if<std::shared_ptr<Quastra::QuastraCallable>>(main_function) : nullptr;
+    try {
+        if (!function) throw std::runtime_error("Can only call functions and classes.");
+        if ((*function)->arity() != 0) {
+            throw std::runtime_error("Expected " + std::to_string((*function)->arity()) + " arguments but got 0.");
+        }
+        return exit_code(engine.call(*function, {}));
+    } catch (const std::runtime_error& error) {
+        Quastra::standard_output().flush();
+        std::cerr << "Runtime Error: " << error.what() << std::endl;
+        return 70; // Internal software error
+    }
+}
+
+// The same on the bytecode virtual machine, which may start from a
+// snapshot's globals and save its own afterwards.
+static int run_vm(const std::vector<std::unique_ptr<Quastra::AST::Stmt>>& statements,
+                  Quastra::VirtualMachine& machine, const Options& options) {
+    machine.interpret(statements);
+    if (!options.save_snapshot.empty()) {
+        try {
+            machine.save_snapshot(options.save_snapshot);
+        } catch (const std::runtime_error& error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return 74; // IO error
+        }
+    }
+    if (!has_main(statements)) return 0;
+
+    const Quastra::QuastraValue* main_function = machine.get_global("main");
+    auto* function = main_function ? std::get_if<std::shared_ptr<Quastra::QuastraCallable>>(main_function) : nullptr;
+    try {
+        if (!function) throw std::runtime_error("Can only call functions and classes.");
+        return exit_code(machine.call(*function, {}));
+    } catch (const std::runtime_error& error) {
+        Quastra::standard_output().flush();
+        std::cerr << "Runtime Error: " << error.what() << std::endl;
+        return 70; // Internal software error
+    }
+}
+
+// Runs `body` on a thread with a stack of `bytes` and waits for it. Returns
+// false if the thread could not be made, e.g. for want of address space.
+// The stack is only reserved: pages are committed as deep calls touch them,
+// with a guard page below so running past it faults.
+static bool run_with_stack(size_t bytes, const std::function<void()>& body) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    bytes = (bytes + page - 1) / page * page + page;
+    void* stack = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                       -1, 0);
+    if (stack == MAP_FAILED) return false;
+    mprotect(stack, page, PROT_NONE);
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, stack, bytes);
+    pthread_t thread;
+    auto entry = [](void* argument) -> void* {
+        (*static_cast<const std::function<void()>*>(argument))();
+        return nullptr;
+    };
+    bool started = pthread_create(&thread, &attributes, entry, const_cast<std::function<void()>*>(&body)) == 0;
+    pthread_attr_destroy(&attributes);
+    if (started) pthread_join(thread, nullptr);
+    munmap(stack, bytes);
+    return started;
+}
+
+// Lexes, parses and runs the passes, then hands the program to a backend.
+// Every stage is measured by `passes`.
+static int run_pipeline(const std::string& source, const Options& options, Quastra::PassManager& passes,
+                        Quastra::VirtualMachine& machine) {
+    std::vector<Quastra::Token> tokens;
+    passes.measure("lex", [&] { tokens = Quastra::Lexer(source).scan_tokens(); });
+    Quastra::Program statements;
+    Quastra::Parser parser(tokens);
+    passes.measure("parse", [&] { statements = parser.parse(); });
+
+    // The parser reports each error and recovers to find more, so any error
+    // fails the program, whether or not it left a statement out.
+    if (parser.failed()) {
+        std::cerr << "Error: Parsing failed." << std::endl;
+        return 65; // Data format error
+    }
+
+    if (!passes.run(statements)) return 65;
+
+    int status = 0;
+    if (options.run) {
+        if (options.engine == "vm") {
+            passes.measure("run-vm", [&] { status = run_vm(statements, machine, options); });
+            return status;
+        }
+        size_t depth = options.max_call_depth ? options.max_call_depth : default_recursive_call_depth;
+        size_t stack = std::max<size_t>(depth, 2048) * stack_per_call;
+        bool started = run_with_stack(stack, [&] {
+            // Measured on the thread, whose allocations it counts.
+            if (options.engine == "closure") {
+                passes.measure("run-closures", [&] { status = run_closures(statements, depth); });
+            } else {
+                passes.measure("interpret", [&] { status = interpret(statements, options, depth); });
+            }
+        });
+        if (!started) {
+            std::cerr << "Error: Cannot reserve a stack for a call depth of " << depth << "." << std::endl;
+            return 71; // System error
         }
+        return status;
     }
 
-    Quastra::CodeGen codegen;
-    std::string cpp_source = codegen.generate(statements);
+    if (options.emit_ir || options.via_ir) {
+        Quastra::IRLowering lowering;
+        bool lowered = false;
+        passes.measure("lower-ir", [&] { lowered = lower_to_ir(statements, lowering); });
+        if (lowered) {
+            if (options.emit_ir) {
+                std::cout << Quastra::IR::to_string(lowering.get_module());
+            } else {
+                std::string cpp_source;
+                passes.measure("codegen", [&] { cpp_source = Quastra::CodeGen().generate(lowering.get_module()); });
+                std::cout << cpp_source;
+            }
+            return 0;
+        }
+        // The IR covers a subset of the language (no strings, closures or
+        // async); other programs still compile from the AST.
+        if (options.emit_ir) {
+            std::cerr << "Error: IR lowering failed." << std::endl;
+            return 65;
+        }
+        std::cerr << "Note: the program is outside what the IR supports; generating C++ from the AST instead."
+                  << std::endl;
+    }
+
+    std::string cpp_source;
+    passes.measure("codegen", [&] { cpp_source = Quastra::CodeGen().generate(statements); });
 
     // For now, we'll just print the generated C++ to the console.
     // The next step would be to save this to a file and invoke g++.
     std::cout << cpp_source;
+    return 0;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: quastra-compiler <file.qstra>" << std::endl;
-        return 64; // Command line usage error
+// The main compiler pipeline.
+static int run(const std::string& source, Options options) {
+    Quastra::PassManager passes(options.time_passes);
+    Quastra::VmOptions vm_options;
+    if (options.max_call_depth) vm_options.max_call_depth = options.max_call_depth;
+    Quastra::VirtualMachine machine(vm_options);
+    if (!options.restore_snapshot.empty()) {
+        try {
+            passes.measure("restore-snapshot", [&] { machine.restore_snapshot(options.restore_snapshot); });
+        } catch (const std::runtime_error& error) {
+            std::cerr << "Error: " << error.what() << std::endl;
+            return 74; // IO error
+        }
+        options.pipeline.globals = machine.global_names();
     }
+    if (!Quastra::build_pipeline(passes, options.pipeline)) return 64;
+
+    int status = run_pipeline(source, options, passes, machine);
+    if (options.time_passes) std::cerr << passes.report();
+    return status;
+}
+
+static void print_usage() {
+    std::cerr << "Usage: quastra-compiler [options] <file.qstra>\n"
+              << "Options:\n"
+              << "  --emit-ir    Print the SSA intermediate representation\n"
+              << "  --via-ir     Generate C++ from the SSA IR (from the AST if the IR cannot express the program)\n"
+              << "  --run        Interpret the program instead of compiling it\n"
+              << "  --engine=<name>  What --run executes with: tree (default), closure or vm\n"
+              << "  --jit        With --run: compile hot numeric functions to x86-64 code\n"
+              << "  --tiered     With --run: compile hot numeric functions with g++ and dlopen them\n"
+              << "  --restore-snapshot=<file>  With --engine=vm: start from the globals saved in <file>\n"
+              << "  --save-snapshot=<file>     With --engine=vm: save the globals to <file> once the program has run\n"
+              << "  --output-buffer=<bytes>    With --run: output held before it is written (default 65536, 0 for none)\n"
+              << "  --max-call-depth=<n>       With --run: calls in progress at once before a runtime error\n"
+              << "                             (default 1000000 on the vm, 100000 on the tree and closure engines)\n"
+              << "  -O<level>    Optimisation level: 0 (default), 1 or 2\n"
+              << "  --inline-budget=<n>  AST nodes the inliner may add at -O2\n"
+              << "  --inline-report      Print the inliner's decisions\n"
+              << "  --type-check         Reject programs the type checker rejects\n"
+              << "  --passes=<a,b,...>   Run exactly these passes instead of the -O pipeline\n"
+              << "  --time-passes        Print time, allocations and AST size per pass\n"
+              << "  --version    Print version information" << std::endl;
+}
 
-    std::string arg = argv[1];
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
 
-    if (arg == "--version") {
-        std::cout << "Quastra Compiler v1.0.0\n"
-          << "Copyright (c) 2025 Quastra Systems\n"
-          << "Licensed under the MIT License\n"
-          << "This compiler translates Quastra source files (.qstra) into C++ code.\n"
-          << "For documentation and updates, visit: https://quastra.dev\n";
+        if (arg == "--version") {
+            std::cout << "Quastra Compiler v1.0.0\n"
+              << "Copyright (c) 2025 Quastra Systems\n"
+              << "Licensed under the MIT License\n"
+              << "This compiler translates Quastra source files (.qstra) into C++ code.\n"
+              << "For documentation and updates, visit: https://quastra.dev\n";
 
-        return 0;
+            return 0;
+        } else if (arg == "--emit-ir") {
+            options.emit_ir = true;
+        } else if (arg == "--via-ir") {
+            options.via_ir = true;
+        } else if (arg == "--run") {
+            options.run = true;
+        } else if (arg == "--jit") {
+            options.jit = true;
+        } else if (arg == "--tiered") {
+            options.tiered = true;
+        } else if (arg == "--engine=tree" || arg == "--engine=closure" || arg == "--engine=vm") {
+            options.engine = arg.substr(9);
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            options.pipeline.opt_level = arg[2] - '0';
+        } else if (arg == "--inline-report") {
+            options.pipeline.inline_report = true;
+        } else if (arg == "--type-check") {
+            options.pipeline.type_check = true;
+        } else if (arg == "--time-passes") {
+            options.time_passes = true;
+        } else if (arg.rfind("--passes=", 0) == 0) {
+            std::stringstream list(arg.substr(9));
+            std::string name;
+            while (std::getline(list, name, ',')) {
+                if (!name.empty()) options.pipeline.passes.push_back(name);
+            }
+        } else if (arg.rfind("--restore-snapshot=", 0) == 0) {
+            options.restore_snapshot = arg.substr(19);
+        } else if (arg.rfind("--save-snapshot=", 0) == 0) {
+            options.save_snapshot = arg.substr(16);
+        } else if (arg.rfind("--output-buffer=", 0) == 0) {
+            std::string size = arg.substr(16);
+            if (size.empty() || size.find_first_not_of("0123456789") != std::string::npos) {
+                print_usage();
+                return 64;
+            }
+            options.output_buffer = std::stoul(size);
+        } else if (arg.rfind("--max-call-depth=", 0) == 0) {
+            std::string depth = arg.substr(17);
+            if (depth.empty() || depth.find_first_not_of("0123456789") != std::string::npos || std::stoul(depth) == 0) {
+                print_usage();
+                return 64;
+            }
+            options.max_call_depth = std::stoul(depth);
+        } else if (arg.rfind("--inline-budget=", 0) == 0) {
+            std::string budget = arg.substr(16);
+            if (budget.empty() || budget.find_first_not_of("0123456789") != std::string::npos) {
+                print_usage();
+                return 64;
+            }
+            options.pipeline.inline_options.budget = std::stoul(budget);
+        } else if (arg.rfind("-", 0) == 0 || !options.source_path.empty()) {
+            print_usage();
+            return 64; // Command line usage error
+        } else {
+            options.source_path = arg;
+        }
     }
 
-    std::string source_path = argv[1];
-    std::string source_code = read_file(source_path);
-    run(source_code);
+    bool snapshots = !options.restore_snapshot.empty() || !options.save_snapshot.empty();
+    if (options.source_path.empty() || (options.jit && options.tiered) ||
+        (snapshots && (!options.run || options.engine != "vm"))) {
+        print_usage();
+        return 64; // Command line usage error
+    }
 
-    return 0;
+    // A terminal sees each line as it is printed; pipes and files get the
+    // output in large writes.
+    Quastra::standard_output().set_capacity(options.output_buffer);
+    Quastra::standard_output().set_line_buffered(isatty(STDOUT_FILENO));
+
+    std::string source_code = read_file(options.source_path);
+    return run(source_code, options);
 }
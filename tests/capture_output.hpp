@@ -0,0 +1,21 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Captures everything written to stdout and stderr while it is alive.
+class CaptureOutput {
+public:
+    CaptureOutput() : old(std::cout.rdbuf(buffer.rdbuf())), old_err(std::cerr.rdbuf(buffer.rdbuf())) {}
+    ~CaptureOutput() {
+        std::cout.rdbuf(old);
+        std::cerr.rdbuf(old_err);
+    }
+    std::string str() const { return buffer.str(); }
+
+private:
+    std::stringstream buffer;
+    std::streambuf* old;
+    std::streambuf* old_err;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+// Helpers for tests that check generated C++ by building and running it,
+// rather than by matching its text.
+
+inline bool has_compiler() {
+    return std::system("g++ --version > /dev/null 2>&1") == 0;
+}
+
+// Compiles `cpp` with g++ (C++20, which the generated code's `auto`
+// parameters and coroutines need) and runs it with `input` as stdin.
+// Returns what it printed, or adds a failure with the compiler's errors and
+// returns "". `elapsed`, if given, gets how long the program ran.
+inline std::string compile_and_run(const std::string& cpp, const std::string& input = "",
+                                   std::chrono::steady_clock::duration* elapsed = nullptr) {
+    char directory[] = "/tmp/quastra_cpp_XXXXXX";
+    if (!mkdtemp(directory)) {
+        ADD_FAILURE() << "Could not create a directory for the generated C++.";
+        return "";
+    }
+    std::string base = directory;
+    std::ofstream(base + "/program.cpp") << cpp;
+    std::ofstream(base + "/input.txt") << input;
+
+    std::string build = "g++ -std=c++20 -o " + base + "/program " + base + "/program.cpp 2> " + base + "/errors.txt";
+    std::string output;
+    if (std::system(build.c_str()) != 0) {
+        std::ifstream errors(base + "/errors.txt");
+        std::stringstream text;
+        text << errors.rdbuf();
+        ADD_FAILURE() << "The generated C++ does not compile:\n" << text.str() << "\n" << cpp;
+    } else {
+        std::string run = base + "/program < " + base + "/input.txt";
+        auto start = std::chrono::steady_clock::now();
+        if (FILE* pipe = popen(run.c_str(), "r")) {
+            char buffer[4096];
+            size_t count;
+            while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0) output.append(buffer, count);
+            pclose(pipe);
+        }
+        if (elapsed) *elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (std::system(("rm -rf " + base).c_str()) != 0) ADD_FAILURE() << "Could not remove " << base << ".";
+    return output;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include "lib/runtime/native_binding.hpp"
+#include <string>
+#include <vector>
+
+// A fixture for tests that bind natives of their own. They go into the
+// process-wide registry, which every engine and checker reads, so they are
+// removed again when the test ends: otherwise the global slots and snapshot
+// contents of every later test would depend on which tests ran first.
+class NativesTest : public ::testing::Test {
+protected:
+    template <typename Signature>
+    void register_native(const std::string& name, Signature* function) {
+        Quastra::register_native(name, function);
+        added.push_back(name);
+    }
+
+    void TearDown() override {
+        for (const auto& name : added) Quastra::native_registry().remove(name);
+    }
+
+private:
+    std::vector<std::string> added;
+};
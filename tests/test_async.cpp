@@ -0,0 +1,301 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/interpreter/closure_engine.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include <chrono>
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(Resolver().resolve(statements));
+    return statements;
+}
+
+// Runs the program on the given engine and captures everything it prints.
+template <typename Engine>
+static std::string run(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Engine engine;
+    engine.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Checks that every engine prints what the Interpreter does and returns it.
+static std::string run_all(const std::string& source) {
+    auto statements = parse(source);
+    std::string expected = run<Interpreter>(statements);
+    EXPECT_EQ(run<ClosureEngine>(statements), expected);
+    EXPECT_EQ(run<VirtualMachine>(statements), expected);
+    return expected;
+}
+
+TEST(AsyncTest, AwaitGivesTheResult) {
+    std::string output = run_all(R"(
+        async fn add(a, b) {
+            return a + b;
+        }
+        async fn twice(x) {
+            let once = await add(x, x);
+            return await add(once, once);
+        }
+        async fn nothing() {}
+        fn plain() {
+            return add(1, 2);
+        }
+        println(await twice(3));
+        println(await nothing());
+        println(await plain());
+        println(add(1, 1));
+    )");
+    EXPECT_EQ(output, "12\nfalse\n3\n<future>\n");
+}
+
+TEST(AsyncTest, BodiesStartWhenCalled) {
+    // Nothing waits, so every engine runs the body up to its return first.
+    std::string output = run_all(R"(
+        async fn log(label) {
+            println(label);
+            return label;
+        }
+        let pending = log("first");
+        println("second");
+        println(await pending);
+    )");
+    EXPECT_EQ(output, "first\nsecond\nfirst\n");
+}
+
+TEST(AsyncTest, RuntimeErrorsMatch) {
+    EXPECT_EQ(run_all("println(await 1);"), "Runtime Error: Can only await futures.\n");
+    EXPECT_EQ(run_all("async fn f() { return 1 / 0; } await f();"), "Runtime Error: Division by zero.\n");
+    EXPECT_EQ(run_all("sleep(true);"), "Runtime Error: Argument to sleep must be a number.\n");
+    EXPECT_EQ(run_all("send(1, 2);"), "Runtime Error: Argument 1 to send must be a channel.\n");
+    EXPECT_EQ(run_all("channel(-1);"), "Runtime Error: Argument to channel must be a whole number from 0 to 1048576.\n");
+    // Nothing else could ever send.
+    EXPECT_EQ(run_all("await receive(channel(1));"), "Runtime Error: Awaited a future that can never complete.\n");
+}
+
+// Runs the program on the given engine, which must finish within `limit`.
+template <typename Engine>
+static std::string run_within(const std::vector<std::unique_ptr<AST::Stmt>>& statements,
+                              std::chrono::milliseconds limit) {
+    auto start = std::chrono::steady_clock::now();
+    std::string output = run<Engine>(statements);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, limit);
+    return output;
+}
+
+TEST(AsyncTest, WaitsOverlapOnEveryEngine) {
+    auto statements = parse(R"(
+        async fn after(ms, label) {
+            await sleep(ms);
+            println(label);
+        }
+        let first = after(200, 1);
+        let second = after(100, 2);
+        let third = after(150, 3);
+        await first;
+        await second;
+        await third;
+    )");
+    // The calls finish in the order their sleeps end, about 200 ms in
+    // rather than after all 450.
+    auto limit = std::chrono::milliseconds(350);
+    EXPECT_EQ(run_within<Interpreter>(statements, limit), "2\n3\n1\n");
+    EXPECT_EQ(run_within<ClosureEngine>(statements, limit), "2\n3\n1\n");
+    EXPECT_EQ(run_within<VirtualMachine>(statements, limit), "2\n3\n1\n");
+}
+
+TEST(AsyncTest, EnginesWaitOnThousandsOfCalls) {
+    std::string output = run_all(R"(
+        let mut done = 0;
+        async fn worker(ms) {
+            await sleep(ms);
+            done = done + 1;
+        }
+        let mut i = 0;
+        while (i < 2000) {
+            worker(i / 1000);
+            i = i + 1;
+        }
+        await sleep(5);
+        println(done);
+    )");
+    EXPECT_EQ(output, "2000\n");
+}
+
+TEST(AsyncTest, ChannelsParkFibersOnEveryEngine) {
+    // Two producers and two consumers share two slots, so each of them
+    // parks over and over.
+    std::string output = run_all(R"(
+        async fn produce(ch, from, to) {
+            let mut i = from;
+            while (i <= to) {
+                await send(ch, i);
+                i = i + 1;
+            }
+        }
+        async fn consume(ch) {
+            let mut total = 0;
+            let mut value = await receive(ch);
+            while (value != false) {
+                total = total + value;
+                value = await receive(ch);
+            }
+            return total;
+        }
+        let ch = channel(2);
+        let first = consume(ch);
+        let second = consume(ch);
+        let a = produce(ch, 1, 50);
+        let b = produce(ch, 51, 100);
+        await a;
+        await b;
+        close(ch);
+        println(await first + await second);
+        println(await send(ch, 1));
+        println(await receive(ch));
+        println(ch);
+    )");
+    EXPECT_EQ(output, "5050\nfalse\nfalse\n<channel>\n");
+}
+
+TEST(AsyncTest, ThousandsOfCallsWaitOnOneChannel) {
+    std::string output = run_all(R"(
+        let mut got = 0;
+        async fn take(ch) {
+            let value = await receive(ch);
+            got = got + value;
+        }
+        let ch = channel(0);
+        let mut i = 0;
+        while (i < 2000) {
+            take(ch);
+            i = i + 1;
+        }
+        println(got);
+        i = 0;
+        while (i < 2000) {
+            send(ch, 1);
+            i = i + 1;
+        }
+        await sleep(1);
+        println(got);
+    )");
+    EXPECT_EQ(output, "0\n2000\n");
+}
+
+TEST(AsyncTest, ChannelsConnectTasksOnOtherThreads) {
+    // Only the Interpreter runs tasks on threads of their own; each waits
+    // for the other through its own thread's event loop.
+    auto statements = parse(R"(
+        let ch = channel(4);
+        let results = channel(1);
+        scope {
+            spawn {
+                let mut total = 0;
+                let mut value = await receive(ch);
+                while (value != false) {
+                    total = total + value;
+                    value = await receive(ch);
+                }
+                await send(results, total);
+            }
+            spawn {
+                let mut i = 1;
+                while (i <= 500) {
+                    await send(ch, i);
+                    i = i + 1;
+                }
+                close(ch);
+            }
+        }
+        println(await receive(results));
+    )");
+    EXPECT_EQ(run<Interpreter>(statements), "125250\n");
+}
+
+TEST(AsyncTest, MachineRunsOtherFibersWhileOneWaits) {
+    auto statements = parse(R"(
+        async fn after(ms, label) {
+            await sleep(ms);
+            println(label);
+            return ms;
+        }
+        let slow = after(60, "slow");
+        let fast = after(20, "fast");
+        println("started");
+        println(await slow + await fast);
+    )");
+    auto start = std::chrono::steady_clock::now();
+    std::string output = run<VirtualMachine>(statements);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(output, "started\nfast\nslow\n80\n");
+    // The waits overlap rather than adding up.
+    EXPECT_LT(elapsed, std::chrono::milliseconds(80));
+}
+
+TEST(AsyncTest, MachineWaitsOnThousandsOfFibers) {
+    auto statements = parse(R"(
+        let mut done = 0;
+        async fn worker(ms) {
+            await sleep(ms);
+            done = done + 1;
+        }
+        let mut i = 0;
+        while (i < 5000) {
+            worker(i / 1000);
+            i = i + 1;
+        }
+        println("spawned");
+    )");
+    VirtualMachine machine;
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    machine.interpret(statements);
+    std::cout.rdbuf(old);
+    // Fibers left behind by the top level still run before it returns.
+    EXPECT_EQ(buffer.str(), "spawned\n");
+    const QuastraValue* done = machine.get_global("done");
+    ASSERT_NE(done, nullptr);
+    EXPECT_EQ(std::get<double>(*done), 5000.0);
+}
+
+TEST(AsyncTest, MachineResumesFibersAcrossBudgets) {
+    auto statements = parse(R"(
+        async fn count(label) {
+            let mut i = 0;
+            while (i < 3) {
+                await sleep(0);
+                println(label + i);
+                i = i + 1;
+            }
+        }
+        let a = count(10);
+        let b = count(20);
+        await a;
+        await b;
+    )");
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    VirtualMachine machine;
+    machine.load(statements);
+    size_t rounds = 0;
+    while (machine.resume(5) == VirtualMachine::Status::Suspended) rounds++;
+    std::cout.rdbuf(old);
+    EXPECT_GT(rounds, 5u);
+    EXPECT_EQ(buffer.str(), "10\n20\n11\n21\n12\n22\n");
+    EXPECT_EQ(machine.resume(), VirtualMachine::Status::Finished);
+}
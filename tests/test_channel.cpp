@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include "lib/runtime/channel.hpp"
+#include "lib/runtime/task_scheduler.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Quastra;
+
+TEST(ChannelTest, BoundedQueueIsFifoAndBounded) {
+    BoundedQueue<int> queue(3);
+    for (int i = 0; i < 3; ++i) {
+        int value = i;
+        EXPECT_TRUE(queue.try_push(value));
+    }
+    int extra = 3;
+    EXPECT_FALSE(queue.try_push(extra));
+    EXPECT_EQ(extra, 3);
+    // Wrap around a few laps.
+    for (int i = 0; i < 10; ++i) {
+        int value = -1;
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+        value = i + 3;
+        EXPECT_TRUE(queue.try_push(value));
+    }
+    int value;
+    for (int i = 10; i < 13; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST(ChannelTest, SegmentedQueueSpansBlocksAndFreesWhatIsLeft) {
+    auto tracked = std::make_shared<int>(0);
+    {
+        SegmentedQueue<std::shared_ptr<int>> queue;
+        for (int i = 0; i < 1000; ++i) queue.push(tracked);
+        std::shared_ptr<int> value;
+        for (int i = 0; i < 500; ++i) ASSERT_TRUE(queue.try_pop(value));
+        value.reset();
+        EXPECT_EQ(tracked.use_count(), 501);
+    }
+    EXPECT_EQ(tracked.use_count(), 1);
+
+    SegmentedQueue<int> queue;
+    int value;
+    EXPECT_FALSE(queue.try_pop(value));
+    for (int i = 0; i < 100; ++i) queue.push(i);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+TEST(ChannelTest, CloseDrainsThenEnds) {
+    Channel<int> channel(4);
+    channel.send(1);
+    channel.send(2);
+    channel.close();
+    EXPECT_THROW(channel.send(3), std::runtime_error);
+    std::vector<int> received;
+    for (int value : channel) received.push_back(value);
+    EXPECT_EQ(received, (std::vector<int>{1, 2}));
+    int value;
+    EXPECT_FALSE(channel.receive(value));
+}
+
+// Every value sent by `producers` threads reaches one of `consumers`
+// threads exactly once.
+static void exchange(size_t capacity, int producers, int consumers) {
+    const long per_producer = 20000;
+    Channel<long> channel(capacity);
+    std::atomic<long> sum{0};
+    std::atomic<long> count{0};
+    std::vector<std::thread> receivers;
+    for (int i = 0; i < consumers; ++i) {
+        receivers.emplace_back([&] {
+            for (long value : channel) {
+                sum += value;
+                count++;
+            }
+        });
+    }
+    std::vector<std::thread> senders;
+    for (int i = 0; i < producers; ++i) {
+        senders.emplace_back([&, i] {
+            for (long n = 0; n < per_producer; ++n) channel.send(i * per_producer + n + 1);
+        });
+    }
+    for (auto& sender : senders) sender.join();
+    channel.close();
+    for (auto& receiver : receivers) receiver.join();
+    long total = producers * per_producer;
+    EXPECT_EQ(count.load(), total);
+    EXPECT_EQ(sum.load(), total * (total + 1) / 2);
+}
+
+TEST(ChannelTest, WakersHearOfEachChange) {
+    Channel<int> channel(1);
+    int woken = 0;
+    channel.when_not_empty([&] { woken++; });
+    channel.when_not_empty([&] { woken++; });
+    EXPECT_EQ(woken, 0);
+    int value = 1;
+    ASSERT_TRUE(channel.try_send(value));
+    EXPECT_EQ(woken, 1); // One value wakes one waker.
+    channel.when_not_full([&] { woken += 10; });
+    EXPECT_EQ(woken, 1);
+    ASSERT_TRUE(channel.try_receive(value));
+    EXPECT_EQ(woken, 11);
+    channel.close(); // Wakes the waker left.
+    EXPECT_EQ(woken, 12);
+    channel.when_not_empty([&] { woken += 100; }); // Runs right away.
+    EXPECT_EQ(woken, 112);
+}
+
+TEST(ChannelTest, ManyProducersAndConsumers) {
+    exchange(1, 1, 1);
+    exchange(16, 4, 1);
+    exchange(16, 4, 4);
+    exchange(0, 1, 1);
+    exchange(0, 4, 4);
+}
+
+TEST(ChannelTest, BlockedTasksDoNotStarveThePool) {
+    // One worker, which takes the consumer first (its newest task). The
+    // consumer parks, and a spare thread runs the producer meanwhile.
+    TaskScheduler scheduler(1);
+    Channel<int> channel(1);
+    std::atomic<int> sum{0};
+    std::atomic<int> finished{0};
+    scheduler.submit([&] {
+        for (int i = 1; i <= 100; ++i) channel.send(i);
+        channel.close();
+        finished++;
+    });
+    scheduler.submit([&] {
+        for (int value : channel) sum += value;
+        finished++;
+    });
+    while (finished.load() != 2) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(sum.load(), 5050);
+}
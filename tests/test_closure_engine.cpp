@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/interpreter/closure_engine.hpp"
+#include "capture_output.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Runs the program on the given engine and captures everything it prints.
+template <typename Engine>
+static std::string run(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Engine engine;
+    engine.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Checks that both engines print the same thing and returns it.
+// The resolver marks the tail calls, which both engines run in constant stack.
+static std::string run_both(const std::string& source, bool resolve = false) {
+    auto statements = parse(source);
+    if (resolve) {
+        EXPECT_TRUE(Resolver().resolve(statements));
+    }
+    std::string expected = run<Interpreter>(statements);
+    EXPECT_EQ(run<ClosureEngine>(statements), expected);
+    return expected;
+}
+
+TEST(ClosureEngineTest, ArithmeticControlFlowAndRecursion) {
+    std::string output = run_both(R"(
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        let mut i = 0;
+        let mut total = 0;
+        while (i < 10) {
+            total = total + i * 2 - i / 2;
+            i = i + 1;
+        }
+        println(total);
+        println(fib(12));
+        println(-total == 0 - total);
+        println(!(i != 10));
+        println(i >= 10);
+    )");
+    EXPECT_EQ(output, "67.5\n144\ntrue\ntrue\ntrue\n");
+}
+
+TEST(ClosureEngineTest, ScopesAndShadowing) {
+    std::string output = run_both(R"(
+        let x = 1;
+        {
+            let x = x + 1;
+            println(x);
+            {
+                let x = x * 10;
+                println(x);
+            }
+            println(x);
+        }
+        let mut counter = 0;
+        while (counter < 3) {
+            {
+                let counter = 99;
+                println(counter);
+            }
+            counter = counter + 1;
+        }
+        let x = 5;
+        println(x);
+        fn noop() {}
+        println(noop());
+    )");
+    EXPECT_EQ(output, "2\n20\n2\n99\n99\n99\n5\nfalse\n");
+}
+
+TEST(ClosureEngineTest, ClosuresCaptureTheirFrame) {
+    std::string output = run_both(R"(
+        fn outer() {
+            fn inner() {
+                return later;
+            }
+            let later = 3;
+            return inner();
+        }
+        println(outer());
+        let mut i = 0;
+        let mut sum = 0;
+        while (i < 3) {
+            let offset = i * 100;
+            fn shifted(x) {
+                return x + offset;
+            }
+            sum = sum + shifted(1);
+            i = i + 1;
+        }
+        println(sum);
+        let mut count = 0;
+        fn bump() {
+            count = count + 1;
+            return count;
+        }
+        bump();
+        println(bump());
+    )");
+    EXPECT_EQ(output, "3\n303\n2\n");
+}
+
+TEST(ClosureEngineTest, TailCallsRunInConstantStack) {
+    std::string output = run_both(R"(
+        fn count(n, acc) {
+            if (n == 0) {
+                return acc;
+            }
+            return count(n - 1, acc + 1);
+        }
+        println(count(50000, 0));
+    )", true);
+    EXPECT_EQ(output, "50000\n");
+}
+
+TEST(ClosureEngineTest, LimitsCallDepthLikeTheInterpreter) {
+    auto statements = parse(R"(
+        fn down(n) {
+            if (n == 0) {
+                return 0;
+            }
+            return down(n - 1) + 1;
+        }
+        println(down(50));
+        println(down(500));
+    )");
+    std::string expected = "50\nRuntime Error: Call depth limit exceeded.\n";
+    {
+        CaptureOutput output;
+        Interpreter interpreter;
+        interpreter.set_limits({0, 100});
+        interpreter.interpret(statements);
+        EXPECT_EQ(output.str(), expected);
+    }
+    CaptureOutput output;
+    ClosureEngine engine(100);
+    engine.interpret(statements);
+    EXPECT_EQ(output.str(), expected);
+}
+
+TEST(ClosureEngineTest, RuntimeErrorsMatchTheInterpreter) {
+    EXPECT_EQ(run_both("println(1 / 0);"), "Runtime Error: Division by zero.\n");
+    EXPECT_EQ(run_both("println(-true);"), "Runtime Error: Operand must be a number for unary minus.\n");
+    EXPECT_EQ(run_both("println(1 < true);"), "Runtime Error: Operands must be numbers for comparison.\n");
+    EXPECT_EQ(run_both("let f = 1; f();"), "Runtime Error: Can only call functions and classes.\n");
+    EXPECT_EQ(run_both("fn f(a) { return a; } f();"), "Runtime Error: Expected 1 arguments but got 0.\n");
+    EXPECT_EQ(run_both("fn f() { return missing; } f();"), "Runtime Error: Undefined variable 'missing'.\n");
+    EXPECT_EQ(run_both("fn f() { return late; } println(f()); let late = 1;"),
+              "Runtime Error: Undefined variable 'late'.\n");
+}
+
+TEST(ClosureEngineTest, CallsFunctionsFromTheHost) {
+    ClosureEngine engine;
+    engine.interpret(parse("fn add(a, b) { return a + b; }"));
+    const QuastraValue* add = engine.get_global("add");
+    ASSERT_NE(add, nullptr);
+    QuastraValue result = engine.call(std::get<std::shared_ptr<QuastraCallable>>(*add), {2.0, 3.0});
+    EXPECT_EQ(std::get<double>(result), 5.0);
+    EXPECT_EQ(engine.get_global("missing"), nullptr);
+}
@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 #include "lib/frontend/lexer.hpp"
 #include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
 #include "lib/backend/codegen.hpp"
+#include "lib/driver/pipeline.hpp"
+#include "compile_cpp.hpp"
 #include <string>
 
 using namespace Quastra;
@@ -65,3 +68,196 @@ int main() {
 )";
     ASSERT_EQ(generate_cpp(source), expected_cpp);
 }
+
+TEST(CodeGenTest, SelfTailCallBecomesJump) {
+    std::string source = R"(
+        fn gcd(a, b) {
+            if (b == 0) {
+                return a;
+            }
+            if (a < b) {
+                return gcd(b, a);
+            }
+            return gcd(a - b, b);
+        }
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+    CodeGen codegen;
+    std::string cpp = codegen.generate(statements);
+
+    std::string expected_body =
+R"(auto gcd(auto a, auto b) {
+tail_call:
+    if ((b == 0)) {
+        return a;
+    }
+    if ((a < b)) {
+        {
+            auto __tail_a = b;
+            auto __tail_b = a;
+            a = __tail_a;
+            b = __tail_b;
+            goto tail_call;
+        }
+    }
+    {
+        auto __tail_a = (a - b);
+        auto __tail_b = b;
+        a = __tail_a;
+        b = __tail_b;
+        goto tail_call;
+    }
+}
+)";
+    EXPECT_NE(cpp.find(expected_body), std::string::npos) << cpp;
+}
+
+TEST(CodeGenTest, AsyncFunctionReturnsAFuture) {
+    std::string cpp = generate_cpp(R"(
+async fn add(a, b) {
+    return a + b;
+}
+
+async fn run() {
+    return await add(1, 2) - 3;
+}
+
+fn main() {
+    return 0;
+}
+)");
+    EXPECT_NE(cpp.find("#include <coroutine>\n"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("struct QuastraLoop {"), std::string::npos) << cpp;
+    std::string expected_body =
+R"(auto add(auto a, auto b) {
+    auto quastra_body = [=]() mutable {
+        return (a + b);
+    };
+    return [](auto a, auto b) -> QuastraFuture<decltype(quastra_body())> {
+        co_return (a + b);
+    }(a, b);
+}
+)";
+    EXPECT_NE(cpp.find(expected_body), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return (quastra_result_of(add(1, 2)) - 3);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("co_return ((co_await add(1, 2)) - 3);"), std::string::npos) << cpp;
+    EXPECT_EQ(generate_cpp("fn main() { return 0; }").find("QuastraFuture"), std::string::npos);
+}
+
+TEST(CodeGenTest, PrintNativesUseTheBufferedPrelude) {
+    auto generate_resolved = [](const std::string& source) {
+        Lexer lexer(source);
+        auto tokens = lexer.scan_tokens();
+        Parser parser(tokens);
+        auto statements = parser.parse();
+        EXPECT_TRUE(Resolver().resolve(statements));
+        return CodeGen().generate(statements);
+    };
+    std::string cpp = generate_resolved(R"(
+fn main() {
+    println("hello");
+    print(42);
+    flush();
+    return 0;
+}
+)");
+    EXPECT_EQ(cpp.find("#include <cstdio>\n#include <cstring>\n#include <iostream>\n#include <string>\n"
+                       "#include <type_traits>\n#include <vector>\n"), 0u) << cpp;
+    EXPECT_NE(cpp.find("struct QuastraOutput {"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("    quastra_println(std::string(\"hello\"));\n    quastra_print(42);\n    quastra_flush();\n"),
+              std::string::npos) << cpp;
+
+    // A function of the program's own takes the native's place.
+    cpp = generate_resolved("fn print(x) { return x; } fn main() { print(1); return 0; }");
+    EXPECT_EQ(cpp.find("QuastraOutput"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("    print(1);\n"), std::string::npos) << cpp;
+}
+
+// Runs the -O2 pipeline and generates C++ from what it leaves.
+static std::string generate_optimized(const std::string& source) {
+    PipelineOptions options;
+    options.opt_level = 2;
+    PassManager passes;
+    EXPECT_TRUE(build_pipeline(passes, options));
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(passes.run(statements));
+    return CodeGen().generate(statements);
+}
+
+TEST(CodeGenTest, InlinedPrintsCompile) {
+    if (!has_compiler()) GTEST_SKIP() << "Needs g++.";
+    // show is inlined into main, println with it; a local named print
+    // still shadows the native.
+    std::string cpp = generate_optimized(R"(
+fn show(x) {
+    println(x);
+    return x;
+}
+fn twice(print) {
+    return print * 2;
+}
+fn main() {
+    let mut i = 0;
+    while (i < 3) {
+        show(twice(i));
+        i = i + 1;
+    }
+    return 0;
+}
+)");
+    EXPECT_EQ(cpp.find("show("), cpp.find("show(x)")) << cpp;
+    EXPECT_EQ(compile_and_run(cpp), "0\n2\n4\n");
+}
+
+TEST(CodeGenTest, AsyncProgramsCompile) {
+    if (!has_compiler()) GTEST_SKIP() << "Needs g++.";
+    EXPECT_EQ(compile_and_run(generate_cpp(R"(
+async fn twice(x) {
+    await sleep(1);
+    return x * 2;
+}
+async fn main() {
+    println(await twice(21));
+    sleep(0);
+    return 0;
+}
+)")), "42\n");
+    EXPECT_EQ(compile_and_run(generate_cpp(R"(
+async fn main() {
+    await sleep(0);
+    println("done");
+}
+)")), "done\n");
+}
+
+TEST(CodeGenTest, AsyncCallsWaitConcurrently) {
+    if (!has_compiler()) GTEST_SKIP() << "Needs g++.";
+    std::string cpp = generate_cpp(R"(
+async fn after(ms, label) {
+    await sleep(ms);
+    println(label);
+}
+async fn main() {
+    let first = after(200, 1);
+    let second = after(100, 2);
+    let third = after(150, 3);
+    await first;
+    await second;
+    await third;
+    return 0;
+}
+)");
+    // As on the engines: the order the sleeps end in, about 200 ms in.
+    std::chrono::steady_clock::duration elapsed{};
+    EXPECT_EQ(compile_and_run(cpp, "", &elapsed), "2\n3\n1\n");
+    EXPECT_GE(elapsed, std::chrono::milliseconds(200));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(350));
+}
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/optimizer/const_evaluator.hpp"
+#include "lib/backend/codegen.hpp"
+#include <string>
+
+using namespace Quastra;
+
+// Helper to run lex->parse->const-eval->generate and return the C++ source.
+// Sets 'ok' to the result of the evaluator.
+static std::string evaluate_and_generate(const std::string& source, bool* ok = nullptr,
+                                         ExecutionLimits limits = {100000, 256}) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+
+    ConstEvaluator evaluator(limits);
+    bool result = evaluator.run(statements);
+    if (ok) *ok = result;
+
+    CodeGen codegen;
+    return codegen.generate(statements);
+}
+
+TEST(ConstEvalTest, FoldsConstDeclaration) {
+    std::string cpp = evaluate_and_generate("const size = 2 * 3 + 1; const twice = size * 2;");
+    EXPECT_NE(cpp.find("const auto size = 7;"), std::string::npos);
+    EXPECT_NE(cpp.find("const auto twice = 14;"), std::string::npos);
+}
+
+TEST(ConstEvalTest, FoldsPureCallWithConstantArguments) {
+    std::string source = R"(
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        fn main() {
+            let result = fib(7);
+            let other = fib(result - 3);
+            return 0;
+        }
+    )";
+    std::string cpp = evaluate_and_generate(source);
+    EXPECT_NE(cpp.find("auto result = 13;"), std::string::npos);
+    // 'result' is not a const, so this call must stay.
+    EXPECT_NE(cpp.find("auto other = fib((result - 3));"), std::string::npos);
+}
+
+TEST(ConstEvalTest, LeavesImpureCallsAlone) {
+    std::string source = R"(
+        fn shout(n) {
+            println(n);
+            return n;
+        }
+        fn main() {
+            let x = shout(1);
+            return 0;
+        }
+    )";
+    std::string cpp = evaluate_and_generate(source);
+    EXPECT_NE(cpp.find("auto x = shout(1);"), std::string::npos);
+}
+
+TEST(ConstEvalTest, StepLimitStopsRunawayRecursion) {
+    std::string source = R"(
+        fn forever(n) {
+            return forever(n + 1);
+        }
+        fn main() {
+            let x = forever(0);
+            return 0;
+        }
+    )";
+    bool ok = false;
+    std::string cpp = evaluate_and_generate(source, &ok);
+    EXPECT_TRUE(ok);
+    EXPECT_NE(cpp.find("auto x = forever(0);"), std::string::npos);
+}
+
+static size_t count(const std::string& text, const std::string& part) {
+    size_t found = 0;
+    for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + 1)) found++;
+    return found;
+}
+
+static const char* fib_and_deep = R"(
+    fn fib(n) {
+        if (n < 2) {
+            return n;
+        }
+        return fib(n - 2) + fib(n - 1);
+    }
+    fn deep(n) {
+        if (n == 0) {
+            return 0;
+        }
+        return deep(n - 1) + 1;
+    }
+)";
+
+TEST(ConstEvalTest, StepLimitIsABudgetForTheWholeRun) {
+    // fib(10) takes about 1600 steps and fib(9) about 1000.
+    std::string cpp = evaluate_and_generate(std::string(fib_and_deep) + R"(
+        fn main() {
+            let a = fib(10);
+            let b = fib(9);
+            return 0;
+        }
+        const c = fib(9);
+    )", nullptr, {2000, 256});
+    EXPECT_NE(cpp.find("auto a = 55;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto b = fib(9);"), std::string::npos) << cpp;
+    // A const must be evaluated, so it gets the limit of its own.
+    EXPECT_NE(cpp.find("const auto c = 34;"), std::string::npos) << cpp;
+}
+
+TEST(ConstEvalTest, EvaluatesEachCallOnce) {
+    // Five fib(10) and three deep(1000), which runs out of call depth after
+    // about 2300 steps, only fit the budget if each is tried once.
+    std::string cpp = evaluate_and_generate(std::string(fib_and_deep) + R"(
+        fn main() {
+            println(fib(10));
+            println(fib(10));
+            println(deep(1000));
+            println(fib(10));
+            println(deep(1000));
+            println(fib(10));
+            println(deep(1000));
+            println(fib(10));
+            println(fib(9));
+            return 0;
+        }
+    )", nullptr, {6000, 256});
+    EXPECT_EQ(count(cpp, "quastra_println(55);"), 5u) << cpp;
+    EXPECT_EQ(count(cpp, "deep(1000)"), 3u) << cpp;
+    EXPECT_NE(cpp.find("quastra_println(34);"), std::string::npos) << cpp;
+}
+
+TEST(ConstEvalTest, RespectsShadowing) {
+    std::string source = R"(
+        const k = 3;
+        fn f(k) {
+            return k;
+        }
+        fn g() {
+            return k;
+        }
+    )";
+    std::string cpp = evaluate_and_generate(source);
+    EXPECT_NE(cpp.find("auto f(auto k) {\n    return k;"), std::string::npos);
+    EXPECT_NE(cpp.find("auto g() {\n    return 3;"), std::string::npos);
+}
+
+TEST(ConstEvalTest, ErrorOnNonConstantInitializer) {
+    bool ok = true;
+    evaluate_and_generate("let x = 1; const y = x + 1;", &ok);
+    EXPECT_FALSE(ok);
+    evaluate_and_generate("const z = 1 / 0;", &ok);
+    EXPECT_FALSE(ok);
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/optimizer/constant_folder.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/backend/codegen.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Helper to run lex->parse->fold->generate and return the C++ source.
+static std::string fold_and_generate(const std::string& source) {
+    auto statements = parse(source);
+    ConstantFolder folder;
+    folder.run(statements);
+    CodeGen codegen;
+    return codegen.generate(statements);
+}
+
+// Helper to interpret a program, optionally folded, and capture its output.
+static std::string interpret(const std::string& source, bool fold) {
+    auto statements = parse(source);
+    if (fold) {
+        ConstantFolder folder;
+        folder.run(statements);
+    }
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+TEST(ConstantFolderTest, FoldsConstantOperands) {
+    std::string cpp = fold_and_generate("fn f(n) { return n - (2 * 3 + 1); }");
+    EXPECT_NE(cpp.find("return (n - 7);"), std::string::npos) << cpp;
+}
+
+TEST(ConstantFolderTest, PropagatesLetIntoLoopCondition) {
+    std::string source = R"(
+        fn count() {
+            let limit = 5;
+            let mut i = 0;
+            while (i < limit) {
+                i = i + 1;
+            }
+            return i;
+        }
+    )";
+    std::string cpp = fold_and_generate(source);
+    EXPECT_NE(cpp.find("while ((i < 5))"), std::string::npos) << cpp;
+    // i changes in the loop, so it is not a constant.
+    EXPECT_NE(cpp.find("(i = (i + 1));"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return i;"), std::string::npos) << cpp;
+}
+
+TEST(ConstantFolderTest, PrunesConstantIfBranches) {
+    std::string source = R"(
+        fn f(x) {
+            let debug = 1 > 2;
+            if (debug) {
+                println(x);
+            } else {
+                return x * 2;
+            }
+            return 0;
+        }
+    )";
+    std::string cpp = fold_and_generate(source);
+    EXPECT_EQ(cpp.find("println"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("if ("), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return (x * 2);"), std::string::npos) << cpp;
+}
+
+TEST(ConstantFolderTest, AssignmentInDeadBranchKeepsConstant) {
+    // A variable only assigned in a branch that never runs is still constant,
+    // even inside a loop.
+    std::string source = R"(
+        fn f(n) {
+            let mut flag = false;
+            let mut x = 1;
+            let mut i = 0;
+            while (i < n) {
+                if (flag) {
+                    x = 2;
+                }
+                i = i + x;
+            }
+            return x;
+        }
+    )";
+    std::string cpp = fold_and_generate(source);
+    EXPECT_NE(cpp.find("(i = (i + 1));"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return 1;"), std::string::npos) << cpp;
+}
+
+TEST(ConstantFolderTest, PreservesDivisionByZero) {
+    std::string source = "let zero = 0; let x = 10 / zero;";
+    std::string cpp = fold_and_generate(source);
+    EXPECT_NE(cpp.find("auto x = (10 / 0);"), std::string::npos) << cpp;
+    EXPECT_NE(interpret(source, true).find("Runtime Error: Division by zero."), std::string::npos);
+}
+
+TEST(ConstantFolderTest, DoesNotPropagateVariablesChangedByCalls) {
+    std::string source = R"(
+        let mut counter = 0;
+        fn bump() {
+            counter = counter + 1;
+        }
+        bump();
+        println(counter);
+    )";
+    std::string cpp = fold_and_generate(source);
+    EXPECT_NE(cpp.find("println(counter)"), std::string::npos) << cpp;
+    EXPECT_EQ(interpret(source, true), "1\n");
+}
+
+TEST(ConstantFolderTest, InterpreterResultIsUnchanged) {
+    std::string source = R"(
+        let base = 10;
+        fn scale(n) {
+            let factor = 2 + 1;
+            return n * factor;
+        }
+        let mut total = 0;
+        let mut i = 0;
+        while (i < 4) {
+            if (base > 5) {
+                total = total + scale(i);
+            } else {
+                total = total - 1;
+            }
+            i = i + 1;
+        }
+        println(total + base / 5);
+    )";
+    EXPECT_EQ(interpret(source, true), interpret(source, false));
+    EXPECT_EQ(interpret(source, true), "20\n");
+}
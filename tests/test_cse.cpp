@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/frontend/ast_hash.hpp"
+#include "lib/optimizer/cse.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/backend/codegen.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Parses `let _ = <expr>;` and returns the initializer.
+static std::unique_ptr<AST::Expr> parse_expr(const std::string& source) {
+    auto statements = parse("let _ = " + source + ";");
+    return std::move(static_cast<AST::VarDecl&>(*statements[0]).initializer);
+}
+
+// Helper to interpret a program and capture its output.
+static std::string interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Runs CSE, checks that the program still prints the same thing, and
+// returns the generated C++.
+static std::string eliminate_and_check(const std::string& source, int* replaced = nullptr) {
+    auto original = parse(source);
+    auto statements = parse(source);
+    CommonSubexpressionEliminator cse;
+    int count = cse.run(statements);
+    if (replaced) *replaced = count;
+    EXPECT_EQ(interpret(statements), interpret(original));
+    CodeGen codegen;
+    return codegen.generate(statements);
+}
+
+TEST(AstHashTest, EqualStructuresHashEqual) {
+    auto a = parse_expr("(n - 2) * f(x, 1)");
+    auto b = parse_expr("(n - 2) * f(x, 1)");
+    EXPECT_EQ(structural_hash(*a), structural_hash(*b));
+    EXPECT_TRUE(structurally_equal(*a, *b));
+
+    for (const char* other : {"(n - 2) * f(x, 2)", "(n + 2) * f(x, 1)", "(m - 2) * f(x, 1)", "f(x, 1) * (n - 2)"}) {
+        auto c = parse_expr(other);
+        EXPECT_FALSE(structurally_equal(*a, *c)) << other;
+        EXPECT_NE(structural_hash(*a), structural_hash(*c)) << other;
+    }
+}
+
+TEST(AstHashTest, TableInternsStructurally) {
+    auto a = parse_expr("counter + 1");
+    auto b = parse_expr("counter + 1");
+    auto c = parse_expr("counter - 1");
+    ExprTable table;
+    EXPECT_EQ(table.intern(*a), 0);
+    EXPECT_EQ(table.intern(*b), 0);
+    EXPECT_EQ(table.find(*c), -1);
+    EXPECT_EQ(table.intern(*c), 1);
+    EXPECT_EQ(table.size(), 2u);
+}
+
+TEST(CseTest, ReusesRepeatedExpressions) {
+    std::string source = R"(
+        fn f(a, b) {
+            let x = (a + b) * 2;
+            let y = (a + b) * 2 + a * b;
+            return x + y + a * b;
+        }
+        println(f(3, 4));
+    )";
+    int replaced = 0;
+    std::string cpp = eliminate_and_check(source, &replaced);
+    EXPECT_EQ(replaced, 2);
+    EXPECT_NE(cpp.find("auto __cse0 = ((a + b) * 2);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto x = __cse0;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto __cse1 = (a * b);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto y = (__cse0 + __cse1);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return ((x + y) + __cse1);"), std::string::npos) << cpp;
+}
+
+TEST(CseTest, AssignmentInvalidates) {
+    std::string source = R"(
+        let mut counter = 1;
+        let a = counter + 1;
+        counter = counter + 1;
+        let b = counter + 1;
+        println(a + b);
+    )";
+    int replaced = -1;
+    std::string cpp = eliminate_and_check(source, &replaced);
+    EXPECT_EQ(replaced, 1) << cpp;
+    // `counter + 1` is reused by the assignment, but not after it.
+    EXPECT_NE(cpp.find("(counter = __cse0);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto b = (counter + 1);"), std::string::npos) << cpp;
+}
+
+TEST(CseTest, CallsInvalidateWhatFunctionsWrite) {
+    std::string source = R"(
+        let mut scale = 2;
+        let base = 5;
+        fn bump() {
+            scale = scale + 1;
+            return 0;
+        }
+        let a = scale * 3 + base * 3;
+        bump();
+        let b = scale * 3 + base * 3;
+        println(a + b);
+    )";
+    int replaced = -1;
+    std::string cpp = eliminate_and_check(source, &replaced);
+    EXPECT_EQ(replaced, 1) << cpp;
+    EXPECT_NE(cpp.find("auto b = ((scale * 3) + __cse0);"), std::string::npos) << cpp;
+}
+
+TEST(CseTest, StopsAtControlFlowAndShadowing) {
+    std::string source = R"(
+        fn main() {
+            let n = 4;
+            let a = n * n;
+            if (a > 3) {
+                println(n * n);
+            }
+            let b = n * n;
+            let n = 5;
+            println(b + n * n);
+            return 0;
+        }
+        main();
+    )";
+    int replaced = -1;
+    std::string cpp = eliminate_and_check(source, &replaced);
+    EXPECT_EQ(replaced, 0) << cpp;
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/optimizer/dead_code.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/backend/codegen.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Helper to run lex->parse->eliminate->generate and return the C++ source.
+static std::string eliminate_and_generate(const std::string& source) {
+    auto statements = parse(source);
+    DeadCodeEliminator eliminator;
+    eliminator.run(statements);
+    CodeGen codegen;
+    return codegen.generate(statements);
+}
+
+// Helper to interpret a program, optionally after elimination, and capture its output.
+static std::string interpret(const std::string& source, bool eliminate) {
+    auto statements = parse(source);
+    if (eliminate) {
+        DeadCodeEliminator eliminator;
+        eliminator.run(statements);
+    }
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+TEST(DeadCodeTest, RemovesUnusedBindings) {
+    std::string source = R"(
+        fn main() {
+            let mut counter = 0;
+            while (counter < 5) {
+                if (counter == 3) {
+                    let message = 1;
+                } else {
+                    let message = 0;
+                }
+                counter = counter + 1;
+            }
+            let unused = counter * 2;
+            return counter;
+        }
+    )";
+    std::string cpp = eliminate_and_generate(source);
+    EXPECT_EQ(cpp.find("message"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("unused"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("if ("), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(counter = (counter + 1));"), std::string::npos) << cpp;
+}
+
+TEST(DeadCodeTest, RemovesDeadStoresButKeepsSideEffects) {
+    std::string source = R"(
+        fn f(n) {
+            let mut x = n;
+            x = n * 2;
+            x = g(n);
+            x = 7;
+            return n;
+        }
+    )";
+    std::string cpp = eliminate_and_generate(source);
+    EXPECT_EQ(cpp.find("x"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("(n * 2)"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("g(n);"), std::string::npos) << cpp;
+}
+
+TEST(DeadCodeTest, KeepsStoresReadInLaterIterations) {
+    std::string source = R"(
+        fn f(n) {
+            let mut last = 0;
+            let mut sum = 0;
+            let mut i = 0;
+            while (i < n) {
+                sum = sum + last;
+                last = i;
+                i = i + 1;
+            }
+            return sum;
+        }
+    )";
+    std::string cpp = eliminate_and_generate(source);
+    EXPECT_NE(cpp.find("(last = i);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(sum = (sum + last));"), std::string::npos) << cpp;
+}
+
+TEST(DeadCodeTest, RemovesStatementsAfterReturn) {
+    std::string source = R"(
+        fn f(n) {
+            if (n < 0) {
+                return 0;
+                println(n);
+            } else {
+                return n;
+            }
+            println(1);
+        }
+    )";
+    std::string cpp = eliminate_and_generate(source);
+    EXPECT_EQ(cpp.find("println"), std::string::npos) << cpp;
+}
+
+TEST(DeadCodeTest, RemovesFunctionsUnreachableFromMain) {
+    std::string source = R"(
+        fn helper(n) { return n + 1; }
+        fn used(n) { return helper(n); }
+        fn unused(n) { return used(n); }
+        fn recursive(n) { return recursive(n); }
+        fn main() { return used(1); }
+    )";
+    std::string cpp = eliminate_and_generate(source);
+    EXPECT_NE(cpp.find("helper("), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("used("), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("unused"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("recursive"), std::string::npos) << cpp;
+
+    // Without main every function may be an entry point.
+    cpp = eliminate_and_generate("fn unused(n) { return n; }");
+    EXPECT_NE(cpp.find("unused"), std::string::npos) << cpp;
+}
+
+TEST(DeadCodeTest, KeepsVariablesSeenByNestedFunctions) {
+    std::string source = R"(
+        fn make() {
+            let mut count = 0;
+            fn next() {
+                count = count + 1;
+                return count;
+            }
+            count = 10;
+            return next;
+        }
+        let counter = make();
+        println(counter());
+    )";
+    EXPECT_EQ(interpret(source, true), "11\n");
+}
+
+TEST(DeadCodeTest, KeepsExpressionsThatMayFail) {
+    std::string source = R"(
+        let zero = 0;
+        let unused = 10 / zero;
+        println(1);
+    )";
+    std::string output = interpret(source, true);
+    EXPECT_NE(output.find("Runtime Error: Division by zero."), std::string::npos) << output;
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include "lib/driver/pipeline.hpp"
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include "capture_output.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Quastra;
+
+static std::shared_ptr<QuastraCallable> function(const VirtualMachine& machine, const std::string& name) {
+    const QuastraValue* value = machine.get_global(name);
+    EXPECT_NE(value, nullptr) << name;
+    return value ? std::get<std::shared_ptr<QuastraCallable>>(*value) : nullptr;
+}
+
+TEST(EmbeddingTest, MachinesShareAProgramButNotItsGlobals) {
+    auto program = compile_program(R"(
+        let mut hits = 0;
+        fn handle(n) {
+            hits = hits + 1;
+            return n * 2;
+        }
+    )");
+    ASSERT_NE(program, nullptr);
+    VirtualMachine first(program);
+    VirtualMachine second(program);
+    ASSERT_EQ(first.resume(), VirtualMachine::Status::Finished);
+    ASSERT_EQ(second.resume(), VirtualMachine::Status::Finished);
+    EXPECT_EQ(std::get<double>(first.call(function(first, "handle"), {21.0})), 42.0);
+    first.call(function(first, "handle"), {1.0});
+    EXPECT_EQ(std::get<double>(*first.get_global("hits")), 2.0);
+    EXPECT_EQ(std::get<double>(*second.get_global("hits")), 0.0);
+}
+
+TEST(EmbeddingTest, RunsOneProgramOnManyThreads) {
+    auto program = compile_program(R"(
+        let mut total = 0;
+        let label = "request ";
+        fn handle(n) {
+            let mut i = 0;
+            while (i < n) {
+                total = total + i;
+                i = i + 1;
+            }
+            return label + "done";
+        }
+    )");
+    ASSERT_NE(program, nullptr);
+    const int threads = 8;
+    const int requests = 50;
+    std::vector<double> totals(threads);
+    std::vector<std::string> results(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            VirtualMachine machine(program);
+            if (machine.resume() != VirtualMachine::Status::Finished) return;
+            auto handle = std::get<std::shared_ptr<QuastraCallable>>(*machine.get_global("handle"));
+            for (int r = 0; r < requests; ++r) {
+                results[t] = std::get<QuastraString>(machine.call(handle, {static_cast<double>(t + 1)})).str();
+            }
+            totals[t] = std::get<double>(*machine.get_global("total"));
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    for (int t = 0; t < threads; ++t) {
+        EXPECT_EQ(results[t], "request done");
+        EXPECT_EQ(totals[t], requests * (t * (t + 1) / 2.0)) << t;
+    }
+}
+
+TEST(EmbeddingTest, ReportsCompileErrors) {
+    CaptureOutput output;
+    EXPECT_EQ(compile_program("let x = ;"), nullptr);
+    EXPECT_EQ(compile_program("fn f(x) { return await x; }"), nullptr);
+    EXPECT_NE(output.str().find("Error: Semantic analysis failed."), std::string::npos) << output.str();
+}
+
+TEST(EmbeddingTest, LoadingMoreCodeKeepsTheProgramsGlobals) {
+    auto program = compile_program("let base = 40;");
+    ASSERT_NE(program, nullptr);
+    VirtualMachine machine(program);
+    ASSERT_EQ(machine.resume(), VirtualMachine::Status::Finished);
+    CaptureOutput output;
+    Lexer lexer("println(base + 2);");
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    machine.interpret(parser.parse());
+    EXPECT_EQ(output.str(), "42\n");
+    // The program itself is unchanged.
+    VirtualMachine other(program);
+    EXPECT_EQ(other.get_global("base"), nullptr);
+}
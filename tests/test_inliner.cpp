@@ -0,0 +1,258 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/optimizer/ast_utils.hpp"
+#include "lib/optimizer/inliner.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/backend/codegen.hpp"
+#include "lib/driver/pipeline.hpp"
+#include "compile_cpp.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Helper to interpret a program and capture its output.
+static std::string interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Inlines the program and checks that it still prints the same thing.
+// Returns the inliner so tests can look at its decisions.
+static Inliner inline_and_check(const std::string& source, std::string* cpp = nullptr, InlineOptions options = {}) {
+    auto original = parse(source);
+    auto statements = parse(source);
+    Inliner inliner(options);
+    inliner.run(statements);
+    EXPECT_EQ(interpret(statements), interpret(original)) << inliner.report();
+    if (cpp) {
+        CodeGen codegen;
+        *cpp = codegen.generate(statements);
+    }
+    return inliner;
+}
+
+TEST(InlinerTest, InlinesSmallCalleeInLoop) {
+    std::string source = R"(
+        fn square(x) { return x * x; }
+        let mut i = 0;
+        let mut total = 0;
+        while (i < 5) {
+            total = total + square(i);
+            i = i + 1;
+        }
+        println(total);
+    )";
+    std::string cpp;
+    Inliner inliner = inline_and_check(source, &cpp);
+    ASSERT_EQ(inliner.get_decisions().size(), 1u);
+    EXPECT_TRUE(inliner.get_decisions()[0].inlined);
+    EXPECT_NE(cpp.find("auto __inl0_x = i;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto __inl0_result = (__inl0_x * __inl0_x);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(total = (total + __inl0_result));"), std::string::npos) << cpp;
+}
+
+TEST(InlinerTest, InlinesCalleeWithSeveralReturns) {
+    std::string source = R"(
+        fn sign(x) {
+            if (x < 0) {
+                return -1;
+            }
+            if (x > 0) {
+                return 1;
+            }
+            return 0;
+        }
+        fn main() {
+            let mut i = -2;
+            while (i < 3) {
+                println(sign(i));
+                i = i + 1;
+            }
+            return 0;
+        }
+    )";
+    std::string cpp;
+    Inliner inliner = inline_and_check(source, &cpp);
+    EXPECT_TRUE(inliner.get_decisions()[0].inlined) << inliner.report();
+    EXPECT_EQ(cpp.find("sign(i"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto __inl0_result = 0;"), std::string::npos) << cpp;
+}
+
+TEST(InlinerTest, RejectsSeveralReturnsOfUnknownType) {
+    // The inlined result's C++ type would come from its initial value, and
+    // nothing says whether `low` is a number.
+    std::string source = R"(
+        fn clamp(x, low, high) {
+            if (x < low) {
+                return low;
+            }
+            if (x > high) {
+                return high;
+            }
+            return x;
+        }
+        let mut i = 0;
+        while (i < 10) {
+            println(clamp(i, 3, 6));
+            i = i + 1;
+        }
+    )";
+    Inliner inliner = inline_and_check(source);
+    ASSERT_EQ(inliner.get_decisions().size(), 1u);
+    EXPECT_EQ(inliner.get_decisions()[0].reason, "returns values of different or unknown types");
+}
+
+TEST(InlinerTest, RenamesLocalsToRespectShadowing) {
+    std::string source = R"(
+        fn twice(x) {
+            let y = x * 2;
+            {
+                let y = 0;
+            }
+            return y;
+        }
+        fn main() {
+            let y = 1;
+            let x = 5;
+            println(twice(y) + x + y);
+            return 0;
+        }
+        main();
+    )";
+    Inliner inliner = inline_and_check(source);
+    EXPECT_TRUE(inliner.get_decisions()[0].inlined) << inliner.report();
+}
+
+TEST(InlinerTest, ReportsRejectedCalls) {
+    std::string source = R"(
+        let scale = 3;
+        fn fact(n) {
+            if (n < 2) {
+                return 1;
+            }
+            return n * fact(n - 1);
+        }
+        fn scaled(n) { return n * scale; }
+        fn main() {
+            let scale = 10;
+            println(fact(5));
+            println(scaled(2));
+            return 0;
+        }
+        main();
+    )";
+    Inliner inliner = inline_and_check(source);
+    std::string report = inliner.report();
+    EXPECT_NE(report.find("main:12: did not inline fact: recursive"), std::string::npos) << report;
+    EXPECT_NE(report.find("main:13: did not inline scaled: 'scale' is shadowed at the call site"), std::string::npos) << report;
+}
+
+TEST(InlinerTest, KeepsEvaluationOrder) {
+    std::string source = R"(
+        let mut counter = 0;
+        fn bump() {
+            counter = counter + 1;
+            return counter;
+        }
+        println(counter + bump());
+        println(bump() + counter);
+    )";
+    Inliner inliner = inline_and_check(source);
+    ASSERT_EQ(inliner.get_decisions().size(), 2u);
+    EXPECT_EQ(inliner.get_decisions()[0].reason, "would change evaluation order");
+    EXPECT_TRUE(inliner.get_decisions()[1].inlined);
+}
+
+TEST(InlinerTest, RespectsBudget) {
+    std::string source = R"(
+        fn inc(x) { return x + 1; }
+        println(inc(1));
+        println(inc(2));
+    )";
+    InlineOptions options;
+    options.budget = 5;
+    Inliner inliner = inline_and_check(source, nullptr, options);
+    ASSERT_EQ(inliner.get_decisions().size(), 2u);
+    EXPECT_TRUE(inliner.get_decisions()[0].inlined);
+    EXPECT_EQ(inliner.get_decisions()[1].reason, "budget exhausted");
+}
+
+TEST(InlinerTest, ClonesKeepResolverAnnotations) {
+    auto statements = parse(R"(
+        fn id(n) { return n; }
+        fn f(n) { return id(n); }
+    )");
+    ASSERT_TRUE(Resolver().resolve(statements));
+    auto copy = clone(*statements[1]);
+    const auto& function = static_cast<const AST::FunctionStmt&>(*copy);
+    const auto& ret = static_cast<const AST::ReturnStmt&>(*function.body[0]);
+    const auto& call = static_cast<const AST::Call&>(*ret.value);
+    EXPECT_TRUE(call.is_tail_call);
+    EXPECT_TRUE(call.is_global_call);
+}
+
+
+// Generates C++ at -O2 and checks the compiled program prints what the
+// Interpreter does. The program's code is in `main`, as the driver runs it.
+static void check_compiled(const std::string& source) {
+    PipelineOptions options;
+    options.opt_level = 2;
+    PassManager passes;
+    ASSERT_TRUE(build_pipeline(passes, options));
+    auto statements = parse(source);
+    ASSERT_TRUE(passes.run(statements));
+    std::string cpp = CodeGen().generate(statements);
+    EXPECT_EQ(compile_and_run(cpp), interpret(parse(source + "main();"))) << cpp;
+}
+
+TEST(InlinerTest, CompiledOutputMatchesInterpreter) {
+    if (!has_compiler()) GTEST_SKIP() << "Needs g++.";
+    check_compiled(R"(
+        fn positive(x) {
+            if (x > 0) {
+                return true;
+            }
+            return false;
+        }
+        fn small(x) {
+            if (x < 3) {
+                return x < 2;
+            }
+        }
+        fn sign(x) {
+            if (x < 0) {
+                return -1;
+            }
+            if (x > 0) {
+                return 1;
+            }
+            return 0;
+        }
+        fn main() {
+            let mut i = -1;
+            while (i < 4) {
+                println(positive(i));
+                println(small(i));
+                println(sign(i));
+                i = i + 1;
+            }
+            return 0;
+        }
+    )");
+}
@@ -1,8 +1,10 @@
 #include <gtest/gtest.h>
 #include "lib/frontend/lexer.hpp"
 #include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
 #include "lib/interpreter/interpreter.hpp"
 #include "lib/runtime/environment.hpp"
+#include "lib/runtime/quastra_callable.hpp"
 #include <variant>
 
 using namespace Quastra;
@@ -119,3 +121,306 @@ TEST(InterpreterFunctionTest, Closure) {
     )";
     ASSERT_EQ(std::get<double>(interpret_and_get_value(source)), 15.0);
 }
+
+TEST(InterpreterFunctionTest, TailCallsRunInConstantStack) {
+    std::string source = R"(
+        fn sum(n, acc) {
+            if (n == 0) {
+                return acc;
+            }
+            return sum(n - 1, acc + n);
+        }
+        fn is_even(n) {
+            if (n == 0) { return true; }
+            return is_odd(n - 1);
+        }
+        fn is_odd(n) {
+            if (n == 0) { return false; }
+            return is_even(n - 1);
+        }
+        let total = sum(20000, 0);
+        let even = is_even(5001);
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+
+    // Tail calls reuse the caller's slot, so a depth limit of 10 is plenty.
+    Interpreter interpreter;
+    interpreter.set_limits({0, 10});
+    interpreter.interpret(statements);
+    auto env = interpreter.get_environment();
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "total", 1})), 200010000.0);
+    EXPECT_FALSE(std::get<bool>(env->get({TokenType::Identifier, "even", 1})));
+}
+
+TEST(InterpreterQuickeningTest, BinaryNodesSpecialiseAndDeoptimise) {
+    std::string source = R"(
+        fn check(a, b) {
+            return a < b;
+        }
+        let first = check(1, 2);
+        let second = check(3, 2);
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    auto* function = dynamic_cast<AST::FunctionStmt*>(statements[0].get());
+    ASSERT_NE(function, nullptr);
+    auto* return_stmt = dynamic_cast<AST::ReturnStmt*>(function->body[0].get());
+    auto* less = dynamic_cast<AST::Binary*>(return_stmt->value.get());
+    ASSERT_NE(less, nullptr);
+    EXPECT_EQ(less->specialization, AST::BinarySpecialization::Uninitialized);
+
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    EXPECT_EQ(less->specialization, AST::BinarySpecialization::LessNumbers);
+    auto env = interpreter.get_environment();
+    EXPECT_TRUE(std::get<bool>(env->get({TokenType::Identifier, "first", 1})));
+    EXPECT_FALSE(std::get<bool>(env->get({TokenType::Identifier, "second", 1})));
+
+    // A bool operand fails the guard: the node goes back to the checked path
+    // and reports the same error it always did.
+    AST::Call call(std::make_unique<AST::Variable>(Token{TokenType::Identifier, "check", 1}),
+                   Token{TokenType::RightParen, ")", 1}, {});
+    call.arguments.push_back(std::make_unique<AST::Literal>(Token{TokenType::True, "true", 1}));
+    call.arguments.push_back(std::make_unique<AST::Literal>(Token{TokenType::IntLiteral, "2", 1}));
+    try {
+        interpreter.evaluate(call);
+        FAIL() << "Expected a runtime error.";
+    } catch (const std::runtime_error& error) {
+        EXPECT_STREQ(error.what(), "Operands must be numbers for comparison.");
+    }
+    EXPECT_EQ(less->specialization, AST::BinarySpecialization::Generic);
+
+    // Numbers still work on the generic node.
+    call.arguments[0] = std::make_unique<AST::Literal>(Token{TokenType::IntLiteral, "1", 1});
+    EXPECT_TRUE(std::get<bool>(interpreter.evaluate(call)));
+    EXPECT_EQ(less->specialization, AST::BinarySpecialization::Generic);
+}
+
+TEST(InterpreterQuickeningTest, MixedOperandsStartGeneric) {
+    std::string source = "let a = true == true; let b = 1 == 1; let c = 6 / 3;";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    auto specialization = [&](size_t i) {
+        auto* decl = dynamic_cast<AST::VarDecl*>(statements[i].get());
+        return dynamic_cast<AST::Binary*>(decl->initializer.get())->specialization;
+    };
+    EXPECT_EQ(specialization(0), AST::BinarySpecialization::Generic);
+    EXPECT_EQ(specialization(1), AST::BinarySpecialization::EqualNumbers);
+    EXPECT_EQ(specialization(2), AST::BinarySpecialization::DivideNumbers);
+    auto env = interpreter.get_environment();
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "c", 1})), 2.0);
+}
+
+TEST(InterpreterInlineCacheTest, RebindingAGlobalFunctionInvalidatesCallSites) {
+    std::string source = R"(
+        fn one() { return 1; }
+        fn two() { return 2; }
+        let mut pick = one;
+        fn call_pick() { return pick(); }
+        let first = call_pick();
+        let again = call_pick();
+        pick = two;
+        let second = call_pick();
+        let mut counter = 0;
+        counter = counter + 1;
+        let third = call_pick();
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+    auto& call_pick = static_cast<AST::FunctionStmt&>(*statements[3]);
+    auto& to_pick = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*call_pick.body[0]).value);
+    ASSERT_TRUE(to_pick.is_global_call);
+
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    auto env = interpreter.get_environment();
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "first", 1})), 1.0);
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "again", 1})), 1.0);
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "second", 1})), 2.0);
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "third", 1})), 2.0);
+    // Assigning a number does not touch the cache.
+    auto two = std::get<std::shared_ptr<QuastraCallable>>(env->get({TokenType::Identifier, "two", 1}));
+    EXPECT_EQ(to_pick.cached_callee, two.get());
+    EXPECT_EQ(to_pick.cached_version, env->get_version());
+}
+
+TEST(InterpreterValueStackTest, RunsStayPutAndAreClearedOnRelease) {
+    ValueStack stack;
+    ValueStack::Mark start = stack.mark();
+    QuastraValue* first = stack.take(1000);
+    first[999] = std::string("kept");
+    ValueStack::Mark middle = stack.mark();
+    // Does not fit behind the first run, so it starts a new segment.
+    QuastraValue* second = stack.take(100);
+    second[0] = std::string("dropped");
+    EXPECT_EQ(std::get<QuastraString>(first[999]).view(), "kept");
+
+    stack.release(middle);
+    EXPECT_EQ(std::get<double>(second[0]), 0.0);
+    EXPECT_EQ(stack.take(100), second); // The segment is reused.
+    stack.release(start);
+    EXPECT_EQ(std::get<double>(first[999]), 0.0);
+    EXPECT_EQ(stack.take(10), first);
+}
+
+TEST(InterpreterValueStackTest, NestedAndTailCallsPassArguments) {
+    std::string source = R"(
+        fn add3(a, b, c) { return a + b + c; }
+        fn pick(a, b) { return b; }
+        fn countdown(n, acc) {
+            if (n == 0) {
+                return pick(acc, add3(acc, n, 1));
+            }
+            return countdown(n - 1, acc + add3(n, pick(0, n), 0));
+        }
+        let result = countdown(100, 0);
+        let nested = add3(add3(1, 2, 3), pick(4, add3(5, 6, 7)), 8);
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    auto env = interpreter.get_environment();
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "result", 1})), 10101.0);
+    EXPECT_EQ(std::get<double>(env->get({TokenType::Identifier, "nested", 1})), 32.0);
+}
+
+TEST(InterpreterStringTest, LiteralsConcatenationAndEquality) {
+    std::string source = R"(
+        fn repeat(word, n) {
+            let mut text = "";
+            let mut i = 0;
+            while (i < n) {
+                text = text + word;
+                i = i + 1;
+            }
+            return text;
+        }
+        let greeting = "hello" + ", " + "world";
+        let long = repeat("abcdefgh", 100);
+        let same = long == repeat("abcdefgh", 100);
+        let different = long == repeat("abcdefgh", 99);
+    )";
+    auto env = interpret_and_get_env(source);
+    EXPECT_EQ(std::get<QuastraString>(env->get({TokenType::Identifier, "greeting", 1})).view(), "hello, world");
+    auto long_text = std::get<QuastraString>(env->get({TokenType::Identifier, "long", 1}));
+    EXPECT_EQ(long_text.size(), 800u);
+    EXPECT_TRUE(std::get<bool>(env->get({TokenType::Identifier, "same", 1})));
+    EXPECT_FALSE(std::get<bool>(env->get({TokenType::Identifier, "different", 1})));
+
+    // The same literal evaluates to the same interned string every time.
+    Lexer lexer("\"a literal that is not inline\";");
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Interpreter interpreter;
+    auto& expression = *static_cast<AST::ExprStmt&>(*statements[0]).expression;
+    QuastraValue first = interpreter.evaluate(expression);
+    QuastraValue second = interpreter.evaluate(expression);
+    EXPECT_EQ(std::get<QuastraString>(first).view().data(), std::get<QuastraString>(second).view().data());
+
+    Lexer mixed_lexer("\"a\" + 1;");
+    auto mixed_tokens = mixed_lexer.scan_tokens();
+    Parser mixed_parser(mixed_tokens);
+    auto mixed = mixed_parser.parse();
+    EXPECT_THROW(interpreter.evaluate(*static_cast<AST::ExprStmt&>(*mixed[0]).expression), std::runtime_error);
+}
+
+TEST(InterpreterEnvironmentCollectorTest, ReclaimsClosureCycles) {
+    std::string source = R"(
+        fn make_counter() {
+            let mut count = 0;
+            fn next() {
+                count = count + 1;
+                return count;
+            }
+            return next;
+        }
+        fn churn(n) {
+            fn helper() {
+                return n;
+            }
+            return helper();
+        }
+        let counter = make_counter();
+        let mut i = 0;
+        while (i < 5000) {
+            churn(i);
+            i = i + 1;
+        }
+        counter();
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    size_t before = Environment::live();
+    {
+        Interpreter interpreter;
+        interpreter.interpret(statements);
+        // Each call to churn leaves a cycle behind; collections bound them.
+        EXPECT_LT(Environment::live() - before, 2 * EnvironmentCollector::young_limit + 100);
+        interpreter.collect_environments();
+        EXPECT_LT(Environment::live() - before, 10u);
+
+        // The counter is still reachable from the globals and keeps its state.
+        Lexer call_lexer("counter();");
+        auto call_tokens = call_lexer.scan_tokens();
+        Parser call_parser(call_tokens);
+        auto call = call_parser.parse();
+        auto& expression = *static_cast<AST::ExprStmt&>(*call[0]).expression;
+        EXPECT_EQ(std::get<double>(interpreter.evaluate(expression)), 2.0);
+    }
+    // Globals and functions defined in them form a cycle too.
+    EXPECT_EQ(Environment::live(), before);
+}
+
+TEST(InterpreterEnvironmentCollectorTest, KeepsEnvironmentsTheHostHolds) {
+    Lexer lexer(R"(
+        fn make_adder(n) {
+            fn add(x) {
+                return x + n;
+            }
+            return add;
+        }
+        let add_two = make_adder(2);
+    )");
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    std::shared_ptr<Environment> env;
+    {
+        Interpreter interpreter;
+        interpreter.interpret(statements);
+        env = interpreter.get_environment();
+    }
+    // The interpreter is gone, but the globals it returned keep their closures.
+    Interpreter interpreter;
+    auto add_two = std::get<std::shared_ptr<QuastraCallable>>(env->get({TokenType::Identifier, "add_two", 1}));
+    QuastraValue argument = 3.0;
+    try {
+        add_two->call(interpreter, Arguments(&argument, 1));
+        FAIL() << "add should return a value";
+    } catch (const ReturnException& result) {
+        EXPECT_EQ(std::get<double>(result.value), 5.0);
+    }
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/ir/lowering.hpp"
+#include "lib/ir/verifier.hpp"
+#include "lib/backend/codegen.hpp"
+#include <string>
+
+using namespace Quastra;
+
+// Helper to run lex->parse->lower. Returns false if lowering failed.
+static bool lower_source(const std::string& source, IRLowering& lowering) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    return lowering.lower(statements);
+}
+
+TEST(IRTest, DumpsStraightLineFunction) {
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source("fn add(a, b) { let c = a + b; return c * 2; }", lowering));
+
+    std::string expected =
+R"(fn add(%0: int, %1: int) -> int {
+bb0:
+    %2: int = add %0, %1
+    %3: int = const 2
+    %4: int = mul %2, %3
+    ret %4
+}
+)";
+    ASSERT_EQ(IR::to_string(lowering.get_module()), expected);
+}
+
+TEST(IRTest, LoopVariablesBecomePhis) {
+    std::string source = R"(
+        fn count(n) {
+            let mut i = 0;
+            while (i < n) {
+                i = i + 1;
+            }
+            return i;
+        }
+    )";
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source(source, lowering));
+    std::string dump = IR::to_string(lowering.get_module());
+    EXPECT_NE(dump.find("%2: int = phi [%1, bb0], [%5, bb2]"), std::string::npos) << dump;
+
+    IRVerifier verifier;
+    EXPECT_TRUE(verifier.verify(lowering.get_module()));
+}
+
+TEST(IRTest, IfWithoutElseMergesValues) {
+    std::string source = R"(
+        fn clamp(x) {
+            let mut y = x;
+            if (x > 10) {
+                y = 10;
+            }
+            return y;
+        }
+    )";
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source(source, lowering));
+    std::string dump = IR::to_string(lowering.get_module());
+    EXPECT_NE(dump.find("phi [%3, bb1], [%0, bb0]"), std::string::npos) << dump;
+
+    IRVerifier verifier;
+    EXPECT_TRUE(verifier.verify(lowering.get_module()));
+}
+
+TEST(IRTest, TopLevelLetsBecomeGlobals) {
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source("let limit = 5; fn get() { return limit; }", lowering));
+    std::string dump = IR::to_string(lowering.get_module());
+    EXPECT_NE(dump.find("global @limit: int"), std::string::npos);
+    EXPECT_NE(dump.find("store @limit"), std::string::npos);
+    EXPECT_NE(dump.find("%0: int = load @limit"), std::string::npos);
+}
+
+TEST(IRTest, VerifierRejectsBrokenIR) {
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source("fn f(a) { if (a < 1) { return 1; } return a; }", lowering));
+    IR::Module module = lowering.get_module();
+
+    IRVerifier verifier;
+    ASSERT_TRUE(verifier.verify(module));
+
+    // Drop a predecessor so it no longer matches the branch.
+    module.functions[0].blocks[1].predecessors.clear();
+    EXPECT_FALSE(verifier.verify(module));
+
+    // Use a register before it is defined.
+    module = lowering.get_module();
+    module.functions[0].blocks[0].instructions[1].operands = {2};
+    module.functions[0].blocks[0].instructions[1].op = IR::Opcode::Add;
+    module.functions[0].blocks[0].instructions[1].type = Type::Int;
+    EXPECT_FALSE(verifier.verify(module));
+}
+
+TEST(IRTest, RejectsUnsupportedConstructs) {
+    IRLowering lowering;
+    EXPECT_FALSE(lower_source("fn outer() { fn inner() { return 1; } return 0; }", lowering));
+    EXPECT_FALSE(lower_source("fn f(g) { return g(1); }", lowering));
+}
+
+TEST(IRTest, CodeGenFromIR) {
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source("fn main() { let mut i = 0; while (i < 3) { i = i + 1; } return i; }", lowering));
+    CodeGen codegen;
+    std::string cpp = codegen.generate(lowering.get_module());
+    EXPECT_NE(cpp.find("int main() {"), std::string::npos);
+    EXPECT_NE(cpp.find("r1_in = r0;\n    goto bb1;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("bb1:\n    r1 = r1_in;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("return r1;"), std::string::npos) << cpp;
+}
+
+TEST(IRTest, InfersReturnTypesFromReturns) {
+    std::string source = R"(
+        fn is_even(n) {
+            if (n == 0) {
+                return true;
+            }
+            return is_odd(n - 1);
+        }
+        fn is_odd(n) {
+            if (n == 0) {
+                return false;
+            }
+            return is_even(n - 1);
+        }
+        fn main() {
+            if (is_even(10)) {
+                return 1;
+            }
+            return 0;
+        }
+    )";
+    IRLowering lowering;
+    ASSERT_TRUE(lower_source(source, lowering));
+    std::string dump = IR::to_string(lowering.get_module());
+    EXPECT_NE(dump.find("fn is_even(%0: int) -> bool {"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("fn is_odd(%0: int) -> bool {"), std::string::npos) << dump;
+    EXPECT_NE(dump.find("fn main() -> int {"), std::string::npos) << dump;
+
+    IRVerifier verifier;
+    EXPECT_TRUE(verifier.verify(lowering.get_module()));
+
+    // Returns of both types cannot be given one.
+    EXPECT_FALSE(lower_source("fn f(a) { if (a < 1) { return true; } return a; }", lowering));
+}
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/jit/jit.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    EXPECT_TRUE(resolver.resolve(statements));
+    return statements;
+}
+
+// Runs the program, with the JIT when one is given, and captures its output.
+static std::string run(const std::vector<std::unique_ptr<AST::Stmt>>& statements, BaselineJit* jit) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.set_tier(jit);
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Checks that the program prints the same with and without the JIT, which
+// compiles functions from their second call on, and returns what it
+// compiled.
+static std::vector<std::string> run_both(const std::string& source) {
+    auto statements = parse(source);
+    BaselineJit jit(statements, {1});
+    EXPECT_EQ(run(statements, &jit), run(statements, nullptr));
+    return jit.compiled_functions();
+}
+
+TEST(BaselineJitTest, CompilesNumericRecursion) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        fn factorial(n) {
+            if (n <= 1) {
+                return 1;
+            }
+            return n * factorial(n - 1);
+        }
+        println(fib(15));
+        println(factorial(10));
+        println(factorial(-3));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"factorial", "fib"}));
+}
+
+TEST(BaselineJitTest, CompilesLoopsLocalsAndCallees) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn square(x) {
+            return x * x;
+        }
+        fn sum_squares(n) {
+            let mut total = 0;
+            let mut i = 0;
+            while (i < n) {
+                {
+                    let i = i * 2;
+                    total = total + square(i) / 4;
+                }
+                if (i == 3) {
+                    total = total - 1;
+                } else {
+                    if (i != 4) {
+                        total = -total + 2 * total;
+                    }
+                }
+                i = i + 1;
+            }
+            return total;
+        }
+        fn count(n, acc) {
+            if (n >= 1) {
+                return count(n - 1, acc + 1);
+            }
+            return acc;
+        }
+        println(sum_squares(10));
+        println(sum_squares(12));
+        println(count(100000, 0));
+        println(count(3, 0));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"count", "square", "sum_squares"}));
+}
+
+TEST(BaselineJitTest, LeavesUnsupportedCodeToTheInterpreter) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn noisy(x) {
+            println(x);
+            return x;
+        }
+        fn less(a, b) {
+            return a < b;
+        }
+        fn caller(x) {
+            return noisy(x) + 1;
+        }
+        fn maybe(x) {
+            if (x > 0) {
+                return x;
+            }
+        }
+        fn numeric(x) {
+            return x + 1;
+        }
+        caller(1);
+        caller(2);
+        println(less(1, 2));
+        println(less(2, 1));
+        println(maybe(1));
+        println(maybe(-1));
+        println(numeric(1));
+        println(numeric(true));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"maybe", "numeric"}));
+}
+
+TEST(BaselineJitTest, BailsOutToTheInterpreterForErrors) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn ratio(a, b) {
+            return a / b;
+        }
+        fn nested(a) {
+            return ratio(1, a) + 1;
+        }
+        println(nested(2));
+        println(nested(4));
+        println(nested(0));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"nested", "ratio"}));
+}
+
+TEST(BaselineJitTest, ComparesNaNLikeTheInterpreter) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    run_both(R"(
+        fn classify(a, b) {
+            let mut result = 0;
+            if (a < b) { result = result + 1; }
+            if (a <= b) { result = result + 2; }
+            if (a > b) { result = result + 4; }
+            if (a >= b) { result = result + 8; }
+            if (a == b) { result = result + 16; }
+            if (a != b) { result = result + 32; }
+            return result;
+        }
+        fn nan() {
+            let mut x = 10;
+            let mut i = 0;
+            while (i < 20) {
+                x = x * x;
+                i = i + 1;
+            }
+            return x - x;
+        }
+        println(classify(1, 2));
+        println(classify(2, 2));
+        println(classify(3, 2));
+        println(classify(nan(), 2));
+        println(classify(2, nan()));
+        println(classify(nan(), nan()));
+    )");
+}
+
+TEST(BaselineJitTest, WaitsForCalleesToBeDefined) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn early(x) {
+            if (x > 0) {
+                return later(x);
+            }
+            return 0;
+        }
+        println(early(0));
+        println(early(0));
+        println(early(0));
+        fn later(x) {
+            return x * 2;
+        }
+        println(early(0));
+        println(early(3));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"early", "later"}));
+}
+
+TEST(BaselineJitTest, DeepRecursionFallsBackToTheInterpreter) {
+    if (!BaselineJit::is_supported()) GTEST_SKIP() << "The JIT needs x86-64 Linux.";
+    auto compiled = run_both(R"(
+        fn is_even(n) {
+            if (n == 0) { return 1; }
+            return is_odd(n - 1);
+        }
+        fn is_odd(n) {
+            if (n == 0) { return 0; }
+            return is_even(n - 1);
+        }
+        println(is_even(10));
+        println(is_even(60001));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"is_even", "is_odd"}));
+}
@@ -40,3 +40,13 @@ fn main() -> int {
         EXPECT_EQ(expected_tokens[i], actual_tokens[i]) << "Mismatch at index " << i;
     }
 }
+
+TEST(LexerTest, StringLiterals) {
+    Lexer lexer("let s = \"say \\\"hi\\\"\\n\";\n\"open");
+    std::vector<Token> tokens = lexer.scan_tokens();
+    ASSERT_EQ(tokens.size(), 7u);
+    EXPECT_EQ(tokens[3], (Token{TokenType::StringLiteral, "\"say \\\"hi\\\"\\n\"", 1}));
+    EXPECT_EQ(string_value(tokens[3]), "say \"hi\"\n");
+    // An unterminated string is an error token.
+    EXPECT_EQ(tokens[5], (Token{TokenType::Unknown, "\"open", 2}));
+}
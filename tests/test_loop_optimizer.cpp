@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/optimizer/loop_optimizer.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/backend/codegen.hpp"
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+// Helper to interpret a program and capture its output.
+static std::string interpret(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Optimises the program's loops, checks that it still prints the same thing,
+// and returns the generated C++.
+static std::string optimize_and_check(const std::string& source, int* optimized = nullptr) {
+    auto original = parse(source);
+    auto statements = parse(source);
+    LoopOptimizer loops;
+    int count = loops.run(statements);
+    if (optimized) *optimized = count;
+    EXPECT_EQ(interpret(statements), interpret(original));
+    CodeGen codegen;
+    return codegen.generate(statements);
+}
+
+TEST(LoopOptimizerTest, HoistsInvariantExpressions) {
+    std::string source = R"(
+        fn main() {
+            let limit = 5;
+            let mut i = 0;
+            let mut total = 0;
+            while (i < limit * 2) {
+                total = total + (limit + 1) * 3;
+                i = i + 1;
+            }
+            println(total);
+            return 0;
+        }
+        main();
+    )";
+    std::string cpp = optimize_and_check(source);
+    EXPECT_NE(cpp.find("if ((i < (limit * 2))) {"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto __licm0 = (limit * 2);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("auto __licm1 = ((limit + 1) * 3);"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("while ((i < __licm0))"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(total = (total + __licm1));"), std::string::npos) << cpp;
+}
+
+TEST(LoopOptimizerTest, StrengthReducesInductionProducts) {
+    std::string source = R"(
+        let mut i = 2;
+        let mut sum = 0;
+        while (i < 20) {
+            sum = sum + i * 4;
+            i = i + 3;
+            println(i * 4 - sum);
+        }
+        println(sum);
+    )";
+    std::string cpp = optimize_and_check(source);
+    EXPECT_NE(cpp.find("auto __sr0 = 8;"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(sum = (sum + __sr0));"), std::string::npos) << cpp;
+    EXPECT_NE(cpp.find("(i = (i + 3));\n        (__sr0 = (__sr0 + 12));"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("(i * 4)"), std::string::npos) << cpp;
+}
+
+TEST(LoopOptimizerTest, RespectsShadowingInNestedBlocks) {
+    // Like examples/complex.qstra: the loop redeclares names it also reads.
+    std::string source = R"(
+        fn main() {
+            let scale = 3;
+            let mut counter = 0;
+            while (counter < 5) {
+                let scale = counter;
+                {
+                    let counter = 99;
+                    println(counter * 2 + scale * 2);
+                }
+                counter = counter + 1;
+            }
+            let mut i = 0;
+            while (i < 3) {
+                {
+                    let i = 10;
+                    println(i * 2);
+                }
+                i = i + 1;
+            }
+            return 0;
+        }
+        main();
+    )";
+    int optimized = -1;
+    std::string cpp = optimize_and_check(source, &optimized);
+    EXPECT_EQ(optimized, 0) << cpp;
+    EXPECT_EQ(cpp.find("__licm"), std::string::npos) << cpp;
+    EXPECT_EQ(cpp.find("__sr"), std::string::npos) << cpp;
+}
+
+TEST(LoopOptimizerTest, StopsAtCallsAndFunctionWrites) {
+    std::string source = R"(
+        let mut limit = 4;
+        fn grow() {
+            limit = limit + 1;
+            return 0;
+        }
+        let mut i = 0;
+        while (i < limit * 2) {
+            grow();
+            i = i + 3;
+        }
+        let mut j = 0;
+        while (j < 3) {
+            println(j);
+            let ratio = limit - 1;
+            j = j + 1;
+        }
+        println(i);
+    )";
+    int optimized = -1;
+    std::string cpp = optimize_and_check(source, &optimized);
+    EXPECT_EQ(optimized, 0) << cpp;
+}
+
+TEST(LoopOptimizerTest, DoesNotEvaluateInvariantsOfLoopsThatNeverRun) {
+    std::string source = R"(
+        let text = "a";
+        let mut i = 0;
+        let mut total = 0;
+        while (i < 0) {
+            total = total + text * 2;
+            i = i + 1;
+        }
+        println(total);
+    )";
+    int optimized = 0;
+    optimize_and_check(source, &optimized);
+    EXPECT_EQ(optimized, 1);
+}
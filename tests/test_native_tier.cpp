@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/jit/native_tier.hpp"
+#include "compile_cpp.hpp"
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    EXPECT_TRUE(resolver.resolve(statements));
+    return statements;
+}
+
+// Runs the program, with the native tier when one is given, and captures
+// its output.
+static std::string run(const std::vector<std::unique_ptr<AST::Stmt>>& statements, NativeTier* tier) {
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    Interpreter interpreter;
+    interpreter.set_tier(tier);
+    interpreter.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+// Checks that the program prints the same with and without the native
+// tier, which compiles functions at their second call and waits for the
+// compiler, and returns what it compiled.
+static std::vector<std::string> run_both(const std::string& source) {
+    auto statements = parse(source);
+    NativeTier tier(statements, {1, "g++", true});
+    EXPECT_EQ(run(statements, &tier), run(statements, nullptr));
+    return tier.compiled_functions();
+}
+
+TEST(NativeTierTest, CompilesHotFunctionsAndCallees) {
+    if (!has_compiler()) GTEST_SKIP() << "The native tier needs g++.";
+    auto compiled = run_both(R"(
+        fn square(x) {
+            return x * x;
+        }
+        fn sum_squares(n) {
+            let mut total = 0;
+            let mut i = 0;
+            while (i < n) {
+                total = total + square(i) / 4;
+                i = i + 1;
+            }
+            return total;
+        }
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        println(sum_squares(10));
+        println(sum_squares(7));
+        println(fib(15));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"fib", "square", "sum_squares"}));
+}
+
+TEST(NativeTierTest, BailsOutToTheInterpreter) {
+    if (!has_compiler()) GTEST_SKIP() << "The native tier needs g++.";
+    auto compiled = run_both(R"(
+        fn ratio(a, b) {
+            return a / b;
+        }
+        fn sign(n) {
+            if (n > 0) {
+                return 1;
+            }
+        }
+        fn count(n, total) {
+            if (n <= 0) {
+                return total;
+            }
+            return count(n - 1, total + 1);
+        }
+        println(ratio(1, 2));
+        println(sign(3));
+        println(sign(2));
+        println(sign(-3));
+        println(count(10, 0));
+        println(count(3000, 0));
+        println(ratio(1, 0));
+    )");
+    EXPECT_EQ(compiled, (std::vector<std::string>{"count", "ratio", "sign"}));
+}
+
+TEST(NativeTierTest, LeavesOtherFunctionsInterpreted) {
+    if (!has_compiler()) GTEST_SKIP() << "The native tier needs g++.";
+    auto compiled = run_both(R"(
+        fn shout(n) {
+            println(n);
+            return n;
+        }
+        fn twice(n) {
+            return shout(n) * 2;
+        }
+        fn is_small(n) {
+            return n < 10;
+        }
+        println(twice(2));
+        println(twice(3));
+        println(is_small(2));
+        println(is_small(20));
+    )");
+    EXPECT_TRUE(compiled.empty());
+}
+
+TEST(NativeTierTest, FailedBuildsStayInterpreted) {
+    auto statements = parse(R"(
+        fn add(a, b) {
+            return a + b;
+        }
+        println(add(1, 2));
+        println(add(3, 4));
+    )");
+    NativeTier tier(statements, {1, "false", true});
+    EXPECT_EQ(run(statements, &tier), "3\n7\n");
+    EXPECT_TRUE(tier.compiled_functions().empty());
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/driver/pass_manager.hpp"
+#include "lib/driver/pipeline.hpp"
+#include <string>
+
+using namespace Quastra;
+
+static Program parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    return parser.parse();
+}
+
+static std::vector<std::string> pipeline_for(const PipelineOptions& options) {
+    PassManager manager;
+    EXPECT_TRUE(build_pipeline(manager, options));
+    return manager.pass_names();
+}
+
+TEST(PassManagerTest, RunsPassesInOrderAndRecordsStats) {
+    Program program = parse("let x = 1 + 2; println(x);");
+    PassManager manager(true);
+    std::vector<std::string> order;
+    manager.add_analysis("count", [&](const Program& p) {
+        order.push_back("count");
+        return p.size() == 2;
+    });
+    manager.add_transform("drop-last", [&](Program& p) {
+        order.push_back("drop-last");
+        p.pop_back();
+        return 1;
+    });
+    ASSERT_TRUE(manager.run(program));
+    EXPECT_EQ(order, (std::vector<std::string>{"count", "drop-last"}));
+
+    const auto& stats = manager.get_stats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_TRUE(stats[0].is_analysis);
+    EXPECT_EQ(stats[0].nodes_before, stats[0].nodes_after);
+    EXPECT_EQ(stats[1].changes, 1);
+    EXPECT_LT(stats[1].nodes_after, stats[1].nodes_before);
+}
+
+TEST(PassManagerTest, StopsAtFailingPass) {
+    Program program = parse("let x = 1;");
+    PassManager manager;
+    bool ran_after = false;
+    manager.add_analysis("reject", [](const Program&) { return false; });
+    manager.add_transform("after", [&](Program&) { ran_after = true; return 0; });
+    EXPECT_FALSE(manager.run(program));
+    EXPECT_FALSE(ran_after);
+    EXPECT_EQ(manager.get_stats().size(), 1u);
+}
+
+TEST(PassManagerTest, CountsAllocations) {
+    struct alignas(64) Line {
+        char bytes[64];
+    };
+    PassManager manager(true);
+    manager.measure("allocate", [] {
+        std::vector<std::unique_ptr<int>> values;
+        for (int i = 0; i < 10; ++i) values.push_back(std::make_unique<int>(i));
+        auto line = std::make_unique<Line>(); // Aligned new.
+    });
+    const PassStats& stats = manager.get_stats()[0];
+    EXPECT_GE(stats.allocations, 11u);
+    EXPECT_GE(stats.bytes, 10 * sizeof(int) + sizeof(Line));
+    EXPECT_FALSE(stats.has_nodes);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(std::make_unique<Line>().get()) % alignof(Line), 0u);
+
+    std::string report = manager.report();
+    EXPECT_NE(report.find("allocate"), std::string::npos) << report;
+    EXPECT_NE(report.find("Total"), std::string::npos) << report;
+}
+
+TEST(PassManagerTest, BuildsPipelineForEachLevel) {
+    PipelineOptions options;
+    EXPECT_EQ(pipeline_for(options), (std::vector<std::string>{"resolve"}));
+    options.opt_level = 1;
+    EXPECT_EQ(pipeline_for(options), (std::vector<std::string>{"resolve", "const-eval", "fold", "cse", "dce"}));
+    options.opt_level = 2;
+    options.type_check = true;
+    EXPECT_EQ(pipeline_for(options), (std::vector<std::string>{"resolve", "type-check", "const-eval", "inline",
+                                                               "fold", "cse", "loop-opt", "dce"}));
+
+    options.passes = {"fold", "dce"};
+    EXPECT_EQ(pipeline_for(options), options.passes);
+
+    options.passes = {"fold", "unroll"};
+    PassManager manager;
+    EXPECT_FALSE(build_pipeline(manager, options));
+}
+
+TEST(PassManagerTest, OptimisingPipelineShrinksProgram) {
+    Program program = parse(R"(
+        fn square(x) { return x * x; }
+        fn main() {
+            let unused = square(3);
+            let mut total = 0;
+            let mut i = 0;
+            while (i < 4) {
+                total = total + square(i) + 2 * 3;
+                i = i + 1;
+            }
+            return total;
+        }
+    )");
+    PipelineOptions options;
+    options.opt_level = 2;
+    PassManager manager(true);
+    ASSERT_TRUE(build_pipeline(manager, options));
+    ASSERT_TRUE(manager.run(program));
+    const auto& stats = manager.get_stats();
+    EXPECT_LT(stats.back().nodes_after, stats.front().nodes_before);
+    for (const auto& pass : stats) {
+        if (pass.name == "fold" || pass.name == "dce") {
+            EXPECT_GT(pass.changes, 0) << pass.name;
+        }
+    }
+}
+
+TEST(PassManagerTest, MeasuresOnlyWhenAsked) {
+    Program program = parse("let x = 1 + 2;");
+    PassManager manager;
+    manager.add_transform("fold", [](Program&) { return 1; });
+    manager.measure("allocate", [] { auto value = std::make_unique<int>(1); });
+    ASSERT_TRUE(manager.run(program));
+    const auto& stats = manager.get_stats();
+    ASSERT_EQ(stats.size(), 2u);
+    EXPECT_EQ(stats[0].allocations, 0u);
+    EXPECT_EQ(stats[1].changes, 1);
+    EXPECT_FALSE(stats[1].has_nodes);
+
+    // Allocations outside a measured pass are not counted either.
+    size_t before = allocation_count();
+    auto value = std::make_unique<int>(2);
+    EXPECT_EQ(allocation_count(), before);
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include "lib/runtime/quastra_string.hpp"
+#include <string>
+
+using namespace Quastra;
+
+TEST(QuastraStringTest, SmallAndLargeStrings) {
+    QuastraString empty;
+    EXPECT_TRUE(empty.empty());
+    EXPECT_EQ(empty.view(), "");
+
+    QuastraString small("fifteen chars!!");
+    EXPECT_EQ(small.size(), QuastraString::inline_capacity);
+    EXPECT_EQ(small.view(), "fifteen chars!!");
+
+    std::string text(100, 'x');
+    QuastraString large(text);
+    QuastraString copy = large;
+    EXPECT_EQ(copy.view(), text);
+    // Copies share the buffer.
+    EXPECT_EQ(copy.view().data(), large.view().data());
+    EXPECT_EQ(copy, large);
+    EXPECT_NE(large, QuastraString(std::string(100, 'y')));
+    EXPECT_NE(large, small);
+}
+
+TEST(QuastraStringTest, ConcatenationBuildsRopesOnlyForLongStrings) {
+    QuastraString short_join = QuastraString::concat("abc", "def");
+    EXPECT_FALSE(short_join.is_rope());
+    EXPECT_EQ(short_join.view(), "abcdef");
+
+    QuastraString left(std::string(40, 'a'));
+    QuastraString right(std::string(40, 'b'));
+    QuastraString rope = QuastraString::concat(left, right);
+    QuastraString copy = rope;
+    EXPECT_TRUE(rope.is_rope());
+    EXPECT_EQ(rope.size(), 80u);
+    EXPECT_EQ(rope.view(), std::string(40, 'a') + std::string(40, 'b'));
+    // Reading flattened it for every copy.
+    EXPECT_FALSE(copy.is_rope());
+    EXPECT_EQ(copy.view().data(), rope.view().data());
+}
+
+TEST(QuastraStringTest, DeepRopesFlattenAndDieWithoutRecursion) {
+    std::string expected;
+    QuastraString text;
+    for (int i = 0; i < 200000; ++i) {
+        text = QuastraString::concat(text, "word ");
+        expected += "word ";
+        // Sharing an inner node must not stop it from being flattened.
+        if (i == 100000) {
+            QuastraString middle = text;
+            EXPECT_EQ(middle.view(), expected);
+        }
+    }
+    EXPECT_TRUE(text.is_rope());
+    EXPECT_EQ(text.size(), expected.size());
+    EXPECT_EQ(text, QuastraString(expected));
+
+    QuastraString unread;
+    for (int i = 0; i < 200000; ++i) unread = QuastraString::concat(unread, "word ");
+    unread = QuastraString();
+}
+
+TEST(QuastraStringTest, InterningReturnsOneCopy) {
+    std::string text = "a string literal long enough to need a buffer";
+    const QuastraString& first = QuastraString::intern(text);
+    const QuastraString& second = QuastraString::intern(std::string(text));
+    EXPECT_EQ(&first, &second);
+    EXPECT_EQ(first.view(), text);
+}
@@ -48,3 +48,119 @@ TEST(ResolverTest, ErrorUndefinedVariable) {
     std::string source = "let x = y;";
     ASSERT_FALSE(resolve_source(source));
 }
+
+TEST(ResolverTest, FunctionsParametersAndForwardCalls) {
+    std::string source = R"(
+        fn is_even(n) {
+            if (n == 0) { return true; }
+            return is_odd(n - 1);
+        }
+        fn is_odd(n) {
+            if (n == 0) { return false; }
+            return is_even(n - 1);
+        }
+        fn main() {
+            println(is_even(limit));
+            return 0;
+        }
+        let limit = 10;
+    )";
+    ASSERT_TRUE(resolve_source(source));
+    ASSERT_FALSE(resolve_source("fn f(a) { return b; }"));
+}
+
+TEST(ResolverTest, MarksTailCalls) {
+    std::string source = R"(
+        fn g(x) { return x; }
+        fn f(n, acc) {
+            if (n == 0) {
+                return g(acc);
+            }
+            let h = g;
+            let unused = f(0, 0);
+            return f(n - 1, acc + n);
+        }
+        fn shadowed(n) {
+            let shadowed = g;
+            return shadowed(n);
+        }
+        g(1);
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+
+    auto& f = static_cast<AST::FunctionStmt&>(*statements[1]);
+    auto& base = static_cast<AST::Block&>(*static_cast<AST::IfStmt&>(*f.body[0]).then_branch);
+    auto& to_g = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*base.statements[0]).value);
+    EXPECT_TRUE(to_g.is_tail_call);
+    EXPECT_FALSE(to_g.is_self_call);
+
+    auto& inner = static_cast<AST::Call&>(*static_cast<AST::VarDecl&>(*f.body[2]).initializer);
+    EXPECT_FALSE(inner.is_tail_call);
+
+    auto& to_f = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*f.body[3]).value);
+    EXPECT_TRUE(to_f.is_tail_call);
+    EXPECT_TRUE(to_f.is_self_call);
+
+    auto& shadowed = static_cast<AST::FunctionStmt&>(*statements[2]);
+    auto& to_local = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*shadowed.body[1]).value);
+    EXPECT_TRUE(to_local.is_tail_call);
+    EXPECT_FALSE(to_local.is_self_call);
+
+    auto& top_level = static_cast<AST::Call&>(*static_cast<AST::ExprStmt&>(*statements[3]).expression);
+    EXPECT_FALSE(top_level.is_tail_call);
+}
+
+TEST(ResolverTest, MarksGlobalCalls) {
+    std::string source = R"(
+        fn g(x) { return x; }
+        fn h(x) { return x; }
+        fn f(n) {
+            let a = g(n);
+            fn inner() {
+                return h(1);
+            }
+            let h = g;
+            return println(a);
+        }
+        g(1);
+    )";
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Resolver resolver;
+    ASSERT_TRUE(resolver.resolve(statements));
+
+    auto& f = static_cast<AST::FunctionStmt&>(*statements[2]);
+    auto& to_g = static_cast<AST::Call&>(*static_cast<AST::VarDecl&>(*f.body[0]).initializer);
+    EXPECT_TRUE(to_g.is_global_call);
+
+    // `h` is declared locally after `inner`, which may run after that.
+    auto& inner = static_cast<AST::FunctionStmt&>(*f.body[1]);
+    auto& to_h = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*inner.body[0]).value);
+    EXPECT_FALSE(to_h.is_global_call);
+
+    auto& to_println = static_cast<AST::Call&>(*static_cast<AST::ReturnStmt&>(*f.body[3]).value);
+    EXPECT_TRUE(to_println.is_global_call);
+
+    auto& top_level = static_cast<AST::Call&>(*static_cast<AST::ExprStmt&>(*statements[3]).expression);
+    EXPECT_TRUE(top_level.is_global_call);
+}
+
+TEST(ResolverTest, ErrorReturnFromSpawnedTask) {
+    ASSERT_FALSE(resolve_source("fn f() { spawn { return 1; } }"));
+    // A function declared in a task returns from its own calls.
+    ASSERT_TRUE(resolve_source("fn f() { spawn { fn g() { return 1; } g(); } return 2; }"));
+}
+
+TEST(ResolverTest, ErrorAwaitOutsideAsyncFunction) {
+    ASSERT_FALSE(resolve_source("fn f(x) { return await x; }"));
+    ASSERT_TRUE(resolve_source("async fn f(x) { return await x; } await f(sleep(1));"));
+    // A nested plain function is not async, even in an async one.
+    ASSERT_FALSE(resolve_source("async fn f(x) { fn g() { return await x; } return g(); }"));
+}
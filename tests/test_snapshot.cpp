@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace Quastra;
+
+// Parses a program that may use the globals `machine` has defined.
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source, const VirtualMachine& machine) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(Resolver(machine.global_names()).resolve(statements));
+    return statements;
+}
+
+// Runs the program on `machine` and returns what it prints.
+static std::string run(VirtualMachine& machine, const std::string& source) {
+    auto statements = parse(source, machine);
+    std::stringstream buffer;
+    std::streambuf* old = std::cout.rdbuf(buffer.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(buffer.rdbuf());
+    machine.interpret(statements);
+    std::cout.rdbuf(old);
+    std::cerr.rdbuf(old_err);
+    return buffer.str();
+}
+
+static std::string snapshot_path(const std::string& name) {
+    return ::testing::TempDir() + "quastra_" + name + ".snapshot";
+}
+
+TEST(SnapshotTest, RestoresGlobalsFunctionsAndClosures) {
+    std::string path = snapshot_path("prelude");
+    {
+        VirtualMachine machine;
+        run(machine, R"(
+            let greeting = "hello";
+            let mut ready = true;
+            let limit = 25;
+            fn counter(start) {
+                let mut n = start;
+                fn next() {
+                    n = n + 1;
+                    return n;
+                }
+                return next;
+            }
+            let tick = counter(10);
+            tick();
+            fn fib(n) {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            async fn later(x) {
+                return x * 2;
+            }
+        )");
+        machine.save_snapshot(path);
+    }
+    VirtualMachine machine;
+    machine.restore_snapshot(path);
+    EXPECT_EQ(machine.resume(), VirtualMachine::Status::Finished);
+    EXPECT_EQ(run(machine, R"(
+        println(greeting);
+        println(limit);
+        println(ready);
+        println(tick());
+        println(tick());
+        println(fib(15));
+        println(await later(21));
+        let fresh = counter(0);
+        println(fresh());
+    )"), "hello\n25\ntrue\n12\n13\n610\n42\n1\n");
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, RestoresNativesUnderOtherNames) {
+    std::string path = snapshot_path("natives");
+    {
+        VirtualMachine machine;
+        run(machine, "let say = println; let mut unset = 0;");
+        machine.save_snapshot(path);
+    }
+    VirtualMachine machine;
+    machine.restore_snapshot(path);
+    EXPECT_EQ(run(machine, "say(\"still works\"); unset = 1; println(unset);"), "still works\n1\n");
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, RefusesStateItCannotSave) {
+    std::string path = snapshot_path("refused");
+    VirtualMachine running;
+    running.load(parse("let x = 1;", running));
+    EXPECT_THROW(running.save_snapshot(path), std::runtime_error);
+
+    VirtualMachine with_future;
+    run(with_future, "async fn f() { return 1; } let pending = f();");
+    try {
+        with_future.save_snapshot(path);
+        FAIL() << "saved a future";
+    } catch (const std::runtime_error& error) {
+        EXPECT_STREQ(error.what(), "Cannot save a future in a snapshot.");
+    }
+}
+
+TEST(SnapshotTest, BadFilesLeaveTheMachineAlone) {
+    VirtualMachine machine;
+    run(machine, "let kept = 7;");
+    EXPECT_THROW(machine.restore_snapshot(snapshot_path("missing")), std::runtime_error);
+
+    std::string path = snapshot_path("bad");
+    std::ofstream(path) << "not a snapshot";
+    try {
+        machine.restore_snapshot(path);
+        FAIL() << "restored a text file";
+    } catch (const std::runtime_error& error) {
+        EXPECT_EQ(std::string(error.what()), "'" + path + "' is not a snapshot.");
+    }
+
+    // Cut a real snapshot short.
+    {
+        VirtualMachine saved;
+        run(saved, "fn f(a, b) { return a + b; } let s = \"some text\";");
+        saved.save_snapshot(path);
+    }
+    std::ifstream in(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary) << contents.substr(0, contents.size() - 5);
+    try {
+        machine.restore_snapshot(path);
+        FAIL() << "restored a truncated snapshot";
+    } catch (const std::runtime_error& error) {
+        EXPECT_STREQ(error.what(), "Snapshot is truncated.");
+    }
+    EXPECT_EQ(run(machine, "println(kept);"), "7\n");
+    std::remove(path.c_str());
+}
+
+TEST(SnapshotTest, CorruptSnapshotsAreRejectedOrRunSafely) {
+    std::string path = snapshot_path("fuzz");
+    {
+        VirtualMachine saved;
+        run(saved, R"(
+            let base = 3;
+            fn counter(start) {
+                let mut n = start;
+                fn next() {
+                    n = n + base;
+                    return n;
+                }
+                return next;
+            }
+            let tick = counter(10);
+            fn fib(n) {
+                if (n < 2) return n;
+                return fib(n - 1) + fib(n - 2);
+            }
+            fn pick(a, b) {
+                if (a < b) {
+                    fn inner() { return a; }
+                    return inner();
+                }
+                return b;
+            }
+        )");
+        saved.save_snapshot(path);
+    }
+    std::ifstream in(path, std::ios::binary);
+    const std::string original((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    std::istringstream no_input;
+    std::streambuf* old_in = std::cin.rdbuf(no_input.rdbuf());
+    std::stringstream output;
+    std::streambuf* old_out = std::cout.rdbuf(output.rdbuf());
+    std::streambuf* old_err = std::cerr.rdbuf(output.rdbuf());
+    std::mt19937 random(48);
+    for (int round = 0; round < 400; ++round) {
+        std::string contents = original;
+        // Past the magic and version, which have their own checks.
+        std::uniform_int_distribution<size_t> position(8, contents.size() - 1);
+        if (round % 2) {
+            contents[position(random)] = static_cast<char>(random());
+        } else {
+            size_t at = std::min(position(random), contents.size() - 4);
+            uint32_t word = random() % 3 == 0 ? UINT32_MAX - random() % 4 : random();
+            std::memcpy(&contents[at], &word, sizeof(word));
+        }
+        std::ofstream(path, std::ios::binary) << contents;
+
+        VirtualMachine machine(VmOptions{1000});
+        run(machine, "let kept = 7;");
+        try {
+            machine.restore_snapshot(path);
+        } catch (const std::runtime_error&) {
+            // The machine is as it was.
+            output.str("");
+            machine.interpret(parse("println(kept);", machine));
+            ASSERT_EQ(output.str(), "7\n") << "round " << round;
+            continue;
+        }
+        // Whatever was restored runs without crashing, if not to the end.
+        for (const char* source : {"println(fib(6));", "println(tick());", "println(pick(1, 2));"}) {
+            Lexer lexer(source);
+            auto tokens = lexer.scan_tokens();
+            Parser parser(tokens);
+            auto statements = parser.parse();
+            if (!Resolver(machine.global_names()).resolve(statements)) continue;
+            try {
+                machine.load(statements);
+            } catch (const std::runtime_error&) {
+                continue;
+            }
+            try {
+                machine.resume(100000);
+            } catch (const std::runtime_error&) {
+                // Errors are fine; crashes are not.
+            }
+        }
+    }
+    std::cin.rdbuf(old_in);
+    std::cout.rdbuf(old_out);
+    std::cerr.rdbuf(old_err);
+    std::remove(path.c_str());
+}
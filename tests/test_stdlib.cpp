@@ -1,10 +1,20 @@
 #include <gtest/gtest.h>
 #include "lib/frontend/lexer.hpp"
 #include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/closure_engine.hpp"
 #include "lib/interpreter/interpreter.hpp"
+#include "lib/runtime/core_io.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include "native_fixture.hpp"
+#include <cmath>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <streambuf>
+#include <thread>
+#include <vector>
 
 using namespace Quastra;
 
@@ -30,3 +40,151 @@ TEST(StdLibTest, PrintlnFunction) {
     // Verify that the captured output is correct.
     ASSERT_EQ(captured_output.str(), "123\n");
 }
+
+// Runs the program on every engine, with `input` as stdin, and checks they
+// all print what the Interpreter does. Returns that.
+static std::string run_all(const std::string& source, const std::string& input = "") {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(Resolver().resolve(statements));
+
+    auto run = [&](auto& engine) {
+        std::istringstream in(input);
+        std::ostringstream out;
+        std::streambuf* old_in = std::cin.rdbuf(in.rdbuf());
+        std::streambuf* old_out = std::cout.rdbuf(out.rdbuf());
+        std::streambuf* old_err = std::cerr.rdbuf(out.rdbuf());
+        engine.interpret(statements);
+        std::cin.rdbuf(old_in);
+        std::cout.rdbuf(old_out);
+        std::cerr.rdbuf(old_err);
+        return out.str();
+    };
+    Interpreter interpreter;
+    ClosureEngine closures;
+    VirtualMachine machine;
+    std::string expected = run(interpreter);
+    EXPECT_EQ(run(closures), expected);
+    EXPECT_EQ(run(machine), expected);
+    return expected;
+}
+
+TEST(StdLibTest, PrintWriteAndFlush) {
+    EXPECT_EQ(run_all(R"(
+        print("a");
+        print(1);
+        print(true);
+        println("");
+        let n = write("bytes\n");
+        flush();
+        println(n);
+        println(3 / 2);
+        println(1000000);
+        println(-0 * 1);
+        println(1 / 3);
+    )"), "a1true\nbytes\n6\n1.5\n1e+06\n-0\n0.333333\n");
+    EXPECT_EQ(run_all("write(1);"), "Runtime Error: Argument to write must be a string.\n");
+}
+
+using StdLibNativesTest = NativesTest;
+
+TEST_F(StdLibNativesTest, BoundNatives) {
+    register_native<double(double)>("sqrt", std::sqrt);
+    register_native("exclaim", +[](std::string_view text) { return std::string(text) + "!"; });
+    register_native("within", +[](double value, double low, double high) { return low <= value && value <= high; });
+
+    EXPECT_EQ(run_all(R"(
+        println(sqrt(16));
+        println(exclaim("hi"));
+        println(within(sqrt(2), 1, 2));
+        println(within(3, 1, 2));
+    )"), "4\nhi!\ntrue\nfalse\n");
+    EXPECT_EQ(run_all("sqrt(\"4\");"), "Runtime Error: Argument to sqrt must be a number.\n");
+    EXPECT_EQ(run_all("within(1, true, 2);"), "Runtime Error: Argument 2 to within must be a number.\n");
+    EXPECT_EQ(run_all("sleep(\"1\");"), "Runtime Error: Argument to sleep must be a number.\n");
+
+    const auto* within = native_registry().find("within");
+    ASSERT_NE(within, nullptr);
+    EXPECT_EQ(within->function->arity(), 3);
+    EXPECT_EQ(within->signature.result, Type::Bool);
+    EXPECT_EQ(within->signature.parameters, std::vector<Type>(3, Type::Int));
+}
+
+TEST(StdLibTest, OutputComesBeforeErrors) {
+    EXPECT_EQ(run_all("println(\"before\"); println(1 / 0);"), "before\nRuntime Error: Division by zero.\n");
+}
+
+TEST(StdLibTest, ReadLine) {
+    EXPECT_EQ(run_all(R"(
+        print("name? ");
+        let name = read_line();
+        println("hi " + name);
+        println(read_line());
+        println(read_line());
+    )", "ada\nlast"), "name? hi ada\nlast\nfalse\n");
+}
+
+TEST(StdLibTest, FormatNumberMatchesStreams) {
+    const double values[] = {0, -0.0, 1, -1, 42, 999999, 1000000, -999999, 0.1, 1.5, 2.0 / 3, 1e-7,
+                             123456.7, 1234567, 2664670000, 1e300, -1e-300, std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity()};
+    for (double value : values) {
+        std::ostringstream expected;
+        expected << value;
+        char text[number_buffer_size];
+        EXPECT_EQ(std::string(text, format_number(value, text)), expected.str()) << value;
+    }
+}
+
+TEST(StdLibTest, BufferedWriterHoldsOutputUntilFull) {
+    std::ostringstream out;
+    {
+        BufferedWriter writer(out, 8);
+        writer.write("abc");
+        writer.println(1.0);
+        EXPECT_EQ(out.str(), "");
+        writer.print(QuastraString("defg"));
+        EXPECT_EQ(out.str(), "abc1\ndefg");
+        writer.print(false);
+        writer.flush();
+        EXPECT_EQ(out.str(), "abc1\ndefgfalse");
+
+        writer.set_line_buffered(true);
+        writer.print(QuastraString("x"));
+        EXPECT_EQ(out.str(), "abc1\ndefgfalse");
+        writer.println(QuastraString("y"));
+        EXPECT_EQ(out.str(), "abc1\ndefgfalsexy\n");
+
+        writer.set_line_buffered(false);
+        writer.set_capacity(0);
+        writer.print(2.0);
+        EXPECT_EQ(out.str(), "abc1\ndefgfalsexy\n2");
+        writer.set_capacity(1024);
+        writer.print(3.0);
+    }
+    // Destroying the writer flushes it.
+    EXPECT_EQ(out.str(), "abc1\ndefgfalsexy\n23");
+}
+
+TEST(StdLibTest, BufferedWriterKeepsLinesWhole) {
+    std::ostringstream out;
+    BufferedWriter writer(out, 64);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&writer, t] {
+            for (int i = 0; i < 500; ++i) writer.println(QuastraString(std::string(10, static_cast<char>('a' + t))));
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    writer.flush();
+    std::istringstream lines(out.str());
+    std::string line;
+    int count = 0;
+    while (std::getline(lines, line)) {
+        EXPECT_EQ(line, std::string(10, line[0]));
+        count++;
+    }
+    EXPECT_EQ(count, 2000);
+}
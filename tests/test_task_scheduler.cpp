@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/runtime/task_scheduler.hpp"
+#include "capture_output.hpp"
+#include "native_fixture.hpp"
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace Quastra;
+
+static std::string run(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(Resolver().resolve(statements));
+    CaptureOutput output;
+    {
+        Interpreter interpreter;
+        interpreter.interpret(statements);
+    }
+    return output.str();
+}
+
+TEST(TaskSchedulerTest, RunsEveryTask) {
+    TaskScheduler scheduler(4);
+    std::atomic<int> count{0};
+    TaskGroup group(scheduler);
+    for (int i = 0; i < 1000; ++i) {
+        // Tasks spawned by tasks land on the worker's own deque.
+        group.spawn([&] {
+            count++;
+            group.spawn([&] { count++; });
+        });
+    }
+    group.wait();
+    EXPECT_EQ(count.load(), 2000);
+    EXPECT_FALSE(group.failed());
+}
+
+TEST(TaskSchedulerTest, KeepsTheFirstError) {
+    TaskScheduler scheduler(2);
+    TaskGroup group(scheduler);
+    group.spawn([] {});
+    group.spawn([] { throw std::runtime_error("Task failed."); });
+    group.wait();
+    EXPECT_TRUE(group.failed());
+    EXPECT_EQ(group.error(), "Task failed.");
+}
+
+TEST(TaskSchedulerTest, RethrowsOtherExceptionsFromWait) {
+    TaskScheduler scheduler(2);
+    TaskGroup group(scheduler);
+    group.spawn([] { throw std::bad_alloc(); });
+    group.spawn([] { throw std::runtime_error("Task failed."); });
+    EXPECT_THROW(group.wait(), std::bad_alloc);
+    EXPECT_TRUE(group.failed());
+    // Both tasks were counted as finished, and the exception is only
+    // rethrown once.
+    group.wait();
+}
+
+using TaskSchedulerNativesTest = NativesTest;
+
+TEST_F(TaskSchedulerNativesTest, MainSpawnsTasksOutsideScopes) {
+    register_native("in_task", +[] { return TaskScheduler::concurrent(); });
+    Lexer lexer(R"(
+        let mut seen = false;
+        fn main() {
+            spawn {
+                seen = in_task();
+            }
+            return 3;
+        }
+    )");
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    Interpreter interpreter;
+    interpreter.interpret(statements);
+
+    // As main.cpp calls it, after the program has run.
+    AST::Call call(std::make_unique<AST::Variable>(Token{TokenType::Identifier, "main", 0}),
+                   Token{TokenType::RightParen, ")", 0}, {});
+    EXPECT_EQ(std::get<double>(interpreter.evaluate_joined(call)), 3.0);
+    AST::Variable seen(Token{TokenType::Identifier, "seen", 0});
+    EXPECT_TRUE(std::get<bool>(interpreter.evaluate(seen)));
+}
+
+TEST(TaskSchedulerTest, ScopeJoinsSpawnedTasks) {
+    EXPECT_EQ(run(R"(
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        let mut a = 0;
+        let mut b = 0;
+        scope {
+            spawn {
+                a = fib(15);
+            }
+            spawn {
+                let n = 16;
+                b = fib(n);
+            }
+        }
+        println(a + b);
+    )"), "1597\n");
+}
+
+TEST(TaskSchedulerTest, NestedScopesDoNotDeadlock) {
+    EXPECT_EQ(run(R"(
+        fn leaves(depth) {
+            if (depth == 0) {
+                return 1;
+            }
+            let mut left = 0;
+            let mut right = 0;
+            scope {
+                spawn {
+                    left = leaves(depth - 1);
+                }
+                spawn {
+                    right = leaves(depth - 1);
+                }
+            }
+            return left + right;
+        }
+        println(leaves(7));
+    )"), "128\n");
+}
+
+TEST(TaskSchedulerTest, ReportsTaskErrors) {
+    EXPECT_EQ(run(R"(
+        scope {
+            spawn {
+                println(1 / 0);
+            }
+        }
+        println("not reached");
+    )"), "Runtime Error: Division by zero.\n");
+    // Tasks outside any scope are joined, and their errors reported, when
+    // the program ends.
+    EXPECT_EQ(run(R"(
+        spawn {
+            println("task");
+        }
+    )"), "task\n");
+    EXPECT_EQ(run("spawn { println(-true); }"), "Runtime Error: Operand must be a number for unary minus.\n");
+    // Returning out of a scope still joins it and reports its tasks' errors.
+    EXPECT_EQ(run(R"(
+        fn f() {
+            scope {
+                spawn {
+                    let x = 1 / 0;
+                }
+                return 5;
+            }
+            return 0;
+        }
+        println(f());
+    )"), "Runtime Error: Division by zero.\n");
+}
+
+TEST(TaskSchedulerTest, ParsesTaskBlocks) {
+    Lexer lexer("scope { spawn { let x = 1; } }");
+    auto tokens = lexer.scan_tokens();
+    EXPECT_EQ(tokens[0].type, TokenType::Scope);
+    EXPECT_EQ(tokens[2].type, TokenType::Spawn);
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    ASSERT_EQ(statements.size(), 1u);
+    auto& scope = static_cast<AST::Block&>(*statements[0]);
+    EXPECT_EQ(scope.kind, AST::BlockKind::Scope);
+    ASSERT_EQ(scope.statements.size(), 1u);
+    EXPECT_EQ(static_cast<AST::Block&>(*scope.statements[0]).kind, AST::BlockKind::Spawn);
+}
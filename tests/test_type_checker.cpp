@@ -2,6 +2,7 @@
 #include "lib/frontend/lexer.hpp"
 #include "lib/frontend/parser.hpp"
 #include "lib/semantic/type_checker.hpp"
+#include "native_fixture.hpp"
 #include <string>
 
 using namespace Quastra;
@@ -45,3 +46,23 @@ TEST(TypeCheckerTest, ErrorReturnFromTopLevel) {
     std::string source = "return 10;";
     ASSERT_FALSE(type_check(source));
 }
+
+using TypeCheckerNativesTest = NativesTest;
+
+TEST_F(TypeCheckerNativesTest, NativeCallsAreChecked) {
+    register_native("repeat", +[](std::string_view text, double times) {
+        std::string result;
+        for (int i = 0; i < times; ++i) result += text;
+        return result;
+    });
+    ASSERT_TRUE(type_check(R"(
+        println(1);
+        let s = repeat("ab", 3) + "c";
+        println(write(s) + 1);
+    )"));
+    ASSERT_FALSE(type_check("repeat(3, \"ab\");"));
+    ASSERT_FALSE(type_check("repeat(\"ab\");"));
+    ASSERT_FALSE(type_check("let n = repeat(\"ab\", 2) * 2;"));
+    // Programs may define their own function of the same name.
+    ASSERT_TRUE(type_check("fn repeat(a) { return a; } repeat(1);"));
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include "lib/frontend/lexer.hpp"
+#include "lib/frontend/parser.hpp"
+#include "lib/semantic/resolver.hpp"
+#include "lib/interpreter/interpreter.hpp"
+#include "lib/vm/virtual_machine.hpp"
+#include "capture_output.hpp"
+#include <string>
+
+using namespace Quastra;
+
+static std::vector<std::unique_ptr<AST::Stmt>> parse(const std::string& source) {
+    Lexer lexer(source);
+    auto tokens = lexer.scan_tokens();
+    Parser parser(tokens);
+    auto statements = parser.parse();
+    EXPECT_TRUE(Resolver().resolve(statements));
+    return statements;
+}
+
+template <typename Engine>
+static std::string run(const std::vector<std::unique_ptr<AST::Stmt>>& statements) {
+    CaptureOutput output;
+    Engine engine;
+    engine.interpret(statements);
+    return output.str();
+}
+
+// Checks that the machine prints what the Interpreter does and returns it.
+static std::string run_both(const std::string& source) {
+    auto statements = parse(source);
+    std::string expected = run<Interpreter>(statements);
+    EXPECT_EQ(run<VirtualMachine>(statements), expected);
+    return expected;
+}
+
+TEST(VirtualMachineTest, MatchesTheInterpreter) {
+    std::string output = run_both(R"(
+        fn fib(n) {
+            if (n < 2) {
+                return n;
+            }
+            return fib(n - 2) + fib(n - 1);
+        }
+        fn make_counter() {
+            let mut count = 0;
+            fn next() {
+                count = count + 1;
+                return count;
+            }
+            return next;
+        }
+        let mut i = 0;
+        let mut total = 0;
+        while (i < 10) {
+            let half = i / 2;
+            total = total + i * 2 - half;
+            i = i + 1;
+        }
+        println(total);
+        println(fib(12));
+        println(!(i != 10) == (i >= 10));
+        let counter = make_counter();
+        counter();
+        println(counter());
+        println("con" + "cat");
+        fn noop() {}
+        println(noop());
+    )");
+    EXPECT_EQ(output, "67.5\n144\ntrue\n2\nconcat\nfalse\n");
+}
+
+TEST(VirtualMachineTest, RuntimeErrorsMatchTheInterpreter) {
+    EXPECT_EQ(run_both("println(1 / 0);"), "Runtime Error: Division by zero.\n");
+    EXPECT_EQ(run_both("println(-true);"), "Runtime Error: Operand must be a number for unary minus.\n");
+    EXPECT_EQ(run_both("let f = 1; f();"), "Runtime Error: Can only call functions and classes.\n");
+    EXPECT_EQ(run_both("fn f(a) { return a; } f();"), "Runtime Error: Expected 1 arguments but got 0.\n");
+    EXPECT_EQ(run_both("fn f() { return late; } println(f()); let late = 1;"),
+              "Runtime Error: Undefined variable 'late'.\n");
+}
+
+TEST(VirtualMachineTest, RecursesBeyondTheNativeStack) {
+    auto statements = parse(R"(
+        fn depth(n) {
+            if (n == 0) {
+                return 0;
+            }
+            return 1 + depth(n - 1);
+        }
+        fn count(n, acc) {
+            if (n == 0) {
+                return acc;
+            }
+            return count(n - 1, acc + 1);
+        }
+        println(depth(50000));
+        println(count(100000, 0));
+    )");
+    EXPECT_EQ(run<VirtualMachine>(statements), "50000\n100000\n");
+}
+
+TEST(VirtualMachineTest, ReportsTheCallDepthLimit) {
+    auto statements = parse(R"(
+        fn forever(n) {
+            return 1 + forever(n + 1);
+        }
+        println("before");
+        forever(0);
+        println("after");
+    )");
+    CaptureOutput output;
+    VirtualMachine machine({1000});
+    machine.interpret(statements);
+    EXPECT_EQ(output.str(), "before\nRuntime Error: Call depth limit exceeded.\n");
+    EXPECT_EQ(machine.call_depth(), 0u);
+}
+
+TEST(VirtualMachineTest, SuspendsAndResumes) {
+    auto first = parse(R"(
+        fn count(label, n) {
+            let mut i = 0;
+            while (i < n) {
+                println(label + i);
+                i = i + 1;
+            }
+        }
+        count(100, 3);
+    )");
+    auto second = parse(R"(
+        let mut i = 0;
+        while (i < 3) {
+            println(200 + i);
+            i = i + 1;
+        }
+    )");
+    CaptureOutput output;
+    VirtualMachine a;
+    VirtualMachine b;
+    a.load(first);
+    b.load(second);
+    // Round-robin both scripts until they finish.
+    size_t rounds = 0;
+    bool a_done = false;
+    bool b_done = false;
+    while (!a_done || !b_done) {
+        if (!a_done) a_done = a.resume(12) == VirtualMachine::Status::Finished;
+        if (!b_done) b_done = b.resume(12) == VirtualMachine::Status::Finished;
+        rounds++;
+    }
+    EXPECT_GT(rounds, 3u);
+    std::string text = output.str();
+    EXPECT_LT(text.find("200\n"), text.find("102\n")); // Interleaved, not one after the other.
+    for (const char* line : {"100\n", "101\n", "102\n", "200\n", "201\n", "202\n"}) {
+        EXPECT_NE(text.find(line), std::string::npos) << line;
+    }
+    EXPECT_EQ(a.resume(), VirtualMachine::Status::Finished);
+}
+
+TEST(VirtualMachineTest, CallsFunctionsFromTheHost) {
+    VirtualMachine machine;
+    machine.interpret(parse("fn add(a, b) { return a + b; } fn fail() { return 1 / 0; }"));
+    const QuastraValue* add = machine.get_global("add");
+    ASSERT_NE(add, nullptr);
+    EXPECT_EQ(std::get<double>(machine.call(std::get<std::shared_ptr<QuastraCallable>>(*add), {2.0, 3.0})), 5.0);
+    const QuastraValue* fail = machine.get_global("fail");
+    ASSERT_NE(fail, nullptr);
+    EXPECT_THROW(machine.call(std::get<std::shared_ptr<QuastraCallable>>(*fail), {}), std::runtime_error);
+    EXPECT_EQ(machine.call_depth(), 0u);
+    EXPECT_EQ(machine.get_global("missing"), nullptr);
+}
+
+TEST(VirtualMachineTest, FreesFunctionsAndFramesWithTheMachine) {
+    std::weak_ptr<QuastraCallable> function;
+    std::weak_ptr<QuastraCallable> nested;
+    {
+        VirtualMachine machine;
+        machine.interpret(parse(R"(
+            let limit = 3;
+            fn below(n) { return n < limit; }
+            fn outer() {
+                fn inner() { return inner; }
+                return inner;
+            }
+            let kept = outer();
+        )"));
+        function = std::get<std::shared_ptr<QuastraCallable>>(*machine.get_global("below"));
+        nested = std::get<std::shared_ptr<QuastraCallable>>(*machine.get_global("kept"));
+    }
+    EXPECT_TRUE(function.expired());
+    EXPECT_TRUE(nested.expired());
+}